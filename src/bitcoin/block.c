@@ -1,17 +1,12 @@
 #include "block.h"
 #include "../sha256.h"
 
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include "sha256.h"
 #include "job.h"
 
-static int hex_val(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
-    if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
-    return -1;
-}
-
 void double_sha256(const uint8_t *data, size_t len, uint8_t out[32]) {
     uint8_t tmp[32];
     sha256_ctx ctx;
@@ -24,21 +19,6 @@ void double_sha256(const uint8_t *data, size_t len, uint8_t out[32]) {
     sha256_final(&ctx, out);
 }
 
-int hex_to_bytes(const char *hex, uint8_t *out, size_t out_cap, size_t *out_len) {
-    size_t len = strlen(hex);
-    if (len % 2 != 0) return 0;
-    size_t needed = len / 2;
-    if (needed > out_cap) return 0;
-    for (size_t i = 0; i < needed; i++) {
-        int hi = hex_val(hex[i * 2]);
-        int lo = hex_val(hex[i * 2 + 1]);
-        if (hi < 0 || lo < 0) return 0;
-        out[i] = (uint8_t)((hi << 4) | lo);
-    }
-    if (out_len) *out_len = needed;
-    return 1;
-}
-
 static int merkle_combine(const uint8_t left[32], const uint8_t right[32], uint8_t out[32]) {
     uint8_t buf[64];
     memcpy(buf, left, 32);
@@ -47,42 +27,193 @@ static int merkle_combine(const uint8_t left[32], const uint8_t right[32], uint8
     return 1;
 }
 
-int bitcoin_build_merkle_root(const bitcoin_job *job,
-                              const char *extranonce1_hex,
-                              const uint8_t *extranonce2,
-                              size_t extranonce2_len,
-                              uint8_t out[32]) {
-    if (!job || !extranonce1_hex || !out) return 0;
-
-    uint8_t coinb1[512];
-    uint8_t coinb2[512];
-    uint8_t ex1[64];
-    size_t coinb1_len = 0, coinb2_len = 0, ex1_len = 0;
-    if (!hex_to_bytes(job->coinb1, coinb1, sizeof(coinb1), &coinb1_len)) return 0;
-    if (!hex_to_bytes(job->coinb2, coinb2, sizeof(coinb2), &coinb2_len)) return 0;
-    if (!hex_to_bytes(extranonce1_hex, ex1, sizeof(ex1), &ex1_len)) return 0;
-
-    size_t coinbase_len = coinb1_len + ex1_len + extranonce2_len + coinb2_len;
-    if (coinbase_len > 2048) return 0;
-    uint8_t coinbase[2048];
-    memcpy(coinbase, coinb1, coinb1_len);
-    memcpy(coinbase + coinb1_len, ex1, ex1_len);
-    if (extranonce2 && extranonce2_len > 0) {
-        memcpy(coinbase + coinb1_len + ex1_len, extranonce2, extranonce2_len);
-    }
-    memcpy(coinbase + coinb1_len + ex1_len + extranonce2_len, coinb2, coinb2_len);
+int bitcoin_compiled_merkle_root(const bitcoin_compiled_job *job,
+                                 const uint8_t *extranonce1, size_t extranonce1_len,
+                                 const uint8_t *extranonce2, size_t extranonce2_len,
+                                 uint8_t out[32]) {
+    if (!job || !out) return 0;
+
+    uint8_t first[32];
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, job->coinb1, job->coinb1_len);
+    if (extranonce1_len) sha256_update(&ctx, extranonce1, extranonce1_len);
+    if (extranonce2_len) sha256_update(&ctx, extranonce2, extranonce2_len);
+    sha256_update(&ctx, job->coinb2, job->coinb2_len);
+    sha256_final(&ctx, first);
 
     uint8_t root[32];
-    double_sha256(coinbase, coinbase_len, root);
+    sha256_init(&ctx);
+    sha256_update(&ctx, first, sizeof(first));
+    sha256_final(&ctx, root);
 
     for (size_t i = 0; i < job->merkle_count; i++) {
-        uint8_t branch[32];
-        size_t branch_len = 0;
-        if (!hex_to_bytes(job->merkle_branch[i], branch, sizeof(branch), &branch_len)) return 0;
-        if (branch_len != 32) return 0;
-        merkle_combine(root, branch, root);
+        merkle_combine(root, job->merkle_branch[i], root);
     }
-
     memcpy(out, root, 32);
     return 1;
 }
+
+void bitcoin_compiled_header(const bitcoin_compiled_job *job, const uint8_t merkle_root[32], uint32_t nonce, uint8_t out[80]) {
+    memcpy(out, job->version, 4);
+    memcpy(out + 4, job->prev_hash, 32);
+    memcpy(out + 36, merkle_root, 32);
+    memcpy(out + 68, job->ntime_bytes, 4);
+    memcpy(out + 72, job->nbits, 4);
+    out[76] = (uint8_t)(nonce & 0xFF);
+    out[77] = (uint8_t)((nonce >> 8) & 0xFF);
+    out[78] = (uint8_t)((nonce >> 16) & 0xFF);
+    out[79] = (uint8_t)((nonce >> 24) & 0xFF);
+}
+
+int bitcoin_target_from_nbits(const uint8_t nbits[4], uint8_t out[32]) {
+    uint8_t exponent = nbits[3];
+    uint32_t mantissa = ((uint32_t)nbits[2] << 16) | ((uint32_t)nbits[1] << 8) | (uint32_t)nbits[0];
+
+    memset(out, 0, 32);
+    if (exponent < 3) return 0;
+    int shift = (int)exponent - 3;
+    int idx = 32 - (shift + 3);
+    if (idx < 0 || idx + 2 >= 32) return 0;
+    out[idx] = (uint8_t)((mantissa >> 16) & 0xFF);
+    out[idx + 1] = (uint8_t)((mantissa >> 8) & 0xFF);
+    out[idx + 2] = (uint8_t)(mantissa & 0xFF);
+    return 1;
+}
+
+int bitcoin_target_from_difficulty(double diff, uint8_t out[32]) {
+    if (diff <= 0.0) return 0;
+    // Difficulty 1 is 0xffff * 2^208 (nbits 0x1d00ffff).
+    long double t = ldexpl(65535.0L / (long double)diff, 208);
+    if (t >= ldexpl(1.0L, 256)) {
+        memset(out, 0xFF, 32);
+        return 1;
+    }
+    for (int i = 0; i < 32; i++) {
+        long double scale = ldexpl(1.0L, 8 * (31 - i));
+        long double b = floorl(t / scale);
+        out[i] = (uint8_t)b;
+        t -= b * scale;
+    }
+    return 1;
+}
+
+int bitcoin_hash_meets_target(const uint8_t hash[32], const uint8_t target[32]) {
+    for (int i = 0; i < 32; i++) {
+        uint8_t h = hash[31 - i];
+        if (h < target[i]) return 1;
+        if (h > target[i]) return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    const uint8_t *p;
+    size_t len;
+    size_t pos;
+} block_reader;
+
+static int read_skip(block_reader *r, size_t n) {
+    if (n > r->len - r->pos) return 0;
+    r->pos += n;
+    return 1;
+}
+
+static int read_varint(block_reader *r, uint64_t *out) {
+    if (r->pos >= r->len) return 0;
+    uint8_t first = r->p[r->pos++];
+    size_t n = first == 0xFD ? 2 : first == 0xFE ? 4 : first == 0xFF ? 8 : 0;
+    if (!n) {
+        *out = first;
+        return 1;
+    }
+    if (n > r->len - r->pos) return 0;
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; i++) v |= (uint64_t)r->p[r->pos + i] << (8 * i);
+    r->pos += n;
+    *out = v;
+    return 1;
+}
+
+// Skips `count` length-prefixed items, each after a fixed part of `fixed`
+// bytes (inputs: outpoint before the script, sequence after it).
+static int skip_items(block_reader *r, uint64_t count, size_t fixed, size_t trailer) {
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t len;
+        if (!read_skip(r, fixed) || !read_varint(r, &len) || len > r->len || !read_skip(r, (size_t)len) ||
+            !read_skip(r, trailer))
+            return 0;
+    }
+    return 1;
+}
+
+// Reads one transaction and hashes its legacy serialization into `txid`.
+static int read_tx(block_reader *r, uint8_t txid[32]) {
+    size_t start = r->pos;
+    if (!read_skip(r, 4)) return 0;
+    int witness = r->pos + 2 <= r->len && r->p[r->pos] == 0 && r->p[r->pos + 1] == 1;
+    if (witness) r->pos += 2;
+    size_t body = r->pos;
+    uint64_t inputs;
+    uint64_t outputs;
+    if (!read_varint(r, &inputs) || !skip_items(r, inputs, 36, 4)) return 0;
+    if (!read_varint(r, &outputs) || !skip_items(r, outputs, 8, 0)) return 0;
+    size_t body_end = r->pos;
+    if (witness) {
+        for (uint64_t i = 0; i < inputs; i++) {
+            uint64_t items;
+            if (!read_varint(r, &items) || !skip_items(r, items, 0, 0)) return 0;
+        }
+    }
+    if (!read_skip(r, 4)) return 0;
+
+    uint8_t first[32];
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, r->p + start, 4);
+    sha256_update(&ctx, r->p + body, body_end - body);
+    sha256_update(&ctx, r->p + r->pos - 4, 4);
+    sha256_final(&ctx, first);
+    sha256_init(&ctx);
+    sha256_update(&ctx, first, sizeof(first));
+    sha256_final(&ctx, txid);
+    return 1;
+}
+
+int bitcoin_block_check(const uint8_t *block, size_t len, uint8_t hash[32], const char **why) {
+    const char *problem = NULL;
+    block_reader r = {block, len, 80};
+    uint64_t count = 0;
+    uint8_t (*txids)[32] = NULL;
+    if (len < 80) {
+        problem = "block-decode-failed";
+    } else {
+        double_sha256(block, 80, hash);
+        if (!read_varint(&r, &count) || count == 0 || count > len / 60) {
+            problem = "bad-blk-length";
+        } else if (!(txids = malloc((size_t)count * sizeof(*txids)))) {
+            problem = "out-of-memory";
+        }
+    }
+    for (uint64_t i = 0; !problem && i < count; i++) {
+        if (!read_tx(&r, txids[i])) problem = "block-decode-failed";
+    }
+    if (!problem && r.pos != len) problem = "block-decode-failed";
+    if (!problem) {
+        // Pairs in place, duplicating the odd one out.
+        size_t n = (size_t)count;
+        while (n > 1) {
+            for (size_t i = 0; i < n; i += 2) {
+                merkle_combine(txids[i], txids[i + 1 < n ? i + 1 : i], txids[i / 2]);
+            }
+            n = (n + 1) / 2;
+        }
+        if (memcmp(txids[0], block + 36, 32) != 0) problem = "bad-txnmrklroot";
+    }
+    uint8_t target[32];
+    if (!problem && !bitcoin_target_from_nbits(block + 72, target)) problem = "bad-diffbits";
+    if (!problem && !bitcoin_hash_meets_target(hash, target)) problem = "high-hash";
+    free(txids);
+    if (why) *why = problem;
+    return problem == NULL;
+}
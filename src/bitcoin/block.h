@@ -6,11 +6,23 @@
 #include "job.h"
 
 void double_sha256(const uint8_t *data, size_t len, uint8_t out[32]);
-int hex_to_bytes(const char *hex, uint8_t *out, size_t out_cap, size_t *out_len);
-int bitcoin_build_merkle_root(const bitcoin_job *job,
-                              const char *extranonce1_hex,
-                              const uint8_t *extranonce2,
-                              size_t extranonce2_len,
-                              uint8_t out[32]);
+
+int bitcoin_compiled_merkle_root(const bitcoin_compiled_job *job,
+                                 const uint8_t *extranonce1, size_t extranonce1_len,
+                                 const uint8_t *extranonce2, size_t extranonce2_len,
+                                 uint8_t out[32]);
+void bitcoin_compiled_header(const bitcoin_compiled_job *job, const uint8_t merkle_root[32], uint32_t nonce, uint8_t out[80]);
+
+// Targets are 32 bytes big-endian; hashes are in the raw double-SHA256 order.
+// nbits is taken in header (little-endian) order.
+int bitcoin_target_from_nbits(const uint8_t nbits[4], uint8_t out[32]);
+int bitcoin_target_from_difficulty(double diff, uint8_t out[32]);
+int bitcoin_hash_meets_target(const uint8_t hash[32], const uint8_t target[32]);
+
+// Checks a serialized block: transaction layout (segwit aware), merkle root
+// against the header and proof of work against its nbits. `hash` receives
+// the block hash; on failure `why` gets the node's reject reason for the
+// first problem (high-hash, bad-txnmrklroot, ...).
+int bitcoin_block_check(const uint8_t *block, size_t len, uint8_t hash[32], const char **why);
 
 #endif
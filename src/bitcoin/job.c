@@ -1,117 +1,91 @@
 #include "job.h"
 
+#include <stdlib.h>
 #include <string.h>
+#include "block.h"
+#include "../hex.h"
 
-static int parse_json_string(const char **p, char *out, size_t out_size) {
-    const char *s = *p;
-    while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r') s++;
-    if (*s != '\"') return 0;
-    s++;  // skip opening quote
-
-    size_t len = 0;
-    while (*s && *s != '\"') {
-        if (len + 1 < out_size) {
-            out[len] = *s;
-            len++;
-        }
-        s++;
+static void reverse_in_place(uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len / 2; i++) {
+        uint8_t tmp = buf[i];
+        buf[i] = buf[len - 1 - i];
+        buf[len - 1 - i] = tmp;
     }
-    if (*s != '\"') return 0;
-    out[len] = '\0';
-    s++;  // skip closing quote
-    *p = s;
-    return 1;
-}
-
-static void skip_ws(const char **p) {
-    while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r') (*p)++;
 }
 
-void bitcoin_job_clear(bitcoin_job *job) {
-    if (!job) return;
-    memset(job, 0, sizeof(*job));
-}
-
-void bitcoin_job_note_notify(bitcoin_job *job) {
-    if (!job) return;
-    job->notify_count++;
+static int decode_exact(json_view hex, uint8_t *out, size_t want) {
+    size_t len = 0;
+    return hex.len == want * 2 && hex_decode(hex.p, hex.len, out, want, &len) && len == want;
 }
 
-void bitcoin_job_set_last_notify(bitcoin_job *job, const char *line, size_t len) {
-    if (!job || !line) return;
-    if (len >= sizeof(job->last_notify)) len = sizeof(job->last_notify) - 1;
-    memcpy(job->last_notify, line, len);
-    job->last_notify[len] = '\0';
-}
+bitcoin_compiled_job *bitcoin_job_from_notify(json_view params) {
+    json_view field[9];
+    json_view raw;
+    json_iter it;
+    if (!json_iter_init(&it, params)) return NULL;
+    for (int i = 0; i < 9; i++) {
+        if (!json_iter_next(&it, &raw)) return NULL;
+        // Every field but the branch list and clean_jobs is a string.
+        if (i == 4 || i == 8) {
+            field[i] = raw;
+        } else if (!json_view_string(raw, &field[i])) {
+            return NULL;
+        }
+    }
+    json_view job_id = field[0], merkle = field[4];
+    if (field[2].len % 2 || field[3].len % 2 || field[7].len != 8) return NULL;
 
-int bitcoin_job_parse_notify(bitcoin_job *job, const char *line, size_t len) {
-    if (!job || !line) return 0;
-    bitcoin_job_clear(job);
-    bitcoin_job_note_notify(job);
-    bitcoin_job_set_last_notify(job, line, len);
+    size_t merkle_count = 0;
+    json_view branch;
+    if (!json_iter_init(&it, merkle)) return NULL;
+    while (json_iter_next(&it, &branch)) merkle_count++;
 
-    // Expect Stratum notify params array:
-    // ["job_id","prevhash","coinb1","coinb2",[merkle...],"version","nbits","ntime",clean_jobs]
-    const char *p = strstr(line, "\"params\"");
-    if (!p) return 0;
-    p = strchr(p, '[');
-    if (!p) return 0;
-    p++;  // move past '['
+    size_t coinb1_len = field[2].len / 2;
+    size_t coinb2_len = field[3].len / 2;
+    size_t total = sizeof(bitcoin_compiled_job) + merkle_count * 32 + coinb1_len + coinb2_len + job_id.len + 1;
+    bitcoin_compiled_job *cj = calloc(1, total);
+    if (!cj) return NULL;
 
-    if (!parse_json_string(&p, job->job_id, sizeof(job->job_id))) return 0;
-    skip_ws(&p);
-    if (*p == ',') p++;
-    if (!parse_json_string(&p, job->prev_hash, sizeof(job->prev_hash))) return 0;
-    skip_ws(&p);
-    if (*p == ',') p++;
-    parse_json_string(&p, job->coinb1, sizeof(job->coinb1));
-    skip_ws(&p);
-    if (*p == ',') p++;
-    parse_json_string(&p, job->coinb2, sizeof(job->coinb2));
-    skip_ws(&p);
-    if (*p == ',') p++;
+    uint8_t *tail = (uint8_t *)(cj + 1);
+    cj->merkle_branch = (uint8_t (*)[32])tail;
+    cj->coinb1 = tail + merkle_count * 32;
+    cj->coinb2 = cj->coinb1 + coinb1_len;
+    cj->job_id = (char *)(cj->coinb2 + coinb2_len);
+    memcpy(cj->job_id, job_id.p, job_id.len);
+    cj->job_id[job_id.len] = '\0';
+    memcpy(cj->ntime, field[7].p, 8);
+    cj->coinb1_len = coinb1_len;
+    cj->coinb2_len = coinb2_len;
+    cj->merkle_count = merkle_count;
+    cj->clean_jobs = json_view_is(field[8], "true");
 
-    // Merkle array
-    skip_ws(&p);
-    if (*p != '[') return 0;
-    p++;
-    job->merkle_count = 0;
-    while (*p && *p != ']') {
-        skip_ws(&p);
-        if (*p == ']') break;
-        if (job->merkle_count < 16) {
-            if (!parse_json_string(&p, job->merkle_branch[job->merkle_count], sizeof(job->merkle_branch[0]))) break;
-            job->merkle_count++;
-        } else {
-            // skip string
-            char dummy[2];
-            if (!parse_json_string(&p, dummy, sizeof(dummy))) break;
-        }
-        skip_ws(&p);
-        if (*p == ',') p++;
+    size_t len = 0;
+    int ok = decode_exact(field[5], cj->version, 4) &&
+             decode_exact(field[1], cj->prev_hash, 32) &&
+             decode_exact(field[7], cj->ntime_bytes, 4) &&
+             decode_exact(field[6], cj->nbits, 4) &&
+             hex_decode(field[2].p, field[2].len, cj->coinb1, coinb1_len, &len) &&
+             hex_decode(field[3].p, field[3].len, cj->coinb2, coinb2_len, &len);
+    json_iter_init(&it, merkle);
+    for (size_t i = 0; ok && i < merkle_count; i++) {
+        json_view hex;
+        ok = json_iter_next(&it, &branch) && json_view_string(branch, &hex) &&
+             decode_exact(hex, cj->merkle_branch[i], 32);
     }
-    if (*p == ']') p++;
-    skip_ws(&p);
-    if (*p == ',') p++;
-
-    parse_json_string(&p, job->version, sizeof(job->version));
-    skip_ws(&p);
-    if (*p == ',') p++;
-    parse_json_string(&p, job->nbits, sizeof(job->nbits));
-    skip_ws(&p);
-    if (*p == ',') p++;
-    parse_json_string(&p, job->ntime, sizeof(job->ntime));
-    skip_ws(&p);
-    if (*p == ',') p++;
-
-    // clean_jobs boolean
-    skip_ws(&p);
-    if (strncmp(p, "true", 4) == 0) {
-        job->clean_jobs = 1;
-    } else {
-        job->clean_jobs = 0;
+    if (!ok) {
+        free(cj);
+        return NULL;
     }
 
-    job->parsed = 1;
-    return 1;
+    // Header fields are little-endian; stratum sends the prevhash as
+    // byte-swapped 32-bit words and the rest as big-endian hex.
+    reverse_in_place(cj->version, 4);
+    reverse_in_place(cj->ntime_bytes, 4);
+    reverse_in_place(cj->nbits, 4);
+    for (size_t i = 0; i < 32; i += 4) reverse_in_place(cj->prev_hash + i, 4);
+    return cj;
+}
+
+void bitcoin_compiled_job_free(bitcoin_compiled_job *cj) {
+    free(cj);
 }
@@ -3,26 +3,30 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include "json.h"
 
-typedef struct {
-    char job_id[128];
-    char prev_hash[80];
-    char coinb1[256];
-    char coinb2[256];
-    char merkle_branch[16][70];
+// Binary form of a notify, decoded once so workers never touch hex. The
+// variable-length parts (job id, coinbase halves, branches) live in the same
+// allocation, so nothing is capped or truncated.
+typedef struct bitcoin_compiled_job {
+    char *job_id;
+    char ntime[9];
+    uint8_t version[4];
+    uint8_t prev_hash[32];
+    uint8_t ntime_bytes[4];
+    uint8_t nbits[4];
+    uint8_t *coinb1;
+    size_t coinb1_len;
+    uint8_t *coinb2;
+    size_t coinb2_len;
+    uint8_t (*merkle_branch)[32];
     size_t merkle_count;
-    char version[16];
-    char nbits[16];
-    char ntime[16];
     int clean_jobs;
-    int parsed;
-    uint64_t notify_count;
-    char last_notify[512];
-} bitcoin_job;
+    int refs;
+} bitcoin_compiled_job;
 
-void bitcoin_job_clear(bitcoin_job *job);
-void bitcoin_job_note_notify(bitcoin_job *job);
-void bitcoin_job_set_last_notify(bitcoin_job *job, const char *line, size_t len);
-int bitcoin_job_parse_notify(bitcoin_job *job, const char *line, size_t len);
+// params: ["job_id","prevhash","coinb1","coinb2",[merkle...],"version","nbits","ntime",clean_jobs]
+bitcoin_compiled_job *bitcoin_job_from_notify(json_view params);
+void bitcoin_compiled_job_free(bitcoin_compiled_job *cj);
 
 #endif
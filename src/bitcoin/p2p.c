@@ -0,0 +1,293 @@
+#include "p2p.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include "../net.h"
+#include "../sha256.h"
+#include "../common.h"
+
+#define P2P_HEADER_SIZE 24
+#define P2P_PING_SECS 30.0
+#define P2P_SEND_TIMEOUT_SECS 10
+
+static double p2p_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void put_le(uint64_t v, uint8_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t get_le(const uint8_t *in, size_t n) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; i++) v |= (uint64_t)in[i] << (8 * i);
+    return v;
+}
+
+// First four bytes of SHA256d over the parts.
+static void checksum(const struct iovec *parts, size_t count, uint8_t out[4]) {
+    uint8_t first[32];
+    uint8_t second[32];
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    for (size_t i = 0; i < count; i++) sha256_update(&ctx, parts[i].iov_base, parts[i].iov_len);
+    sha256_final(&ctx, first);
+    sha256_init(&ctx);
+    sha256_update(&ctx, first, sizeof(first));
+    sha256_final(&ctx, second);
+    memcpy(out, second, 4);
+}
+
+static void message_header(const p2p_peer *p, const char *command, size_t len, const uint8_t sum[4],
+                           uint8_t out[P2P_HEADER_SIZE]) {
+    memset(out, 0, P2P_HEADER_SIZE);
+    memcpy(out, p->magic, 4);
+    memcpy(out + 4, command, strlen(command));
+    put_le(len, out + 16, 4);
+    memcpy(out + 20, sum, 4);
+}
+
+// Caller holds p->lock.
+static int send_message(p2p_peer *p, const char *command, const uint8_t *payload, size_t len) {
+    uint8_t head[P2P_HEADER_SIZE];
+    struct iovec iov[2] = {{head, sizeof(head)}, {(void *)payload, len}};
+    uint8_t sum[4];
+    checksum(&iov[1], 1, sum);
+    message_header(p, command, len, sum, head);
+    return p->sock != -1 && net_sendv_all(p->sock, iov, len ? 2 : 1);
+}
+
+static size_t version_payload(const p2p_peer *p, uint8_t *out) {
+    static const char agent[] = "/coinminer:" COINMINER_VERSION "/";
+    size_t n = 0;
+    put_le(P2P_PROTOCOL_VERSION, out + n, 4);
+    n += 4;
+    put_le(0, out + n, 8);  // services: none
+    n += 8;
+    put_le((uint64_t)time(NULL), out + n, 8);
+    n += 8;
+    memset(out + n, 0, 52);  // addr_recv and addr_from, unused by the node
+    n += 52;
+    put_le(((uint64_t)rand() << 32) ^ (uint64_t)rand() ^ (uint64_t)p2p_now(), out + n, 8);
+    n += 8;
+    out[n++] = (uint8_t)(sizeof(agent) - 1);
+    memcpy(out + n, agent, sizeof(agent) - 1);
+    n += sizeof(agent) - 1;
+    put_le((uint32_t)p->start_height, out + n, 4);
+    n += 4;
+    out[n++] = 0;  // relay: no transaction announcements
+    return n;
+}
+
+static void read_version(p2p_peer *p, const uint8_t *payload, size_t len) {
+    if (len < 81) return;
+    p->peer_version = (int)get_le(payload, 4);
+    size_t agent_len = payload[80];
+    if (agent_len < 0xFD && 81 + agent_len <= len) {
+        if (agent_len >= sizeof(p->peer_agent)) agent_len = sizeof(p->peer_agent) - 1;
+        memcpy(p->peer_agent, payload + 81, agent_len);
+        p->peer_agent[agent_len] = '\0';
+    }
+}
+
+static void disconnect(p2p_peer *p) {
+    pthread_mutex_lock(&p->lock);
+    atomic_store(&p->ready, 0);
+    if (p->sock != -1) close(p->sock);
+    p->sock = -1;
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Reads messages until the connection drops or p2p_stop.
+static void run_connection(p2p_peer *p) {
+    net_buffer rx = {0};
+    uint64_t ping_nonce = 0;
+    double ping_sent = 0.0;
+    double last_ping = p2p_now();
+    int sock = p->sock;
+    while (!atomic_load(&p->stop)) {
+        double now = p2p_now();
+        if (atomic_load(&p->ready) && !ping_sent && now - last_ping >= P2P_PING_SECS) {
+            uint8_t nonce[8];
+            put_le(++ping_nonce, nonce, 8);
+            pthread_mutex_lock(&p->lock);
+            int ok = send_message(p, "ping", nonce, sizeof(nonce));
+            pthread_mutex_unlock(&p->lock);
+            if (!ok) break;
+            ping_sent = now;
+            last_ping = now;
+        }
+        // A node that stops answering (no verack, no pong) is dropped so the
+        // thread reconnects instead of writing blocks into a dead socket.
+        double waiting = ping_sent ? now - ping_sent : atomic_load(&p->ready) ? 0.0 : now - last_ping;
+        if (waiting > 2 * P2P_PING_SECS) {
+            fprintf(stderr, "[p2p] %s:%s sem resposta ha %.0fs, reconectando\n", p->host, p->port, waiting);
+            break;
+        }
+        if (!net_buffer_reserve(&rx, 65536)) break;
+        ssize_t n = recv(sock, rx.data + rx.len, rx.cap - rx.len, 0);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            break;
+        }
+        rx.len += (size_t)n;
+
+        int failed = 0;
+        while (!failed && rx.len >= P2P_HEADER_SIZE) {
+            const uint8_t *head = (const uint8_t *)rx.data;
+            uint32_t len = (uint32_t)get_le(head + 16, 4);
+            if (memcmp(head, p->magic, 4) != 0 || len > P2P_MAX_MESSAGE) {
+                fprintf(stderr, "[p2p] mensagem invalida de %s:%s\n", p->host, p->port);
+                failed = 1;
+                break;
+            }
+            if (rx.len < P2P_HEADER_SIZE + (size_t)len) break;
+            const uint8_t *payload = head + P2P_HEADER_SIZE;
+            struct iovec body = {(void *)payload, len};
+            uint8_t sum[4];
+            checksum(&body, 1, sum);
+            char command[13];
+            memcpy(command, head + 4, 12);
+            command[12] = '\0';
+            if (memcmp(sum, head + 20, 4) != 0) {
+                failed = 1;
+            } else if (strcmp(command, "version") == 0) {
+                pthread_mutex_lock(&p->lock);
+                read_version(p, payload, len);
+                failed = !send_message(p, "verack", NULL, 0);
+                pthread_mutex_unlock(&p->lock);
+            } else if (strcmp(command, "verack") == 0) {
+                atomic_store(&p->ready, 1);
+                printf("[p2p] conectado a %s:%s (versao %d, %s)\n", p->host, p->port, p->peer_version, p->peer_agent);
+            } else if (strcmp(command, "ping") == 0 && len >= 8) {
+                pthread_mutex_lock(&p->lock);
+                failed = !send_message(p, "pong", payload, 8);
+                pthread_mutex_unlock(&p->lock);
+            } else if (strcmp(command, "pong") == 0 && len >= 8 && get_le(payload, 8) == ping_nonce && ping_sent) {
+                pthread_mutex_lock(&p->lock);
+                p->ping_rtt = p2p_now() - ping_sent;
+                pthread_mutex_unlock(&p->lock);
+                ping_sent = 0.0;
+            }
+            net_buffer_consume(&rx, P2P_HEADER_SIZE + (size_t)len);
+        }
+        if (failed) break;
+    }
+    net_buffer_free(&rx);
+}
+
+static void *p2p_thread(void *arg) {
+    p2p_peer *p = arg;
+    int attempt = 0;
+    while (!atomic_load(&p->stop)) {
+        int sock = net_connect_tcp(p->host, p->port);
+        if (sock != -1) {
+            int one = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            struct timeval tv = {0, 500000};
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            // A node that stops reading fails a block send instead of
+            // holding p->lock forever.
+            struct timeval send_tv = {P2P_SEND_TIMEOUT_SECS, 0};
+            setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &send_tv, sizeof(send_tv));
+            uint8_t version[128];
+            size_t len = version_payload(p, version);
+            pthread_mutex_lock(&p->lock);
+            p->sock = sock;
+            p->connects++;
+            int ok = send_message(p, "version", version, len);
+            pthread_mutex_unlock(&p->lock);
+            if (ok) {
+                attempt = 0;
+                run_connection(p);
+            }
+            // Unblocks a send in p2p_send_block, which holds the lock that
+            // disconnect needs; the fd stays open until disconnect closes it.
+            shutdown(sock, SHUT_RDWR);
+            int was_ready = atomic_load(&p->ready);
+            disconnect(p);
+            if (was_ready && !atomic_load(&p->stop)) fprintf(stderr, "[p2p] conexao com %s:%s caiu\n", p->host, p->port);
+        }
+        double until = p2p_now() + net_backoff_delay(1.0, ++attempt);
+        while (!atomic_load(&p->stop) && p2p_now() < until) {
+            struct timespec ts = {0, 100000000L};
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+int p2p_start(p2p_peer *p, const char *host, const char *port, const uint8_t magic[4], int32_t start_height) {
+    memset(p, 0, sizeof(*p));
+    snprintf(p->host, sizeof(p->host), "%s", host);
+    snprintf(p->port, sizeof(p->port), "%s", port);
+    memcpy(p->magic, magic, 4);
+    p->start_height = start_height;
+    p->sock = -1;
+    atomic_init(&p->stop, 0);
+    atomic_init(&p->ready, 0);
+    pthread_mutex_init(&p->lock, NULL);
+    if (pthread_create(&p->thread, NULL, p2p_thread, p) != 0) {
+        pthread_mutex_destroy(&p->lock);
+        return 0;
+    }
+    p->started = 1;
+    return 1;
+}
+
+void p2p_stop(p2p_peer *p) {
+    if (!p->started) return;
+    atomic_store(&p->stop, 1);
+    pthread_join(p->thread, NULL);
+    disconnect(p);
+    pthread_mutex_destroy(&p->lock);
+    p->started = 0;
+}
+
+int p2p_send_block(p2p_peer *p, const uint8_t header[80], const struct iovec *parts, size_t count) {
+    if (!atomic_load(&p->ready)) return 0;
+    struct iovec *iov = malloc((count + 1) * sizeof(*iov));
+    if (!iov) return 0;
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+        iov[i + 1] = parts[i];
+        len += parts[i].iov_len;
+    }
+    uint8_t headers[82];
+    headers[0] = 1;
+    memcpy(headers + 1, header, 80);
+    headers[81] = 0;  // no transactions in a headers message
+
+    pthread_mutex_lock(&p->lock);
+    int ok = send_message(p, "headers", headers, sizeof(headers));
+    if (ok) {
+        uint8_t head[P2P_HEADER_SIZE];
+        uint8_t sum[4];
+        checksum(iov + 1, count, sum);
+        message_header(p, "block", len, sum, head);
+        iov[0].iov_base = head;
+        iov[0].iov_len = sizeof(head);
+        ok = net_sendv_all(p->sock, iov, (int)count + 1);
+    }
+    if (ok) {
+        p->blocks++;
+        p->sent_at = p2p_now();
+    } else if (p->sock != -1) {
+        // The reader thread sees the shutdown and reconnects.
+        shutdown(p->sock, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&p->lock);
+    free(iov);
+    return ok;
+}
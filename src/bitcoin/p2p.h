@@ -0,0 +1,48 @@
+#ifndef BITCOIN_P2P_H
+#define BITCOIN_P2P_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define P2P_PROTOCOL_VERSION 70016
+// Largest message accepted from the peer (the node's own limit).
+#define P2P_MAX_MESSAGE (32u << 20)
+
+// Persistent Bitcoin P2P connection used to hand found blocks to a node as
+// binary `block` messages. A background thread does the version/verack
+// handshake, answers pings, pings the node itself for a round-trip time and
+// reconnects with backoff. Everything else the node sends is ignored; the
+// version message asks for no transaction relay.
+typedef struct {
+    char host[256];
+    char port[16];
+    uint8_t magic[4];
+    int32_t start_height;
+    int sock;
+    pthread_mutex_t lock;   // sock, writes and the stats below
+    pthread_t thread;
+    int started;
+    atomic_int stop;
+    atomic_int ready;       // handshake done
+    size_t connects;
+    size_t blocks;
+    int peer_version;
+    char peer_agent[80];
+    double ping_rtt;
+    double sent_at;         // CLOCK_MONOTONIC when the last block was written
+} p2p_peer;
+
+int p2p_start(p2p_peer *p, const char *host, const char *port, const uint8_t magic[4], int32_t start_height);
+void p2p_stop(p2p_peer *p);
+
+// Announces the header in a `headers` message, then sends the block (the
+// serialization in `parts`, header included) as a `block` message. The
+// header goes first because the block message needs the checksum of the
+// whole payload before it can start. Returns 0 when the connection is not
+// up or the write fails.
+int p2p_send_block(p2p_peer *p, const uint8_t header[80], const struct iovec *parts, size_t count);
+
+#endif
@@ -0,0 +1,403 @@
+#include "template.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "block.h"
+#include "../hex.h"
+#include "sha256.h"
+
+static int reserve_bytes(block_template *t, size_t extra) {
+    if (t->bytes_len + extra <= t->bytes_cap) return 1;
+    size_t cap = t->bytes_cap ? t->bytes_cap : 4096;
+    while (cap < t->bytes_len + extra) cap *= 2;
+    uint8_t *bytes = realloc(t->bytes, cap);
+    if (!bytes) return 0;
+    t->bytes = bytes;
+    t->bytes_cap = cap;
+    return 1;
+}
+
+// Decodes a hex string into the arena; returns its offset via `offset`.
+static int append_hex(block_template *t, json_view value, size_t *offset, size_t *len) {
+    json_view hex;
+    if (!json_view_string(value, &hex) || hex.len % 2 != 0) return 0;
+    if (!reserve_bytes(t, hex.len / 2)) return 0;
+    if (!hex_decode(hex.p, hex.len, t->bytes + t->bytes_len, hex.len / 2, len)) return 0;
+    *offset = t->bytes_len;
+    t->bytes_len += *len;
+    return 1;
+}
+
+static int key_is(const char *key, size_t klen, const char *name) {
+    return strlen(name) == klen && memcmp(key, name, klen) == 0;
+}
+
+typedef struct {
+    block_template *t;
+    block_template_tx *tx;
+    int have_data;
+    int have_txid;
+    int have_fee;
+    int ok;
+} tx_parse;
+
+static int tx_member(void *ctx, const char *key, size_t klen, json_view value) {
+    tx_parse *tp = ctx;
+    if (key_is(key, klen, "data")) {
+        if (!append_hex(tp->t, value, &tp->tx->offset, &tp->tx->len)) return tp->ok = 0;
+        tp->have_data = 1;
+    } else if (key_is(key, klen, "txid")) {
+        json_view hex;
+        size_t len = 0;
+        if (!json_view_string(value, &hex) || hex.len != 64 || !hex_decode(hex.p, hex.len, tp->tx->txid, 32, &len))
+            return tp->ok = 0;
+        // RPC shows txids byte-reversed.
+        for (size_t i = 0; i < 16; i++) {
+            uint8_t tmp = tp->tx->txid[i];
+            tp->tx->txid[i] = tp->tx->txid[31 - i];
+            tp->tx->txid[31 - i] = tmp;
+        }
+        tp->have_txid = 1;
+    } else if (key_is(key, klen, "fee")) {
+        tp->t->fees += json_view_int(value);
+        tp->have_fee = 1;
+    }
+    return 1;
+}
+
+static int parse_transactions(block_template *t, json_view array) {
+    // Hex is twice the binary size, so this one reserve covers every tx.
+    if (!reserve_bytes(t, array.len / 2)) return 0;
+    json_iter it;
+    json_view item;
+    if (!json_iter_init(&it, array)) return 0;
+    while (json_iter_next(&it, &item)) {
+        if (t->tx_count == t->tx_cap) {
+            size_t cap = t->tx_cap ? t->tx_cap * 2 : 256;
+            block_template_tx *txs = realloc(t->txs, cap * sizeof(*txs));
+            if (!txs) return 0;
+            t->txs = txs;
+            t->tx_cap = cap;
+        }
+        tx_parse tp = {t, &t->txs[t->tx_count], 0, 0, 0, 1};
+        if (!json_object_each(item, tx_member, &tp) || !tp.ok || !tp.have_data || !tp.have_txid) return 0;
+        if (!tp.have_fee) t->fees_known = 0;
+        t->tx_count++;
+    }
+    return 1;
+}
+
+typedef struct {
+    block_template *t;
+    int have;
+    int ok;
+} template_parse;
+
+enum {
+    HAVE_PREV = 1 << 0,
+    HAVE_BITS = 1 << 1,
+    HAVE_TARGET = 1 << 2,
+    HAVE_VERSION = 1 << 3,
+    HAVE_CURTIME = 1 << 4,
+    HAVE_ALL = (1 << 5) - 1
+};
+
+static int coinbase_member(void *ctx, const char *key, size_t klen, json_view value) {
+    template_parse *tp = ctx;
+    if (!key_is(key, klen, "data")) return 1;
+    if (!append_hex(tp->t, value, &tp->t->coinb1_offset, &tp->t->coinb1_len)) return tp->ok = 0;
+    return 0;
+}
+
+static int template_member(void *ctx, const char *key, size_t klen, json_view value) {
+    template_parse *tp = ctx;
+    block_template *t = tp->t;
+    int ok = 1;
+    if (key_is(key, klen, "previousblockhash")) {
+        ok = json_view_copy(value, t->prev_hash, sizeof(t->prev_hash));
+        tp->have |= HAVE_PREV;
+    } else if (key_is(key, klen, "bits")) {
+        ok = json_view_copy(value, t->bits, sizeof(t->bits));
+        tp->have |= HAVE_BITS;
+    } else if (key_is(key, klen, "target")) {
+        ok = json_view_copy(value, t->target, sizeof(t->target));
+        tp->have |= HAVE_TARGET;
+    } else if (key_is(key, klen, "version")) {
+        t->version = (int)json_view_int(value);
+        tp->have |= HAVE_VERSION;
+    } else if (key_is(key, klen, "curtime")) {
+        t->curtime = (uint32_t)json_view_int(value);
+        tp->have |= HAVE_CURTIME;
+    } else if (key_is(key, klen, "height")) {
+        t->height = (uint32_t)json_view_int(value);
+    } else if (key_is(key, klen, "coinbasevalue")) {
+        t->coinbase_value = json_view_int(value);
+        t->has_coinbase_value = 1;
+    } else if (key_is(key, klen, "default_witness_commitment")) {
+        ok = append_hex(t, value, &t->commitment_offset, &t->commitment_len);
+    } else if (key_is(key, klen, "longpollid")) {
+        // Optional (BIP 22): nodes without long polling leave it out.
+        ok = json_view_copy(value, t->longpollid, sizeof(t->longpollid));
+    } else if (key_is(key, klen, "coinbasetxn")) {
+        ok = json_object_each(value, coinbase_member, tp) && tp->ok;
+    } else if (key_is(key, klen, "transactions")) {
+        ok = parse_transactions(t, value);
+    }
+    if (!ok) tp->ok = 0;
+    return ok;
+}
+
+void block_template_reset(block_template *t) {
+    t->prev_hash[0] = t->bits[0] = t->target[0] = t->longpollid[0] = '\0';
+    t->version = 0;
+    t->curtime = 0;
+    t->height = 0;
+    t->coinbase_value = 0;
+    t->has_coinbase_value = 0;
+    t->fees = 0;
+    t->fees_known = 1;
+    t->coinb1_offset = t->coinb1_len = t->coinb2_offset = t->coinb2_len = 0;
+    t->extranonce_size = 0;
+    t->coinbase_witness = 0;
+    t->commitment_offset = t->commitment_len = 0;
+    t->tx_count = 0;
+    t->bytes_len = 0;
+    t->branch_count = 0;
+}
+
+void block_template_free(block_template *t) {
+    free(t->txs);
+    free(t->bytes);
+    free(t->branch);
+    free(t->scratch);
+    memset(t, 0, sizeof(*t));
+}
+
+static int grow_hashes(uint8_t (**hashes)[32], size_t *cap, size_t need) {
+    if (*cap >= need) return 1;
+    uint8_t (*grown)[32] = realloc(*hashes, need * sizeof(**hashes));
+    if (!grown) return 0;
+    *hashes = grown;
+    *cap = need;
+    return 1;
+}
+
+// Level by level with the coinbase slot left open: the right neighbour of
+// slot 0 is the branch entry, the rest are paired as usual.
+static int build_branch(block_template *t) {
+    size_t count = t->tx_count + 1;
+    size_t depth = 0;
+    while (((size_t)1 << depth) < count) depth++;
+    if (!grow_hashes(&t->scratch, &t->scratch_cap, count) || !grow_hashes(&t->branch, &t->branch_cap, depth + 1)) return 0;
+    for (size_t i = 0; i < t->tx_count; i++) memcpy(t->scratch[i + 1], t->txs[i].txid, 32);
+
+    uint8_t pair[64];
+    t->branch_count = 0;
+    while (count > 1) {
+        memcpy(t->branch[t->branch_count++], t->scratch[1], 32);
+        size_t next = 1;
+        for (size_t i = 2; i < count; i += 2) {
+            memcpy(pair, t->scratch[i], 32);
+            memcpy(pair + 32, t->scratch[i + 1 < count ? i + 1 : i], 32);
+            double_sha256(pair, sizeof(pair), t->scratch[next++]);
+        }
+        count = next;
+    }
+    return 1;
+}
+
+int block_template_parse(block_template *t, json_view result) {
+    block_template_reset(t);
+    template_parse tp = {t, 0, 1};
+    if (!json_object_each(result, template_member, &tp) || !tp.ok) return 0;
+    if ((tp.have & HAVE_ALL) != HAVE_ALL || (t->coinb1_len == 0 && !t->has_coinbase_value)) return 0;
+    return build_branch(t);
+}
+
+static size_t varint_size(uint64_t value) {
+    if (value < 0xFD) return 1;
+    if (value <= 0xFFFF) return 3;
+    if (value <= 0xFFFFFFFF) return 5;
+    return 9;
+}
+
+static size_t append_varint(uint64_t value, uint8_t *out) {
+    size_t n = varint_size(value);
+    if (n == 1) {
+        out[0] = (uint8_t)value;
+        return 1;
+    }
+    out[0] = n == 3 ? 0xFD : n == 5 ? 0xFE : 0xFF;
+    for (size_t i = 1; i < n; i++) out[i] = (uint8_t)(value >> (8 * (i - 1)));
+    return n;
+}
+
+// Script number push as Bitcoin Core's CScript() << n, which BIP 34
+// compares against: OP_0, OP_1..OP_16, else minimal little-endian bytes.
+static size_t push_script_int(uint32_t n, uint8_t *out) {
+    if (n == 0) {
+        out[0] = 0x00;
+        return 1;
+    }
+    if (n <= 16) {
+        out[0] = (uint8_t)(0x50 + n);
+        return 1;
+    }
+    size_t len = 0;
+    uint8_t *digits = out + 1;
+    while (n) {
+        digits[len++] = (uint8_t)(n & 0xFF);
+        n >>= 8;
+    }
+    if (digits[len - 1] & 0x80) digits[len++] = 0x00;
+    out[0] = (uint8_t)len;
+    return len + 1;
+}
+
+static void put_le(uint64_t v, uint8_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = (uint8_t)(v >> (8 * i));
+}
+
+int block_template_build_coinbase(block_template *t, const uint8_t *script, size_t script_len, size_t extranonce_size) {
+    static const uint8_t tag[] = "/coinminer/";
+    const size_t tag_len = sizeof(tag) - 1;
+    if (!t->has_coinbase_value || extranonce_size == 0 || extranonce_size > 32 || script_len == 0) return 0;
+
+    uint8_t height[8];
+    size_t height_len = push_script_int(t->height, height);
+    size_t sig_len = height_len + 1 + extranonce_size + 1 + tag_len;
+    if (sig_len > 100) return 0;
+    if (!reserve_bytes(t, 128 + sig_len + script_len + t->commitment_len)) return 0;
+
+    uint8_t *p = t->bytes + t->bytes_len;
+    t->coinb1_offset = t->bytes_len;
+    put_le(1, p, 4);
+    p += 4;
+    *p++ = 1;
+    memset(p, 0, 32);
+    p += 32;
+    put_le(0xFFFFFFFFu, p, 4);
+    p += 4;
+    p += append_varint(sig_len, p);
+    memcpy(p, height, height_len);
+    p += height_len;
+    *p++ = (uint8_t)extranonce_size;
+    t->coinb1_len = (size_t)(p - (t->bytes + t->coinb1_offset));
+
+    t->coinb2_offset = t->coinb1_offset + t->coinb1_len + extranonce_size;
+    p += extranonce_size;
+    *p++ = (uint8_t)tag_len;
+    memcpy(p, tag, tag_len);
+    p += tag_len;
+    put_le(0xFFFFFFFFu, p, 4);
+    p += 4;
+    *p++ = t->commitment_len ? 2 : 1;
+    put_le((uint64_t)t->coinbase_value, p, 8);
+    p += 8;
+    p += append_varint(script_len, p);
+    memcpy(p, script, script_len);
+    p += script_len;
+    if (t->commitment_len) {
+        put_le(0, p, 8);
+        p += 8;
+        p += append_varint(t->commitment_len, p);
+        memcpy(p, t->bytes + t->commitment_offset, t->commitment_len);
+        p += t->commitment_len;
+    }
+    put_le(0, p, 4);
+    p += 4;
+    t->coinb2_len = (size_t)(p - (t->bytes + t->coinb2_offset));
+    t->bytes_len = (size_t)(p - t->bytes);
+    t->extranonce_size = extranonce_size;
+    t->coinbase_witness = t->commitment_len > 0;
+    return 1;
+}
+
+int block_template_make_empty(block_template *t, const block_template *from, const char *prev_hash, uint32_t curtime) {
+    if (!from->has_coinbase_value || !from->fees_known || from->fees > from->coinbase_value) return 0;
+    block_template_reset(t);
+    if (snprintf(t->prev_hash, sizeof(t->prev_hash), "%s", prev_hash) >= (int)sizeof(t->prev_hash)) return 0;
+    memcpy(t->bits, from->bits, sizeof(t->bits));
+    memcpy(t->target, from->target, sizeof(t->target));
+    t->version = from->version;
+    t->curtime = curtime > from->curtime ? curtime : from->curtime;
+    t->height = from->height + 1;
+    t->coinbase_value = from->coinbase_value - from->fees;
+    t->has_coinbase_value = 1;
+    // No transactions, so no witness commitment is required.
+    return build_branch(t);
+}
+
+void block_template_coinbase_txid(const block_template *t, const uint8_t *extranonce, uint8_t out[32]) {
+    uint8_t first[32];
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, t->bytes + t->coinb1_offset, t->coinb1_len);
+    if (t->extranonce_size) sha256_update(&ctx, extranonce, t->extranonce_size);
+    sha256_update(&ctx, t->bytes + t->coinb2_offset, t->coinb2_len);
+    sha256_final(&ctx, first);
+    sha256_init(&ctx);
+    sha256_update(&ctx, first, sizeof(first));
+    sha256_final(&ctx, out);
+}
+
+void block_template_merkle_root(const block_template *t, const uint8_t coinbase_txid[32], uint8_t out[32]) {
+    uint8_t pair[64];
+    memcpy(out, coinbase_txid, 32);
+    for (size_t i = 0; i < t->branch_count; i++) {
+        memcpy(pair, out, 32);
+        memcpy(pair + 32, t->branch[i], 32);
+        double_sha256(pair, sizeof(pair), out);
+    }
+}
+
+// BIP 141 coinbase: marker and flag after the version, and one witness
+// item (the 32-byte reserved value) before the locktime.
+#define COINBASE_WITNESS_EXTRA (2 + 1 + 1 + 32)
+
+static size_t coinbase_size(const block_template *t) {
+    size_t size = t->coinb1_len + t->extranonce_size + t->coinb2_len;
+    return t->coinbase_witness ? size + COINBASE_WITNESS_EXTRA : size;
+}
+
+size_t block_template_block_size(const block_template *t) {
+    size_t size = 80 + varint_size(t->tx_count + 1) + coinbase_size(t);
+    for (size_t i = 0; i < t->tx_count; i++) size += t->txs[i].len;
+    return size;
+}
+
+static void add_part(struct iovec *out, size_t *n, const void *p, size_t len) {
+    out[*n].iov_base = (void *)p;
+    out[*n].iov_len = len;
+    (*n)++;
+}
+
+size_t block_template_parts(const block_template *t, const uint8_t header[80], const uint8_t *extranonce,
+                            block_template_glue *glue, struct iovec *out) {
+    const uint8_t *coinb1 = t->bytes + t->coinb1_offset;
+    const uint8_t *coinb2 = t->bytes + t->coinb2_offset;
+    size_t n = 0;
+    add_part(out, &n, header, 80);
+    add_part(out, &n, glue->tx_count, append_varint(t->tx_count + 1, glue->tx_count));
+    if (t->coinbase_witness) {
+        glue->marker[0] = 0x00;
+        glue->marker[1] = 0x01;
+        glue->witness[0] = 1;
+        glue->witness[1] = 32;
+        memset(glue->witness + 2, 0, 32);
+        add_part(out, &n, coinb1, 4);
+        add_part(out, &n, glue->marker, 2);
+        add_part(out, &n, coinb1 + 4, t->coinb1_len - 4);
+        if (t->extranonce_size) add_part(out, &n, extranonce, t->extranonce_size);
+        add_part(out, &n, coinb2, t->coinb2_len - 4);
+        add_part(out, &n, glue->witness, 34);
+        add_part(out, &n, coinb2 + t->coinb2_len - 4, 4);
+    } else {
+        add_part(out, &n, coinb1, t->coinb1_len);
+        if (t->extranonce_size) add_part(out, &n, extranonce, t->extranonce_size);
+        if (t->coinb2_len) add_part(out, &n, coinb2, t->coinb2_len);
+    }
+    for (size_t i = 0; i < t->tx_count; i++) add_part(out, &n, t->bytes + t->txs[i].offset, t->txs[i].len);
+    return n;
+}
@@ -0,0 +1,101 @@
+#ifndef BITCOIN_TEMPLATE_H
+#define BITCOIN_TEMPLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "json.h"
+
+typedef struct {
+    size_t offset;      // into block_template.bytes
+    size_t len;
+    uint8_t txid[32];   // internal (hashing) byte order
+} block_template_tx;
+
+// getblocktemplate result decoded in one pass. Coinbase and transaction
+// bytes live in one arena; reset keeps every buffer for the next template,
+// so steady-state parsing does not allocate and nothing is capped.
+//
+// The coinbase is kept in its legacy (txid) serialization split around the
+// extranonce: coinb1 || extranonce || coinb2. A node-supplied coinbasetxn
+// is all coinb1 with no extranonce.
+typedef struct {
+    char prev_hash[65];
+    char bits[9];
+    char target[65];
+    int version;
+    uint32_t curtime;
+    uint32_t height;
+    int64_t coinbase_value;
+    int has_coinbase_value;
+    // Sum of the transactions' "fee" fields; fees_known is cleared when
+    // any transaction lacks one.
+    int64_t fees;
+    int fees_known;
+    char longpollid[256];
+
+    size_t coinb1_offset;
+    size_t coinb1_len;
+    size_t coinb2_offset;
+    size_t coinb2_len;
+    size_t extranonce_size;
+    // Set when the coinbase carries the BIP 141 reserved value.
+    int coinbase_witness;
+    size_t commitment_offset;
+    size_t commitment_len;
+
+    block_template_tx *txs;
+    size_t tx_count;
+    size_t tx_cap;
+
+    uint8_t *bytes;
+    size_t bytes_len;
+    size_t bytes_cap;
+
+    // Siblings of the coinbase on its way to the root, computed once per
+    // transaction set, so a new coinbase costs branch_count hashes.
+    uint8_t (*branch)[32];
+    size_t branch_count;
+    size_t branch_cap;
+    uint8_t (*scratch)[32];
+    size_t scratch_cap;
+} block_template;
+
+void block_template_reset(block_template *t);
+void block_template_free(block_template *t);
+// `result` is the getblocktemplate result object. Needs either coinbasetxn
+// or coinbasevalue (then call block_template_build_coinbase). Also builds
+// the merkle branch.
+int block_template_parse(block_template *t, json_view result);
+
+// Builds the coinbase locally: BIP 34 height and an extranonce_size-byte
+// extranonce in the scriptSig, coinbasevalue paid to `script`, and the
+// default_witness_commitment output when the node sent one.
+int block_template_build_coinbase(block_template *t, const uint8_t *script, size_t script_len, size_t extranonce_size);
+
+// Coinbase-only successor of `from` on top of `prev_hash`: height + 1, same
+// version, bits and target, and the subsidy without fees. Needs
+// from->fees_known; the caller builds the coinbase and checks retargets.
+int block_template_make_empty(block_template *t, const block_template *from, const char *prev_hash, uint32_t curtime);
+
+void block_template_coinbase_txid(const block_template *t, const uint8_t *extranonce, uint8_t out[32]);
+void block_template_merkle_root(const block_template *t, const uint8_t coinbase_txid[32], uint8_t out[32]);
+// The serialized block as a scatter list over the template's own bytes,
+// for gather writes without assembling it. The few bytes the template does
+// not hold (tx count, witness marker and reserved value) go in `glue`,
+// which must outlive the list.
+typedef struct {
+    uint8_t tx_count[9];
+    uint8_t marker[2];
+    uint8_t witness[34];
+} block_template_glue;
+
+#define BLOCK_TEMPLATE_FIXED_PARTS 10
+
+size_t block_template_block_size(const block_template *t);
+// `out` needs tx_count + BLOCK_TEMPLATE_FIXED_PARTS entries; returns how
+// many were used.
+size_t block_template_parts(const block_template *t, const uint8_t header[80], const uint8_t *extranonce,
+                            block_template_glue *glue, struct iovec *out);
+
+#endif
@@ -1,20 +1,20 @@
 #include "cli.h"
 
 #include <errno.h>
-<<<<<<< HEAD
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-=======
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "stratum.h"
 
 static void set_default_wallet(wallet_options *wallet) {
     wallet->path = DEFAULT_WALLET_PATH;
     wallet->reset = 0;
+    wallet->flush_secs = DEFAULT_WALLET_FLUSH_SECS;
+    wallet->history = 0;
+    wallet->since = 0;
+    wallet->limit = DEFAULT_HISTORY_LIMIT;
 }
 
 static void set_default_stratum(stratum_options *s) {
@@ -25,6 +25,26 @@ static void set_default_stratum(stratum_options *s) {
     s->max_reconnects = 5;
     s->reconnect_delay_secs = 5;
     s->coin = COIN_BTC;
+    s->weight = 1.0;
+    s->threads = 0;
+    s->share_rate = 0.0;
+    s->record_path = NULL;
+    s->extra_pool_count = 0;
+}
+
+static void set_default_proxy(proxy_options *p) {
+    p->bind_host = NULL;
+    p->listen_port = NULL;
+    p->host = NULL;
+    p->port = NULL;
+    p->user = NULL;
+    p->password = NULL;
+    p->slice_bytes = 2;
+    p->max_clients = 4096;
+    p->max_reconnects = -1;
+    p->reconnect_delay_secs = 5;
+    p->share_rate = 0.0;
+    p->coin = COIN_BTC;
 }
 
 static void set_default_solo(solo_options *s) {
@@ -33,8 +53,16 @@ static void set_default_solo(solo_options *s) {
     s->user = NULL;
     s->password = NULL;
     s->coin = COIN_BTC;
+    s->threads = 0;
+    s->refresh_secs = 30;
+    s->payout_script = NULL;
+    s->tip_poll_ms = 250;
+    s->speculate = 1;
+    s->extra_node_count = 0;
+    s->p2p_host[0] = '\0';
+    s->p2p_port[0] = '\0';
+    s->p2p_magic = NULL;
 }
->>>>>>> codex/create-readme-for-project-vn5azj
 
 static int parse_int_range(const char *arg, int min, int max, int *out) {
     char *end = NULL;
@@ -56,8 +84,6 @@ static int parse_u64_min(const char *arg, uint64_t min, uint64_t *out) {
     return 1;
 }
 
-<<<<<<< HEAD
-=======
 static int parse_u64_infinite_ok(const char *arg, uint64_t min, uint64_t *out) {
     char *end = NULL;
     errno = 0;
@@ -72,25 +98,93 @@ static int parse_u64_infinite_ok(const char *arg, uint64_t min, uint64_t *out) {
     return 1;
 }
 
->>>>>>> codex/create-readme-for-project-vn5azj
 static void set_default_run(run_options *run) {
     run->data = DEFAULT_DATA;
     run->difficulty = DEFAULT_DIFFICULTY;
     run->max_attempts = DEFAULT_MAX_ATTEMPTS;
     run->progress_interval = DEFAULT_PROGRESS_INTERVAL;
-<<<<<<< HEAD
-=======
     set_default_wallet(&run->wallet);
->>>>>>> codex/create-readme-for-project-vn5azj
 }
 
 static void set_default_bench(bench_options *bench) {
     bench->iterations = DEFAULT_BENCH_ITERATIONS;
     bench->progress_interval = DEFAULT_PROGRESS_INTERVAL;
+    bench->hex = 0;
+}
+
+static int copy_field(char *dst, size_t cap, const char *src, size_t len) {
+    if (len == 0 || len >= cap) return 0;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return 1;
+}
+
+// Shares per minute; 0 turns the controller off.
+static int parse_share_rate(const char *text, double *out, cli_result *res) {
+    char *end = NULL;
+    double v = strtod(text, &end);
+    if (end == text || *end != '\0' || v < 0.0 || v > 6000.0) {
+        snprintf(res->error, sizeof(res->error), "Share rate invalido: %s (use 0-6000 shares/min)", text);
+        return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+// HOST:PORT:USER[:PASSWORD[:WEIGHT]]
+static int parse_pool_spec(const char *spec, stratum_pool_options *out) {
+    const char *fields[5] = {0};
+    size_t lens[5] = {0};
+    int count = 0;
+    const char *p = spec;
+    while (count < 5) {
+        const char *sep = (count < 4) ? strchr(p, ':') : NULL;
+        fields[count] = p;
+        lens[count] = sep ? (size_t)(sep - p) : strlen(p);
+        count++;
+        if (!sep) break;
+        p = sep + 1;
+    }
+    if (count < 3) return 0;
+
+    memset(out, 0, sizeof(*out));
+    if (!copy_field(out->host, sizeof(out->host), fields[0], lens[0])) return 0;
+    if (!copy_field(out->port, sizeof(out->port), fields[1], lens[1])) return 0;
+    if (!copy_field(out->user, sizeof(out->user), fields[2], lens[2])) return 0;
+    if (count >= 4 && lens[3] > 0 && !copy_field(out->password, sizeof(out->password), fields[3], lens[3])) return 0;
+    out->weight = 1.0;
+    if (count >= 5) {
+        char *end = NULL;
+        out->weight = strtod(fields[4], &end);
+        if (end == fields[4] || *end != '\0' || out->weight <= 0.0) return 0;
+    }
+    return 1;
+}
+
+// HOST:PORT[:USER[:PASSWORD]]
+static int parse_node_spec(const char *spec, solo_node_options *out) {
+    const char *fields[4] = {0};
+    size_t lens[4] = {0};
+    int count = 0;
+    const char *p = spec;
+    while (count < 4) {
+        const char *sep = (count < 3) ? strchr(p, ':') : NULL;
+        fields[count] = p;
+        lens[count] = sep ? (size_t)(sep - p) : strlen(p);
+        count++;
+        if (!sep) break;
+        p = sep + 1;
+    }
+    if (count < 2) return 0;
+
+    memset(out, 0, sizeof(*out));
+    if (!copy_field(out->host, sizeof(out->host), fields[0], lens[0])) return 0;
+    if (!copy_field(out->port, sizeof(out->port), fields[1], lens[1])) return 0;
+    if (count >= 3 && lens[2] > 0 && !copy_field(out->user, sizeof(out->user), fields[2], lens[2])) return 0;
+    if (count >= 4 && lens[3] > 0 && !copy_field(out->password, sizeof(out->password), fields[3], lens[3])) return 0;
+    return 1;
 }
 
-<<<<<<< HEAD
-=======
 static int parse_stratum(int argc, char **argv, cli_result *res) {
     set_default_stratum(&res->stratum);
     if (argc < 4) {
@@ -116,12 +210,124 @@ static int parse_stratum(int argc, char **argv, cli_result *res) {
         } else if (strcmp(argv[i], "--coin") == 0 && i + 1 < argc) {
             res->stratum.coin = coin_type_from_name(argv[i + 1]);
             i++;
+        } else if (strcmp(argv[i], "--weight") == 0 && i + 1 < argc) {
+            char *end = NULL;
+            double w = strtod(argv[i + 1], &end);
+            if (end == argv[i + 1] || *end != '\0' || w <= 0.0) {
+                snprintf(res->error, sizeof(res->error), "Peso invalido: %s (use numero > 0)", argv[i + 1]);
+                return 0;
+            }
+            res->stratum.weight = w;
+            i++;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            if (!parse_int_range(argv[i + 1], 0, 256, &res->stratum.threads)) {
+                snprintf(res->error, sizeof(res->error), "Threads invalido: %s (use 0-256, 0 = automatico)", argv[i + 1]);
+                return 0;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--share-rate") == 0 && i + 1 < argc) {
+            if (!parse_share_rate(argv[i + 1], &res->stratum.share_rate, res)) return 0;
+            i++;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            res->stratum.record_path = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--pool") == 0 && i + 1 < argc) {
+            if (res->stratum.extra_pool_count >= STRATUM_MAX_POOLS - 1) {
+                snprintf(res->error, sizeof(res->error), "Maximo de %d pools por processo", STRATUM_MAX_POOLS);
+                return 0;
+            }
+            if (!parse_pool_spec(argv[i + 1], &res->stratum.extra_pools[res->stratum.extra_pool_count])) {
+                snprintf(res->error, sizeof(res->error), "Pool invalido: %s (use host:port:user[:senha[:peso]])", argv[i + 1]);
+                return 0;
+            }
+            res->stratum.extra_pool_count++;
+            i++;
         }
     }
     res->type = CMD_STRATUM;
     return 1;
 }
 
+static int parse_proxy(int argc, char **argv, cli_result *res) {
+    set_default_proxy(&res->proxy);
+    if (argc < 6) {
+        snprintf(res->error, sizeof(res->error), "Uso: %s proxy <listen_port> <pool_host> <pool_port> <user> [password]", argv[0]);
+        return 0;
+    }
+    res->proxy.listen_port = argv[2];
+    res->proxy.host = argv[3];
+    res->proxy.port = argv[4];
+    res->proxy.user = argv[5];
+    int i = 6;
+    if (argc >= 7 && argv[6][0] != '-') {
+        res->proxy.password = argv[6];
+        i = 7;
+    }
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc) {
+            res->proxy.bind_host = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--slice-bytes") == 0 && i + 1 < argc) {
+            if (!parse_int_range(argv[i + 1], 1, 3, &res->proxy.slice_bytes)) {
+                snprintf(res->error, sizeof(res->error), "Slice invalido: %s (use 1-3 bytes)", argv[i + 1]);
+                return 0;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--max-clients") == 0 && i + 1 < argc) {
+            if (!parse_int_range(argv[i + 1], 1, 1 << 24, &res->proxy.max_clients)) {
+                snprintf(res->error, sizeof(res->error), "Max clientes invalido: %s", argv[i + 1]);
+                return 0;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--retries") == 0 && i + 1 < argc) {
+            res->proxy.max_reconnects = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc) {
+            int v = atoi(argv[i + 1]);
+            if (v < 1) v = 1;
+            res->proxy.reconnect_delay_secs = v;
+            i++;
+        } else if (strcmp(argv[i], "--share-rate") == 0 && i + 1 < argc) {
+            if (!parse_share_rate(argv[i + 1], &res->proxy.share_rate, res)) return 0;
+            i++;
+        } else if (strcmp(argv[i], "--coin") == 0 && i + 1 < argc) {
+            res->proxy.coin = coin_type_from_name(argv[i + 1]);
+            i++;
+        }
+    }
+    res->type = CMD_PROXY;
+    return 1;
+}
+
+static int parse_replay(int argc, char **argv, cli_result *res) {
+    res->replay.path = NULL;
+    res->replay.fast = 0;
+    res->replay.threads = 0;
+    res->replay.coin = COIN_BTC;
+    if (argc < 3) {
+        snprintf(res->error, sizeof(res->error), "Uso: %s replay <arquivo> [--fast] [--threads N]", argv[0]);
+        return 0;
+    }
+    res->replay.path = argv[2];
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--fast") == 0) {
+            res->replay.fast = 1;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            if (!parse_int_range(argv[i + 1], 0, 256, &res->replay.threads)) {
+                snprintf(res->error, sizeof(res->error), "Threads invalido: %s (use 0-256, 0 = automatico)", argv[i + 1]);
+                return 0;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--coin") == 0 && i + 1 < argc) {
+            res->replay.coin = coin_type_from_name(argv[i + 1]);
+            i++;
+        }
+    }
+    res->type = CMD_REPLAY;
+    return 1;
+}
+
 static int parse_solo(int argc, char **argv, cli_result *res) {
     set_default_solo(&res->solo);
     if (argc < 6) {
@@ -137,6 +343,52 @@ static int parse_solo(int argc, char **argv, cli_result *res) {
         if (strcmp(argv[i], "--coin") == 0 && i + 1 < argc) {
             res->solo.coin = coin_type_from_name(argv[i + 1]);
             i++;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            if (!parse_int_range(argv[i + 1], 0, 256, &res->solo.threads)) {
+                snprintf(res->error, sizeof(res->error), "Threads invalido: %s (use 0-256, 0 = automatico)", argv[i + 1]);
+                return 0;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--refresh") == 0 && i + 1 < argc) {
+            if (!parse_int_range(argv[i + 1], 1, 3600, &res->solo.refresh_secs)) {
+                snprintf(res->error, sizeof(res->error), "Refresh invalido: %s (use 1-3600 segundos)", argv[i + 1]);
+                return 0;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--payout-script") == 0 && i + 1 < argc) {
+            res->solo.payout_script = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--no-speculate") == 0) {
+            res->solo.speculate = 0;
+        } else if (strcmp(argv[i], "--tip-poll-ms") == 0 && i + 1 < argc) {
+            if (!parse_int_range(argv[i + 1], 0, 60000, &res->solo.tip_poll_ms)) {
+                snprintf(res->error, sizeof(res->error), "Tip poll invalido: %s (use 0-60000 ms)", argv[i + 1]);
+                return 0;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--node") == 0 && i + 1 < argc) {
+            if (res->solo.extra_node_count >= SOLO_MAX_NODES - 1) {
+                snprintf(res->error, sizeof(res->error), "Maximo de %d nodes por processo", SOLO_MAX_NODES);
+                return 0;
+            }
+            if (!parse_node_spec(argv[i + 1], &res->solo.extra_nodes[res->solo.extra_node_count])) {
+                snprintf(res->error, sizeof(res->error), "Node invalido: %s (use host:port[:user[:senha]])", argv[i + 1]);
+                return 0;
+            }
+            res->solo.extra_node_count++;
+            i++;
+        } else if (strcmp(argv[i], "--p2p") == 0 && i + 1 < argc) {
+            solo_node_options peer;
+            if (!parse_node_spec(argv[i + 1], &peer) || peer.user[0] || peer.password[0]) {
+                snprintf(res->error, sizeof(res->error), "Endereco p2p invalido: %s (use host:port)", argv[i + 1]);
+                return 0;
+            }
+            memcpy(res->solo.p2p_host, peer.host, sizeof(res->solo.p2p_host));
+            memcpy(res->solo.p2p_port, peer.port, sizeof(res->solo.p2p_port));
+            i++;
+        } else if (strcmp(argv[i], "--p2p-magic") == 0 && i + 1 < argc) {
+            res->solo.p2p_magic = argv[i + 1];
+            i++;
         }
     }
     res->type = CMD_SOLO;
@@ -154,12 +406,20 @@ static int parse_wallet_flags(int argc, char **argv, int start, wallet_options *
             i++;
         } else if (strcmp(argv[i], "--reset-wallet") == 0) {
             wallet->reset = 1;
+        } else if (strcmp(argv[i], "--wallet-flush") == 0) {
+            char *end = NULL;
+            double v = i + 1 < argc ? strtod(argv[i + 1], &end) : -1.0;
+            if (!end || *end != '\0' || v < 0.0) {
+                snprintf(error, error_len, "Intervalo invalido para --wallet-flush (use segundos >= 0)");
+                return 0;
+            }
+            wallet->flush_secs = v;
+            i++;
         }
     }
     return 1;
 }
 
->>>>>>> codex/create-readme-for-project-vn5azj
 static int parse_run(int argc, char **argv, cli_result *res) {
     set_default_run(&res->run);
 
@@ -171,13 +431,8 @@ static int parse_run(int argc, char **argv, cli_result *res) {
         }
     }
     if (argc >= 5 && argv[4][0] != '-') {
-<<<<<<< HEAD
-        if (!parse_u64_min(argv[4], 1, &res->run.max_attempts)) {
-            snprintf(res->error, sizeof(res->error), "Max tentativas invalido: %s (use inteiro >= 1)", argv[4]);
-=======
         if (!parse_u64_infinite_ok(argv[4], 0, &res->run.max_attempts)) {
             snprintf(res->error, sizeof(res->error), "Max tentativas invalido: %s (use inteiro >= 0)", argv[4]);
->>>>>>> codex/create-readme-for-project-vn5azj
             return 0;
         }
     }
@@ -194,10 +449,6 @@ static int parse_run(int argc, char **argv, cli_result *res) {
             }
             i++;
         }
-<<<<<<< HEAD
-    }
-
-=======
         if (strcmp(argv[i], "--infinite") == 0 || strcmp(argv[i], "-i") == 0) {
             res->run.max_attempts = MAX_ATTEMPTS_INFINITE;
         }
@@ -205,7 +456,6 @@ static int parse_run(int argc, char **argv, cli_result *res) {
 
     if (!parse_wallet_flags(argc, argv, 2, &res->run.wallet, res->error, sizeof(res->error))) return 0;
 
->>>>>>> codex/create-readme-for-project-vn5azj
     res->type = CMD_RUN;
     return 1;
 }
@@ -231,6 +481,8 @@ static int parse_bench(int argc, char **argv, cli_result *res) {
                 return 0;
             }
             i++;
+        } else if (strcmp(argv[i], "--hex") == 0) {
+            res->bench.hex = 1;
         }
     }
 
@@ -238,27 +490,62 @@ static int parse_bench(int argc, char **argv, cli_result *res) {
     return 1;
 }
 
-<<<<<<< HEAD
-=======
+// Unix seconds, or N followed by s/m/h/d for "N ago".
+static int parse_since(const char *arg, int64_t *out) {
+    char *end = NULL;
+    long long v = strtoll(arg, &end, 10);
+    if (end == arg || v < 0) return 0;
+    long long unit = 0;
+    if (*end == '\0') {
+        *out = v;
+        return 1;
+    }
+    if (end[1] != '\0') return 0;
+    switch (*end) {
+        case 's': unit = 1; break;
+        case 'm': unit = 60; break;
+        case 'h': unit = 3600; break;
+        case 'd': unit = 86400; break;
+        default: return 0;
+    }
+    *out = (int64_t)time(NULL) - v * unit;
+    return 1;
+}
+
 static int parse_wallet_cmd(int argc, char **argv, cli_result *res) {
     set_default_wallet(&res->wallet);
     if (!parse_wallet_flags(argc, argv, 2, &res->wallet, res->error, sizeof(res->error))) return 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--history") == 0) {
+            res->wallet.history = 1;
+        } else if (strcmp(argv[i], "--since") == 0) {
+            if (i + 1 >= argc || !parse_since(argv[i + 1], &res->wallet.since)) {
+                snprintf(res->error, sizeof(res->error), "Valor invalido para --since (use segundos unix ou N[s|m|h|d])");
+                return 0;
+            }
+            res->wallet.history = 1;
+            i++;
+        } else if (strcmp(argv[i], "--limit") == 0) {
+            if (i + 1 >= argc || !parse_u64_min(argv[i + 1], 0, &res->wallet.limit)) {
+                snprintf(res->error, sizeof(res->error), "Valor invalido para --limit (use inteiro >= 0)");
+                return 0;
+            }
+            i++;
+        }
+    }
     res->type = CMD_WALLET;
     return 1;
 }
 
->>>>>>> codex/create-readme-for-project-vn5azj
 int parse_command(int argc, char **argv, cli_result *out) {
     memset(out, 0, sizeof(*out));
     out->type = CMD_UNKNOWN;
     set_default_run(&out->run);
     set_default_bench(&out->bench);
-<<<<<<< HEAD
-=======
     set_default_wallet(&out->wallet);
     set_default_stratum(&out->stratum);
+    set_default_proxy(&out->proxy);
     set_default_solo(&out->solo);
->>>>>>> codex/create-readme-for-project-vn5azj
 
     if (argc < 2) {
         snprintf(out->error, sizeof(out->error), "Nenhum comando informado");
@@ -279,18 +566,21 @@ int parse_command(int argc, char **argv, cli_result *out) {
     if (strcmp(argv[1], "bench") == 0) {
         return parse_bench(argc, argv, out);
     }
-<<<<<<< HEAD
-=======
     if (strcmp(argv[1], "wallet") == 0) {
         return parse_wallet_cmd(argc, argv, out);
     }
     if (strcmp(argv[1], "stratum") == 0) {
         return parse_stratum(argc, argv, out);
     }
+    if (strcmp(argv[1], "proxy") == 0) {
+        return parse_proxy(argc, argv, out);
+    }
     if (strcmp(argv[1], "solo") == 0) {
         return parse_solo(argc, argv, out);
     }
->>>>>>> codex/create-readme-for-project-vn5azj
+    if (strcmp(argv[1], "replay") == 0) {
+        return parse_replay(argc, argv, out);
+    }
 
     snprintf(out->error, sizeof(out->error), "Comando desconhecido: %s", argv[1]);
     return 0;
@@ -298,42 +588,60 @@ int parse_command(int argc, char **argv, cli_result *out) {
 
 void print_usage(const char *progname) {
     printf("Uso:\n");
-<<<<<<< HEAD
-    printf("  %s run [data] [dificuldade_hex] [max_tentativas] [--progress N]\n", progname);
-    printf("  %s bench [iteracoes] [--progress N]\n", progname);
-=======
-    printf("  %s run [data] [dificuldade_hex] [max_tentativas] [--progress N] [--infinite]\n", progname);
-    printf("  %s bench [iteracoes] [--progress N]\n", progname);
-    printf("  %s wallet [--wallet caminho] [--reset-wallet]\n", progname);
+    printf("  %s run [data] [dificuldade_hex] [max_tentativas] [--progress N] [--infinite] [--wallet-flush SECS]\n", progname);
+    printf("  %s bench [iteracoes] [--progress N] [--hex]\n", progname);
+    printf("  %s wallet [--wallet caminho] [--reset-wallet] [--history] [--since T] [--limit N]\n", progname);
     printf("  %s stratum <host> <port> <user> [password] [--retries N] [--delay SECS] [--coin NAME]\n", progname);
-    printf("  %s solo <host> <port> <user> <password> [--coin NAME]\n", progname);
->>>>>>> codex/create-readme-for-project-vn5azj
+    printf("          [--threads N] [--weight W] [--share-rate N] [--record ARQUIVO] [--pool host:port:user[:senha[:peso]]]...\n");
+    printf("  %s replay <arquivo> [--fast] [--threads N] [--coin NAME]\n", progname);
+    printf("  %s proxy <listen_port> <pool_host> <pool_port> <user> [password] [--bind ADDR] [--slice-bytes N]\n", progname);
+    printf("          [--max-clients N] [--retries N] [--delay SECS] [--share-rate N] [--coin NAME]\n");
+    printf("  %s solo <host> <port> <user> <password> [--coin NAME] [--threads N] [--refresh SECS] [--payout-script HEX] [--tip-poll-ms N] [--no-speculate] [--node SPEC]... [--p2p HOST:PORT] [--p2p-magic HEX]\n", progname);
     printf("  %s help\n", progname);
     printf("  %s version\n\n", progname);
     printf("Argumentos run:\n");
     printf("  data             string base concatenada ao nonce (default: %s)\n", DEFAULT_DATA);
     printf("  dificuldade_hex  zeros iniciais em hexadecimal exigidos (0-64, default: %d)\n", DEFAULT_DIFFICULTY);
-<<<<<<< HEAD
-    printf("  max_tentativas   limite de nonces testados (>=1, default: %llu)\n", (unsigned long long)DEFAULT_MAX_ATTEMPTS);
-    printf("  --progress N     exibe progresso e hashrate a cada N tentativas (opcional)\n");
-    printf("Argumentos bench:\n");
-    printf("  iteracoes        quantidade de hashes para medir hashrate (default: %llu)\n", (unsigned long long)DEFAULT_BENCH_ITERATIONS);
-    printf("  --progress N     exibe progresso a cada N hashes (opcional)\n");
-=======
     printf("  max_tentativas   ignorado (modo infinito). Campo mantido por compatibilidade; use Ctrl+C para parar.\n");
     printf("  --progress N     exibe progresso e hashrate a cada N tentativas (opcional)\n");
     printf("  --infinite       atalho para max_tentativas=0 (roda ate Ctrl+C)\n");
     printf("  --wallet caminho arquivo da carteira (default: %s)\n", DEFAULT_WALLET_PATH);
     printf("  --reset-wallet   recria carteira (novo endereco, saldo zerado)\n");
+    printf("  --wallet-flush S agrupa as gravacoes da carteira a cada S segundos, fora da thread de mineracao (default: %.0f)\n", DEFAULT_WALLET_FLUSH_SECS);
     printf("Argumentos bench:\n");
     printf("  iteracoes        quantidade de hashes para medir hashrate (default: %llu)\n", (unsigned long long)DEFAULT_BENCH_ITERATIONS);
     printf("  --progress N     exibe progresso a cada N hashes (opcional)\n");
+    printf("  --hex            mede encode/decode hex (scalar, SSE2, AVX2) de 32 B a 4 MB em vez de hashes\n");
     printf("Comando wallet:\n");
     printf("  --wallet caminho arquivo da carteira (default: %s)\n", DEFAULT_WALLET_PATH);
     printf("  --reset-wallet   recria carteira e zera saldo/mineracao\n");
+    printf("  --history        lista os blocos gravados no ledger (<carteira>.ledger)\n");
+    printf("  --since T        so blocos a partir de T: segundos unix ou N[s|m|h|d] atras (implica --history)\n");
+    printf("  --limit N        maximo de blocos listados (default: %llu, 0 = todos)\n", (unsigned long long)DEFAULT_HISTORY_LIMIT);
     printf("Comando stratum:\n");
     printf("  host/port/user/(password) para testar subscribe/authorize em um pool Stratum (fluxo basico)\n");
+    printf("  --threads N      threads de hash compartilhadas entre os pools (0 = todos os nucleos)\n");
+    printf("  --weight W       peso do pool principal na divisao de hashrate (default: 1)\n");
+    printf("  --share-rate N   shares/min desejados; sugere difficulty ao pool pelo hashrate medido (0 = desligado)\n");
+    printf("  --record ARQUIVO grava as linhas recebidas/enviadas com timestamps (para o comando replay)\n");
+    printf("  --pool SPEC      sessao adicional host:port:user[:senha[:peso]] (ate %d pools no total)\n", STRATUM_MAX_POOLS);
+    printf("Comando proxy:\n");
+    printf("  aceita mineradores Stratum v1 e agrega todos em uma unica conexao com o pool\n");
+    printf("  --bind ADDR      endereco local para escutar (default: todas as interfaces)\n");
+    printf("  --slice-bytes N  bytes do extranonce2 do pool reservados por minerador (1-3, default: 2)\n");
+    printf("  --max-clients N  limite de mineradores conectados (default: 4096)\n");
+    printf("  --share-rate N   shares/min desejados do proxy ao pool, pelo hashrate agregado (0 = desligado)\n");
+    printf("Comando replay:\n");
+    printf("  reprocessa uma captura de --record no mesmo pipeline (parse, jobs, threads) e mede desempenho\n");
+    printf("  --fast           sem pausas entre as linhas (padrao: velocidade original)\n");
     printf("Comando solo:\n");
     printf("  host/port/user/password para usar getblocktemplate em um node local via RPC\n");
->>>>>>> codex/create-readme-for-project-vn5azj
+    printf("  --threads N      threads de hash (0 = todos os nucleos)\n");
+    printf("  --refresh SECS   busca um template novo a cada SECS segundos (default: 30); novos blocos chegam por long polling\n");
+    printf("  --payout-script HEX  scriptPubKey que recebe coinbasevalue; a coinbase e montada localmente com extranonce\n");
+    printf("  --tip-poll-ms N  consulta getbestblockhash a cada N ms e minera um bloco vazio no novo tip ate o template chegar (default: 250, 0 = desliga)\n");
+    printf("  --no-speculate   detecta o novo tip mas espera o template completo (para comparar)\n");
+    printf("  --node SPEC      node adicional host:port[:user[:senha]] (ate %d nodes no total): templates do primeiro a ver o tip, submitblock em todos\n", SOLO_MAX_NODES);
+    printf("  --p2p HOST:PORT  envia blocos achados tambem como mensagem block pela porta P2P do node (binario, sem JSON)\n");
+    printf("  --p2p-magic HEX  bytes iniciais das mensagens P2P (default: mainnet da moeda; regtest bitcoin = fabfb5da)\n");
 }
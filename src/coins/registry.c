@@ -1,5 +1,6 @@
 #include "registry.h"
 
+#include <string.h>
 #include <strings.h>
 
 const char *coin_type_to_name(coin_type t) {
@@ -11,6 +12,32 @@ const char *coin_type_to_name(coin_type t) {
     }
 }
 
+int coin_retarget_interval(coin_type t) {
+    switch (t) {
+        case COIN_BTC: return 2016;
+        case COIN_LTC: return 2016;
+        case COIN_DOGE: return 1;
+        default: return 0;
+    }
+}
+
+int coin_halving_interval(coin_type t) {
+    switch (t) {
+        case COIN_BTC: return 210000;
+        case COIN_LTC: return 840000;
+        default: return 0;
+    }
+}
+
+int coin_p2p_magic(coin_type t, unsigned char out[4]) {
+    switch (t) {
+        case COIN_BTC: memcpy(out, "\xf9\xbe\xb4\xd9", 4); return 1;
+        case COIN_LTC: memcpy(out, "\xfb\xc0\xb6\xdb", 4); return 1;
+        case COIN_DOGE: memcpy(out, "\xc0\xc0\xc0\xc0", 4); return 1;
+        default: return 0;
+    }
+}
+
 coin_type coin_type_from_name(const char *name) {
     if (!name) return COIN_UNKNOWN;
     if (strcasecmp(name, "bitcoin") == 0 || strcasecmp(name, "btc") == 0) return COIN_BTC;
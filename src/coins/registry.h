@@ -10,5 +10,11 @@ typedef enum {
 
 const char *coin_type_to_name(coin_type t);
 coin_type coin_type_from_name(const char *name);
+// Blocks between difficulty retargets (1 = every block, 0 = unknown) and
+// between subsidy halvings (0 = none or unknown).
+int coin_retarget_interval(coin_type t);
+int coin_halving_interval(coin_type t);
+// Mainnet P2P message start bytes, in wire order.
+int coin_p2p_magic(coin_type t, unsigned char out[4]);
 
 #endif
@@ -2,17 +2,18 @@
 #define COMMON_H
 
 #include <stdint.h>
-<<<<<<< HEAD
+#include "coins/registry.h"
 
-#define COINMINER_VERSION "0.3.0"
+#define STRATUM_MAX_POOLS 8
+#define SOLO_MAX_NODES 8
 
-#define DEFAULT_DATA "hello-from-coinminer"
-#define DEFAULT_DIFFICULTY 4
-#define DEFAULT_MAX_ATTEMPTS 2000000ull
-#define DEFAULT_BENCH_ITERATIONS 500000ull
-#define DEFAULT_PROGRESS_INTERVAL 0ull
-=======
-#include "coins/registry.h"
+typedef struct stratum_pool_options {
+    char host[256];
+    char port[16];
+    char user[128];
+    char password[128];
+    double weight;
+} stratum_pool_options;
 
 typedef struct stratum_options {
     const char *host;
@@ -22,14 +23,64 @@ typedef struct stratum_options {
     int max_reconnects;
     int reconnect_delay_secs;
     coin_type coin;
+    double weight;
+    int threads;
+    double share_rate;
+    const char *record_path;
+    stratum_pool_options extra_pools[STRATUM_MAX_POOLS - 1];
+    int extra_pool_count;
 } stratum_options;
 
+typedef struct replay_options {
+    const char *path;
+    int fast;
+    int threads;
+    coin_type coin;
+} replay_options;
+
+typedef struct proxy_options {
+    const char *bind_host;
+    const char *listen_port;
+    const char *host;
+    const char *port;
+    const char *user;
+    const char *password;
+    int slice_bytes;
+    int max_clients;
+    int max_reconnects;
+    int reconnect_delay_secs;
+    double share_rate;
+    coin_type coin;
+} proxy_options;
+
+// Additional RPC backend; empty user/password inherit the main node's.
+typedef struct solo_node_options {
+    char host[256];
+    char port[16];
+    char user[128];
+    char password[128];
+} solo_node_options;
+
 typedef struct solo_options {
     const char *host;
     const char *port;
     const char *user;
     const char *password;
     coin_type coin;
+    int threads;
+    int refresh_secs;
+    // Hex scriptPubKey for a locally built coinbase; NULL uses coinbasetxn.
+    const char *payout_script;
+    // getbestblockhash polling interval; 0 disables speculative empty blocks.
+    int tip_poll_ms;
+    int speculate;
+    solo_node_options extra_nodes[SOLO_MAX_NODES - 1];
+    int extra_node_count;
+    // Node P2P port for block relay (empty = RPC only); magic in hex, NULL
+    // for the coin's mainnet value.
+    char p2p_host[256];
+    char p2p_port[16];
+    const char *p2p_magic;
 } solo_options;
 
 #define COINMINER_VERSION "0.4.0"
@@ -40,60 +91,56 @@ typedef struct solo_options {
 #define DEFAULT_BENCH_ITERATIONS 500000ull
 #define DEFAULT_PROGRESS_INTERVAL 0ull
 #define DEFAULT_WALLET_PATH "wallet.dat"
+#define DEFAULT_WALLET_FLUSH_SECS 1.0
+#define DEFAULT_HISTORY_LIMIT 100ull
 #define MINING_REWARD 50ull
 #define MAX_ATTEMPTS_INFINITE 0ull
->>>>>>> codex/create-readme-for-project-vn5azj
 
 typedef enum {
     CMD_RUN,
     CMD_BENCH,
-<<<<<<< HEAD
-=======
     CMD_WALLET,
     CMD_STRATUM,
+    CMD_PROXY,
     CMD_SOLO,
->>>>>>> codex/create-readme-for-project-vn5azj
+    CMD_REPLAY,
     CMD_HELP,
     CMD_VERSION,
     CMD_UNKNOWN
 } command_type;
 
 typedef struct {
-<<<<<<< HEAD
-=======
     const char *path;
     int reset;
+    double flush_secs;
+    int history;
+    int64_t since;
+    uint64_t limit;
 } wallet_options;
 
 typedef struct {
->>>>>>> codex/create-readme-for-project-vn5azj
     const char *data;
     int difficulty;
     uint64_t max_attempts;
     uint64_t progress_interval;
-<<<<<<< HEAD
-=======
     wallet_options wallet;
->>>>>>> codex/create-readme-for-project-vn5azj
 } run_options;
 
 typedef struct {
     uint64_t iterations;
     uint64_t progress_interval;
+    int hex;
 } bench_options;
 
 typedef struct {
     command_type type;
     run_options run;
     bench_options bench;
-<<<<<<< HEAD
-    char error[160];
-} cli_result;
-
-=======
     wallet_options wallet;
     stratum_options stratum;
+    proxy_options proxy;
     solo_options solo;
+    replay_options replay;
     char error[160];
 } cli_result;
 
@@ -103,5 +150,4 @@ typedef struct {
     uint64_t mined_blocks;
 } wallet_info;
 
->>>>>>> codex/create-readme-for-project-vn5azj
 #endif
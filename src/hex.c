@@ -0,0 +1,230 @@
+#include "hex.h"
+
+#include <stdatomic.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HEX_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 is compiled per function and only used after a CPU check, so the
+// binary still runs on machines without it. GCC/clang only.
+#if defined(HEX_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HEX_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+static const char digits[] = "0123456789abcdef";
+
+// Digit value + 1; 0 marks a non-hex character.
+static const uint8_t digit_value[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8,
+    ['8'] = 9, ['9'] = 10, ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+static atomic_int current_impl;
+
+static void encode_scalar(const uint8_t *in, size_t len, char *out) {
+    for (size_t i = 0; i < len; i++) {
+        out[i * 2] = digits[in[i] >> 4];
+        out[i * 2 + 1] = digits[in[i] & 0xF];
+    }
+}
+
+static int decode_scalar(const char *hex, size_t n, uint8_t *out) {
+    unsigned bad = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned hi = digit_value[(uint8_t)hex[i * 2]];
+        unsigned lo = digit_value[(uint8_t)hex[i * 2 + 1]];
+        bad |= (hi == 0) | (lo == 0);
+        out[i] = (uint8_t)(((hi - 1) << 4) | ((lo - 1) & 0xF));
+    }
+    return !bad;
+}
+
+#ifdef HEX_HAVE_SSE2
+static __m128i sse2_ascii(__m128i n) {
+    __m128i letter = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+    return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), _mm_and_si128(letter, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+static void encode_sse2(const uint8_t *in, size_t len, char *out) {
+    const __m128i low = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+        __m128i lo = _mm_and_si128(v, low);
+        _mm_storeu_si128((__m128i *)(out + i * 2), sse2_ascii(_mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128((__m128i *)(out + i * 2 + 16), sse2_ascii(_mm_unpackhi_epi8(hi, lo)));
+    }
+    encode_scalar(in + i, len - i, out + i * 2);
+}
+
+// Digit values of 16 characters; anything that is not [0-9a-fA-F] sets its
+// lane in *bad. Signed compares also reject bytes >= 0x80.
+static __m128i sse2_nibbles(__m128i v, __m128i *bad) {
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    *bad = _mm_or_si128(*bad, _mm_andnot_si128(_mm_or_si128(digit, alpha), _mm_set1_epi8(-1)));
+    return _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+                        _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+
+// (hi, lo) digit pairs to one byte per 16-bit lane.
+static __m128i sse2_join(__m128i n) {
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n, _mm_set1_epi16(0x00FF)), 4), _mm_srli_epi16(n, 8));
+}
+
+static int decode_sse2(const char *hex, size_t n, uint8_t *out) {
+    __m128i bad = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i joined = sse2_join(sse2_nibbles(_mm_loadu_si128((const __m128i *)(hex + i * 2)), &bad));
+        _mm_storel_epi64((__m128i *)(out + i), _mm_packus_epi16(joined, joined));
+    }
+    return _mm_movemask_epi8(bad) == 0 && decode_scalar(hex + i * 2, n - i, out + i);
+}
+#endif
+
+#ifdef HEX_HAVE_AVX2
+__attribute__((target("avx2"))) static void encode_avx2(const uint8_t *in, size_t len, char *out) {
+    const __m256i table = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+                                           '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+        // Unpacks work per 128-bit lane; the permutes put the halves back in order.
+        __m256i x = _mm256_unpacklo_epi8(hi, lo);
+        __m256i y = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *)(out + i * 2), _mm256_permute2x128_si256(x, y, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + i * 2 + 32), _mm256_permute2x128_si256(x, y, 0x31));
+    }
+    _mm256_zeroupper();
+    encode_scalar(in + i, len - i, out + i * 2);
+}
+
+__attribute__((target("avx2"))) static __m256i avx2_nibbles(__m256i v, __m256i *bad) {
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+    *bad = _mm256_or_si256(*bad, _mm256_andnot_si256(_mm256_or_si256(digit, alpha), _mm256_set1_epi8(-1)));
+    return _mm256_or_si256(_mm256_and_si256(digit, _mm256_sub_epi8(v, _mm256_set1_epi8('0'))),
+                           _mm256_and_si256(alpha, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+}
+
+__attribute__((target("avx2"))) static __m256i avx2_join(__m256i n) {
+    return _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(n, _mm256_set1_epi16(0x00FF)), 4), _mm256_srli_epi16(n, 8));
+}
+
+__attribute__((target("avx2"))) static int decode_avx2(const char *hex, size_t n, uint8_t *out) {
+    __m256i bad = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i joined = avx2_join(avx2_nibbles(_mm256_loadu_si256((const __m256i *)(hex + i * 2)), &bad));
+        // packus works per 128-bit lane; quarters 0 and 2 hold the 16 bytes.
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(joined, joined), 0x08);
+        _mm_storeu_si128((__m128i *)(out + i), _mm256_castsi256_si128(packed));
+    }
+    int ok = _mm256_movemask_epi8(bad) == 0;
+    _mm256_zeroupper();
+    return ok && decode_scalar(hex + i * 2, n - i, out + i);
+}
+#endif
+
+int hex_impl_supported(hex_impl impl) {
+    switch (impl) {
+        case HEX_IMPL_AUTO:
+        case HEX_IMPL_SCALAR:
+            return 1;
+#ifdef HEX_HAVE_SSE2
+        case HEX_IMPL_SSE2:
+            return 1;
+#endif
+#ifdef HEX_HAVE_AVX2
+        case HEX_IMPL_AVX2:
+            return __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+hex_impl hex_set_impl(hex_impl impl) {
+    if (impl == HEX_IMPL_AUTO || !hex_impl_supported(impl)) {
+        impl = HEX_IMPL_SCALAR;
+        if (hex_impl_supported(HEX_IMPL_SSE2)) impl = HEX_IMPL_SSE2;
+        if (hex_impl_supported(HEX_IMPL_AVX2)) impl = HEX_IMPL_AVX2;
+    }
+    atomic_store_explicit(&current_impl, (int)impl, memory_order_relaxed);
+    return impl;
+}
+
+hex_impl hex_get_impl(void) {
+    int impl = atomic_load_explicit(&current_impl, memory_order_relaxed);
+    return impl ? (hex_impl)impl : hex_set_impl(HEX_IMPL_AUTO);
+}
+
+const char *hex_impl_name(hex_impl impl) {
+    switch (impl) {
+        case HEX_IMPL_SCALAR: return "scalar";
+        case HEX_IMPL_SSE2: return "sse2";
+        case HEX_IMPL_AVX2: return "avx2";
+        default: return "auto";
+    }
+}
+
+void hex_encode(const uint8_t *in, size_t len, char *out) {
+    switch (hex_get_impl()) {
+#ifdef HEX_HAVE_AVX2
+        case HEX_IMPL_AVX2:
+            encode_avx2(in, len, out);
+            return;
+#endif
+#ifdef HEX_HAVE_SSE2
+        case HEX_IMPL_SSE2:
+            encode_sse2(in, len, out);
+            return;
+#endif
+        default:
+            encode_scalar(in, len, out);
+    }
+}
+
+void hex_encode_reversed(const uint8_t *in, size_t len, char *out) {
+    for (size_t i = 0; i < len; i++) {
+        out[i * 2] = digits[in[len - 1 - i] >> 4];
+        out[i * 2 + 1] = digits[in[len - 1 - i] & 0xF];
+    }
+}
+
+int hex_decode(const char *hex, size_t hex_len, uint8_t *out, size_t out_cap, size_t *out_len) {
+    if (hex_len % 2 != 0) return 0;
+    size_t n = hex_len / 2;
+    if (n > out_cap) return 0;
+    int ok;
+    switch (hex_get_impl()) {
+#ifdef HEX_HAVE_AVX2
+        case HEX_IMPL_AVX2:
+            ok = decode_avx2(hex, n, out);
+            break;
+#endif
+#ifdef HEX_HAVE_SSE2
+        case HEX_IMPL_SSE2:
+            ok = decode_sse2(hex, n, out);
+            break;
+#endif
+        default:
+            ok = decode_scalar(hex, n, out);
+    }
+    if (!ok) return 0;
+    if (out_len) *out_len = n;
+    return 1;
+}
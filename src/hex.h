@@ -0,0 +1,31 @@
+#ifndef HEX_H
+#define HEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Lengths are always explicit: nothing here calls strlen or writes a
+// terminator. SSE2/AVX2 paths are picked at runtime when the CPU has them.
+typedef enum {
+    HEX_IMPL_AUTO = 0,
+    HEX_IMPL_SCALAR,
+    HEX_IMPL_SSE2,
+    HEX_IMPL_AVX2
+} hex_impl;
+
+// Writes exactly 2 * len lowercase digits to `out`.
+void hex_encode(const uint8_t *in, size_t len, char *out);
+// Same, last byte first (display order of hashes and txids).
+void hex_encode_reversed(const uint8_t *in, size_t len, char *out);
+// Decodes exactly hex_len digits (either case). Fails on odd length, any
+// non-hex character or if the result does not fit in out_cap.
+int hex_decode(const char *hex, size_t hex_len, uint8_t *out, size_t out_cap, size_t *out_len);
+
+// Forces an implementation, for benchmarks. Unsupported ones fall back to
+// the best available; returns the one now in use.
+hex_impl hex_set_impl(hex_impl impl);
+hex_impl hex_get_impl(void);
+int hex_impl_supported(hex_impl impl);
+const char *hex_impl_name(hex_impl impl);
+
+#endif
@@ -0,0 +1,117 @@
+#include "inflight.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static inflight_submit *slot_for(inflight_table *t, long long id) {
+    return &t->slots[(unsigned long long)id % INFLIGHT_CAP];
+}
+
+void inflight_init(inflight_table *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+static void release(inflight_table *t, inflight_submit *s, submit_outcome outcome) {
+    t->outcomes[outcome]++;
+    t->pending--;
+    free(s->job_id);
+    memset(s, 0, sizeof(*s));
+}
+
+void inflight_add(inflight_table *t, long long id, const char *job_id, uint64_t extranonce2, uint32_t nonce,
+                  double difficulty, double now) {
+    inflight_submit *s = slot_for(t, id);
+    // More than INFLIGHT_CAP outstanding: the oldest reply is given up on.
+    if (s->used) release(t, s, SUBMIT_TIMEOUT);
+    s->used = 1;
+    s->id = id;
+    s->job_id = strdup(job_id ? job_id : "");
+    s->extranonce2 = extranonce2;
+    s->nonce = nonce;
+    s->difficulty = difficulty;
+    s->sent_at = now;
+    t->pending++;
+}
+
+const inflight_submit *inflight_find(const inflight_table *t, long long id) {
+    const inflight_submit *s = &t->slots[(unsigned long long)id % INFLIGHT_CAP];
+    return s->used && s->id == id ? s : NULL;
+}
+
+void inflight_finish(inflight_table *t, long long id, submit_outcome outcome, double now) {
+    inflight_submit *s = slot_for(t, id);
+    if (!s->used || s->id != id) return;
+    latency_add(&t->latency, now - s->sent_at);
+    if (outcome == SUBMIT_ACCEPTED) t->accepted_difficulty += s->difficulty;
+    release(t, s, outcome);
+}
+
+size_t inflight_expire(inflight_table *t, double now, double timeout) {
+    size_t expired = 0;
+    for (size_t i = 0; i < INFLIGHT_CAP && t->pending > 0; i++) {
+        inflight_submit *s = &t->slots[i];
+        if (s->used && now - s->sent_at >= timeout) {
+            release(t, s, SUBMIT_TIMEOUT);
+            expired++;
+        }
+    }
+    return expired;
+}
+
+size_t inflight_drop_all(inflight_table *t) {
+    size_t dropped = 0;
+    for (size_t i = 0; i < INFLIGHT_CAP && t->pending > 0; i++) {
+        if (t->slots[i].used) {
+            release(t, &t->slots[i], SUBMIT_LOST);
+            dropped++;
+        }
+    }
+    return dropped;
+}
+
+void inflight_free(inflight_table *t) {
+    for (size_t i = 0; i < INFLIGHT_CAP; i++) free(t->slots[i].job_id);
+    memset(t, 0, sizeof(*t));
+}
+
+const char *submit_outcome_name(submit_outcome outcome) {
+    switch (outcome) {
+    case SUBMIT_ACCEPTED: return "aceitos";
+    case SUBMIT_STALE: return "stale";
+    case SUBMIT_DUPLICATE: return "duplicados";
+    case SUBMIT_LOW_DIFF: return "low-diff";
+    case SUBMIT_REJECTED: return "rejeitados";
+    case SUBMIT_TIMEOUT: return "timeout";
+    case SUBMIT_LOST: return "perdidos";
+    default: return "?";
+    }
+}
+
+void latency_add(latency_histogram *h, double secs) {
+    double ms = secs * 1000.0;
+    if (ms < 0.0) ms = 0.0;
+    size_t b = 0;
+    double bound = 1.0;
+    while (b + 1 < LATENCY_BUCKETS && ms >= bound) {
+        bound *= 2.0;
+        b++;
+    }
+    h->buckets[b]++;
+    h->count++;
+    h->sum += secs;
+    if (secs > h->max) h->max = secs;
+}
+
+// Upper bound of the bucket holding the p-th percentile, in seconds.
+double latency_percentile(const latency_histogram *h, double p) {
+    if (h->count == 0) return 0.0;
+    uint64_t rank = (uint64_t)(p * (double)h->count);
+    if (rank >= h->count) rank = h->count - 1;
+    uint64_t seen = 0;
+    double bound = 1.0;
+    for (size_t b = 0; b < LATENCY_BUCKETS; b++, bound *= 2.0) {
+        seen += h->buckets[b];
+        if (seen > rank) return b + 1 == LATENCY_BUCKETS ? h->max : bound / 1000.0;
+    }
+    return h->max;
+}
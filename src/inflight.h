@@ -0,0 +1,61 @@
+#ifndef INFLIGHT_H
+#define INFLIGHT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define INFLIGHT_CAP 1024
+#define LATENCY_BUCKETS 16
+
+typedef enum {
+    SUBMIT_ACCEPTED,
+    SUBMIT_STALE,
+    SUBMIT_DUPLICATE,
+    SUBMIT_LOW_DIFF,
+    SUBMIT_REJECTED,
+    SUBMIT_TIMEOUT,
+    SUBMIT_LOST,
+    SUBMIT_OUTCOMES
+} submit_outcome;
+
+typedef struct {
+    int used;
+    long long id;
+    char *job_id;
+    uint64_t extranonce2;
+    uint32_t nonce;
+    double difficulty;
+    double sent_at;
+} inflight_submit;
+
+// Bucket i counts round trips below 2^i ms; the last one is open-ended.
+typedef struct {
+    uint64_t buckets[LATENCY_BUCKETS];
+    uint64_t count;
+    double sum;
+    double max;
+} latency_histogram;
+
+// Submits waiting for a pool reply, keyed by request id. Not thread safe.
+typedef struct {
+    inflight_submit slots[INFLIGHT_CAP];
+    size_t pending;
+    size_t outcomes[SUBMIT_OUTCOMES];
+    double accepted_difficulty;
+    latency_histogram latency;
+} inflight_table;
+
+void inflight_init(inflight_table *t);
+void inflight_add(inflight_table *t, long long id, const char *job_id, uint64_t extranonce2, uint32_t nonce,
+                  double difficulty, double now);
+const inflight_submit *inflight_find(const inflight_table *t, long long id);
+void inflight_finish(inflight_table *t, long long id, submit_outcome outcome, double now);
+size_t inflight_expire(inflight_table *t, double now, double timeout);
+size_t inflight_drop_all(inflight_table *t);
+void inflight_free(inflight_table *t);
+const char *submit_outcome_name(submit_outcome outcome);
+
+void latency_add(latency_histogram *h, double secs);
+double latency_percentile(const latency_histogram *h, double p);
+
+#endif
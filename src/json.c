@@ -0,0 +1,210 @@
+#include "json.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *json_skip_ws(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    return p;
+}
+
+static const char *json_skip_string(const char *p, const char *end) {
+    for (p++; p < end; p++) {
+        if (*p == '\\') {
+            p++;
+        } else if (*p == '"') {
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
+const char *json_skip_value(const char *p, const char *end) {
+    p = json_skip_ws(p, end);
+    if (p >= end) return NULL;
+    if (*p == '"') return json_skip_string(p, end);
+    if (*p == '[' || *p == '{') {
+        int depth = 0;
+        while (p < end) {
+            char c = *p;
+            if (c == '"') {
+                p = json_skip_string(p, end);
+                if (!p) return NULL;
+                continue;
+            }
+            if (c == '[' || c == '{') {
+                depth++;
+            } else if (c == ']' || c == '}') {
+                if (--depth == 0) return p + 1;
+            }
+            p++;
+        }
+        return NULL;
+    }
+    const char *start = p;
+    while (p < end && *p != ',' && *p != ']' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+    return p > start ? p : NULL;
+}
+
+// Walks the members of the top-level object, calling fn for each key/value.
+// Stops early when fn returns 0.
+static int json_each_member(const char *line, size_t len, json_member_fn fn, void *ctx) {
+    const char *end = line + len;
+    const char *p = json_skip_ws(line, end);
+    if (p >= end || *p != '{') return 0;
+    p = json_skip_ws(p + 1, end);
+    if (p < end && *p == '}') return 1;
+    while (p < end) {
+        if (*p != '"') return 0;
+        const char *kend = json_skip_string(p, end);
+        if (!kend) return 0;
+        const char *key = p + 1;
+        size_t klen = (size_t)(kend - key - 1);
+        p = json_skip_ws(kend, end);
+        if (p >= end || *p != ':') return 0;
+        p = json_skip_ws(p + 1, end);
+        const char *vend = json_skip_value(p, end);
+        if (!vend) return 0;
+        json_view value = {p, (size_t)(vend - p)};
+        if (!fn(ctx, key, klen, value)) return 1;
+        p = json_skip_ws(vend, end);
+        if (p < end && *p == ',') {
+            p = json_skip_ws(p + 1, end);
+        } else {
+            return p < end && *p == '}';
+        }
+    }
+    return 0;
+}
+
+static int message_member(void *ctx, const char *key, size_t klen, json_view value) {
+    json_message *msg = ctx;
+    switch (klen) {
+    case 2:
+        if (memcmp(key, "id", 2) == 0) msg->id = value;
+        break;
+    case 5:
+        if (memcmp(key, "error", 5) == 0) msg->error = value;
+        break;
+    case 6:
+        if (memcmp(key, "method", 6) == 0) msg->method = value;
+        else if (memcmp(key, "params", 6) == 0) msg->params = value;
+        else if (memcmp(key, "result", 6) == 0) msg->result = value;
+        break;
+    default:
+        break;
+    }
+    return 1;
+}
+
+int json_parse_message(const char *line, size_t len, json_message *msg) {
+    memset(msg, 0, sizeof(*msg));
+    return json_each_member(line, len, message_member, msg);
+}
+
+int json_object_each(json_view object, json_member_fn fn, void *ctx) {
+    return object.p && json_each_member(object.p, object.len, fn, ctx);
+}
+
+int json_iter_init(json_iter *it, json_view array) {
+    const char *end = array.p + array.len;
+    const char *p = array.p ? json_skip_ws(array.p, end) : NULL;
+    if (!p || p >= end || *p != '[') {
+        it->p = it->end = NULL;
+        return 0;
+    }
+    it->p = p + 1;
+    it->end = end;
+    return 1;
+}
+
+int json_iter_next(json_iter *it, json_view *item) {
+    if (!it->p) return 0;
+    const char *p = json_skip_ws(it->p, it->end);
+    if (p >= it->end || *p == ']') return 0;
+    const char *e = json_skip_value(p, it->end);
+    if (!e) return 0;
+    item->p = p;
+    item->len = (size_t)(e - p);
+    p = json_skip_ws(e, it->end);
+    if (p < it->end && *p == ',') p++;
+    it->p = p;
+    return 1;
+}
+
+int json_view_string(json_view v, json_view *out) {
+    if (!v.p || v.len < 2 || v.p[0] != '"' || v.p[v.len - 1] != '"') return 0;
+    out->p = v.p + 1;
+    out->len = v.len - 2;
+    return 1;
+}
+
+int json_view_string_eq(json_view v, const char *s) {
+    json_view inner;
+    size_t n = strlen(s);
+    return json_view_string(v, &inner) && inner.len == n && memcmp(inner.p, s, n) == 0;
+}
+
+int json_view_is(json_view v, const char *literal) {
+    size_t n = strlen(literal);
+    return v.p && v.len == n && memcmp(v.p, literal, n) == 0;
+}
+
+// Numbers are always followed by a delimiter inside the line, so the
+// strto* calls cannot run past the view.
+long long json_view_int(json_view v) {
+    return v.p ? strtoll(v.p, NULL, 10) : 0;
+}
+
+double json_view_double(json_view v) {
+    return v.p ? strtod(v.p, NULL) : 0.0;
+}
+
+int json_view_copy(json_view v, char *out, size_t cap) {
+    json_view inner;
+    if (!json_view_string(v, &inner) || inner.len >= cap) return 0;
+    memcpy(out, inner.p, inner.len);
+    out[inner.len] = '\0';
+    return 1;
+}
+
+typedef struct {
+    const char *key;
+    size_t klen;
+    json_view found;
+} field_lookup;
+
+static int field_member(void *ctx, const char *key, size_t klen, json_view value) {
+    field_lookup *f = ctx;
+    if (klen != f->klen || memcmp(key, f->key, klen) != 0) return 1;
+    f->found = value;
+    return 0;
+}
+
+int json_field(const char *line, size_t len, const char *key, const char **v, size_t *vlen) {
+    field_lookup f = {key, strlen(key), {NULL, 0}};
+    if (!json_each_member(line, len, field_member, &f) || !f.found.p) return 0;
+    *v = f.found.p;
+    *vlen = f.found.len;
+    return 1;
+}
+
+int json_array_item(const char *arr, size_t arr_len, int index, const char **v, size_t *vlen) {
+    json_iter it;
+    json_view item;
+    json_view array = {arr, arr_len};
+    if (!json_iter_init(&it, array)) return 0;
+    for (int i = 0; json_iter_next(&it, &item); i++) {
+        if (i == index) {
+            *v = item.p;
+            *vlen = item.len;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int json_string_copy(const char *v, size_t vlen, char *out, size_t cap) {
+    json_view view = {v, vlen};
+    return json_view_copy(view, out, cap);
+}
@@ -0,0 +1,52 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+
+// Minimal tokenizer over a single JSON line. Nothing is copied: values come
+// back as views pointing into the line, which must outlive them.
+
+typedef struct {
+    const char *p;
+    size_t len;
+} json_view;
+
+// Top-level members of a JSON-RPC message, found in one pass. Missing
+// members have p == NULL.
+typedef struct {
+    json_view id;
+    json_view method;
+    json_view params;
+    json_view result;
+    json_view error;
+} json_message;
+
+typedef struct {
+    const char *p;
+    const char *end;
+} json_iter;
+
+int json_parse_message(const char *line, size_t len, json_message *msg);
+
+// Calls fn for each member of an object, in order; fn returns 0 to stop.
+typedef int (*json_member_fn)(void *ctx, const char *key, size_t klen, json_view value);
+int json_object_each(json_view object, json_member_fn fn, void *ctx);
+
+int json_iter_init(json_iter *it, json_view array);
+int json_iter_next(json_iter *it, json_view *item);
+
+// String contents without the quotes; escapes are not decoded.
+int json_view_string(json_view v, json_view *out);
+int json_view_string_eq(json_view v, const char *s);
+int json_view_is(json_view v, const char *literal);
+long long json_view_int(json_view v);
+double json_view_double(json_view v);
+int json_view_copy(json_view v, char *out, size_t cap);
+
+// Returns the end of the JSON value starting at p, or NULL if malformed.
+const char *json_skip_value(const char *p, const char *end);
+int json_field(const char *line, size_t len, const char *key, const char **v, size_t *vlen);
+int json_array_item(const char *arr, size_t arr_len, int index, const char **v, size_t *vlen);
+int json_string_copy(const char *v, size_t vlen, char *out, size_t cap);
+
+#endif
@@ -0,0 +1,391 @@
+#include "ledger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "coins/registry.h"
+#include "hex.h"
+
+#define LEDGER_HEADER_SIZE 64
+#define LEDGER_VERSION 1
+#define LEDGER_SCAN_BATCH 4096
+
+static const char ledger_magic[8] = {'C', 'M', 'L', 'E', 'D', 'G', 'E', 'R'};
+
+static void put_le(uint64_t v, uint8_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t get_le(const uint8_t *in, size_t n) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; i++) v |= (uint64_t)in[i] << (8 * i);
+    return v;
+}
+
+static void encode_record(const ledger_record *r, uint8_t out[LEDGER_RECORD_SIZE]) {
+    uint64_t diff_bits;
+    memcpy(&diff_bits, &r->difficulty, sizeof(diff_bits));
+    memset(out, 0, LEDGER_RECORD_SIZE);
+    put_le(r->time_ms, out, 8);
+    put_le(r->nonce, out + 8, 8);
+    put_le(r->reward, out + 16, 8);
+    put_le(diff_bits, out + 24, 8);
+    memcpy(out + 32, r->hash, 32);
+    out[64] = r->mode;
+    out[65] = r->coin;
+}
+
+static void decode_record(const uint8_t in[LEDGER_RECORD_SIZE], ledger_record *r) {
+    uint64_t diff_bits = get_le(in + 24, 8);
+    r->time_ms = get_le(in, 8);
+    r->nonce = get_le(in + 8, 8);
+    r->reward = get_le(in + 16, 8);
+    memcpy(&r->difficulty, &diff_bits, sizeof(diff_bits));
+    memcpy(r->hash, in + 32, 32);
+    r->mode = in[64];
+    r->coin = in[65];
+}
+
+static int pwrite_all(int fd, const void *buf, size_t len, uint64_t off) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+        off += (uint64_t)n;
+    }
+    return 1;
+}
+
+static int pread_all(int fd, void *buf, size_t len, uint64_t off) {
+    uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+        off += (uint64_t)n;
+    }
+    return 1;
+}
+
+static int read_header(int fd, ledger_summary *checkpoint) {
+    uint8_t head[LEDGER_HEADER_SIZE];
+    if (!pread_all(fd, head, sizeof(head), 0)) return 0;
+    if (memcmp(head, ledger_magic, 8) != 0 || get_le(head + 8, 4) != LEDGER_VERSION ||
+        get_le(head + 12, 4) != LEDGER_RECORD_SIZE) {
+        return 0;
+    }
+    checkpoint->records = get_le(head + 16, 8);
+    checkpoint->reward = get_le(head + 24, 8);
+    checkpoint->last_time_ms = get_le(head + 32, 8);
+    return 1;
+}
+
+static int write_header(int fd, const ledger_summary *checkpoint) {
+    uint8_t head[LEDGER_HEADER_SIZE];
+    memset(head, 0, sizeof(head));
+    memcpy(head, ledger_magic, 8);
+    put_le(LEDGER_VERSION, head + 8, 4);
+    put_le(LEDGER_RECORD_SIZE, head + 12, 4);
+    put_le(checkpoint->records, head + 16, 8);
+    put_le(checkpoint->reward, head + 24, 8);
+    put_le(checkpoint->last_time_ms, head + 32, 8);
+    return pwrite_all(fd, head, sizeof(head), 0);
+}
+
+static uint64_t record_count(uint64_t file_size) {
+    return file_size > LEDGER_HEADER_SIZE ? (file_size - LEDGER_HEADER_SIZE) / LEDGER_RECORD_SIZE : 0;
+}
+
+// Folds records [sum->records, count) into the summary.
+static int scan_tail(int fd, ledger_summary *sum, uint64_t count) {
+    if (sum->records >= count) return 1;
+    uint8_t *buf = malloc(LEDGER_SCAN_BATCH * LEDGER_RECORD_SIZE);
+    if (!buf) return 0;
+    while (sum->records < count) {
+        uint64_t n = count - sum->records;
+        if (n > LEDGER_SCAN_BATCH) n = LEDGER_SCAN_BATCH;
+        if (!pread_all(fd, buf, (size_t)n * LEDGER_RECORD_SIZE, LEDGER_HEADER_SIZE + sum->records * LEDGER_RECORD_SIZE)) {
+            free(buf);
+            return 0;
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            ledger_record r;
+            decode_record(buf + i * LEDGER_RECORD_SIZE, &r);
+            sum->reward += r.reward;
+            sum->last_time_ms = r.time_ms;
+        }
+        sum->records += n;
+    }
+    free(buf);
+    return 1;
+}
+
+// Summary of the first `count` records, starting from the checkpoint when
+// it is consistent with the file.
+static int load_summary(int fd, uint64_t count, ledger_summary *out, int *rescanned) {
+    if (!read_header(fd, out)) return 0;
+    if (out->records > count) memset(out, 0, sizeof(*out));
+    *rescanned = out->records < count;
+    return scan_tail(fd, out, count);
+}
+
+static void ledger_paths(ledger *l, const char *wallet_path) {
+    snprintf(l->path, sizeof(l->path), "%s.ledger", wallet_path);
+    snprintf(l->idx_path, sizeof(l->idx_path), "%s.idx", l->path);
+}
+
+// Brings the sparse index in line with `count` records.
+static int sync_index(ledger *l, uint64_t count) {
+    struct stat st;
+    if (fstat(l->idx_fd, &st) != 0) return 0;
+    uint64_t have = (uint64_t)st.st_size / 8;
+    uint64_t want = (count + LEDGER_INDEX_STRIDE - 1) / LEDGER_INDEX_STRIDE;
+    if (have > want || (uint64_t)st.st_size % 8 != 0) {
+        if (have > want) have = want;
+        if (ftruncate(l->idx_fd, (off_t)(have * 8)) != 0) return 0;
+    }
+    for (; have < want; have++) {
+        uint8_t rec[8];
+        uint64_t off = LEDGER_HEADER_SIZE + have * LEDGER_INDEX_STRIDE * LEDGER_RECORD_SIZE;
+        if (!pread_all(l->fd, rec, sizeof(rec), off) || !pwrite_all(l->idx_fd, rec, sizeof(rec), have * 8)) return 0;
+    }
+    l->index_entries = want;
+    return 1;
+}
+
+int ledger_open(ledger *l, const char *wallet_path) {
+    memset(l, 0, sizeof(*l));
+    l->fd = -1;
+    l->idx_fd = -1;
+    ledger_paths(l, wallet_path);
+    l->fd = open(l->path, O_RDWR | O_CREAT, 0644);
+    l->idx_fd = l->fd < 0 ? -1 : open(l->idx_path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (l->fd < 0 || l->idx_fd < 0 || fstat(l->fd, &st) != 0) {
+        fprintf(stderr, "[ledger] nao foi possivel abrir %s: %s\n", l->path, strerror(errno));
+        ledger_close(l);
+        return 0;
+    }
+    if (st.st_size == 0 && (!write_header(l->fd, &l->summary) || fsync(l->fd) != 0)) {
+        fprintf(stderr, "[ledger] nao foi possivel criar %s\n", l->path);
+        ledger_close(l);
+        return 0;
+    }
+
+    uint64_t count = record_count((uint64_t)st.st_size);
+    int rescanned = 0;
+    if (st.st_size > 0 && !load_summary(l->fd, count, &l->summary, &rescanned)) {
+        fprintf(stderr, "[ledger] %s nao e um ledger valido\n", l->path);
+        ledger_close(l);
+        return 0;
+    }
+    // A partial record at the end is an append cut short by a crash.
+    uint64_t whole = LEDGER_HEADER_SIZE + count * LEDGER_RECORD_SIZE;
+    if (st.st_size > 0 && (uint64_t)st.st_size != whole && ftruncate(l->fd, (off_t)whole) != 0) {
+        ledger_close(l);
+        return 0;
+    }
+    if ((rescanned && !write_header(l->fd, &l->summary)) || !sync_index(l, count)) {
+        fprintf(stderr, "[ledger] nao foi possivel atualizar %s\n", l->path);
+        ledger_close(l);
+        return 0;
+    }
+    return 1;
+}
+
+int ledger_append(ledger *l, ledger_record *records, size_t count) {
+    if (count == 0) return 1;
+    uint8_t *buf = malloc(count * LEDGER_RECORD_SIZE);
+    if (!buf) return 0;
+    ledger_summary next = l->summary;
+    for (size_t i = 0; i < count; i++) {
+        if (records[i].time_ms < next.last_time_ms) records[i].time_ms = next.last_time_ms;
+        next.last_time_ms = records[i].time_ms;
+        next.reward += records[i].reward;
+        encode_record(&records[i], buf + i * LEDGER_RECORD_SIZE);
+    }
+    next.records += count;
+    int ok = pwrite_all(l->fd, buf, count * LEDGER_RECORD_SIZE, LEDGER_HEADER_SIZE + l->summary.records * LEDGER_RECORD_SIZE) &&
+             fsync(l->fd) == 0;
+    free(buf);
+    if (!ok) {
+        fprintf(stderr, "[ledger] falha ao gravar em %s: %s\n", l->path, strerror(errno));
+        return 0;
+    }
+
+    // Index and checkpoint only ever describe synced records. Neither is
+    // fsynced: after a crash, open rebuilds them from the records.
+    for (uint64_t pos = l->index_entries * LEDGER_INDEX_STRIDE; l->idx_fd >= 0 && pos < next.records;
+         pos += LEDGER_INDEX_STRIDE) {
+        uint8_t t[8];
+        put_le(records[pos - l->summary.records].time_ms, t, 8);
+        if (!pwrite_all(l->idx_fd, t, sizeof(t), l->index_entries * 8)) {
+            // A short index only slows --since down; the next open rebuilds it.
+            fprintf(stderr, "[ledger] indice %s desativado ate reabrir: %s\n", l->idx_path, strerror(errno));
+            close(l->idx_fd);
+            l->idx_fd = -1;
+            break;
+        }
+        l->index_entries++;
+    }
+    l->summary = next;
+    if (!write_header(l->fd, &l->summary)) {
+        // The records are synced; open rescans past a stale checkpoint.
+        fprintf(stderr, "[ledger] falha ao atualizar o checkpoint de %s: %s\n", l->path, strerror(errno));
+    }
+    return 1;
+}
+
+void ledger_close(ledger *l) {
+    if (l->fd >= 0) close(l->fd);
+    if (l->idx_fd >= 0) close(l->idx_fd);
+    l->fd = -1;
+    l->idx_fd = -1;
+}
+
+int ledger_rotate(const char *wallet_path) {
+    ledger l;
+    ledger_paths(&l, wallet_path);
+    char archived[1080];
+    snprintf(archived, sizeof(archived), "%s.%lld", l.path, (long long)time(NULL));
+    if (rename(l.path, archived) != 0 && errno != ENOENT) {
+        fprintf(stderr, "[ledger] nao foi possivel arquivar %s: %s\n", l.path, strerror(errno));
+        return 0;
+    }
+    // The index is rebuilt from the records if the archive is ever reopened.
+    if (unlink(l.idx_path) != 0 && errno != ENOENT) {
+        fprintf(stderr, "[ledger] nao foi possivel remover %s: %s\n", l.idx_path, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+int ledger_read_summary(const char *wallet_path, ledger_summary *out) {
+    ledger l;
+    ledger_paths(&l, wallet_path);
+    int fd = open(l.path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    int rescanned = 0;
+    int ok = fstat(fd, &st) == 0 && load_summary(fd, record_count((uint64_t)st.st_size), out, &rescanned);
+    close(fd);
+    return ok;
+}
+
+static const char *mode_name(uint8_t mode) {
+    switch (mode) {
+        case LEDGER_MODE_RUN: return "run";
+        case LEDGER_MODE_STRATUM: return "stratum";
+        case LEDGER_MODE_SOLO: return "solo";
+        default: return "?";
+    }
+}
+
+static void format_time(uint64_t time_ms, char *out, size_t cap) {
+    time_t secs = (time_t)(time_ms / 1000);
+    struct tm tm;
+    localtime_r(&secs, &tm);
+    size_t n = strftime(out, cap, "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(out + n, cap - n, ".%03u", (unsigned)(time_ms % 1000));
+}
+
+static uint64_t time_at(const uint8_t *base, uint64_t i) {
+    return get_le(base + LEDGER_HEADER_SIZE + i * LEDGER_RECORD_SIZE, 8);
+}
+
+// First record in [lo, hi) with time >= since_ms; records are time-ordered.
+static uint64_t lower_bound(const uint8_t *base, uint64_t lo, uint64_t hi, uint64_t since_ms) {
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (time_at(base, mid) < since_ms) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int ledger_print_history(const char *wallet_path, int64_t since_secs, uint64_t limit) {
+    ledger l;
+    ledger_paths(&l, wallet_path);
+    int fd = open(l.path, O_RDONLY);
+    struct stat st;
+    ledger_summary head;
+    if (fd < 0 || fstat(fd, &st) != 0 || !read_header(fd, &head)) {
+        if (fd >= 0) close(fd);
+        printf("[ledger] sem historico em %s\n", l.path);
+        return 1;
+    }
+    uint64_t count = record_count((uint64_t)st.st_size);
+    if (count == 0) {
+        close(fd);
+        printf("[ledger] nenhum bloco registrado\n");
+        return 1;
+    }
+    const uint8_t *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "[ledger] mmap de %s falhou: %s\n", l.path, strerror(errno));
+        return 0;
+    }
+
+    // The sparse index narrows the search to one stride of records; a
+    // missing or short index just widens it.
+    uint64_t since_ms = since_secs > 0 ? (uint64_t)since_secs * 1000 : 0;
+    uint64_t lo = 0;
+    uint64_t hi = count;
+    FILE *idx = fopen(l.idx_path, "rb");
+    if (idx) {
+        uint64_t entries = (count + LEDGER_INDEX_STRIDE - 1) / LEDGER_INDEX_STRIDE;
+        uint64_t *times = malloc(entries * sizeof(*times));
+        uint64_t have = 0;
+        uint8_t t[8];
+        while (times && have < entries && fread(t, 1, sizeof(t), idx) == sizeof(t)) times[have++] = get_le(t, 8);
+        if (times && have == entries) {
+            uint64_t a = 0;
+            uint64_t b = entries;
+            while (a < b) {
+                uint64_t mid = a + (b - a) / 2;
+                if (times[mid] < since_ms) a = mid + 1;
+                else b = mid;
+            }
+            lo = a > 0 ? (a - 1) * LEDGER_INDEX_STRIDE : 0;
+            hi = a * LEDGER_INDEX_STRIDE < count ? a * LEDGER_INDEX_STRIDE : count;
+            if (hi < lo) hi = lo;
+        }
+        free(times);
+        fclose(idx);
+    }
+    uint64_t first = lower_bound(base, lo, hi, since_ms);
+    uint64_t shown = count - first;
+    if (limit && shown > limit) shown = limit;
+
+    char when[40];
+    snprintf(when, sizeof(when), "o inicio");
+    if (since_ms) format_time(since_ms, when, sizeof(when));
+    printf("[ledger] %llu de %llu blocos desde %s", (unsigned long long)(count - first), (unsigned long long)count, when);
+    if (shown < count - first) printf(" (mostrando os %llu primeiros)", (unsigned long long)shown);
+    printf("\n");
+    for (uint64_t i = first; i < first + shown; i++) {
+        ledger_record r;
+        char hash[65];
+        decode_record(base + LEDGER_HEADER_SIZE + i * LEDGER_RECORD_SIZE, &r);
+        format_time(r.time_ms, when, sizeof(when));
+        hex_encode(r.hash, 32, hash);
+        hash[64] = '\0';
+        printf("%s %-7s %-8s nonce=%llu dificuldade=%g recompensa=%llu hash=%s\n", when, mode_name(r.mode),
+               r.mode == LEDGER_MODE_RUN ? "-" : coin_type_to_name((coin_type)r.coin), (unsigned long long)r.nonce,
+               r.difficulty, (unsigned long long)r.reward, hash);
+    }
+    munmap((void *)base, (size_t)st.st_size);
+    return 1;
+}
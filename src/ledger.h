@@ -0,0 +1,61 @@
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Append-only record of found blocks, kept next to the wallet as
+// "<wallet>.ledger". Fixed-size records follow a header whose checkpoint
+// summarizes the records already synced, so opening only rescans the tail.
+// "<wallet>.ledger.idx" holds the time of every LEDGER_INDEX_STRIDE-th
+// record for --since lookups.
+#define LEDGER_RECORD_SIZE 72
+#define LEDGER_INDEX_STRIDE 1024
+
+typedef enum {
+    LEDGER_MODE_RUN = 1,
+    LEDGER_MODE_STRATUM,
+    LEDGER_MODE_SOLO
+} ledger_mode;
+
+typedef struct {
+    uint64_t time_ms;  // unix time, never decreasing within a ledger
+    uint64_t nonce;
+    uint64_t reward;
+    double difficulty;
+    uint8_t hash[32];
+    uint8_t mode;
+    uint8_t coin;
+} ledger_record;
+
+typedef struct {
+    uint64_t records;
+    uint64_t reward;
+    uint64_t last_time_ms;
+} ledger_summary;
+
+typedef struct {
+    int fd;
+    int idx_fd;
+    char path[1024];
+    char idx_path[1040];
+    ledger_summary summary;
+    uint64_t index_entries;
+} ledger;
+
+// Creates the files if needed and recovers from an interrupted append.
+int ledger_open(ledger *l, const char *wallet_path);
+// Appends, fsyncs and then moves the checkpoint past the new records.
+int ledger_append(ledger *l, ledger_record *records, size_t count);
+void ledger_close(ledger *l);
+// Moves the ledger aside as "<wallet>.ledger.<unix time>" so a reset wallet
+// starts an empty one. No ledger yet is not an error.
+int ledger_rotate(const char *wallet_path);
+
+// Summary from the checkpoint (plus any unsynced tail); 0 if no ledger.
+int ledger_read_summary(const char *wallet_path, ledger_summary *out);
+// Prints records with time >= since_secs, oldest first, at most `limit`
+// of them (0 = all). Reads the ledger through mmap.
+int ledger_print_history(const char *wallet_path, int64_t since_secs, uint64_t limit);
+
+#endif
@@ -2,22 +2,14 @@
 #include "cli.h"
 #include "common.h"
 #include "miner.h"
-<<<<<<< HEAD
-=======
 #include "wallet.h"
 #include "stratum.h"
+#include "proxy.h"
 #include "solo.h"
->>>>>>> codex/create-readme-for-project-vn5azj
 
 static void print_run_plan(const run_options *opts) {
     printf("Data: \"%s\"\n", opts->data);
     printf("Difficulty (hex zeros): %d\n", opts->difficulty);
-<<<<<<< HEAD
-    printf("Max attempts: %llu\n", (unsigned long long)opts->max_attempts);
-    if (opts->progress_interval > 0) {
-        printf("Progress interval: %llu tentativas\n", (unsigned long long)opts->progress_interval);
-    }
-=======
     printf("Max attempts (ignorado, modo infinito): %llu\n", (unsigned long long)opts->max_attempts);
     printf("Modo: infinito (rodar ate Ctrl+C)\n");
     printf("Wallet file: %s\n", opts->wallet.path ? opts->wallet.path : DEFAULT_WALLET_PATH);
@@ -28,11 +20,14 @@ static void print_run_plan(const run_options *opts) {
         printf("Progress interval: %llu tentativas\n", (unsigned long long)opts->progress_interval);
     }
     printf("Miner will keep running and credit rewards until max attempts are exhausted.\n");
->>>>>>> codex/create-readme-for-project-vn5azj
     printf("\n");
 }
 
 static void print_bench_plan(const bench_options *opts) {
+    if (opts->hex) {
+        printf("Benchmarking hex encode/decode\n\n");
+        return;
+    }
     printf("Benchmarking %llu hashes\n", (unsigned long long)opts->iterations);
     if (opts->progress_interval > 0) {
         printf("Progress interval: %llu hashes\n", (unsigned long long)opts->progress_interval);
@@ -55,34 +50,27 @@ int main(int argc, char **argv) {
         case CMD_VERSION:
             printf("coinminer version %s\n", COINMINER_VERSION);
             return 0;
-<<<<<<< HEAD
-=======
         case CMD_WALLET: {
             wallet_info info;
+            const char *path = res.wallet.path ? res.wallet.path : DEFAULT_WALLET_PATH;
+            if (res.wallet.history) return ledger_print_history(path, res.wallet.since, res.wallet.limit) ? 0 : 1;
             if (!ensure_wallet(&res.wallet, &info, res.wallet.reset)) return 1;
             print_wallet(&info);
+            ledger_summary summary;
+            if (ledger_read_summary(path, &summary)) {
+                printf("Ledger: %llu blocos registrados, %llu coins\n", (unsigned long long)summary.records,
+                       (unsigned long long)summary.reward);
+            }
             return 0;
         }
-        case CMD_STRATUM: {
-            stratum_options s = {
-                .host = res.stratum.host,
-                .port = res.stratum.port,
-                .user = res.stratum.user,
-                .password = res.stratum.password
-            };
-            return stratum_run(&s);
-        }
-        case CMD_SOLO: {
-            solo_options s = {
-                .host = res.solo.host,
-                .port = res.solo.port,
-                .user = res.solo.user,
-                .password = res.solo.password,
-                .coin = res.solo.coin
-            };
-            return solo_run(&s);
-        }
->>>>>>> codex/create-readme-for-project-vn5azj
+        case CMD_STRATUM:
+            return stratum_run(&res.stratum);
+        case CMD_PROXY:
+            return proxy_run(&res.proxy);
+        case CMD_REPLAY:
+            return stratum_replay(&res.replay);
+        case CMD_SOLO:
+            return solo_run(&res.solo);
         case CMD_RUN:
             print_run_plan(&res.run);
             return run_miner(&res.run);
@@ -1,17 +1,16 @@
 #include "miner.h"
 
 #include <stdio.h>
-<<<<<<< HEAD
-#include <string.h>
-#include <time.h>
-#include "sha256.h"
-=======
 #include <signal.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "coins/registry.h"
+#include "hex.h"
 #include "sha256.h"
 #include "wallet.h"
->>>>>>> codex/create-readme-for-project-vn5azj
+
+#define HEX_BENCH_VOLUME (64u << 20)
 
 static void hex_print(const uint8_t *buf, size_t n) {
     for (size_t i = 0; i < n; i++) printf("%02x", buf[i]);
@@ -21,17 +20,50 @@ static double now_seconds(void) {
     return (double)clock() / (double)CLOCKS_PER_SEC;
 }
 
-static int has_leading_hex_zeros(const uint8_t hash[SHA256_DIGEST_SIZE], int zeros) {
-    int full_bytes = zeros / 2;
-    int half = zeros % 2;
+// Leading hex zeros as a check on the final SHA-256 state words: `words`
+// whole words must be zero and the next one must clear `mask`.
+typedef struct {
+    int words;
+    uint32_t mask;
+} zero_target;
 
-    for (int i = 0; i < full_bytes; i++) {
-        if (hash[i] != 0x00) return 0;
+static zero_target zero_target_from_digits(int zeros) {
+    zero_target t;
+    t.words = zeros / 8;
+    t.mask = zeros % 8 ? ~(uint32_t)0 << (32 - 4 * (zeros % 8)) : 0;
+    return t;
+}
+
+static int meets_zero_target(const uint32_t state[8], zero_target t) {
+    for (int i = 0; i < t.words; i++) {
+        if (state[i] != 0) return 0;
     }
-    if (half) {
-        if ((hash[full_bytes] & 0xF0) != 0x00) return 0;
+    return t.words == 8 || (state[t.words] & t.mask) == 0;
+}
+
+// Decimal nonce kept as text and incremented in place, so an attempt only
+// rewrites the digits that carry. Digits live in buf[start..].
+typedef struct {
+    char buf[24];
+    size_t start;
+} nonce_odometer;
+
+static void odometer_reset(nonce_odometer *o) {
+    o->start = sizeof(o->buf) - 1;
+    o->buf[o->start] = '0';
+}
+
+static void odometer_next(nonce_odometer *o) {
+    size_t i = sizeof(o->buf);
+    while (i > o->start) {
+        i--;
+        if (o->buf[i] != '9') {
+            o->buf[i]++;
+            return;
+        }
+        o->buf[i] = '0';
     }
-    return 1;
+    o->buf[--o->start] = '1';
 }
 
 static void maybe_report_progress(uint64_t current, double start, uint64_t interval, const char *label) {
@@ -43,15 +75,6 @@ static void maybe_report_progress(uint64_t current, double start, uint64_t inter
            label, (unsigned long long)(current + 1), rate, elapsed);
 }
 
-<<<<<<< HEAD
-int run_miner(const run_options *opts) {
-    uint8_t hash[SHA256_DIGEST_SIZE];
-    char input[1024];
-
-    double start = now_seconds();
-
-    for (uint64_t i = 0; i < opts->max_attempts; i++) {
-=======
 static volatile sig_atomic_t stop_flag = 0;
 
 static void handle_stop(int sig) {
@@ -61,7 +84,6 @@ static void handle_stop(int sig) {
 
 int run_miner(const run_options *opts) {
     uint8_t hash[SHA256_DIGEST_SIZE];
-    char input[1024];
     wallet_info wallet;
     uint64_t found_blocks = 0;
     uint64_t attempts_done = 0;
@@ -74,52 +96,54 @@ int run_miner(const run_options *opts) {
     if (!ensure_wallet(&opts->wallet, &wallet, opts->wallet.reset)) {
         return 1;
     }
+    // Found blocks only post the new balance; the disk is touched off-thread.
+    wallet_persister persister;
+    if (!wallet_persister_start(&persister, &opts->wallet)) return 1;
+
+    // The "data|" prefix never changes: hash it once and start every
+    // attempt from that state, so only the nonce digits are fed per hash.
+    sha256_ctx prefix;
+    sha256_init(&prefix);
+    sha256_update(&prefix, (const uint8_t *)opts->data, strlen(opts->data));
+    sha256_update(&prefix, (const uint8_t *)"|", 1);
+    zero_target target = zero_target_from_digits(opts->difficulty);
+    nonce_odometer nonce;
+    odometer_reset(&nonce);
 
     double start = now_seconds();
 
-    for (uint64_t i = 0; ; i++) {
+    for (uint64_t i = 0; ; i++, odometer_next(&nonce)) {
         if (stop_flag) {
             attempts_done = i;
             break;
         }
->>>>>>> codex/create-readme-for-project-vn5azj
-        int n = snprintf(input, sizeof(input), "%s|%llu", opts->data, (unsigned long long)i);
-        if (n < 0 || (size_t)n >= sizeof(input)) {
-            fprintf(stderr, "input buffer overflow\n");
-            return 1;
-        }
 
-        sha256_ctx ctx;
-        sha256_init(&ctx);
-        sha256_update(&ctx, (const uint8_t*)input, (size_t)n);
+        sha256_ctx ctx = prefix;
+        sha256_update(&ctx, (const uint8_t *)nonce.buf + nonce.start, sizeof(nonce.buf) - nonce.start);
         sha256_final(&ctx, hash);
 
-        if (has_leading_hex_zeros(hash, opts->difficulty)) {
+        if (meets_zero_target(ctx.state, target)) {
             double elapsed = now_seconds() - start;
             double hash_rate = (elapsed > 0.0) ? (double)(i + 1) / elapsed : 0.0;
             printf("FOUND!\nNonce: %llu\nHash: ", (unsigned long long)i);
             hex_print(hash, SHA256_DIGEST_SIZE);
             printf("\nTime: %.3fs | Hashrate: %.2f H/s\n", elapsed, hash_rate);
-<<<<<<< HEAD
-            return 0;
-        }
-
-        maybe_report_progress(i, start, opts->progress_interval, "run");
-    }
-
-    double elapsed = now_seconds() - start;
-    double hash_rate = (elapsed > 0.0) ? (double)opts->max_attempts / elapsed : 0.0;
-    printf("\nNot found within max attempts.\n");
-    printf("Time: %.3fs | Hashrate: %.2f H/s\n", elapsed, hash_rate);
-=======
 
             wallet.balance += MINING_REWARD;
             wallet.mined_blocks += 1;
             found_blocks += 1;
-            if (!save_wallet(&opts->wallet, &wallet)) {
-                fprintf(stderr, "Nao foi possivel atualizar carteira.\n");
-                return 1;
-            }
+            ledger_record found;
+            memset(&found, 0, sizeof(found));
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            found.time_ms = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+            found.nonce = i;
+            found.reward = MINING_REWARD;
+            found.difficulty = opts->difficulty;
+            memcpy(found.hash, hash, sizeof(found.hash));
+            found.mode = LEDGER_MODE_RUN;
+            found.coin = COIN_UNKNOWN;
+            wallet_persister_post(&persister, &wallet, &found);
             printf("Reward: %llu coins adicionados. Novo saldo:\n", (unsigned long long)MINING_REWARD);
             print_wallet(&wallet);
         }
@@ -128,18 +152,102 @@ int run_miner(const run_options *opts) {
         attempts_done = i + 1;
     }
 
+    int saved = wallet_persister_stop(&persister);
     double elapsed = now_seconds() - start;
     double hash_rate = (elapsed > 0.0) ? (double)attempts_done / elapsed : 0.0;
     printf("\nMineracao interrompida manualmente (modo infinito).\n");
     printf("Time: %.3fs | Hashrate medio: %.2f H/s\n", elapsed, hash_rate);
     printf("Blocos encontrados nesta sessao: %llu\n", (unsigned long long)found_blocks);
-    printf("Carteira apos a sessao:\n");
+    printf("Carteira apos a sessao (%llu atualizacoes em %llu gravacoes):\n", (unsigned long long)persister.posts,
+           (unsigned long long)persister.writes);
     print_wallet(&wallet);
->>>>>>> codex/create-readme-for-project-vn5azj
+    if (!saved) {
+        fprintf(stderr, "Nao foi possivel atualizar carteira.\n");
+        return 1;
+    }
     return 0;
 }
 
+// Hex throughput per implementation on protocol-sized inputs, from a hash
+// to a full block. Each case moves about HEX_BENCH_VOLUME bytes.
+static int run_hex_benchmark(void) {
+    static const struct {
+        const char *label;
+        size_t bytes;
+    } cases[] = {
+        {"hash 32 B", 32},
+        {"coinbase 250 B", 250},
+        {"tx 4 KB", 4096},
+        {"template 1 MB", 1u << 20},
+        {"block 4 MB", 4u << 20},
+    };
+    static const hex_impl impls[] = {HEX_IMPL_SCALAR, HEX_IMPL_SSE2, HEX_IMPL_AVX2};
+    size_t max = cases[sizeof(cases) / sizeof(cases[0]) - 1].bytes;
+    uint8_t *data = malloc(max);
+    uint8_t *back = malloc(max);
+    char *text = malloc(max * 2);
+    char *expect = malloc(max * 2);
+    if (!data || !back || !text || !expect) {
+        free(data);
+        free(back);
+        free(text);
+        free(expect);
+        fprintf(stderr, "[bench] sem memoria\n");
+        return 1;
+    }
+    uint32_t x = 0x9E3779B9u;
+    for (size_t i = 0; i < max; i++) {
+        x = x * 1664525u + 1013904223u;
+        data[i] = (uint8_t)(x >> 24);
+    }
+
+    int failed = 0;
+    hex_impl previous = hex_get_impl();
+    printf("%-16s %-7s %14s %14s\n", "entrada", "impl", "encode MB/s", "decode MB/s");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]) && !failed; c++) {
+        size_t len = cases[c].bytes;
+        size_t reps = HEX_BENCH_VOLUME / len;
+        hex_set_impl(HEX_IMPL_SCALAR);
+        hex_encode(data, len, expect);
+        for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+            if (!hex_impl_supported(impls[k])) continue;
+            hex_set_impl(impls[k]);
+
+            double start = now_seconds();
+            for (size_t r = 0; r < reps; r++) hex_encode(data, len, text);
+            double encode_secs = now_seconds() - start;
+            if (memcmp(text, expect, len * 2) != 0) {
+                fprintf(stderr, "[bench] encode %s divergente em %s\n", hex_impl_name(impls[k]), cases[c].label);
+                failed = 1;
+                break;
+            }
+
+            int ok = 1;
+            start = now_seconds();
+            for (size_t r = 0; r < reps; r++) ok &= hex_decode(text, len * 2, back, len, NULL);
+            double decode_secs = now_seconds() - start;
+            if (!ok || memcmp(back, data, len) != 0) {
+                fprintf(stderr, "[bench] decode %s divergente em %s\n", hex_impl_name(impls[k]), cases[c].label);
+                failed = 1;
+                break;
+            }
+
+            double mb = (double)(reps * len) / 1e6;
+            printf("%-16s %-7s %14.1f %14.1f\n", cases[c].label, hex_impl_name(impls[k]),
+                   encode_secs > 0.0 ? mb / encode_secs : 0.0, decode_secs > 0.0 ? mb / decode_secs : 0.0);
+        }
+    }
+    hex_set_impl(previous);
+    free(data);
+    free(back);
+    free(text);
+    free(expect);
+    return failed;
+}
+
 int run_benchmark(const bench_options *opts) {
+    if (opts->hex) return run_hex_benchmark();
+
     uint8_t hash[SHA256_DIGEST_SIZE];
     char input[128];
 
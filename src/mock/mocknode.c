@@ -0,0 +1,1031 @@
+// coinminer_mocknode: local stand-in for bitcoind's mining RPC, for
+// repeatable measurements of the solo pipeline (template fetch, merkle
+// build, found-block latency, stale time) without a full node.
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include "bitcoin/block.h"
+#include "common.h"
+#include "hex.h"
+#include "json.h"
+#include "net.h"
+
+#define MOCKNODE_EVENTS 64
+#define MOCKNODE_RECENT 64
+#define MOCKNODE_MAX_REQUEST (64u << 20)
+
+typedef struct {
+    const char *bind_host;
+    const char *port;
+    int tx_count;
+    int coinbasetxn;
+    const char *bits;
+    uint32_t height;
+    int tip_secs;
+    int reorg_secs;
+    int build_ms;
+    int longpoll_secs;
+    int duration_secs;
+    int report_secs;
+    uint64_t seed;
+} mocknode_options;
+
+typedef struct {
+    int fd;
+    int in_use;
+    uint32_t generation;
+    net_buffer rx;
+    net_buffer tx;
+    net_buffer body;    // decoded body of the request being served
+    int want_write;
+    int has_request;
+    double received;    // first byte of the current request
+    // A request waiting for a tip change (long poll) or a build delay.
+    int parked;
+    int longpoll;
+    int built;
+    double due;
+    uint8_t wait_tip[32];
+} node_client;
+
+typedef struct {
+    double *v;
+    size_t len;
+    size_t cap;
+} sample_vec;
+
+typedef struct {
+    mocknode_options opts;
+    int epfd;
+    int listen_fd;
+    node_client *clients;
+    size_t client_cap;
+    uint64_t rng;
+
+    // Chain: tips are kept in internal byte order.
+    uint8_t tip[32];
+    uint32_t height;
+    double tip_at;
+    int tip_served;
+    uint8_t recent[MOCKNODE_RECENT][32];
+    size_t recent_next;
+    uint8_t nbits[4];
+    char target_hex[65];
+    double difficulty;
+
+    // Mempool, rendered once as the "transactions" array.
+    net_buffer tx_json;
+    int64_t fees;
+    char commitment[77];
+
+    net_buffer out;
+    uint8_t *block;
+    size_t block_cap;
+
+    size_t requests;
+    size_t templates;
+    size_t longpolls;
+    size_t best_calls;
+    size_t tips;
+    size_t accepted;
+    size_t stale;
+    size_t duplicate;
+    size_t rejected;
+    sample_vec tip_to_template;
+    sample_vec render;
+    sample_vec submit_receive;
+    sample_vec block_check;
+    sample_vec stale_delay;
+} mocknode;
+
+static volatile sig_atomic_t stop_flag = 0;
+
+static void handle_stop(int sig) {
+    (void)sig;
+    stop_flag = 1;
+}
+
+static double mono_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_rand(mocknode *mn) {
+    // xorshift64*: deterministic for a given --seed.
+    uint64_t x = mn->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    mn->rng = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static void random_bytes(mocknode *mn, uint8_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = (uint8_t)next_rand(mn);
+}
+
+static void sample_push(sample_vec *s, double v) {
+    if (s->len == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 256;
+        double *n = realloc(s->v, cap * sizeof(*n));
+        if (!n) return;
+        s->v = n;
+        s->cap = cap;
+    }
+    s->v[s->len++] = v;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_samples(const char *label, const sample_vec *s) {
+    if (s->len == 0) {
+        printf("[mocknode]   %-22s sem amostras\n", label);
+        return;
+    }
+    double *sorted = malloc(s->len * sizeof(*sorted));
+    if (!sorted) return;
+    memcpy(sorted, s->v, s->len * sizeof(*sorted));
+    qsort(sorted, s->len, sizeof(*sorted), cmp_double);
+    double sum = 0.0;
+    for (size_t i = 0; i < s->len; i++) sum += sorted[i];
+    printf("[mocknode]   %-22s n=%zu avg=%.2fms p50=%.2fms p90=%.2fms p99=%.2fms max=%.2fms\n",
+           label, s->len, 1000.0 * sum / (double)s->len,
+           1000.0 * sorted[s->len / 2], 1000.0 * sorted[(s->len * 9) / 10],
+           1000.0 * sorted[(s->len * 99) / 100], 1000.0 * sorted[s->len - 1]);
+    free(sorted);
+}
+
+static void print_report(const mocknode *mn, double elapsed) {
+    size_t clients = 0;
+    for (size_t i = 0; i < mn->client_cap; i++) clients += mn->clients[i].in_use ? 1 : 0;
+    printf("[mocknode] %.1fs | clientes=%zu | altura=%u | tips externos=%zu | requests=%zu | templates=%zu (long-poll=%zu) | getbestblockhash=%zu\n",
+           elapsed, clients, mn->height, mn->tips, mn->requests, mn->templates, mn->longpolls, mn->best_calls);
+    printf("[mocknode]   blocos: aceitos=%zu stale=%zu duplicados=%zu rejeitados=%zu\n", mn->accepted, mn->stale,
+           mn->duplicate, mn->rejected);
+    print_samples("tip->1o template", &mn->tip_to_template);
+    print_samples("montagem do template", &mn->render);
+    print_samples("submit recebido", &mn->submit_receive);
+    print_samples("verificacao do bloco", &mn->block_check);
+    print_samples("stale: atraso do tip", &mn->stale_delay);
+}
+
+static void append_str(net_buffer *b, const char *s) {
+    net_buffer_append(b, s, strlen(s));
+}
+
+static void append_hex(net_buffer *b, const uint8_t *data, size_t len, int reversed) {
+    if (!net_buffer_reserve(b, len * 2)) return;
+    if (reversed) hex_encode_reversed(data, len, b->data + b->len);
+    else hex_encode(data, len, b->data + b->len);
+    b->len += len * 2;
+}
+
+static void to_hex(const uint8_t *data, size_t len, int reversed, char *out) {
+    if (reversed) hex_encode_reversed(data, len, out);
+    else hex_encode(data, len, out);
+    out[len * 2] = '\0';
+}
+
+static size_t push_height(uint32_t n, uint8_t *out) {
+    // BIP 34: CScript() << height.
+    if (n == 0) {
+        out[0] = 0x00;
+        return 1;
+    }
+    if (n <= 16) {
+        out[0] = (uint8_t)(0x50 + n);
+        return 1;
+    }
+    size_t len = 0;
+    while (n) {
+        out[1 + len++] = (uint8_t)(n & 0xFF);
+        n >>= 8;
+    }
+    if (out[len] & 0x80) out[1 + len++] = 0x00;
+    out[0] = (uint8_t)len;
+    return len + 1;
+}
+
+static void put_le(uint64_t v, uint8_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = (uint8_t)(v >> (8 * i));
+}
+
+// Pairs in place, duplicating the odd one out.
+static void merkle_fold(uint8_t (*hashes)[32], size_t n, uint8_t out[32]) {
+    while (n > 1) {
+        for (size_t i = 0; i < n; i += 2) {
+            uint8_t pair[64];
+            memcpy(pair, hashes[i], 32);
+            memcpy(pair + 32, hashes[i + 1 < n ? i + 1 : i], 32);
+            double_sha256(pair, sizeof(pair), hashes[i / 2]);
+        }
+        n = (n + 1) / 2;
+    }
+    memcpy(out, hashes[0], 32);
+}
+
+// One-input, two-output P2WPKH-style spends; every other one carries a
+// witness, so txid and wtxid differ as in a real mempool.
+static int build_mempool(mocknode *mn) {
+    size_t count = (size_t)mn->opts.tx_count;
+    uint8_t (*wtxids)[32] = malloc((count + 1) * sizeof(*wtxids));
+    if (!wtxids) return 0;
+    memset(wtxids[0], 0, 32);  // the coinbase's wtxid is zero by definition
+    append_str(&mn->tx_json, "[");
+    for (size_t i = 0; i < count; i++) {
+        int witness = i % 2;
+        uint8_t tx[400];
+        size_t n = 0;
+        put_le(2, tx, 4);
+        n = 4;
+        size_t body = n;
+        if (witness) {
+            tx[n++] = 0x00;
+            tx[n++] = 0x01;
+            body = n;
+        }
+        tx[n++] = 1;
+        random_bytes(mn, tx + n, 36);
+        n += 36;
+        if (witness) {
+            tx[n++] = 0;
+        } else {
+            tx[n++] = 107;
+            random_bytes(mn, tx + n, 107);
+            n += 107;
+        }
+        put_le(0xFFFFFFFF, tx + n, 4);
+        n += 4;
+        tx[n++] = 2;
+        for (int o = 0; o < 2; o++) {
+            put_le(10000 + next_rand(mn) % 100000, tx + n, 8);
+            n += 8;
+            tx[n++] = 22;
+            tx[n++] = 0x00;
+            tx[n++] = 0x14;
+            random_bytes(mn, tx + n, 20);
+            n += 20;
+        }
+        size_t body_end = n;
+        if (witness) {
+            tx[n++] = 2;
+            tx[n++] = 71;
+            random_bytes(mn, tx + n, 71);
+            n += 71;
+            tx[n++] = 33;
+            random_bytes(mn, tx + n, 33);
+            n += 33;
+        }
+        put_le(0, tx + n, 4);
+        n += 4;
+
+        uint8_t legacy[400];
+        size_t legacy_len = 0;
+        memcpy(legacy, tx, 4);
+        memcpy(legacy + 4, tx + body, body_end - body);
+        memcpy(legacy + 4 + (body_end - body), tx + n - 4, 4);
+        legacy_len = 8 + (body_end - body);
+        uint8_t txid[32];
+        double_sha256(legacy, legacy_len, txid);
+        double_sha256(tx, n, wtxids[i + 1]);
+        int64_t fee = 1000 + (int64_t)(next_rand(mn) % 20000);
+        mn->fees += fee;
+
+        char line[160];
+        append_str(&mn->tx_json, i ? ",{\"data\":\"" : "{\"data\":\"");
+        append_hex(&mn->tx_json, tx, n, 0);
+        append_str(&mn->tx_json, "\",\"txid\":\"");
+        append_hex(&mn->tx_json, txid, 32, 1);
+        append_str(&mn->tx_json, "\",\"hash\":\"");
+        append_hex(&mn->tx_json, wtxids[i + 1], 32, 1);
+        snprintf(line, sizeof(line), "\",\"depends\":[],\"fee\":%lld,\"sigops\":1,\"weight\":%zu}", (long long)fee,
+                 3 * legacy_len + n);
+        append_str(&mn->tx_json, line);
+    }
+    append_str(&mn->tx_json, "]");
+
+    // BIP 141: SHA256d(witness root || reserved value of zeros).
+    uint8_t commit[64];
+    merkle_fold(wtxids, count + 1, commit);
+    memset(commit + 32, 0, 32);
+    double_sha256(commit, sizeof(commit), commit);
+    memcpy(mn->commitment, "6a24aa21a9ed", 12);
+    to_hex(commit, 32, 0, mn->commitment + 12);
+    free(wtxids);
+    return mn->tx_json.len > 0;
+}
+
+static int64_t coinbase_value(const mocknode *mn) {
+    uint32_t halvings = (mn->height + 1) / 210000;
+    return (halvings < 64 ? (int64_t)(5000000000ull >> halvings) : 0) + mn->fees;
+}
+
+// Node-built coinbase in legacy serialization: height, a tag, the value to
+// OP_TRUE and the witness commitment.
+static void append_coinbasetxn(mocknode *mn, net_buffer *b) {
+    uint8_t cb[200];
+    size_t n = 0;
+    put_le(1, cb, 4);
+    n = 4;
+    cb[n++] = 1;
+    memset(cb + n, 0, 32);
+    n += 32;
+    put_le(0xFFFFFFFF, cb + n, 4);
+    n += 4;
+    uint8_t script[40];
+    size_t script_len = push_height(mn->height + 1, script);
+    static const char tag[] = "/mocknode/";
+    script[script_len++] = (uint8_t)(sizeof(tag) - 1);
+    memcpy(script + script_len, tag, sizeof(tag) - 1);
+    script_len += sizeof(tag) - 1;
+    cb[n++] = (uint8_t)script_len;
+    memcpy(cb + n, script, script_len);
+    n += script_len;
+    put_le(0xFFFFFFFF, cb + n, 4);
+    n += 4;
+    cb[n++] = 2;
+    put_le((uint64_t)coinbase_value(mn), cb + n, 8);
+    n += 8;
+    cb[n++] = 1;
+    cb[n++] = 0x51;
+    put_le(0, cb + n, 8);
+    n += 8;
+    cb[n++] = 38;
+    hex_decode(mn->commitment, 76, cb + n, 38, NULL);
+    n += 38;
+    put_le(0, cb + n, 4);
+    n += 4;
+    append_str(b, ",\"coinbasetxn\":{\"data\":\"");
+    append_hex(b, cb, n, 0);
+    append_str(b, "\"}");
+}
+
+static void append_template(mocknode *mn, net_buffer *b) {
+    char tip[65];
+    to_hex(mn->tip, 32, 1, tip);
+    char head[768];
+    snprintf(head, sizeof(head),
+             "{\"version\":536870912,\"rules\":[\"segwit\"],\"previousblockhash\":\"%s\",\"coinbasevalue\":%lld,"
+             "\"longpollid\":\"%s%zu\",\"target\":\"%s\",\"mintime\":%lld,\"mutable\":[\"time\",\"transactions\",\"prevblock\"],"
+             "\"noncerange\":\"00000000ffffffff\",\"curtime\":%lld,\"bits\":\"%02x%02x%02x%02x\",\"height\":%u,"
+             "\"default_witness_commitment\":\"%s\",\"transactions\":",
+             tip, (long long)coinbase_value(mn), tip, mn->tips + mn->accepted, mn->target_hex, (long long)time(NULL) - 600,
+             (long long)time(NULL), mn->nbits[3], mn->nbits[2], mn->nbits[1], mn->nbits[0], mn->height + 1, mn->commitment);
+    append_str(b, head);
+    net_buffer_append(b, mn->tx_json.data, mn->tx_json.len);
+    if (mn->opts.coinbasetxn) append_coinbasetxn(mn, b);
+    append_str(b, "}");
+}
+
+static void remember_tip(mocknode *mn, const uint8_t hash[32], double now) {
+    memcpy(mn->recent[mn->recent_next++ % MOCKNODE_RECENT], hash, 32);
+    memcpy(mn->tip, hash, 32);
+    mn->height++;
+    mn->tip_at = now;
+    mn->tip_served = 0;
+}
+
+static int is_recent(const mocknode *mn, const uint8_t hash[32]) {
+    size_t count = mn->recent_next < MOCKNODE_RECENT ? mn->recent_next : MOCKNODE_RECENT;
+    for (size_t i = 0; i < count; i++) {
+        if (memcmp(mn->recent[i], hash, 32) == 0) return 1;
+    }
+    return 0;
+}
+
+// Height push at the start of the coinbase scriptSig (BIP 34).
+static int coinbase_height_ok(const uint8_t *block, size_t len, uint32_t height) {
+    size_t pos = 80;
+    if (pos >= len) return 0;
+    uint8_t first = block[pos];
+    pos += first < 0xFD ? 1 : first == 0xFD ? 3 : first == 0xFE ? 5 : 9;
+    pos += 4;
+    if (pos + 2 <= len && block[pos] == 0 && block[pos + 1] == 1) pos += 2;
+    pos += 1 + 36 + 1;
+    uint8_t want[8];
+    size_t want_len = push_height(height, want);
+    return pos + want_len <= len && memcmp(block + pos, want, want_len) == 0;
+}
+
+// Returns NULL when the block becomes the new tip, else the reject reason.
+static const char *submit_block(mocknode *mn, json_view params, double received) {
+    const char *v;
+    size_t vlen;
+    json_view hex;
+    if (!json_array_item(params.p, params.len, 0, &v, &vlen)) return "block-decode-failed";
+    json_view item = {v, vlen};
+    if (!json_view_string(item, &hex) || hex.len % 2) return "block-decode-failed";
+    size_t len = hex.len / 2;
+    if (len > mn->block_cap) {
+        uint8_t *block = realloc(mn->block, len);
+        if (!block) return "out-of-memory";
+        mn->block = block;
+        mn->block_cap = len;
+    }
+    double now = mono_seconds();
+    sample_push(&mn->submit_receive, now - received);
+    if (!hex_decode(hex.p, hex.len, mn->block, mn->block_cap, NULL)) return "block-decode-failed";
+
+    uint8_t hash[32];
+    const char *why = NULL;
+    int ok = bitcoin_block_check(mn->block, len, hash, &why);
+    sample_push(&mn->block_check, mono_seconds() - now);
+    if (!ok) {
+        mn->rejected++;
+        return why;
+    }
+    if (is_recent(mn, hash)) {
+        mn->duplicate++;
+        return "duplicate";
+    }
+    if (memcmp(mn->block + 4, mn->tip, 32) != 0) {
+        if (!is_recent(mn, mn->block + 4)) {
+            mn->rejected++;
+            return "prev-blk-not-found";
+        }
+        // Valid, but on a tip that is already gone.
+        mn->stale++;
+        sample_push(&mn->stale_delay, now - mn->tip_at);
+        return "inconclusive";
+    }
+    if (!coinbase_height_ok(mn->block, len, mn->height + 1)) {
+        mn->rejected++;
+        return "bad-cb-height";
+    }
+    mn->accepted++;
+    remember_tip(mn, hash, mono_seconds());
+    char hex_hash[65];
+    to_hex(hash, 32, 1, hex_hash);
+    printf("[mocknode] bloco aceito %s altura=%u (%zu bytes)\n", hex_hash, mn->height, len);
+    return NULL;
+}
+
+static void append_reply(mocknode *mn, net_buffer *b, json_message *msg, double received) {
+    json_view id = msg->id.p ? msg->id : (json_view){"null", 4};
+    append_str(b, "{\"result\":");
+    if (json_view_string_eq(msg->method, "getblocktemplate")) {
+        double start = mono_seconds();
+        append_template(mn, b);
+        sample_push(&mn->render, mono_seconds() - start);
+        mn->templates++;
+        if (!mn->tip_served) {
+            sample_push(&mn->tip_to_template, mono_seconds() - mn->tip_at);
+            mn->tip_served = 1;
+        }
+    } else if (json_view_string_eq(msg->method, "submitblock")) {
+        const char *why = submit_block(mn, msg->params, received);
+        if (why) {
+            append_str(b, "\"");
+            append_str(b, why);
+            append_str(b, "\"");
+        } else {
+            append_str(b, "null");
+        }
+    } else if (json_view_string_eq(msg->method, "getbestblockhash")) {
+        char tip[65];
+        to_hex(mn->tip, 32, 1, tip);
+        append_str(b, "\"");
+        append_str(b, tip);
+        append_str(b, "\"");
+        mn->best_calls++;
+    } else if (json_view_string_eq(msg->method, "getblockcount")) {
+        char n[16];
+        snprintf(n, sizeof(n), "%u", mn->height);
+        append_str(b, n);
+    } else if (json_view_string_eq(msg->method, "getmininginfo")) {
+        char info[200];
+        snprintf(info, sizeof(info), "{\"blocks\":%u,\"difficulty\":%.8f,\"networkhashps\":0,\"pooledtx\":%d,\"chain\":\"mock\"}",
+                 mn->height, mn->difficulty, mn->opts.tx_count);
+        append_str(b, info);
+    } else {
+        append_str(b, "null,\"error\":{\"code\":-32601,\"message\":\"Method not found\"},\"id\":");
+        net_buffer_append(b, id.p, id.len);
+        append_str(b, "}");
+        return;
+    }
+    append_str(b, ",\"error\":null,\"id\":");
+    net_buffer_append(b, id.p, id.len);
+    append_str(b, "}");
+}
+
+// Long polls wait for a tip other than the one in their longpollid (or for
+// --longpoll-secs); template requests then wait --build-ms. Returns 0 while
+// the request stays parked.
+static int must_wait(mocknode *mn, node_client *c, json_message *msg, double now) {
+    if (!json_view_string_eq(msg->method, "getblocktemplate")) return 0;
+    const char *request;
+    size_t request_len;
+    const char *id;
+    size_t id_len;
+    char tip[65];
+    to_hex(mn->tip, 32, 1, tip);
+    if (json_array_item(msg->params.p, msg->params.len, 0, &request, &request_len) &&
+        json_field(request, request_len, "longpollid", &id, &id_len)) {
+        json_view view = {id, id_len};
+        json_view inner;
+        if (json_view_string(view, &inner) && inner.len >= 64 && memcmp(inner.p, tip, 64) == 0 &&
+            now < c->received + mn->opts.longpoll_secs) {
+            c->longpoll = 1;
+            c->due = c->received + mn->opts.longpoll_secs;
+            memcpy(c->wait_tip, mn->tip, 32);
+            return 1;
+        }
+        if (c->longpoll) mn->longpolls++;
+    }
+    if (mn->opts.build_ms > 0 && !c->built) {
+        c->built = 1;
+        c->longpoll = 0;
+        c->due = now + mn->opts.build_ms / 1000.0;
+        return 1;
+    }
+    return 0;
+}
+
+static void epoll_update(mocknode *mn, int fd, uint32_t idx, int want_write) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    ev.data.u32 = idx;
+    epoll_ctl(mn->epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+static void client_close(mocknode *mn, uint32_t idx) {
+    node_client *c = &mn->clients[idx];
+    if (!c->in_use) return;
+    epoll_ctl(mn->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    net_buffer_free(&c->rx);
+    net_buffer_free(&c->tx);
+    net_buffer_free(&c->body);
+    c->in_use = 0;
+    c->generation++;
+}
+
+static int client_flush(mocknode *mn, uint32_t idx) {
+    node_client *c = &mn->clients[idx];
+    size_t sent = 0;
+    while (sent < c->tx.len) {
+        ssize_t n = send(c->fd, c->tx.data + sent, c->tx.len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return 0;
+        }
+        sent += (size_t)n;
+    }
+    net_buffer_consume(&c->tx, sent);
+    int pending = c->tx.len > 0;
+    if (pending != c->want_write) {
+        c->want_write = pending;
+        epoll_update(mn, c->fd, idx, pending);
+    }
+    return 1;
+}
+
+// Answers the request in c->body (a single call or a batch) unless part of
+// it has to wait.
+static int serve_request(mocknode *mn, uint32_t idx) {
+    node_client *c = &mn->clients[idx];
+    double now = mono_seconds();
+    json_view body = {c->body.data, c->body.len};
+    const char *p = body.p;
+    while (p < body.p + body.len && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+    int batch = p < body.p + body.len && *p == '[';
+
+    json_iter it;
+    json_view item = body;
+    json_message msg;
+    if (batch) json_iter_init(&it, body);
+    while (batch ? json_iter_next(&it, &item) : item.p != NULL) {
+        if (json_parse_message(item.p, item.len, &msg) && must_wait(mn, c, &msg, now)) {
+            c->parked = 1;
+            return 1;
+        }
+        if (!batch) break;
+    }
+
+    mn->out.len = 0;
+    if (batch) {
+        append_str(&mn->out, "[");
+        json_iter_init(&it, body);
+        for (int i = 0; json_iter_next(&it, &item); i++) {
+            if (i) append_str(&mn->out, ",");
+            if (json_parse_message(item.p, item.len, &msg)) append_reply(mn, &mn->out, &msg, c->received);
+        }
+        append_str(&mn->out, "]");
+    } else if (json_parse_message(body.p, body.len, &msg)) {
+        append_reply(mn, &mn->out, &msg, c->received);
+    } else {
+        append_str(&mn->out, "{\"result\":null,\"error\":{\"code\":-32700,\"message\":\"Parse error\"},\"id\":null}");
+    }
+    char head[160];
+    int head_len = snprintf(head, sizeof(head),
+                            "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n", mn->out.len);
+    net_buffer_append(&c->tx, head, (size_t)head_len);
+    net_buffer_append(&c->tx, mn->out.data, mn->out.len);
+    c->parked = 0;
+    c->longpoll = 0;
+    c->built = 0;
+    c->has_request = 0;
+    mn->requests++;
+    return client_flush(mn, idx);
+}
+
+static const char *find_crlf(const char *p, const char *end) {
+    for (; p + 1 < end; p++) {
+        if (p[0] == '\r' && p[1] == '\n') return p;
+    }
+    return NULL;
+}
+
+// Moves one complete HTTP request from rx into body. Returns 1 when one
+// was taken, 0 when more bytes are needed and -1 on a malformed request.
+static int take_request(node_client *c) {
+    const char *data = c->rx.data;
+    const char *end = data + c->rx.len;
+    const char *head_end = NULL;
+    for (const char *p = data; p + 3 < end; p++) {
+        if (p[0] == '\r' && p[1] == '\n' && p[2] == '\r' && p[3] == '\n') {
+            head_end = p + 4;
+            break;
+        }
+    }
+    if (!head_end) return c->rx.len > 65536 ? -1 : 0;
+
+    size_t content_length = 0;
+    int chunked = 0;
+    for (const char *line = data; line < head_end - 2;) {
+        const char *eol = find_crlf(line, head_end);
+        if (!eol) break;
+        if ((size_t)(eol - line) > 15 && strncasecmp(line, "Content-Length:", 15) == 0) {
+            content_length = strtoul(line + 15, NULL, 10);
+        } else if ((size_t)(eol - line) > 18 && strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            for (const char *q = line + 18; q + 7 <= eol; q++) {
+                if (strncasecmp(q, "chunked", 7) == 0) chunked = 1;
+            }
+        }
+        line = eol + 2;
+    }
+
+    c->body.len = 0;
+    size_t consumed;
+    if (!chunked) {
+        if (content_length > MOCKNODE_MAX_REQUEST) return -1;
+        if ((size_t)(end - head_end) < content_length) return 0;
+        if (!net_buffer_append(&c->body, head_end, content_length)) return -1;
+        consumed = (size_t)(head_end - data) + content_length;
+    } else {
+        // Walk the sizes first so nothing is copied before the last chunk.
+        const char *p = head_end;
+        size_t total = 0;
+        for (;;) {
+            const char *eol = find_crlf(p, end);
+            if (!eol) return 0;
+            size_t size = strtoul(p, NULL, 16);
+            if (size == 0) {
+                if (end - eol < 4) return 0;
+                consumed = (size_t)(eol + 4 - data);
+                break;
+            }
+            total += size;
+            if (total > MOCKNODE_MAX_REQUEST) return -1;
+            if ((size_t)(end - eol) < size + 4) return 0;
+            p = eol + 2 + size + 2;
+        }
+        if (!net_buffer_reserve(&c->body, total)) return -1;
+        for (p = head_end;;) {
+            const char *eol = find_crlf(p, end);
+            size_t size = strtoul(p, NULL, 16);
+            if (size == 0) break;
+            net_buffer_append(&c->body, eol + 2, size);
+            p = eol + 2 + size + 2;
+        }
+    }
+    net_buffer_consume(&c->rx, consumed);
+    return 1;
+}
+
+// Serves complete requests in rx, one at a time; a parked one holds the
+// rest back. Returns 0 when the client was closed.
+static int process_requests(mocknode *mn, uint32_t idx) {
+    node_client *c = &mn->clients[idx];
+    while (!c->has_request && !c->parked) {
+        int r = take_request(c);
+        if (r < 0) {
+            client_close(mn, idx);
+            return 0;
+        }
+        if (r == 0) break;
+        c->has_request = 1;
+        if (!serve_request(mn, idx)) {
+            client_close(mn, idx);
+            return 0;
+        }
+        if (c->rx.len) c->received = mono_seconds();
+    }
+    return 1;
+}
+
+static void client_readable(mocknode *mn, uint32_t idx) {
+    node_client *c = &mn->clients[idx];
+    for (;;) {
+        if (!net_buffer_reserve(&c->rx, 65536)) {
+            client_close(mn, idx);
+            return;
+        }
+        ssize_t n = recv(c->fd, c->rx.data + c->rx.len, c->rx.cap - c->rx.len, 0);
+        if (n == 0) {
+            client_close(mn, idx);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) client_close(mn, idx);
+            return;
+        }
+        if (c->rx.len == 0 && !c->has_request) c->received = mono_seconds();
+        c->rx.len += (size_t)n;
+        if (!process_requests(mn, idx)) return;
+    }
+}
+
+static void accept_clients(mocknode *mn) {
+    for (;;) {
+        int fd = accept(mn->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        uint32_t idx = 0;
+        while (idx < mn->client_cap && mn->clients[idx].in_use) idx++;
+        if (idx == mn->client_cap) {
+            size_t cap = mn->client_cap ? mn->client_cap * 2 : 16;
+            node_client *n = realloc(mn->clients, cap * sizeof(*n));
+            if (!n) {
+                close(fd);
+                continue;
+            }
+            memset(n + mn->client_cap, 0, (cap - mn->client_cap) * sizeof(*n));
+            mn->clients = n;
+            mn->client_cap = cap;
+        }
+        net_set_nonblocking(fd);
+        node_client *c = &mn->clients[idx];
+        uint32_t generation = c->generation;
+        memset(c, 0, sizeof(*c));
+        c->generation = generation;
+        c->fd = fd;
+        c->in_use = 1;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = idx;
+        epoll_ctl(mn->epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+// Serves parked requests whose tip changed or whose wait ran out, then
+// anything pipelined behind them.
+static void wake_parked(mocknode *mn, double now) {
+    for (uint32_t i = 0; i < mn->client_cap; i++) {
+        node_client *c = &mn->clients[i];
+        if (!c->in_use || !c->parked) continue;
+        if (now < c->due && !(c->longpoll && memcmp(c->wait_tip, mn->tip, 32) != 0)) continue;
+        c->parked = 0;
+        if (!serve_request(mn, i)) {
+            client_close(mn, i);
+            continue;
+        }
+        process_requests(mn, i);
+    }
+}
+
+static void new_tip(mocknode *mn, double now) {
+    uint8_t hash[32];
+    random_bytes(mn, hash, sizeof(hash));
+    hash[31] = 0;  // looks like a hash that met a target
+    mn->tips++;
+    remember_tip(mn, hash, now);
+}
+
+// One-block reorg: the tip is replaced by a sibling at the same height.
+static void reorg_tip(mocknode *mn, double now) {
+    mn->height--;
+    new_tip(mn, now);
+    char hex_hash[65];
+    to_hex(mn->tip, 32, 1, hex_hash);
+    printf("[mocknode] reorg: tip na altura %u trocado por %s\n", mn->height, hex_hash);
+}
+
+static void print_usage(const char *progname) {
+    printf("Uso: %s [opcoes]\n", progname);
+    printf("  --port N              porta RPC (default: 18443)\n");
+    printf("  --bind ADDR           endereco (default: 127.0.0.1)\n");
+    printf("  --txs N               transacoes por template (default: 2000)\n");
+    printf("  --coinbasetxn 0|1     envia coinbasetxn pronta (default: 0, so coinbasevalue)\n");
+    printf("  --bits HEX            nbits dos templates (default: 1e0fffff, ~1M hashes por bloco)\n");
+    printf("  --height N            altura inicial do tip (default: 800000)\n");
+    printf("  --tip-secs N          novo bloco externo a cada N segundos (default: 30, 0 = so os achados)\n");
+    printf("  --reorg-secs N        troca o tip por outro na mesma altura a cada N segundos (default: 0)\n");
+    printf("  --build-ms N          atraso simulado para montar cada template (default: 0)\n");
+    printf("  --longpoll-secs N     tempo maximo preso num long poll (default: 60)\n");
+    printf("  --duration N          encerra apos N segundos (default: 0 = Ctrl+C)\n");
+    printf("  --report-secs N       intervalo do relatorio (default: 10)\n");
+    printf("  --seed N              semente do mempool e dos tips (default: 1)\n");
+}
+
+static int parse_args(int argc, char **argv, mocknode_options *o) {
+    o->bind_host = "127.0.0.1";
+    o->port = "18443";
+    o->tx_count = 2000;
+    o->coinbasetxn = 0;
+    o->bits = "1e0fffff";
+    o->height = 800000;
+    o->tip_secs = 30;
+    o->reorg_secs = 0;
+    o->build_ms = 0;
+    o->longpoll_secs = 60;
+    o->duration_secs = 0;
+    o->report_secs = 10;
+    o->seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--help") == 0 || strcmp(a, "help") == 0) {
+            print_usage(argv[0]);
+            exit(0);
+        }
+        if (!v) {
+            fprintf(stderr, "Falta valor para %s\n", a);
+            return 0;
+        }
+        if (strcmp(a, "--port") == 0) o->port = v;
+        else if (strcmp(a, "--bind") == 0) o->bind_host = v;
+        else if (strcmp(a, "--txs") == 0) o->tx_count = atoi(v);
+        else if (strcmp(a, "--coinbasetxn") == 0) o->coinbasetxn = atoi(v);
+        else if (strcmp(a, "--bits") == 0) o->bits = v;
+        else if (strcmp(a, "--height") == 0) o->height = (uint32_t)strtoul(v, NULL, 10);
+        else if (strcmp(a, "--tip-secs") == 0) o->tip_secs = atoi(v);
+        else if (strcmp(a, "--reorg-secs") == 0) o->reorg_secs = atoi(v);
+        else if (strcmp(a, "--build-ms") == 0) o->build_ms = atoi(v);
+        else if (strcmp(a, "--longpoll-secs") == 0) o->longpoll_secs = atoi(v);
+        else if (strcmp(a, "--duration") == 0) o->duration_secs = atoi(v);
+        else if (strcmp(a, "--report-secs") == 0) o->report_secs = atoi(v);
+        else if (strcmp(a, "--seed") == 0) o->seed = strtoull(v, NULL, 10);
+        else {
+            fprintf(stderr, "Opcao desconhecida: %s\n", a);
+            return 0;
+        }
+        i++;
+    }
+    if (o->tx_count < 0 || o->tx_count > 1000000 || o->report_secs <= 0 || o->longpoll_secs <= 0) {
+        fprintf(stderr, "Parametros invalidos\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    mocknode mn;
+    memset(&mn, 0, sizeof(mn));
+    if (!parse_args(argc, argv, &mn.opts)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    // nbits comes in display order; the header keeps it little-endian.
+    uint8_t bits_be[4];
+    size_t bits_len = 0;
+    uint8_t target[32];
+    if (!hex_decode(mn.opts.bits, strlen(mn.opts.bits), bits_be, sizeof(bits_be), &bits_len) || bits_len != 4) {
+        fprintf(stderr, "--bits invalido: %s\n", mn.opts.bits);
+        return 1;
+    }
+    for (int i = 0; i < 4; i++) mn.nbits[i] = bits_be[3 - i];
+    if (!bitcoin_target_from_nbits(mn.nbits, target)) {
+        fprintf(stderr, "--bits invalido: %s\n", mn.opts.bits);
+        return 1;
+    }
+    to_hex(target, 32, 0, mn.target_hex);
+    double target_value = 0.0;
+    for (int i = 0; i < 32; i++) target_value = target_value * 256.0 + target[i];
+    mn.difficulty = ldexp(65535.0, 208) / target_value;
+
+    mn.rng = mn.opts.seed ? mn.opts.seed : 1;
+    double t0 = mono_seconds();
+    if (!build_mempool(&mn)) {
+        fprintf(stderr, "[mocknode] falha ao gerar o mempool\n");
+        return 1;
+    }
+    double start = mono_seconds();
+    printf("[mocknode] mempool: %d transacoes, %zu bytes de JSON, taxas=%lld (gerado em %.1fms)\n", mn.opts.tx_count,
+           mn.tx_json.len, (long long)mn.fees, 1000.0 * (start - t0));
+    mn.height = mn.opts.height - 1;
+    new_tip(&mn, start);
+    mn.tips = 0;
+
+    mn.epfd = epoll_create1(0);
+    mn.listen_fd = net_listen_tcp(mn.opts.bind_host, mn.opts.port, 64);
+    if (mn.epfd < 0 || mn.listen_fd < 0) return 1;
+    net_set_nonblocking(mn.listen_fd);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = UINT32_MAX;
+    epoll_ctl(mn.epfd, EPOLL_CTL_ADD, mn.listen_fd, &ev);
+
+    printf("[mocknode] coinminer %s | escutando em %s:%s | bits %s (difficulty %.6f) | coinbasetxn=%s | tip a cada %ds\n",
+           COINMINER_VERSION, mn.opts.bind_host, mn.opts.port, mn.opts.bits, mn.difficulty,
+           mn.opts.coinbasetxn ? "sim" : "nao", mn.opts.tip_secs);
+    fflush(stdout);
+
+    double next_tip = mn.opts.tip_secs > 0 ? start + mn.opts.tip_secs : 0.0;
+    double next_reorg = mn.opts.reorg_secs > 0 ? start + mn.opts.reorg_secs : 0.0;
+    double next_report = start + mn.opts.report_secs;
+    struct epoll_event events[MOCKNODE_EVENTS];
+    while (!stop_flag) {
+        double now = mono_seconds();
+        if (mn.opts.duration_secs > 0 && now - start >= mn.opts.duration_secs) break;
+        if (next_tip > 0.0 && now >= next_tip) {
+            new_tip(&mn, now);
+            next_tip += mn.opts.tip_secs;
+            if (next_tip < now) next_tip = now + mn.opts.tip_secs;
+        }
+        if (next_reorg > 0.0 && now >= next_reorg) {
+            reorg_tip(&mn, now);
+            next_reorg += mn.opts.reorg_secs;
+            if (next_reorg < now) next_reorg = now + mn.opts.reorg_secs;
+        }
+        wake_parked(&mn, now);
+        if (now >= next_report) {
+            print_report(&mn, now - start);
+            fflush(stdout);
+            next_report += mn.opts.report_secs;
+        }
+
+        double wake = next_report;
+        if (next_tip > 0.0 && next_tip < wake) wake = next_tip;
+        if (next_reorg > 0.0 && next_reorg < wake) wake = next_reorg;
+        for (uint32_t i = 0; i < mn.client_cap; i++) {
+            if (mn.clients[i].in_use && mn.clients[i].parked && mn.clients[i].due < wake) wake = mn.clients[i].due;
+        }
+        int timeout = (int)((wake - now) * 1000.0) + 1;
+        if (timeout < 0) timeout = 0;
+        if (timeout > 1000) timeout = 1000;
+
+        int n = epoll_wait(mn.epfd, events, MOCKNODE_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("[mocknode] epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint32_t idx = events[i].data.u32;
+            if (idx == UINT32_MAX) {
+                accept_clients(&mn);
+                continue;
+            }
+            if (idx >= mn.client_cap || !mn.clients[idx].in_use) continue;
+            if ((events[i].events & EPOLLOUT) && !client_flush(&mn, idx)) {
+                client_close(&mn, idx);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) client_readable(&mn, idx);
+        }
+    }
+
+    print_report(&mn, mono_seconds() - start);
+    for (uint32_t i = 0; i < mn.client_cap; i++) client_close(&mn, i);
+    free(mn.clients);
+    free(mn.block);
+    net_buffer_free(&mn.tx_json);
+    net_buffer_free(&mn.out);
+    free(mn.tip_to_template.v);
+    free(mn.render.v);
+    free(mn.submit_receive.v);
+    free(mn.block_check.v);
+    free(mn.stale_delay.v);
+    close(mn.listen_fd);
+    close(mn.epfd);
+    return 0;
+}
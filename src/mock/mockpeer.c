@@ -0,0 +1,256 @@
+// coinminer_mockpeer: stand-in for a node's P2P port. Does the handshake,
+// answers pings and fully checks every block the miner relays (layout,
+// merkle root, proof of work), timing how long each one takes to arrive.
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include "bitcoin/block.h"
+#include "bitcoin/p2p.h"
+#include "common.h"
+#include "hex.h"
+#include "net.h"
+#include "sha256.h"
+
+#define MOCKPEER_HEADER_SIZE 24
+
+typedef struct {
+    const char *bind_host;
+    const char *port;
+    uint8_t magic[4];
+    int ping_secs;
+} mockpeer_options;
+
+typedef struct {
+    size_t connections;
+    size_t headers;
+    size_t blocks;
+    size_t valid;
+    size_t bytes;
+    double receive_secs;
+    double check_secs;
+} mockpeer_stats;
+
+static volatile sig_atomic_t stop_flag = 0;
+
+static void handle_stop(int sig) {
+    (void)sig;
+    stop_flag = 1;
+}
+
+static double mono_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int send_message(int fd, const uint8_t magic[4], const char *command, const uint8_t *payload, size_t len) {
+    uint8_t head[MOCKPEER_HEADER_SIZE];
+    uint8_t hash[32];
+    memset(head, 0, sizeof(head));
+    memcpy(head, magic, 4);
+    memcpy(head + 4, command, strlen(command));
+    for (int i = 0; i < 4; i++) head[16 + i] = (uint8_t)(len >> (8 * i));
+    double_sha256(payload, len, hash);
+    memcpy(head + 20, hash, 4);
+    struct iovec iov[2] = {{head, sizeof(head)}, {(void *)payload, len}};
+    return net_sendv_all(fd, iov, len ? 2 : 1);
+}
+
+static void print_hash(const char *label, const uint8_t hash[32]) {
+    char hex[65];
+    hex_encode_reversed(hash, 32, hex);
+    hex[64] = '\0';
+    printf("%s%s", label, hex);
+}
+
+static void handle_block(const uint8_t *payload, size_t len, double started, double header_at, mockpeer_stats *stats) {
+    double received = mono_seconds();
+    uint8_t hash[32];
+    const char *why = NULL;
+    int ok = bitcoin_block_check(payload, len, hash, &why);
+    double checked = mono_seconds();
+    stats->blocks++;
+    stats->valid += ok ? 1 : 0;
+    stats->bytes += len;
+    stats->receive_secs += received - started;
+    stats->check_secs += checked - received;
+    print_hash("[mockpeer] block ", hash);
+    printf(" %zu bytes: %s | recebido em %.2fms", len, ok ? "valido" : why, 1000.0 * (received - started));
+    if (header_at > 0.0) printf(" (headers -> block completo %.2fms)", 1000.0 * (received - header_at));
+    printf(" | verificado em %.2fms\n", 1000.0 * (checked - received));
+    fflush(stdout);
+}
+
+// One miner connection, until it closes or Ctrl+C.
+static void serve(int fd, const mockpeer_options *o, mockpeer_stats *stats) {
+    net_buffer rx = {0};
+    double message_started = 0.0;
+    double header_at = 0.0;
+    double next_ping = mono_seconds() + o->ping_secs;
+    uint64_t ping_nonce = 0;
+    while (!stop_flag) {
+        if (o->ping_secs > 0 && mono_seconds() >= next_ping) {
+            uint8_t nonce[8];
+            ping_nonce++;
+            for (int i = 0; i < 8; i++) nonce[i] = (uint8_t)(ping_nonce >> (8 * i));
+            if (!send_message(fd, o->magic, "ping", nonce, sizeof(nonce))) break;
+            next_ping += o->ping_secs;
+        }
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, 200);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) continue;
+        if (!net_buffer_reserve(&rx, 1 << 20)) break;
+        ssize_t n = recv(fd, rx.data + rx.len, rx.cap - rx.len, 0);
+        if (n <= 0) break;
+        if (rx.len == 0) message_started = mono_seconds();
+        rx.len += (size_t)n;
+
+        int failed = 0;
+        while (!failed && rx.len >= MOCKPEER_HEADER_SIZE) {
+            const uint8_t *head = (const uint8_t *)rx.data;
+            uint32_t len = read_le32(head + 16);
+            if (memcmp(head, o->magic, 4) != 0 || len > P2P_MAX_MESSAGE) {
+                printf("[mockpeer] magic ou tamanho invalido, desconectando\n");
+                failed = 1;
+                break;
+            }
+            if (rx.len < MOCKPEER_HEADER_SIZE + (size_t)len) break;
+            const uint8_t *payload = head + MOCKPEER_HEADER_SIZE;
+            uint8_t hash[32];
+            double_sha256(payload, len, hash);
+            char command[13];
+            memcpy(command, head + 4, 12);
+            command[12] = '\0';
+            if (memcmp(hash, head + 20, 4) != 0) {
+                printf("[mockpeer] checksum invalido em %s\n", command);
+                failed = 1;
+            } else if (strcmp(command, "version") == 0) {
+                uint8_t version[128];
+                memset(version, 0, sizeof(version));
+                uint32_t v = P2P_PROTOCOL_VERSION;
+                for (int i = 0; i < 4; i++) version[i] = (uint8_t)(v >> (8 * i));
+                static const char agent[] = "/coinminer-mockpeer:" COINMINER_VERSION "/";
+                version[80] = (uint8_t)(sizeof(agent) - 1);
+                memcpy(version + 81, agent, sizeof(agent) - 1);
+                size_t vlen = 81 + sizeof(agent) - 1 + 5;
+                printf("[mockpeer] version do minerador (protocolo %u)\n", read_le32(payload));
+                failed = !send_message(fd, o->magic, "version", version, vlen) ||
+                         !send_message(fd, o->magic, "verack", NULL, 0);
+            } else if (strcmp(command, "ping") == 0 && len >= 8) {
+                failed = !send_message(fd, o->magic, "pong", payload, 8);
+            } else if (strcmp(command, "headers") == 0 && len >= 81) {
+                stats->headers++;
+                header_at = mono_seconds();
+                double_sha256(payload + 1, 80, hash);
+                print_hash("[mockpeer] headers ", hash);
+                printf("\n");
+            } else if (strcmp(command, "block") == 0) {
+                handle_block(payload, len, message_started, header_at, stats);
+                header_at = 0.0;
+            }
+            net_buffer_consume(&rx, MOCKPEER_HEADER_SIZE + (size_t)len);
+            message_started = mono_seconds();
+        }
+        if (failed) break;
+    }
+    net_buffer_free(&rx);
+}
+
+static void print_usage(const char *progname) {
+    printf("Uso: %s [opcoes]\n", progname);
+    printf("  --port N         porta P2P (default: 8333)\n");
+    printf("  --bind ADDR      endereco (default: 127.0.0.1)\n");
+    printf("  --magic HEX      bytes iniciais das mensagens (default: f9beb4d9, bitcoin mainnet)\n");
+    printf("  --ping-secs N    envia ping a cada N segundos (default: 20, 0 = nunca)\n");
+}
+
+static int parse_args(int argc, char **argv, mockpeer_options *o) {
+    o->bind_host = "127.0.0.1";
+    o->port = "8333";
+    memcpy(o->magic, "\xf9\xbe\xb4\xd9", 4);
+    o->ping_secs = 20;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--help") == 0 || strcmp(a, "help") == 0) {
+            print_usage(argv[0]);
+            exit(0);
+        }
+        if (!v) {
+            fprintf(stderr, "Falta valor para %s\n", a);
+            return 0;
+        }
+        size_t magic_len = 0;
+        if (strcmp(a, "--port") == 0) o->port = v;
+        else if (strcmp(a, "--bind") == 0) o->bind_host = v;
+        else if (strcmp(a, "--ping-secs") == 0) o->ping_secs = atoi(v);
+        else if (strcmp(a, "--magic") == 0) {
+            if (!hex_decode(v, strlen(v), o->magic, sizeof(o->magic), &magic_len) || magic_len != 4) {
+                fprintf(stderr, "Magic invalido: %s (4 bytes em hex)\n", v);
+                return 0;
+            }
+        } else {
+            fprintf(stderr, "Opcao desconhecida: %s\n", a);
+            return 0;
+        }
+        i++;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    mockpeer_options opts;
+    if (!parse_args(argc, argv, &opts)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = net_listen_tcp(opts.bind_host, opts.port, 4);
+    if (listen_fd < 0) return 1;
+    printf("[mockpeer] coinminer %s | escutando em %s:%s | magic %02x%02x%02x%02x\n", COINMINER_VERSION,
+           opts.bind_host, opts.port, opts.magic[0], opts.magic[1], opts.magic[2], opts.magic[3]);
+    fflush(stdout);
+
+    mockpeer_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    while (!stop_flag) {
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        stats.connections++;
+        printf("[mockpeer] minerador conectado\n");
+        serve(fd, &opts, &stats);
+        close(fd);
+        printf("[mockpeer] minerador desconectado\n");
+        fflush(stdout);
+    }
+    close(listen_fd);
+
+    printf("[mockpeer] conexoes=%zu | headers=%zu | blocos=%zu (validos=%zu, %zu bytes)", stats.connections,
+           stats.headers, stats.blocks, stats.valid, stats.bytes);
+    if (stats.blocks) {
+        printf(" | recebimento medio %.2fms, verificacao media %.2fms", 1000.0 * stats.receive_secs / (double)stats.blocks,
+               1000.0 * stats.check_secs / (double)stats.blocks);
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,920 @@
+// coinminer_mockpool: local Stratum v1 pool for deterministic load tests of
+// the stratum client (job switches, clean_jobs, difficulty changes).
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include "bitcoin/block.h"
+#include "common.h"
+#include "hex.h"
+#include "json.h"
+#include "net.h"
+#include "sha256.h"
+#include "shareset.h"
+
+#define MOCK_JOB_RING 16
+#define MOCK_MAX_MERKLE 32
+#define MOCK_EVENTS 128
+#define MOCK_SESSION_RING 64
+#define MOCK_TX_LIMIT (1u << 20)
+
+typedef struct {
+    const char *bind_host;
+    const char *port;
+    int notify_ms;
+    double clean_ratio;
+    double difficulty;
+    int diff_change_secs;
+    double diff_factor;
+    int extranonce2_size;
+    int extranonce_change_secs;
+    int drop_secs;
+    int merkle_count;
+    int coinbase_bytes;
+    int reply_delay_ms;
+    const char *suggest;
+    int notify_first;
+    int duration_secs;
+    int report_secs;
+    uint64_t seed;
+} mockpool_options;
+
+typedef struct {
+    uint64_t seq;
+    char job_id[17];
+    char prev_hash[65];
+    char *coinb1;
+    char *coinb2;
+    char merkle[MOCK_MAX_MERKLE][65];
+    size_t merkle_count;
+    char version[9];
+    char nbits[9];
+    char ntime[9];
+    int clean;
+} mock_job;
+
+typedef struct {
+    int fd;
+    int in_use;
+    uint32_t generation;
+    net_line_reader rx;
+    net_buffer tx;
+    int want_write;
+    char session_id[9];
+    char extranonce1[9];
+    char prev_extranonce1[9];
+    uint64_t extranonce1_since;
+    int extranonce_subscribe;
+    int subscribed;
+    int authorized;
+    double difficulty;
+    double prev_difficulty;
+    uint64_t current_job;
+    double current_job_sent;
+    uint64_t first_share_job;
+    share_set seen;
+} mock_client;
+
+// Extranonce state of a closed connection, kept so a resume gets back the
+// extranonce1 the client was last using, not the one it subscribed with.
+typedef struct {
+    char id[9];
+    char extranonce1[9];
+    char prev_extranonce1[9];
+    uint64_t extranonce1_since;
+} mock_session;
+
+typedef struct {
+    double due;
+    uint32_t client;
+    uint32_t generation;
+    double received;
+    char line[160];
+} mock_reply;
+
+typedef struct {
+    double *v;
+    size_t len;
+    size_t cap;
+} sample_vec;
+
+typedef struct {
+    mockpool_options opts;
+    int epfd;
+    int listen_fd;
+    mock_client *clients;
+    size_t client_cap;
+    uint32_t next_extranonce1;
+    uint64_t rng;
+    mock_session sessions[MOCK_SESSION_RING];
+    size_t session_next;
+
+    mock_job jobs[MOCK_JOB_RING];
+    uint64_t job_seq;
+    uint64_t last_clean_seq;
+    double difficulty;
+    int diff_direction;
+
+    mock_reply *replies;
+    size_t reply_head;
+    size_t reply_len;
+    size_t reply_cap;
+
+    size_t notifies;
+    size_t clean_notifies;
+    size_t difficulty_changes;
+    size_t extranonce_changes;
+    size_t resumed;
+    size_t accepted;
+    size_t stale;
+    size_t duplicate;
+    size_t low_difficulty;
+    size_t malformed;
+    double accepted_work;
+    sample_vec first_share;
+    sample_vec reply_latency;
+    sample_vec job_age;
+} mockpool;
+
+static volatile sig_atomic_t stop_flag = 0;
+
+static void handle_stop(int sig) {
+    (void)sig;
+    stop_flag = 1;
+}
+
+static double mono_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_rand(mockpool *mp) {
+    // xorshift64*: deterministic for a given --seed.
+    uint64_t x = mp->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    mp->rng = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static void random_hex(mockpool *mp, char *out, size_t bytes) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < bytes; i++) {
+        uint8_t b = (uint8_t)next_rand(mp);
+        out[i * 2] = hex[b >> 4];
+        out[i * 2 + 1] = hex[b & 0xF];
+    }
+    out[bytes * 2] = '\0';
+}
+
+static void sample_push(sample_vec *s, double v) {
+    if (s->len == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 256;
+        double *n = realloc(s->v, cap * sizeof(*n));
+        if (!n) return;
+        s->v = n;
+        s->cap = cap;
+    }
+    s->v[s->len++] = v;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_samples(const char *label, const sample_vec *s) {
+    if (s->len == 0) {
+        printf("[mockpool]   %-22s sem amostras\n", label);
+        return;
+    }
+    double *sorted = malloc(s->len * sizeof(*sorted));
+    if (!sorted) return;
+    memcpy(sorted, s->v, s->len * sizeof(*sorted));
+    qsort(sorted, s->len, sizeof(*sorted), cmp_double);
+    double sum = 0.0;
+    for (size_t i = 0; i < s->len; i++) sum += sorted[i];
+    printf("[mockpool]   %-22s n=%zu avg=%.2fms p50=%.2fms p90=%.2fms p99=%.2fms max=%.2fms\n",
+           label, s->len, 1000.0 * sum / (double)s->len,
+           1000.0 * sorted[s->len / 2], 1000.0 * sorted[(s->len * 9) / 10],
+           1000.0 * sorted[(s->len * 99) / 100], 1000.0 * sorted[s->len - 1]);
+    free(sorted);
+}
+
+static void print_report(const mockpool *mp, double elapsed) {
+    size_t clients = 0;
+    for (size_t i = 0; i < mp->client_cap; i++) clients += mp->clients[i].in_use ? 1 : 0;
+    size_t total = mp->accepted + mp->stale + mp->duplicate + mp->low_difficulty + mp->malformed;
+    double hashrate = elapsed > 0.0 ? mp->accepted_work * 4294967296.0 / elapsed : 0.0;
+    printf("[mockpool] %.1fs | clientes=%zu | notify=%zu (clean=%zu) | difficulty=%.8f (trocas=%zu)\n",
+           elapsed, clients, mp->notifies, mp->clean_notifies, mp->difficulty, mp->difficulty_changes);
+    printf("[mockpool]   shares=%zu aceitos=%zu stale=%zu duplicados=%zu low-diff=%zu malformados=%zu (stale %.2f%%)\n",
+           total, mp->accepted, mp->stale, mp->duplicate, mp->low_difficulty, mp->malformed,
+           total ? 100.0 * (double)mp->stale / (double)total : 0.0);
+    printf("[mockpool]   hashrate estimado pelos shares: %.2f H/s\n", hashrate);
+    if (mp->extranonce_changes) printf("[mockpool]   trocas de extranonce1: %zu\n", mp->extranonce_changes);
+    if (mp->resumed) printf("[mockpool]   sessoes retomadas: %zu\n", mp->resumed);
+    print_samples("notify->1o share", &mp->first_share);
+    print_samples("idade do job no submit", &mp->job_age);
+    print_samples("submit->resposta", &mp->reply_latency);
+}
+
+static void epoll_update(mockpool *mp, int fd, uint32_t idx, int want_write) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    ev.data.u32 = idx;
+    epoll_ctl(mp->epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+static void client_close(mockpool *mp, uint32_t idx) {
+    mock_client *c = &mp->clients[idx];
+    if (!c->in_use) return;
+    if (c->subscribed) {
+        mock_session *ms = &mp->sessions[mp->session_next++ % MOCK_SESSION_RING];
+        memcpy(ms->id, c->session_id, sizeof(ms->id));
+        memcpy(ms->extranonce1, c->extranonce1, sizeof(ms->extranonce1));
+        memcpy(ms->prev_extranonce1, c->prev_extranonce1, sizeof(ms->prev_extranonce1));
+        ms->extranonce1_since = c->extranonce1_since;
+    }
+    epoll_ctl(mp->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    net_reader_free(&c->rx);
+    net_buffer_free(&c->tx);
+    share_set_free(&c->seen);
+    c->in_use = 0;
+    c->generation++;
+}
+
+static int client_flush(mockpool *mp, uint32_t idx) {
+    mock_client *c = &mp->clients[idx];
+    size_t sent = 0;
+    while (sent < c->tx.len) {
+        ssize_t n = send(c->fd, c->tx.data + sent, c->tx.len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return 0;
+        }
+        sent += (size_t)n;
+    }
+    net_buffer_consume(&c->tx, sent);
+    int pending = c->tx.len > 0;
+    if (pending != c->want_write) {
+        c->want_write = pending;
+        epoll_update(mp, c->fd, idx, pending);
+    }
+    return 1;
+}
+
+static void client_send(mockpool *mp, uint32_t idx, const char *line) {
+    mock_client *c = &mp->clients[idx];
+    size_t len = strlen(line);
+    if (c->tx.len + len + 1 > MOCK_TX_LIMIT ||
+        !net_buffer_append(&c->tx, line, len) || !net_buffer_append(&c->tx, "\n", 1) ||
+        !client_flush(mp, idx)) {
+        client_close(mp, idx);
+    }
+}
+
+static void send_difficulty(mockpool *mp, uint32_t idx, double diff) {
+    mock_client *c = &mp->clients[idx];
+    if (c->difficulty != diff) {
+        c->prev_difficulty = c->difficulty > 0.0 ? c->difficulty : diff;
+        c->difficulty = diff;
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[%.10g]}", diff);
+    client_send(mp, idx, line);
+}
+
+static void send_job(mockpool *mp, uint32_t idx, const mock_job *job, int clean) {
+    mock_client *c = &mp->clients[idx];
+    net_buffer line = {0};
+    char head[256];
+    snprintf(head, sizeof(head), "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"%s\",\"%s\",\"",
+             job->job_id, job->prev_hash);
+    net_buffer_append(&line, head, strlen(head));
+    net_buffer_append(&line, job->coinb1, strlen(job->coinb1));
+    net_buffer_append(&line, "\",\"", 3);
+    net_buffer_append(&line, job->coinb2, strlen(job->coinb2));
+    net_buffer_append(&line, "\",[", 3);
+    for (size_t i = 0; i < job->merkle_count; i++) {
+        char item[72];
+        snprintf(item, sizeof(item), "%s\"%s\"", i ? "," : "", job->merkle[i]);
+        net_buffer_append(&line, item, strlen(item));
+    }
+    char tail[96];
+    snprintf(tail, sizeof(tail), "],\"%s\",\"%s\",\"%s\",%s]}", job->version, job->nbits, job->ntime, clean ? "true" : "false");
+    net_buffer_append(&line, tail, strlen(tail) + 1);
+    if (line.data) {
+        c->current_job = job->seq;
+        c->current_job_sent = mono_seconds();
+        if (clean) {
+            share_set_clear(&c->seen);
+        }
+        client_send(mp, idx, line.data);
+    }
+    net_buffer_free(&line);
+}
+
+static const mock_job *current_job(const mockpool *mp) {
+    if (mp->job_seq == 0) return NULL;
+    return &mp->jobs[(mp->job_seq - 1) % MOCK_JOB_RING];
+}
+
+static void new_job(mockpool *mp) {
+    mp->job_seq++;
+    mock_job *job = &mp->jobs[(mp->job_seq - 1) % MOCK_JOB_RING];
+    free(job->coinb1);
+    free(job->coinb2);
+    memset(job, 0, sizeof(*job));
+    job->seq = mp->job_seq;
+    snprintf(job->job_id, sizeof(job->job_id), "%llx", (unsigned long long)job->seq);
+    random_hex(mp, job->prev_hash, 32);
+
+    // Coinbase split around the extranonce, padded to --coinbase-bytes.
+    size_t half = (size_t)mp->opts.coinbase_bytes / 2;
+    job->coinb1 = malloc(half * 2 + 1);
+    job->coinb2 = malloc(half * 2 + 1);
+    if (!job->coinb1 || !job->coinb2) {
+        fprintf(stderr, "[mockpool] sem memoria para o coinbase\n");
+        exit(1);
+    }
+    random_hex(mp, job->coinb1, half);
+    random_hex(mp, job->coinb2, half);
+    job->merkle_count = (size_t)mp->opts.merkle_count;
+    for (size_t i = 0; i < job->merkle_count; i++) random_hex(mp, job->merkle[i], 32);
+    snprintf(job->version, sizeof(job->version), "20000000");
+    snprintf(job->nbits, sizeof(job->nbits), "1d00ffff");
+    snprintf(job->ntime, sizeof(job->ntime), "%08x", (unsigned)time(NULL));
+
+    job->clean = mp->job_seq == 1 ||
+                 (double)(next_rand(mp) >> 11) / 9007199254740992.0 < mp->opts.clean_ratio;
+    if (job->clean) {
+        mp->last_clean_seq = job->seq;
+        mp->clean_notifies++;
+    }
+    mp->notifies++;
+    for (uint32_t i = 0; i < mp->client_cap; i++) {
+        if (mp->clients[i].in_use && mp->clients[i].authorized) send_job(mp, i, job, job->clean);
+    }
+}
+
+static void change_difficulty(mockpool *mp) {
+    double factor = mp->opts.diff_factor > 0.0 ? mp->opts.diff_factor : 2.0;
+    mp->difficulty = mp->diff_direction ? mp->difficulty / factor : mp->difficulty * factor;
+    mp->diff_direction = !mp->diff_direction;
+    mp->difficulty_changes++;
+    for (uint32_t i = 0; i < mp->client_cap; i++) {
+        if (mp->clients[i].in_use && mp->clients[i].authorized) send_difficulty(mp, i, mp->difficulty);
+    }
+}
+
+// set_extranonce takes effect from the next notify on; shares for older
+// jobs are still checked against the previous extranonce1.
+static void change_extranonce(mockpool *mp) {
+    for (uint32_t i = 0; i < mp->client_cap; i++) {
+        mock_client *c = &mp->clients[i];
+        if (!c->in_use || !c->authorized || !c->extranonce_subscribe) continue;
+        char reply[160];
+        memcpy(c->prev_extranonce1, c->extranonce1, sizeof(c->extranonce1));
+        snprintf(c->extranonce1, sizeof(c->extranonce1), "%08x", mp->next_extranonce1++);
+        c->extranonce1_since = mp->job_seq + 1;
+        mp->extranonce_changes++;
+        snprintf(reply, sizeof(reply), "{\"id\":null,\"method\":\"mining.set_extranonce\",\"params\":[\"%s\",%d]}",
+                 c->extranonce1, mp->opts.extranonce2_size);
+        client_send(mp, i, reply);
+    }
+}
+
+static const mock_job *find_job(const mockpool *mp, const char *job_id) {
+    for (size_t i = 0; i < MOCK_JOB_RING; i++) {
+        const mock_job *job = &mp->jobs[i];
+        if (job->seq && strcmp(job->job_id, job_id) == 0) return job;
+    }
+    return NULL;
+}
+
+static int decode_hex(const char *hex, uint8_t *out, size_t want) {
+    size_t len = 0;
+    return hex_decode(hex, strlen(hex), out, want, &len) && len == want;
+}
+
+static void dsha(const uint8_t *data, size_t len, uint8_t out[32]) {
+    uint8_t tmp[32];
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, tmp);
+    sha256_init(&ctx);
+    sha256_update(&ctx, tmp, sizeof(tmp));
+    sha256_final(&ctx, out);
+}
+
+static void reverse(uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len / 2; i++) {
+        uint8_t t = buf[i];
+        buf[i] = buf[len - 1 - i];
+        buf[len - 1 - i] = t;
+    }
+}
+
+// Independent re-implementation of the stratum header rules, so a byte-order
+// mistake in the miner cannot cancel out against the same code here.
+static int share_hash(const mock_job *job, const char *en1, const char *en2, const char *ntime, const char *nonce,
+                      uint8_t hash_be[32]) {
+    size_t cb_hex = strlen(job->coinb1) + strlen(en1) + strlen(en2) + strlen(job->coinb2);
+    char *hex = malloc(cb_hex + 1);
+    uint8_t *coinbase = malloc(cb_hex / 2 + 1);
+    if (!hex || !coinbase) {
+        free(hex);
+        free(coinbase);
+        return 0;
+    }
+    snprintf(hex, cb_hex + 1, "%s%s%s%s", job->coinb1, en1, en2, job->coinb2);
+    int ok = (cb_hex % 2 == 0) && decode_hex(hex, coinbase, cb_hex / 2);
+    uint8_t root[32];
+    if (ok) dsha(coinbase, cb_hex / 2, root);
+    free(hex);
+    free(coinbase);
+    if (!ok) return 0;
+
+    for (size_t i = 0; i < job->merkle_count; i++) {
+        uint8_t pair[64];
+        memcpy(pair, root, 32);
+        if (!decode_hex(job->merkle[i], pair + 32, 32)) return 0;
+        dsha(pair, sizeof(pair), root);
+    }
+
+    uint8_t header[80];
+    if (!decode_hex(job->version, header, 4)) return 0;
+    reverse(header, 4);
+    if (!decode_hex(job->prev_hash, header + 4, 32)) return 0;
+    for (size_t i = 0; i < 32; i += 4) reverse(header + 4 + i, 4);
+    memcpy(header + 36, root, 32);
+    if (strlen(ntime) != 8 || !decode_hex(ntime, header + 68, 4)) return 0;
+    reverse(header + 68, 4);
+    if (!decode_hex(job->nbits, header + 72, 4)) return 0;
+    reverse(header + 72, 4);
+    if (strlen(nonce) != 8 || !decode_hex(nonce, header + 76, 4)) return 0;
+    reverse(header + 76, 4);
+
+    dsha(header, sizeof(header), hash_be);
+    reverse(hash_be, 32);
+    return 1;
+}
+
+static uint64_t tuple_key(const char *job_id, const char *en2, const char *ntime, const char *nonce) {
+    const void *parts[4] = {job_id, en2, ntime, nonce};
+    size_t lens[4] = {strlen(job_id), strlen(en2), strlen(ntime), strlen(nonce)};
+    return share_key(parts, lens, 4);
+}
+
+static void queue_reply(mockpool *mp, uint32_t idx, const char *line, double received) {
+    if (mp->opts.reply_delay_ms <= 0) {
+        client_send(mp, idx, line);
+        sample_push(&mp->reply_latency, mono_seconds() - received);
+        return;
+    }
+    if (mp->reply_len == mp->reply_cap) {
+        size_t cap = mp->reply_cap ? mp->reply_cap * 2 : 256;
+        mock_reply *n = malloc(cap * sizeof(*n));
+        if (!n) return;
+        for (size_t i = 0; i < mp->reply_len; i++) n[i] = mp->replies[(mp->reply_head + i) % mp->reply_cap];
+        free(mp->replies);
+        mp->replies = n;
+        mp->reply_head = 0;
+        mp->reply_cap = cap;
+    }
+    mock_reply *r = &mp->replies[(mp->reply_head + mp->reply_len) % mp->reply_cap];
+    r->due = received + mp->opts.reply_delay_ms / 1000.0;
+    r->client = idx;
+    r->generation = mp->clients[idx].generation;
+    r->received = received;
+    snprintf(r->line, sizeof(r->line), "%s", line);
+    mp->reply_len++;
+}
+
+static void flush_replies(mockpool *mp, double now) {
+    while (mp->reply_len > 0) {
+        mock_reply *r = &mp->replies[mp->reply_head];
+        if (r->due > now) break;
+        mock_client *c = &mp->clients[r->client];
+        if (c->in_use && c->generation == r->generation) {
+            client_send(mp, r->client, r->line);
+            sample_push(&mp->reply_latency, mono_seconds() - r->received);
+        }
+        mp->reply_head = (mp->reply_head + 1) % mp->reply_cap;
+        mp->reply_len--;
+    }
+}
+
+static void handle_submit(mockpool *mp, uint32_t idx, json_view params, const char *id) {
+    double now = mono_seconds();
+    mock_client *c = &mp->clients[idx];
+    char job_id[32], en2[64], ntime[16], nonce[16];
+    json_iter it;
+    json_view v;
+    char reply[160];
+    int ok = json_iter_init(&it, params) && json_iter_next(&it, &v);
+    ok = ok && json_iter_next(&it, &v) && json_view_copy(v, job_id, sizeof(job_id));
+    ok = ok && json_iter_next(&it, &v) && json_view_copy(v, en2, sizeof(en2));
+    ok = ok && json_iter_next(&it, &v) && json_view_copy(v, ntime, sizeof(ntime));
+    ok = ok && json_iter_next(&it, &v) && json_view_copy(v, nonce, sizeof(nonce));
+    if (!ok || strlen(en2) != (size_t)mp->opts.extranonce2_size * 2) {
+        mp->malformed++;
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":null,\"error\":[20,\"Malformed submit\",null]}", id);
+        queue_reply(mp, idx, reply, now);
+        return;
+    }
+
+    const mock_job *job = find_job(mp, job_id);
+    if (!job || job->seq < mp->last_clean_seq) {
+        mp->stale++;
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":null,\"error\":[21,\"Stale job\",null]}", id);
+        queue_reply(mp, idx, reply, now);
+        return;
+    }
+    if (!share_set_insert(&c->seen, tuple_key(job_id, en2, ntime, nonce))) {
+        mp->duplicate++;
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":null,\"error\":[22,\"Duplicate share\",null]}", id);
+        queue_reply(mp, idx, reply, now);
+        return;
+    }
+
+    uint8_t hash[32], target[32], prev_target[32];
+    const char *en1 = job->seq < c->extranonce1_since && c->prev_extranonce1[0] ? c->prev_extranonce1 : c->extranonce1;
+    if (!share_hash(job, en1, en2, ntime, nonce, hash)) {
+        mp->malformed++;
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":null,\"error\":[20,\"Malformed submit\",null]}", id);
+        queue_reply(mp, idx, reply, now);
+        return;
+    }
+    bitcoin_target_from_difficulty(c->difficulty, target);
+    bitcoin_target_from_difficulty(c->prev_difficulty > 0.0 ? c->prev_difficulty : c->difficulty, prev_target);
+    // Allow the previous difficulty as well: the change races with work in flight.
+    if (memcmp(hash, target, 32) > 0 && memcmp(hash, prev_target, 32) > 0) {
+        mp->low_difficulty++;
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":null,\"error\":[23,\"Low difficulty share\",null]}", id);
+        queue_reply(mp, idx, reply, now);
+        return;
+    }
+
+    mp->accepted++;
+    mp->accepted_work += c->difficulty;
+    if (job->seq == c->current_job && job->seq > c->first_share_job) {
+        c->first_share_job = job->seq;
+        sample_push(&mp->first_share, now - c->current_job_sent);
+    }
+    if (job->seq == c->current_job) sample_push(&mp->job_age, now - c->current_job_sent);
+    snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":true,\"error\":null}", id);
+    queue_reply(mp, idx, reply, now);
+}
+
+// The subscription id is the extranonce1 given at connect time. A client
+// that passes the id of a closed session gets back that session's current
+// extranonce1 (and the previous one, for jobs issued before a switch).
+static void resume_session(mockpool *mp, uint32_t idx, json_view params) {
+    json_iter it;
+    json_view v;
+    char id[16];
+    if (!json_iter_init(&it, params) || !json_iter_next(&it, &v) || !json_iter_next(&it, &v) ||
+        !json_view_copy(v, id, sizeof(id)) || strlen(id) != 8) {
+        return;
+    }
+    for (size_t i = 0; i < MOCK_SESSION_RING; i++) {
+        mock_session *ms = &mp->sessions[i];
+        if (strcmp(ms->id, id) != 0) continue;
+        mock_client *c = &mp->clients[idx];
+        memcpy(c->session_id, ms->id, sizeof(c->session_id));
+        memcpy(c->extranonce1, ms->extranonce1, sizeof(c->extranonce1));
+        memcpy(c->prev_extranonce1, ms->prev_extranonce1, sizeof(c->prev_extranonce1));
+        c->extranonce1_since = ms->extranonce1_since;
+        memset(ms, 0, sizeof(*ms));
+        mp->resumed++;
+        printf("[mockpool] sessao %s retomada (extranonce1=%s)\n", id, c->extranonce1);
+        return;
+    }
+}
+
+static void client_line(mockpool *mp, uint32_t idx, const char *line, size_t len) {
+    json_message msg;
+    char id[64] = "null";
+    if (!json_parse_message(line, len, &msg) || !msg.method.p) return;
+    if (msg.id.p && msg.id.len < sizeof(id)) {
+        memcpy(id, msg.id.p, msg.id.len);
+        id[msg.id.len] = '\0';
+    }
+
+    mock_client *c = &mp->clients[idx];
+    char reply[256];
+    if (json_view_string_eq(msg.method, "mining.subscribe")) {
+        resume_session(mp, idx, msg.params);
+        snprintf(reply, sizeof(reply),
+                 "{\"id\":%s,\"result\":[[[\"mining.set_difficulty\",\"%s\"],[\"mining.notify\",\"%s\"]],\"%s\",%d],\"error\":null}",
+                 id, c->session_id, c->session_id, c->extranonce1, mp->opts.extranonce2_size);
+        c->subscribed = 1;
+        client_send(mp, idx, reply);
+    } else if (json_view_string_eq(msg.method, "mining.authorize")) {
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":true,\"error\":null}", id);
+        client_send(mp, idx, reply);
+        if (!c->in_use) return;
+        c->authorized = 1;
+        // --notify-first 1: job before set_difficulty, as some pools do.
+        const mock_job *job = current_job(mp);
+        if (job && mp->opts.notify_first) send_job(mp, idx, job, 1);
+        if (c->in_use) send_difficulty(mp, idx, mp->difficulty);
+        if (job && c->in_use && !mp->opts.notify_first) send_job(mp, idx, job, 1);
+    } else if (json_view_string_eq(msg.method, "mining.extranonce.subscribe")) {
+        c->extranonce_subscribe = 1;
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":true,\"error\":null}", id);
+        client_send(mp, idx, reply);
+    } else if (json_view_string_eq(msg.method, "mining.submit")) {
+        handle_submit(mp, idx, msg.params, id);
+    } else if (json_view_string_eq(msg.method, "mining.suggest_difficulty")) {
+        // --suggest accept|ignore|reject: follow it, answer true and keep
+        // the pool value, or reply as a pool without the method.
+        json_iter it;
+        json_view v;
+        double diff = json_iter_init(&it, msg.params) && json_iter_next(&it, &v) ? json_view_double(v) : 0.0;
+        if (strcmp(mp->opts.suggest, "reject") == 0) {
+            snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":null,\"error\":[20,\"Unsupported method\",null]}", id);
+            client_send(mp, idx, reply);
+            return;
+        }
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":true,\"error\":null}", id);
+        client_send(mp, idx, reply);
+        printf("[mockpool] cliente %s sugeriu difficulty %.8f (%s)\n", c->extranonce1, diff, mp->opts.suggest);
+        if (c->in_use && diff > 0.0 && strcmp(mp->opts.suggest, "accept") == 0) send_difficulty(mp, idx, diff);
+    } else {
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":true,\"error\":null}", id);
+        client_send(mp, idx, reply);
+    }
+}
+
+static void client_readable(mockpool *mp, uint32_t idx) {
+    mock_client *c = &mp->clients[idx];
+    for (;;) {
+        ssize_t n = net_reader_recv(&c->rx, c->fd);
+        if (n == 0) {
+            client_close(mp, idx);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) client_close(mp, idx);
+            return;
+        }
+        uint32_t gen = c->generation;
+        const char *line;
+        size_t len;
+        while (net_reader_next(&c->rx, &line, &len)) {
+            client_line(mp, idx, line, len);
+            if (c->generation != gen) return;
+        }
+    }
+}
+
+static void accept_clients(mockpool *mp) {
+    for (;;) {
+        int fd = accept(mp->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        uint32_t idx = 0;
+        while (idx < mp->client_cap && mp->clients[idx].in_use) idx++;
+        if (idx == mp->client_cap) {
+            size_t cap = mp->client_cap ? mp->client_cap * 2 : 64;
+            mock_client *n = realloc(mp->clients, cap * sizeof(*n));
+            if (!n) {
+                close(fd);
+                continue;
+            }
+            memset(n + mp->client_cap, 0, (cap - mp->client_cap) * sizeof(*n));
+            mp->clients = n;
+            mp->client_cap = cap;
+        }
+        net_set_nonblocking(fd);
+        mock_client *c = &mp->clients[idx];
+        uint32_t generation = c->generation;
+        memset(c, 0, sizeof(*c));
+        c->generation = generation;
+        c->fd = fd;
+        c->in_use = 1;
+        snprintf(c->extranonce1, sizeof(c->extranonce1), "%08x", mp->next_extranonce1++);
+        memcpy(c->session_id, c->extranonce1, sizeof(c->session_id));
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = idx;
+        epoll_ctl(mp->epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+static void print_usage(const char *progname) {
+    printf("Uso: %s [opcoes]\n", progname);
+    printf("  --port N              porta (default: 3333)\n");
+    printf("  --bind ADDR           endereco (default: 127.0.0.1)\n");
+    printf("  --notify-ms N         intervalo entre mining.notify (default: 5000)\n");
+    printf("  --clean-ratio R       fracao de notifies com clean_jobs=true (0-1, default: 0.25)\n");
+    printf("  --diff D              difficulty inicial (default: 0.001)\n");
+    printf("  --diff-change-secs N  alterna a difficulty a cada N segundos (default: 0 = fixa)\n");
+    printf("  --diff-factor F       fator da alternancia (default: 2)\n");
+    printf("  --extranonce2-size N  bytes de extranonce2 (default: 4)\n");
+    printf("  --extranonce-change-secs N  envia mining.set_extranonce a cada N segundos (default: 0)\n");
+    printf("  --drop-secs N         derruba todas as conexoes a cada N segundos (default: 0)\n");
+    printf("  --merkle N            ramos merkle por job (default: 12)\n");
+    printf("  --coinbase-bytes N    tamanho de coinb1+coinb2 (default: 200)\n");
+    printf("  --reply-delay-ms N    atraso simulado nas respostas de submit (default: 0)\n");
+    printf("  --suggest MODO        mining.suggest_difficulty: accept, ignore ou reject (default: accept)\n");
+    printf("  --notify-first 0|1    envia o primeiro notify antes do set_difficulty (default: 0)\n");
+    printf("  --duration N          encerra apos N segundos (default: 0 = Ctrl+C)\n");
+    printf("  --report-secs N       intervalo do relatorio (default: 10)\n");
+    printf("  --seed N              semente dos jobs (default: 1)\n");
+}
+
+static int parse_args(int argc, char **argv, mockpool_options *o) {
+    o->bind_host = "127.0.0.1";
+    o->port = "3333";
+    o->notify_ms = 5000;
+    o->clean_ratio = 0.25;
+    o->difficulty = 0.001;
+    o->diff_change_secs = 0;
+    o->diff_factor = 2.0;
+    o->extranonce2_size = 4;
+    o->extranonce_change_secs = 0;
+    o->drop_secs = 0;
+    o->merkle_count = 12;
+    o->coinbase_bytes = 200;
+    o->reply_delay_ms = 0;
+    o->suggest = "accept";
+    o->notify_first = 0;
+    o->duration_secs = 0;
+    o->report_secs = 10;
+    o->seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--help") == 0 || strcmp(a, "help") == 0) {
+            print_usage(argv[0]);
+            exit(0);
+        }
+        if (!v) {
+            fprintf(stderr, "Falta valor para %s\n", a);
+            return 0;
+        }
+        if (strcmp(a, "--port") == 0) o->port = v;
+        else if (strcmp(a, "--bind") == 0) o->bind_host = v;
+        else if (strcmp(a, "--notify-ms") == 0) o->notify_ms = atoi(v);
+        else if (strcmp(a, "--clean-ratio") == 0) o->clean_ratio = strtod(v, NULL);
+        else if (strcmp(a, "--diff") == 0) o->difficulty = strtod(v, NULL);
+        else if (strcmp(a, "--diff-change-secs") == 0) o->diff_change_secs = atoi(v);
+        else if (strcmp(a, "--diff-factor") == 0) o->diff_factor = strtod(v, NULL);
+        else if (strcmp(a, "--extranonce2-size") == 0) o->extranonce2_size = atoi(v);
+        else if (strcmp(a, "--extranonce-change-secs") == 0) o->extranonce_change_secs = atoi(v);
+        else if (strcmp(a, "--drop-secs") == 0) o->drop_secs = atoi(v);
+        else if (strcmp(a, "--merkle") == 0) o->merkle_count = atoi(v);
+        else if (strcmp(a, "--coinbase-bytes") == 0) o->coinbase_bytes = atoi(v);
+        else if (strcmp(a, "--reply-delay-ms") == 0) o->reply_delay_ms = atoi(v);
+        else if (strcmp(a, "--suggest") == 0) o->suggest = v;
+        else if (strcmp(a, "--notify-first") == 0) o->notify_first = atoi(v);
+        else if (strcmp(a, "--duration") == 0) o->duration_secs = atoi(v);
+        else if (strcmp(a, "--report-secs") == 0) o->report_secs = atoi(v);
+        else if (strcmp(a, "--seed") == 0) o->seed = strtoull(v, NULL, 10);
+        else {
+            fprintf(stderr, "Opcao desconhecida: %s\n", a);
+            return 0;
+        }
+        i++;
+    }
+    if (o->notify_ms < 1 || o->difficulty <= 0.0 || o->extranonce2_size < 1 || o->extranonce2_size > 8 ||
+        o->merkle_count < 0 || o->merkle_count > MOCK_MAX_MERKLE || o->coinbase_bytes < 2 || o->report_secs < 1) {
+        fprintf(stderr, "Parametros invalidos\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    mockpool mp;
+    memset(&mp, 0, sizeof(mp));
+    if (!parse_args(argc, argv, &mp.opts)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    mp.rng = mp.opts.seed ? mp.opts.seed : 1;
+    mp.difficulty = mp.opts.difficulty;
+    mp.next_extranonce1 = 0x10000000u;
+    mp.epfd = epoll_create1(0);
+    mp.listen_fd = net_listen_tcp(mp.opts.bind_host, mp.opts.port, 256);
+    if (mp.epfd < 0 || mp.listen_fd < 0) return 1;
+    net_set_nonblocking(mp.listen_fd);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = UINT32_MAX;
+    epoll_ctl(mp.epfd, EPOLL_CTL_ADD, mp.listen_fd, &ev);
+
+    printf("[mockpool] coinminer %s | escutando em %s:%s | notify a cada %dms (clean %.0f%%) | diff %.8f\n",
+           COINMINER_VERSION, mp.opts.bind_host, mp.opts.port, mp.opts.notify_ms,
+           100.0 * mp.opts.clean_ratio, mp.difficulty);
+
+    double start = mono_seconds();
+    double next_notify = start;
+    double next_diff = mp.opts.diff_change_secs > 0 ? start + mp.opts.diff_change_secs : 0.0;
+    double next_extranonce = mp.opts.extranonce_change_secs > 0 ? start + mp.opts.extranonce_change_secs : 0.0;
+    double next_drop = mp.opts.drop_secs > 0 ? start + mp.opts.drop_secs : 0.0;
+    double next_report = start + mp.opts.report_secs;
+    struct epoll_event events[MOCK_EVENTS];
+    while (!stop_flag) {
+        double now = mono_seconds();
+        if (mp.opts.duration_secs > 0 && now - start >= mp.opts.duration_secs) break;
+        if (next_diff > 0.0 && now >= next_diff) {
+            change_difficulty(&mp);
+            next_diff += mp.opts.diff_change_secs;
+        }
+        if (next_extranonce > 0.0 && now >= next_extranonce) {
+            change_extranonce(&mp);
+            next_extranonce += mp.opts.extranonce_change_secs;
+        }
+        if (next_drop > 0.0 && now >= next_drop) {
+            for (uint32_t i = 0; i < mp.client_cap; i++) {
+                if (mp.clients[i].in_use) client_close(&mp, i);
+            }
+            printf("[mockpool] conexoes derrubadas (--drop-secs)\n");
+            next_drop += mp.opts.drop_secs;
+        }
+        if (now >= next_notify) {
+            new_job(&mp);
+            next_notify += mp.opts.notify_ms / 1000.0;
+            if (next_notify < now) next_notify = now + mp.opts.notify_ms / 1000.0;
+        }
+        flush_replies(&mp, now);
+        if (now >= next_report) {
+            print_report(&mp, now - start);
+            next_report += mp.opts.report_secs;
+        }
+
+        double wake = next_notify;
+        if (next_diff > 0.0 && next_diff < wake) wake = next_diff;
+        if (next_extranonce > 0.0 && next_extranonce < wake) wake = next_extranonce;
+        if (next_drop > 0.0 && next_drop < wake) wake = next_drop;
+        if (mp.reply_len > 0 && mp.replies[mp.reply_head].due < wake) wake = mp.replies[mp.reply_head].due;
+        int timeout = (int)((wake - now) * 1000.0) + 1;
+        if (timeout < 0) timeout = 0;
+        if (timeout > 1000) timeout = 1000;
+
+        int n = epoll_wait(mp.epfd, events, MOCK_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("[mockpool] epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint32_t idx = events[i].data.u32;
+            if (idx == UINT32_MAX) {
+                accept_clients(&mp);
+                continue;
+            }
+            if (idx >= mp.client_cap || !mp.clients[idx].in_use) continue;
+            if ((events[i].events & EPOLLOUT) && !client_flush(&mp, idx)) {
+                client_close(&mp, idx);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) client_readable(&mp, idx);
+        }
+    }
+
+    print_report(&mp, mono_seconds() - start);
+    for (uint32_t i = 0; i < mp.client_cap; i++) client_close(&mp, i);
+    for (size_t i = 0; i < MOCK_JOB_RING; i++) {
+        free(mp.jobs[i].coinb1);
+        free(mp.jobs[i].coinb2);
+    }
+    free(mp.clients);
+    free(mp.replies);
+    free(mp.first_share.v);
+    free(mp.reply_latency.v);
+    free(mp.job_age.v);
+    close(mp.listen_fd);
+    close(mp.epfd);
+    return 0;
+}
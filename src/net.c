@@ -0,0 +1,500 @@
+#include "net.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NET_DNS_SLOTS 16
+#define NET_DNS_MAX_ADDRS 8
+#define NET_DNS_TTL 300.0
+#define NET_CONNECT_STAGGER_MS 250
+#define NET_CONNECT_TIMEOUT_MS 10000
+
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t len;
+    int family;
+} net_addr;
+
+// Resolved addresses per host:port, interleaved by family and with the last
+// address that connected first. Expired entries are still used when a new
+// lookup fails.
+typedef struct {
+    char host[256];
+    char port[16];
+    net_addr addrs[NET_DNS_MAX_ADDRS];
+    size_t count;
+    double resolved_at;
+    double used_at;
+} net_dns_entry;
+
+static net_dns_entry dns_cache[NET_DNS_SLOTS];
+static pthread_mutex_t dns_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t backoff_rng;
+
+static double net_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static net_dns_entry *dns_find(const char *host, const char *port) {
+    for (size_t i = 0; i < NET_DNS_SLOTS; i++) {
+        net_dns_entry *e = &dns_cache[i];
+        if (e->count && strcmp(e->host, host) == 0 && strcmp(e->port, port) == 0) return e;
+    }
+    return NULL;
+}
+
+static size_t dns_lookup(const char *host, const char *port, net_addr *out) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *res = NULL;
+    int rc = getaddrinfo(host, port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rc));
+        return 0;
+    }
+    // Alternate families in the resolver's order (RFC 8305, section 4).
+    net_addr v6[NET_DNS_MAX_ADDRS], v4[NET_DNS_MAX_ADDRS];
+    size_t n6 = 0, n4 = 0;
+    int first = res->ai_family;
+    for (struct addrinfo *p = res; p != NULL; p = p->ai_next) {
+        net_addr *a = NULL;
+        if (p->ai_family == AF_INET6 && n6 < NET_DNS_MAX_ADDRS) a = &v6[n6++];
+        else if (p->ai_family == AF_INET && n4 < NET_DNS_MAX_ADDRS) a = &v4[n4++];
+        if (!a || p->ai_addrlen > sizeof(a->addr)) continue;
+        memcpy(&a->addr, p->ai_addr, p->ai_addrlen);
+        a->len = (socklen_t)p->ai_addrlen;
+        a->family = p->ai_family;
+    }
+    freeaddrinfo(res);
+
+    net_addr *lead = first == AF_INET ? v4 : v6;
+    net_addr *other = first == AF_INET ? v6 : v4;
+    size_t nlead = first == AF_INET ? n4 : n6;
+    size_t nother = first == AF_INET ? n6 : n4;
+    size_t count = 0;
+    for (size_t i = 0; count < NET_DNS_MAX_ADDRS && (i < nlead || i < nother); i++) {
+        if (i < nlead) out[count++] = lead[i];
+        if (i < nother && count < NET_DNS_MAX_ADDRS) out[count++] = other[i];
+    }
+    return count;
+}
+
+static size_t net_resolve(const char *host, const char *port, net_addr *out) {
+    double now = net_now();
+    pthread_mutex_lock(&dns_lock);
+    net_dns_entry *e = dns_find(host, port);
+    if (e && now - e->resolved_at < NET_DNS_TTL) {
+        size_t count = e->count;
+        memcpy(out, e->addrs, count * sizeof(*out));
+        e->used_at = now;
+        pthread_mutex_unlock(&dns_lock);
+        return count;
+    }
+    pthread_mutex_unlock(&dns_lock);
+
+    // Blocking lookup outside the lock; the cache only saves repeats.
+    net_addr fresh[NET_DNS_MAX_ADDRS];
+    size_t count = dns_lookup(host, port, fresh);
+
+    pthread_mutex_lock(&dns_lock);
+    e = dns_find(host, port);
+    if (count == 0) {
+        if (e) {
+            fprintf(stderr, "usando enderecos em cache para %s:%s\n", host, port);
+            count = e->count;
+            memcpy(out, e->addrs, count * sizeof(*out));
+        }
+        pthread_mutex_unlock(&dns_lock);
+        return count;
+    }
+    if (!e && strlen(host) < sizeof(e->host) && strlen(port) < sizeof(e->port)) {
+        e = &dns_cache[0];
+        for (size_t i = 0; i < NET_DNS_SLOTS; i++) {
+            if (!dns_cache[i].count) {
+                e = &dns_cache[i];
+                break;
+            }
+            if (dns_cache[i].used_at < e->used_at) e = &dns_cache[i];
+        }
+        snprintf(e->host, sizeof(e->host), "%s", host);
+        snprintf(e->port, sizeof(e->port), "%s", port);
+    }
+    if (e) {
+        memcpy(e->addrs, fresh, count * sizeof(*fresh));
+        e->count = count;
+        e->resolved_at = now;
+        e->used_at = now;
+    }
+    pthread_mutex_unlock(&dns_lock);
+    memcpy(out, fresh, count * sizeof(*out));
+    return count;
+}
+
+static void dns_prefer(const char *host, const char *port, const net_addr *winner) {
+    pthread_mutex_lock(&dns_lock);
+    net_dns_entry *e = dns_find(host, port);
+    for (size_t i = 0; e && i < e->count; i++) {
+        if (e->addrs[i].len == winner->len && memcmp(&e->addrs[i].addr, &winner->addr, winner->len) == 0) {
+            net_addr a = e->addrs[i];
+            memmove(&e->addrs[1], &e->addrs[0], i * sizeof(a));
+            e->addrs[0] = a;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&dns_lock);
+}
+
+static int set_blocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return 0;
+    return fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) == 0;
+}
+
+// Happy eyeballs: a new attempt starts every NET_CONNECT_STAGGER_MS (or as
+// soon as one fails) while earlier ones stay pending; the first to finish
+// wins and the socket is handed back in blocking mode.
+int net_connect_tcp(const char *host, const char *port) {
+    net_addr addrs[NET_DNS_MAX_ADDRS];
+    size_t count = net_resolve(host, port, addrs);
+    if (count == 0) {
+        fprintf(stderr, "Nao foi possivel conectar a %s:%s\n", host, port);
+        return -1;
+    }
+
+    struct pollfd pfd[NET_DNS_MAX_ADDRS];
+    size_t started = 0;
+    size_t active = 0;
+    int winner = -1;
+    double start = net_now();
+    double next_start = start;
+    while (winner < 0) {
+        double now = net_now();
+        if (started < count && (now >= next_start || active == 0)) {
+            const net_addr *a = &addrs[started];
+            pfd[started].fd = -1;
+            pfd[started].events = POLLOUT;
+            pfd[started].revents = 0;
+            int fd = socket(a->family, SOCK_STREAM, 0);
+            if (fd != -1 && net_set_nonblocking(fd)) {
+                if (connect(fd, (const struct sockaddr *)&a->addr, a->len) == 0) {
+                    pfd[started].fd = fd;
+                    winner = (int)started;
+                } else if (errno == EINPROGRESS) {
+                    pfd[started].fd = fd;
+                    active++;
+                } else {
+                    close(fd);
+                }
+            } else if (fd != -1) {
+                close(fd);
+            }
+            started++;
+            next_start = now + NET_CONNECT_STAGGER_MS / 1000.0;
+            continue;
+        }
+        if (active == 0 || now - start >= NET_CONNECT_TIMEOUT_MS / 1000.0) break;
+
+        double wait = start + NET_CONNECT_TIMEOUT_MS / 1000.0 - now;
+        if (started < count && next_start - now < wait) wait = next_start - now;
+        int rc = poll(pfd, started, (int)(wait * 1000.0) + 1);
+        if (rc < 0 && errno != EINTR) break;
+        for (size_t i = 0; rc > 0 && i < started && winner < 0; i++) {
+            if (pfd[i].fd == -1 || !pfd[i].revents) continue;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (getsockopt(pfd[i].fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) {
+                winner = (int)i;
+            } else {
+                close(pfd[i].fd);
+                pfd[i].fd = -1;
+                active--;
+                next_start = now;
+            }
+        }
+    }
+
+    int sock = -1;
+    for (size_t i = 0; i < started; i++) {
+        if (pfd[i].fd == -1) continue;
+        if ((int)i == winner) sock = pfd[i].fd;
+        else close(pfd[i].fd);
+    }
+    if (sock != -1 && !set_blocking(sock)) {
+        close(sock);
+        sock = -1;
+    }
+    if (sock == -1) {
+        fprintf(stderr, "Nao foi possivel conectar a %s:%s\n", host, port);
+        return -1;
+    }
+    if (winner > 0) dns_prefer(host, port, &addrs[winner]);
+    return sock;
+}
+
+void net_connector_init(net_connector *c) {
+    memset(c, 0, sizeof(*c));
+    c->wake_fd = -1;
+    c->signal_fd = -1;
+    c->result = -1;
+}
+
+static void *connector_thread(void *arg) {
+    net_connector *c = arg;
+    c->result = net_connect_tcp(c->host, c->port);
+    char one = 1;
+    ssize_t n;
+    do {
+        n = write(c->signal_fd, &one, 1);
+    } while (n < 0 && errno == EINTR);
+    return NULL;
+}
+
+int net_connector_start(net_connector *c, const char *host, const char *port) {
+    if (c->busy) return 0;
+    if (c->wake_fd == -1) {
+        int fds[2];
+        if (pipe(fds) != 0) return 0;
+        if (!net_set_nonblocking(fds[0])) {
+            close(fds[0]);
+            close(fds[1]);
+            return 0;
+        }
+        c->wake_fd = fds[0];
+        c->signal_fd = fds[1];
+    }
+    c->host = host;
+    c->port = port;
+    c->result = -1;
+    if (pthread_create(&c->thread, NULL, connector_thread, c) != 0) return 0;
+    c->busy = 1;
+    return 1;
+}
+
+int net_connector_finish(net_connector *c, int *fd) {
+    char one;
+    if (!c->busy || read(c->wake_fd, &one, 1) != 1) return 0;
+    pthread_join(c->thread, NULL);
+    c->busy = 0;
+    *fd = c->result;
+    c->result = -1;
+    return 1;
+}
+
+void net_connector_free(net_connector *c) {
+    if (c->busy) {
+        pthread_join(c->thread, NULL);
+        if (c->result != -1) close(c->result);
+    }
+    if (c->wake_fd != -1) close(c->wake_fd);
+    if (c->signal_fd != -1) close(c->signal_fd);
+    net_connector_init(c);
+}
+
+double net_backoff_delay(double base, int attempt) {
+    if (base <= 0.0) return 0.0;
+    double delay = base;
+    for (int i = 1; i < attempt && delay < NET_BACKOFF_MAX; i++) delay *= 2.0;
+    if (delay > NET_BACKOFF_MAX) delay = NET_BACKOFF_MAX;
+    pthread_mutex_lock(&dns_lock);
+    if (backoff_rng == 0) backoff_rng = ((uint64_t)getpid() << 32) ^ (uint64_t)(net_now() * 1e9) ^ 1;
+    backoff_rng ^= backoff_rng << 13;
+    backoff_rng ^= backoff_rng >> 7;
+    backoff_rng ^= backoff_rng << 17;
+    double r = (double)(backoff_rng >> 11) / 9007199254740992.0;
+    pthread_mutex_unlock(&dns_lock);
+    // Equal jitter: half fixed, half random, so retries from many miners spread out.
+    return delay / 2.0 + r * delay / 2.0;
+}
+
+int net_listen_tcp(const char *bind_host, const char *port, int backlog) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    struct addrinfo *res = NULL;
+    int rc = getaddrinfo(bind_host, port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rc));
+        return -1;
+    }
+
+    int sock = -1;
+    for (struct addrinfo *p = res; p != NULL; p = p->ai_next) {
+        sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        if (sock == -1) continue;
+        int one = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(sock, p->ai_addr, p->ai_addrlen) == 0 && listen(sock, backlog) == 0) break;
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+
+    if (sock == -1) {
+        fprintf(stderr, "Nao foi possivel escutar em %s:%s\n", bind_host ? bind_host : "*", port);
+    }
+    return sock;
+}
+
+int net_set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return 0;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+int net_send_all(int sock, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(sock, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+// Entries per sendmsg call; IOV_MAX on Linux, larger lists are split.
+#define NET_SENDV_BATCH 1024
+
+int net_sendv_all(int sock, struct iovec *iov, int count) {
+    while (count > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (size_t)(count < NET_SENDV_BATCH ? count : NET_SENDV_BATCH);
+        ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        size_t left = (size_t)n;
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return 1;
+}
+
+int net_send_line(int sock, const char *msg) {
+    if (!net_send_all(sock, msg, strlen(msg))) return 0;
+    if (!net_send_all(sock, "\n", 1)) return 0;
+    return 1;
+}
+
+int net_buffer_reserve(net_buffer *b, size_t extra) {
+    if (extra > SIZE_MAX - b->len) return 0;
+    if (b->len + extra <= b->cap) return 1;
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->len + extra) {
+        if (cap > SIZE_MAX / 2) return 0;
+        cap *= 2;
+    }
+    char *data = realloc(b->data, cap);
+    if (!data) return 0;
+    b->data = data;
+    b->cap = cap;
+    return 1;
+}
+
+int net_buffer_append(net_buffer *b, const void *data, size_t len) {
+    if (!net_buffer_reserve(b, len)) return 0;
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return 1;
+}
+
+void net_buffer_consume(net_buffer *b, size_t n) {
+    if (n >= b->len) {
+        b->len = 0;
+        return;
+    }
+    memmove(b->data, b->data + n, b->len - n);
+    b->len -= n;
+}
+
+void net_buffer_free(net_buffer *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
+
+ssize_t net_reader_recv(net_line_reader *r, int fd) {
+    if (r->start > 0) {
+        net_buffer_consume(&r->buf, r->start);
+        r->scan -= r->start;
+        r->start = 0;
+    }
+    if (!net_buffer_reserve(&r->buf, 4096)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    ssize_t n = recv(fd, r->buf.data + r->buf.len, r->buf.cap - r->buf.len, 0);
+    if (n > 0) r->buf.len += (size_t)n;
+    return n;
+}
+
+int net_reader_next(net_line_reader *r, const char **line, size_t *len) {
+    while (r->start < r->buf.len) {
+        // Only bytes that arrived since the last call are searched, so a
+        // large message split over many reads is scanned once.
+        size_t from = r->scan > r->start ? r->scan : r->start;
+        char *nl = memchr(r->buf.data + from, '\n', r->buf.len - from);
+        if (!nl) {
+            r->scan = r->buf.len;
+            return 0;
+        }
+        size_t begin = r->start;
+        size_t n = (size_t)(nl - (r->buf.data + begin));
+        r->start = r->scan = begin + n + 1;
+        if (n > 0 && r->buf.data[begin + n - 1] == '\r') n--;
+        r->buf.data[begin + n] = '\0';
+        if (n == 0) continue;
+        *line = r->buf.data + begin;
+        *len = n;
+        return 1;
+    }
+    return 0;
+}
+
+size_t net_reader_pending(const net_line_reader *r) {
+    return r->buf.len - r->start;
+}
+
+void net_reader_reset(net_line_reader *r) {
+    r->buf.len = 0;
+    r->start = 0;
+    r->scan = 0;
+}
+
+void net_reader_free(net_line_reader *r) {
+    net_buffer_free(&r->buf);
+    r->start = 0;
+    r->scan = 0;
+}
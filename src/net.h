@@ -0,0 +1,72 @@
+#ifndef NET_H
+#define NET_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} net_buffer;
+
+// Newline-framed receive buffer. Lines are handed out in place (the '\n' is
+// replaced by a NUL) and stay valid until the next net_reader_recv.
+typedef struct {
+    net_buffer buf;
+    size_t start;
+    size_t scan;
+} net_line_reader;
+
+// Upper bound for net_backoff_delay, in seconds.
+#define NET_BACKOFF_MAX 300.0
+
+// Resolves through a small TTL cache and races the addresses (IPv6/IPv4
+// interleaved) with staggered non-blocking connects. Returns a blocking fd.
+int net_connect_tcp(const char *host, const char *port);
+// Runs net_connect_tcp on a helper thread, so an event loop never waits on
+// DNS or a slow handshake. `wake_fd` turns readable when the attempt ends.
+typedef struct {
+    int wake_fd;
+    int signal_fd;
+    int busy;
+    pthread_t thread;
+    const char *host;
+    const char *port;
+    int result;
+} net_connector;
+
+void net_connector_init(net_connector *c);
+// host and port must stay valid until the attempt is finished.
+int net_connector_start(net_connector *c, const char *host, const char *port);
+// 1 once the attempt is over, with the socket (or -1) in *fd; 0 while it
+// is still running.
+int net_connector_finish(net_connector *c, int *fd);
+// Waits for a running attempt and closes whatever it connected.
+void net_connector_free(net_connector *c);
+
+// Delay before reconnect number `attempt` (1-based): base doubled per
+// attempt, capped, with jitter.
+double net_backoff_delay(double base, int attempt);
+int net_listen_tcp(const char *bind_host, const char *port, int backlog);
+int net_set_nonblocking(int fd);
+int net_send_all(int sock, const char *buf, size_t len);
+int net_send_line(int sock, const char *msg);
+// Gather write of the whole iovec array (may be modified); MSG_NOSIGNAL.
+int net_sendv_all(int sock, struct iovec *iov, int count);
+
+int net_buffer_reserve(net_buffer *b, size_t extra);
+int net_buffer_append(net_buffer *b, const void *data, size_t len);
+void net_buffer_consume(net_buffer *b, size_t n);
+void net_buffer_free(net_buffer *b);
+
+// One recv() into the reader; returns its result (0 on EOF, -1 with errno).
+ssize_t net_reader_recv(net_line_reader *r, int fd);
+int net_reader_next(net_line_reader *r, const char **line, size_t *len);
+size_t net_reader_pending(const net_line_reader *r);
+void net_reader_reset(net_line_reader *r);
+void net_reader_free(net_line_reader *r);
+
+#endif
@@ -0,0 +1,877 @@
+#include "proxy.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include "bitcoin/block.h"
+#include "bitcoin/job.h"
+#include "coins/registry.h"
+#include "hex.h"
+#include "json.h"
+#include "net.h"
+#include "sharerate.h"
+
+#define PROXY_JOB_RING 8
+#define PROXY_PENDING_CAP 4096
+#define PROXY_MAX_LINE 65536
+#define PROXY_TX_LIMIT (1u << 20)
+#define PROXY_EVENTS 256
+#define PROXY_SUGGEST_ID 3
+#define PROXY_EXTRANONCE_SUBSCRIBE_ID 4
+#define PROXY_RATE_INTERVAL 10.0
+#define TAG_LISTEN UINT64_MAX
+#define TAG_UPSTREAM (UINT64_MAX - 1)
+#define TAG_CONNECT (UINT64_MAX - 2)
+
+typedef struct {
+    int fd;
+    int in_use;
+    uint32_t generation;
+    net_line_reader rx;
+    net_buffer tx;
+    int want_write;
+    int subscribed;
+    int subscribe_pending;
+    char subscribe_id[64];
+    int authorized;
+    int extranonce_subscribe;
+    uint32_t slice;
+    int has_slice;
+    char worker[128];
+    size_t shares_ok;
+    size_t shares_bad;
+} proxy_client;
+
+// A job with the upstream extranonce it was issued under: after a
+// set_extranonce, miners still on older jobs keep submitting with the old one.
+typedef struct {
+    bitcoin_compiled_job *job;
+    uint8_t en1[32];
+    size_t en1_len;
+    int en2_size;
+} proxy_job;
+
+typedef struct {
+    int used;
+    uint32_t client;
+    uint32_t generation;
+    char id[64];
+} proxy_pending;
+
+typedef struct {
+    const proxy_options *opts;
+    int epfd;
+    int listen_fd;
+
+    int up_fd;
+    net_connector up_connector;
+    net_line_reader up_rx;
+    net_buffer up_tx;
+    int up_want_write;
+    int up_ready;
+    int up_attempts;
+    double up_next_connect;
+    char up_extranonce1[64];
+    int up_extranonce2_size;
+    int up_extranonce_pending;
+    char up_pending_extranonce1[64];
+    int up_pending_extranonce2_size;
+    uint8_t up_en1[32];
+    size_t up_en1_len;
+    double up_difficulty;
+    uint8_t up_target[32];
+    int up_target_ready;
+    int up_submit_seq;
+    share_rate_ctl rate_ctl;
+    double share_work;
+    double rate_mark;
+    double up_rate;
+    proxy_job jobs[PROXY_JOB_RING];
+    size_t job_head;
+    net_buffer last_notify;
+    net_buffer last_difficulty;
+    proxy_pending pending[PROXY_PENDING_CAP];
+
+    proxy_client *clients;
+    size_t client_cap;
+    size_t client_count;
+    uint32_t *free_list;
+    size_t free_count;
+    uint8_t *slice_used;
+    uint32_t slice_space;
+    uint32_t slice_cursor;
+
+    size_t notifies;
+    size_t shares_valid;
+    size_t shares_invalid;
+    size_t up_accepted;
+    size_t up_rejected;
+    size_t bytes_in;
+    size_t bytes_out;
+} proxy_state;
+
+static volatile sig_atomic_t stop_flag = 0;
+
+static void handle_stop(int sig) {
+    (void)sig;
+    stop_flag = 1;
+}
+
+static double mono_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int json_param_string(json_view params, int index, char *out, size_t cap) {
+    json_iter it;
+    json_view v;
+    if (!json_iter_init(&it, params)) return 0;
+    for (int i = 0; json_iter_next(&it, &v); i++) {
+        if (i == index) return json_view_copy(v, out, cap);
+    }
+    return 0;
+}
+
+static void epoll_update(proxy_state *ps, int fd, uint64_t tag, int want_write) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    ev.data.u64 = tag;
+    epoll_ctl(ps->epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+// Appends to the outgoing buffer and flushes as much as the socket takes.
+// Returns 0 if the peer is gone or too far behind to keep.
+static int queue_send(proxy_state *ps, int fd, net_buffer *tx, int *want_write, uint64_t tag, const char *data, size_t len) {
+    if (tx->len + len > PROXY_TX_LIMIT) return 0;
+    if (!net_buffer_append(tx, data, len)) return 0;
+    size_t sent = 0;
+    while (sent < tx->len) {
+        ssize_t n = send(fd, tx->data + sent, tx->len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return 0;
+        }
+        sent += (size_t)n;
+    }
+    ps->bytes_out += sent;
+    net_buffer_consume(tx, sent);
+    int pending = tx->len > 0;
+    if (pending != *want_write) {
+        *want_write = pending;
+        epoll_update(ps, fd, tag, pending);
+    }
+    return 1;
+}
+
+static void client_close(proxy_state *ps, uint32_t idx) {
+    proxy_client *c = &ps->clients[idx];
+    if (!c->in_use) return;
+    epoll_ctl(ps->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    net_reader_free(&c->rx);
+    net_buffer_free(&c->tx);
+    if (c->has_slice) ps->slice_used[c->slice] = 0;
+    c->in_use = 0;
+    c->has_slice = 0;
+    c->generation++;
+    ps->free_list[ps->free_count++] = idx;
+    ps->client_count--;
+}
+
+static int client_send(proxy_state *ps, uint32_t idx, const char *line) {
+    proxy_client *c = &ps->clients[idx];
+    size_t len = strlen(line);
+    if (!queue_send(ps, c->fd, &c->tx, &c->want_write, idx, line, len) ||
+        !queue_send(ps, c->fd, &c->tx, &c->want_write, idx, "\n", 1)) {
+        fprintf(stderr, "[proxy] cliente %u lento ou desconectado, encerrando\n", idx);
+        client_close(ps, idx);
+        return 0;
+    }
+    return 1;
+}
+
+static void client_reply_error(proxy_state *ps, uint32_t idx, const char *id, int code, const char *msg) {
+    char line[256];
+    snprintf(line, sizeof(line), "{\"id\":%s,\"result\":null,\"error\":[%d,\"%s\",null]}", id, code, msg);
+    client_send(ps, idx, line);
+}
+
+static void client_reply_result(proxy_state *ps, uint32_t idx, const char *id, const char *result) {
+    char line[256];
+    snprintf(line, sizeof(line), "{\"id\":%s,\"result\":%s,\"error\":null}", id, result);
+    client_send(ps, idx, line);
+}
+
+static void upstream_send(proxy_state *ps, const char *line) {
+    if (ps->up_fd == -1) return;
+    size_t len = strlen(line);
+    if (!queue_send(ps, ps->up_fd, &ps->up_tx, &ps->up_want_write, TAG_UPSTREAM, line, len) ||
+        !queue_send(ps, ps->up_fd, &ps->up_tx, &ps->up_want_write, TAG_UPSTREAM, "\n", 1)) {
+        fprintf(stderr, "[proxy] falha ao enviar para o pool\n");
+    }
+}
+
+static size_t downstream_en2_size(const proxy_state *ps) {
+    return (size_t)ps->up_extranonce2_size - (size_t)ps->opts->slice_bytes;
+}
+
+static size_t job_en2_size(const proxy_state *ps, const proxy_job *pj) {
+    return (size_t)pj->en2_size - (size_t)ps->opts->slice_bytes;
+}
+
+static void slice_prefix(const proxy_state *ps, uint32_t slice, uint8_t *out) {
+    size_t n = (size_t)ps->opts->slice_bytes;
+    for (size_t i = 0; i < n; i++) out[i] = (uint8_t)((slice >> ((n - 1 - i) * 8)) & 0xFF);
+}
+
+static void downstream_extranonce1(const proxy_state *ps, uint32_t slice, char *out, size_t cap) {
+    uint8_t prefix[4];
+    char prefix_hex[9];
+    slice_prefix(ps, slice, prefix);
+    hex_encode(prefix, (size_t)ps->opts->slice_bytes, prefix_hex);
+    prefix_hex[ps->opts->slice_bytes * 2] = '\0';
+    snprintf(out, cap, "%s%s", ps->up_extranonce1, prefix_hex);
+}
+
+static int slice_alloc(proxy_state *ps, uint32_t *out) {
+    for (uint32_t n = 0; n < ps->slice_space; n++) {
+        uint32_t s = (ps->slice_cursor + n) % ps->slice_space;
+        if (!ps->slice_used[s]) {
+            ps->slice_used[s] = 1;
+            ps->slice_cursor = s + 1;
+            *out = s;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void client_send_work(proxy_state *ps, uint32_t idx) {
+    if (ps->last_difficulty.len > 0 && !client_send(ps, idx, ps->last_difficulty.data)) return;
+    if (ps->last_notify.len > 0) client_send(ps, idx, ps->last_notify.data);
+}
+
+static void client_finish_subscribe(proxy_state *ps, uint32_t idx) {
+    proxy_client *c = &ps->clients[idx];
+    c->subscribe_pending = 0;
+    if (!c->has_slice) {
+        if (!slice_alloc(ps, &c->slice)) {
+            client_reply_error(ps, idx, c->subscribe_id, 20, "No extranonce slice available");
+            client_close(ps, idx);
+            return;
+        }
+        c->has_slice = 1;
+    }
+    char en1[80];
+    downstream_extranonce1(ps, c->slice, en1, sizeof(en1));
+    char line[384];
+    snprintf(line, sizeof(line),
+             "{\"id\":%s,\"result\":[[[\"mining.set_difficulty\",\"%x\"],[\"mining.notify\",\"%x\"]],\"%s\",%zu],\"error\":null}",
+             c->subscribe_id, c->slice, c->slice, en1, downstream_en2_size(ps));
+    if (!client_send(ps, idx, line)) return;
+    c->subscribed = 1;
+    client_send_work(ps, idx);
+}
+
+static void broadcast(proxy_state *ps, const char *line) {
+    for (uint32_t i = 0; i < ps->client_cap; i++) {
+        if (ps->clients[i].in_use && ps->clients[i].subscribed) client_send(ps, i, line);
+    }
+}
+
+static proxy_job *find_job(proxy_state *ps, const char *job_id) {
+    for (size_t i = 0; i < PROXY_JOB_RING; i++) {
+        proxy_job *pj = &ps->jobs[i];
+        if (pj->job && strcmp(pj->job->job_id, job_id) == 0) return pj;
+    }
+    return NULL;
+}
+
+static void clear_jobs(proxy_state *ps) {
+    for (size_t i = 0; i < PROXY_JOB_RING; i++) {
+        bitcoin_compiled_job_free(ps->jobs[i].job);
+        ps->jobs[i].job = NULL;
+    }
+}
+
+static void push_job(proxy_state *ps, bitcoin_compiled_job *cj) {
+    proxy_job *pj = &ps->jobs[ps->job_head];
+    bitcoin_compiled_job_free(pj->job);
+    pj->job = cj;
+    memcpy(pj->en1, ps->up_en1, ps->up_en1_len);
+    pj->en1_len = ps->up_en1_len;
+    pj->en2_size = ps->up_extranonce2_size;
+    ps->job_head = (ps->job_head + 1) % PROXY_JOB_RING;
+}
+
+static int decode_be32(const char *hex, uint8_t out_le[4]) {
+    uint8_t be[4];
+    size_t len = 0;
+    if (strlen(hex) != 8 || !hex_decode(hex, 8, be, sizeof(be), &len) || len != 4) return 0;
+    for (int i = 0; i < 4; i++) out_le[i] = be[3 - i];
+    return 1;
+}
+
+static void handle_submit(proxy_state *ps, uint32_t idx, json_view params, const char *id) {
+    proxy_client *c = &ps->clients[idx];
+    char job_id[128], en2_hex[64], ntime_hex[16], nonce_hex[16];
+    if (!c->subscribed || !c->authorized) {
+        client_reply_error(ps, idx, id, 24, "Unauthorized worker");
+        return;
+    }
+    json_iter it;
+    json_view v;
+    int ok = json_iter_init(&it, params) && json_iter_next(&it, &v);
+    ok = ok && json_iter_next(&it, &v) && json_view_copy(v, job_id, sizeof(job_id));
+    ok = ok && json_iter_next(&it, &v) && json_view_copy(v, en2_hex, sizeof(en2_hex));
+    ok = ok && json_iter_next(&it, &v) && json_view_copy(v, ntime_hex, sizeof(ntime_hex));
+    ok = ok && json_iter_next(&it, &v) && json_view_copy(v, nonce_hex, sizeof(nonce_hex));
+    if (!ok) {
+        client_reply_error(ps, idx, id, 20, "Malformed submit");
+        return;
+    }
+    if (!ps->up_ready) {
+        client_reply_error(ps, idx, id, 20, "Upstream unavailable");
+        return;
+    }
+    proxy_job *pj = find_job(ps, job_id);
+    if (!pj) {
+        c->shares_bad++;
+        ps->shares_invalid++;
+        client_reply_error(ps, idx, id, 21, "Job not found");
+        return;
+    }
+
+    size_t slice_bytes = (size_t)ps->opts->slice_bytes;
+    size_t en2_size = job_en2_size(ps, pj);
+    uint8_t en2_full[16];
+    size_t en2_len = 0;
+    uint8_t ntime_le[4], nonce_le[4];
+    if (strlen(en2_hex) != en2_size * 2 ||
+        !hex_decode(en2_hex, en2_size * 2, en2_full + slice_bytes, sizeof(en2_full) - slice_bytes, &en2_len) ||
+        !decode_be32(ntime_hex, ntime_le) || !decode_be32(nonce_hex, nonce_le)) {
+        c->shares_bad++;
+        ps->shares_invalid++;
+        client_reply_error(ps, idx, id, 20, "Malformed submit");
+        return;
+    }
+    slice_prefix(ps, c->slice, en2_full);
+
+    uint8_t merkle[32], header[80], hash[32];
+    bitcoin_compiled_merkle_root(pj->job, pj->en1, pj->en1_len, en2_full, slice_bytes + en2_len, merkle);
+    bitcoin_compiled_header(pj->job, merkle, 0, header);
+    memcpy(header + 68, ntime_le, 4);
+    memcpy(header + 76, nonce_le, 4);
+    double_sha256(header, sizeof(header), hash);
+    if (!ps->up_target_ready || !bitcoin_hash_meets_target(hash, ps->up_target)) {
+        c->shares_bad++;
+        ps->shares_invalid++;
+        client_reply_error(ps, idx, id, 23, "Low difficulty share");
+        return;
+    }
+    c->shares_ok++;
+    ps->shares_valid++;
+    ps->share_work += ps->up_difficulty;
+
+    int up_id = 1000 + ps->up_submit_seq++;
+    proxy_pending *p = &ps->pending[up_id % PROXY_PENDING_CAP];
+    p->used = 1;
+    p->client = idx;
+    p->generation = c->generation;
+    snprintf(p->id, sizeof(p->id), "%s", id);
+
+    char full_hex[40];
+    hex_encode(en2_full, slice_bytes + en2_len, full_hex);
+    full_hex[(slice_bytes + en2_len) * 2] = '\0';
+    char submit[512];
+    snprintf(submit, sizeof(submit),
+             "{\"id\":%d,\"method\":\"mining.submit\",\"params\":[\"%s\",\"%s\",\"%s\",\"%s\",\"%s\"]}",
+             up_id, ps->opts->user, job_id, full_hex, ntime_hex, nonce_hex);
+    upstream_send(ps, submit);
+}
+
+static void client_line(proxy_state *ps, uint32_t idx, const char *line, size_t len) {
+    json_message msg;
+    char id[64] = "null";
+    if (!json_parse_message(line, len, &msg) || !msg.method.p) return;
+    if (msg.id.p && msg.id.len < sizeof(id)) {
+        memcpy(id, msg.id.p, msg.id.len);
+        id[msg.id.len] = '\0';
+    }
+
+    proxy_client *c = &ps->clients[idx];
+    json_view method = msg.method;
+    if (json_view_string_eq(method, "mining.subscribe")) {
+        snprintf(c->subscribe_id, sizeof(c->subscribe_id), "%s", id);
+        if (ps->up_ready) {
+            client_finish_subscribe(ps, idx);
+        } else {
+            c->subscribe_pending = 1;
+        }
+    } else if (json_view_string_eq(method, "mining.authorize")) {
+        if (!json_param_string(msg.params, 0, c->worker, sizeof(c->worker))) {
+            snprintf(c->worker, sizeof(c->worker), "cliente-%u", idx);
+        }
+        c->authorized = 1;
+        client_reply_result(ps, idx, id, "true");
+    } else if (json_view_string_eq(method, "mining.extranonce.subscribe")) {
+        c->extranonce_subscribe = 1;
+        client_reply_result(ps, idx, id, "true");
+    } else if (json_view_string_eq(method, "mining.submit")) {
+        handle_submit(ps, idx, msg.params, id);
+    } else if (json_view_string_eq(method, "mining.suggest_difficulty") ||
+               json_view_string_eq(method, "mining.suggest_target")) {
+        // Every miner shares the upstream difficulty; the proxy suggests one
+        // to the pool from the aggregate hashrate instead.
+        client_reply_result(ps, idx, id, "true");
+    } else if (json_view_string_eq(method, "mining.ping")) {
+        client_reply_result(ps, idx, id, "\"pong\"");
+    } else {
+        client_reply_error(ps, idx, id, 20, "Unsupported method");
+    }
+}
+
+static void client_readable(proxy_state *ps, uint32_t idx) {
+    proxy_client *c = &ps->clients[idx];
+    for (;;) {
+        ssize_t n = net_reader_recv(&c->rx, c->fd);
+        if (n == 0) {
+            client_close(ps, idx);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) client_close(ps, idx);
+            return;
+        }
+        ps->bytes_in += (size_t)n;
+        uint32_t gen = c->generation;
+        const char *line;
+        size_t len;
+        while (net_reader_next(&c->rx, &line, &len)) {
+            client_line(ps, idx, line, len);
+            if (c->generation != gen) return;  // closed while handling
+        }
+        if (net_reader_pending(&c->rx) > PROXY_MAX_LINE) {
+            fprintf(stderr, "[proxy] cliente %u enviou linha grande demais\n", idx);
+            client_close(ps, idx);
+            return;
+        }
+    }
+}
+
+static void client_writable(proxy_state *ps, uint32_t idx) {
+    proxy_client *c = &ps->clients[idx];
+    if (!queue_send(ps, c->fd, &c->tx, &c->want_write, idx, "", 0)) client_close(ps, idx);
+}
+
+static void accept_clients(proxy_state *ps) {
+    for (;;) {
+        int fd = accept(ps->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("[proxy] accept");
+            return;
+        }
+        if (ps->client_count >= (size_t)ps->opts->max_clients || ps->client_count >= ps->slice_space) {
+            close(fd);
+            continue;
+        }
+        if (ps->free_count == 0) {
+            size_t cap = ps->client_cap ? ps->client_cap * 2 : 256;
+            proxy_client *clients = realloc(ps->clients, cap * sizeof(*clients));
+            uint32_t *free_list = realloc(ps->free_list, cap * sizeof(*free_list));
+            if (!clients || !free_list) {
+                if (clients) ps->clients = clients;
+                if (free_list) ps->free_list = free_list;
+                close(fd);
+                continue;
+            }
+            memset(clients + ps->client_cap, 0, (cap - ps->client_cap) * sizeof(*clients));
+            ps->clients = clients;
+            ps->free_list = free_list;
+            for (size_t i = cap; i > ps->client_cap; i--) ps->free_list[ps->free_count++] = (uint32_t)(i - 1);
+            ps->client_cap = cap;
+        }
+        net_set_nonblocking(fd);
+        uint32_t idx = ps->free_list[--ps->free_count];
+        proxy_client *c = &ps->clients[idx];
+        uint32_t generation = c->generation;
+        memset(c, 0, sizeof(*c));
+        c->generation = generation;
+        c->fd = fd;
+        c->in_use = 1;
+        ps->client_count++;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = idx;
+        epoll_ctl(ps->epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+static void upstream_apply_extranonce(proxy_state *ps, const char *en1, int en2_size) {
+    int changed = ps->up_extranonce1[0] != '\0' &&
+                  (strcmp(ps->up_extranonce1, en1) != 0 || ps->up_extranonce2_size != en2_size);
+    snprintf(ps->up_extranonce1, sizeof(ps->up_extranonce1), "%s", en1);
+    ps->up_extranonce2_size = en2_size;
+    ps->up_en1_len = 0;
+    if (!hex_decode(en1, strlen(en1), ps->up_en1, sizeof(ps->up_en1), &ps->up_en1_len) ||
+        en2_size <= ps->opts->slice_bytes || en2_size > 8) {
+        fprintf(stderr, "[proxy] extranonce do pool incompativel (extranonce2_size=%d, slice=%d)\n",
+                en2_size, ps->opts->slice_bytes);
+        ps->up_ready = 0;
+        return;
+    }
+    ps->up_ready = 1;
+    printf("[proxy] upstream extranonce1=%s extranonce2_size=%d -> %zu bytes por minerador\n",
+           en1, en2_size, downstream_en2_size(ps));
+
+    for (uint32_t i = 0; i < ps->client_cap; i++) {
+        proxy_client *c = &ps->clients[i];
+        if (!c->in_use) continue;
+        if (c->subscribe_pending) {
+            client_finish_subscribe(ps, i);
+        } else if (changed && c->subscribed) {
+            if (!c->extranonce_subscribe) {
+                client_close(ps, i);
+                continue;
+            }
+            char en1_down[80];
+            char line[256];
+            downstream_extranonce1(ps, c->slice, en1_down, sizeof(en1_down));
+            snprintf(line, sizeof(line), "{\"id\":null,\"method\":\"mining.set_extranonce\",\"params\":[\"%s\",%zu]}",
+                     en1_down, downstream_en2_size(ps));
+            client_send(ps, i, line);
+        }
+    }
+}
+
+static void upstream_line(proxy_state *ps, const char *line, size_t len) {
+    json_message msg;
+    json_iter it;
+    json_view v;
+    if (!json_parse_message(line, len, &msg)) {
+        fprintf(stderr, "[proxy] mensagem invalida do pool ignorada\n");
+        return;
+    }
+    if (msg.method.p) {
+        if (json_view_string_eq(msg.method, "mining.notify")) {
+            bitcoin_compiled_job *cj = bitcoin_job_from_notify(msg.params);
+            if (!cj) {
+                fprintf(stderr, "[proxy] notify com campos invalidos ignorado\n");
+                return;
+            }
+            if (ps->up_extranonce_pending) {
+                // Miners get set_extranonce right before the job it applies to.
+                ps->up_extranonce_pending = 0;
+                upstream_apply_extranonce(ps, ps->up_pending_extranonce1, ps->up_pending_extranonce2_size);
+            }
+            if (cj->clean_jobs) clear_jobs(ps);
+            push_job(ps, cj);
+            ps->last_notify.len = 0;
+            net_buffer_append(&ps->last_notify, line, len + 1);
+            ps->notifies++;
+            broadcast(ps, line);
+        } else if (json_view_string_eq(msg.method, "mining.set_difficulty")) {
+            if (!json_iter_init(&it, msg.params) || !json_iter_next(&it, &v)) return;
+            double diff = json_view_double(v);
+            if (diff <= 0.0 || !bitcoin_target_from_difficulty(diff, ps->up_target)) return;
+            ps->up_difficulty = diff;
+            share_rate_pool_difficulty(&ps->rate_ctl, diff);
+            ps->up_target_ready = 1;
+            ps->last_difficulty.len = 0;
+            net_buffer_append(&ps->last_difficulty, line, len + 1);
+            printf("[proxy] difficulty set to %.8f\n", diff);
+            broadcast(ps, line);
+        } else if (json_view_string_eq(msg.method, "mining.set_extranonce")) {
+            char en1[sizeof(ps->up_pending_extranonce1)];
+            if (!json_iter_init(&it, msg.params) || !json_iter_next(&it, &v) || !json_view_copy(v, en1, sizeof(en1))) return;
+            int en2_size = json_iter_next(&it, &v) ? (int)json_view_int(v) : ps->up_extranonce2_size;
+            memcpy(ps->up_pending_extranonce1, en1, sizeof(en1));
+            ps->up_pending_extranonce2_size = en2_size;
+            ps->up_extranonce_pending = 1;
+            printf("[proxy] pool trocou extranonce1 para %s (aplicado no proximo job)\n", en1);
+        }
+        return;
+    }
+
+    if (!msg.id.p) return;
+    long long id = json_view_int(msg.id);
+    if (id == 1) {
+        char en1[64];
+        if (json_iter_init(&it, msg.result) && json_iter_next(&it, &v) &&
+            json_iter_next(&it, &v) && json_view_copy(v, en1, sizeof(en1)) &&
+            json_iter_next(&it, &v)) {
+            upstream_apply_extranonce(ps, en1, (int)json_view_int(v));
+        } else {
+            fprintf(stderr, "[proxy] resposta de subscribe invalida: %s\n", line);
+        }
+    } else if (id == 2) {
+        if (!json_view_is(msg.result, "true")) fprintf(stderr, "[proxy] authorize recusado pelo pool: %s\n", line);
+    } else if (id == PROXY_EXTRANONCE_SUBSCRIBE_ID) {
+        if (!json_view_is(msg.result, "true")) printf("[proxy] pool sem suporte a mining.extranonce.subscribe\n");
+    } else if (id == PROXY_SUGGEST_ID) {
+        if (!json_view_is(msg.result, "true") && msg.error.p && !json_view_is(msg.error, "null")) {
+            printf("[proxy] pool nao aceita sugestao de dificuldade: %.*s\n", (int)msg.error.len, msg.error.p);
+            share_rate_unsupported(&ps->rate_ctl);
+        }
+    } else if (id >= 1000) {
+        proxy_pending *p = &ps->pending[id % PROXY_PENDING_CAP];
+        json_view result = msg.result.p ? msg.result : (json_view){"null", 4};
+        json_view error = msg.error.p ? msg.error : (json_view){"null", 4};
+        int accepted = json_view_is(result, "true");
+        if (accepted) ps->up_accepted++; else ps->up_rejected++;
+        if (!p->used) return;
+        p->used = 0;
+        if (p->client >= ps->client_cap) return;
+        proxy_client *c = &ps->clients[p->client];
+        if (!c->in_use || c->generation != p->generation) return;
+        if (result.len > 128) result = (json_view){"null", 4};
+        if (error.len > 256) error = (json_view){"null", 4};
+        char reply[512];
+        snprintf(reply, sizeof(reply), "{\"id\":%s,\"result\":%.*s,\"error\":%.*s}",
+                 p->id, (int)result.len, result.p, (int)error.len, error.p);
+        client_send(ps, p->client, reply);
+    }
+}
+
+static void upstream_close(proxy_state *ps, double now) {
+    if (ps->up_fd != -1) {
+        epoll_ctl(ps->epfd, EPOLL_CTL_DEL, ps->up_fd, NULL);
+        close(ps->up_fd);
+    }
+    ps->up_fd = -1;
+    ps->up_ready = 0;
+    ps->up_want_write = 0;
+    ps->up_extranonce_pending = 0;
+    net_reader_reset(&ps->up_rx);
+    ps->up_tx.len = 0;
+    // Jobs and difficulty belong to the old session: miners subscribing now
+    // wait for the pool's next notify, and shares on old jobs are refused.
+    clear_jobs(ps);
+    ps->last_notify.len = 0;
+    ps->last_difficulty.len = 0;
+    ps->up_target_ready = 0;
+    ps->up_attempts++;
+    double delay = net_backoff_delay(ps->opts->reconnect_delay_secs, ps->up_attempts);
+    ps->up_next_connect = now + delay;
+    printf("[proxy] reconectando ao pool em %.1f segundos (tentativa %d)...\n", delay, ps->up_attempts + 1);
+}
+
+// The connect runs on the connector's thread; the epoll loop goes on
+// serving miners and picks the socket up in upstream_connected.
+static void upstream_connect(proxy_state *ps) {
+    if (!net_connector_start(&ps->up_connector, ps->opts->host, ps->opts->port)) {
+        upstream_close(ps, mono_seconds());
+        return;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = TAG_CONNECT;
+    epoll_ctl(ps->epfd, EPOLL_CTL_ADD, ps->up_connector.wake_fd, &ev);
+}
+
+static void upstream_connected(proxy_state *ps) {
+    const proxy_options *opts = ps->opts;
+    int fd;
+    if (!net_connector_finish(&ps->up_connector, &fd)) return;
+    epoll_ctl(ps->epfd, EPOLL_CTL_DEL, ps->up_connector.wake_fd, NULL);
+    if (fd == -1) {
+        upstream_close(ps, mono_seconds());
+        return;
+    }
+    printf("[proxy] conectado ao pool %s:%s\n", opts->host, opts->port);
+    ps->up_attempts = 0;
+    share_rate_init(&ps->rate_ctl, opts->share_rate);
+    net_set_nonblocking(fd);
+    ps->up_fd = fd;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = TAG_UPSTREAM;
+    epoll_ctl(ps->epfd, EPOLL_CTL_ADD, fd, &ev);
+
+    char line[512];
+    snprintf(line, sizeof(line), "{\"id\":1,\"method\":\"mining.subscribe\",\"params\":[\"coinminer-proxy/%s\"]}", COINMINER_VERSION);
+    upstream_send(ps, line);
+    snprintf(line, sizeof(line), "{\"id\":2,\"method\":\"mining.authorize\",\"params\":[\"%s\",\"%s\"]}",
+             opts->user, opts->password ? opts->password : "x");
+    upstream_send(ps, line);
+    snprintf(line, sizeof(line), "{\"id\":%d,\"method\":\"mining.extranonce.subscribe\",\"params\":[]}",
+             PROXY_EXTRANONCE_SUBSCRIBE_ID);
+    upstream_send(ps, line);
+}
+
+static void upstream_readable(proxy_state *ps) {
+    for (;;) {
+        ssize_t n = net_reader_recv(&ps->up_rx, ps->up_fd);
+        if (n == 0) {
+            fprintf(stderr, "[proxy] conexao com o pool encerrada\n");
+            upstream_close(ps, mono_seconds());
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) upstream_close(ps, mono_seconds());
+            return;
+        }
+        ps->bytes_in += (size_t)n;
+        const char *line;
+        size_t len;
+        while (ps->up_fd != -1 && net_reader_next(&ps->up_rx, &line, &len)) upstream_line(ps, line, len);
+        if (ps->up_fd == -1) return;
+    }
+}
+
+static void print_stats(const proxy_state *ps) {
+    printf("[proxy] stats: clientes=%zu | notify=%zu | shares validos=%zu invalidos=%zu | pool aceitos=%zu rejeitados=%zu | bytes_in=%zu bytes_out=%zu | hashrate~%.2f H/s\n",
+           ps->client_count, ps->notifies, ps->shares_valid, ps->shares_invalid,
+           ps->up_accepted, ps->up_rejected, ps->bytes_in, ps->bytes_out, ps->up_rate);
+}
+
+// Aggregate hashrate is estimated from the work in validated shares, since
+// the proxy never sees the miners' own counters.
+static void update_share_rate(proxy_state *ps, double now) {
+    double dt = now - ps->rate_mark;
+    if (dt < PROXY_RATE_INTERVAL) return;
+    double inst = ps->share_work * 4294967296.0 / dt;
+    ps->up_rate = ps->up_rate > 0.0 ? 0.7 * ps->up_rate + 0.3 * inst : inst;
+    ps->share_work = 0.0;
+    ps->rate_mark = now;
+
+    double diff;
+    char line[256];
+    if (!ps->up_ready || !share_rate_decide(&ps->rate_ctl, ps->up_rate, now, &diff)) return;
+    if (!share_rate_format(&ps->rate_ctl, PROXY_SUGGEST_ID, diff, line, sizeof(line))) return;
+    printf("[proxy] sugerindo difficulty %.8f ao pool (%.2f H/s agregados, alvo %.1f shares/min)\n",
+           diff, ps->up_rate, ps->rate_ctl.target_spm);
+    upstream_send(ps, line);
+}
+
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+int proxy_run(const proxy_options *opts) {
+    if (!opts || !opts->listen_port || !opts->host || !opts->port || !opts->user) {
+        fprintf(stderr, "[proxy] parametros invalidos\n");
+        return 1;
+    }
+    signal(SIGINT, handle_stop);
+#ifdef SIGTERM
+    signal(SIGTERM, handle_stop);
+#endif
+    raise_fd_limit();
+
+    proxy_state *ps = calloc(1, sizeof(*ps));
+    if (!ps) return 1;
+    ps->opts = opts;
+    ps->up_fd = -1;
+    net_connector_init(&ps->up_connector);
+    ps->slice_space = 1u << (8 * opts->slice_bytes);
+    ps->slice_used = calloc(ps->slice_space, 1);
+    ps->epfd = epoll_create1(0);
+    ps->listen_fd = net_listen_tcp(opts->bind_host, opts->listen_port, 1024);
+    if (!ps->slice_used || ps->epfd < 0 || ps->listen_fd < 0) {
+        if (ps->epfd >= 0) close(ps->epfd);
+        free(ps->slice_used);
+        free(ps);
+        return 1;
+    }
+    net_set_nonblocking(ps->listen_fd);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = TAG_LISTEN;
+    epoll_ctl(ps->epfd, EPOLL_CTL_ADD, ps->listen_fd, &ev);
+    printf("[proxy] escutando em %s:%s -> pool %s:%s (coin=%s, slice=%d bytes)\n",
+           opts->bind_host ? opts->bind_host : "*", opts->listen_port, opts->host, opts->port,
+           coin_type_to_name(opts->coin), opts->slice_bytes);
+
+    int failed = 0;
+    double last_stats = mono_seconds();
+    ps->rate_mark = last_stats;
+    struct epoll_event events[PROXY_EVENTS];
+    while (!stop_flag) {
+        double now = mono_seconds();
+        if (ps->up_fd == -1 && !ps->up_connector.busy && now >= ps->up_next_connect) {
+            if (opts->max_reconnects >= 0 && ps->up_attempts > opts->max_reconnects) {
+                fprintf(stderr, "[proxy] limite de reconexoes ao pool atingido (%d)\n", opts->max_reconnects);
+                failed = 1;
+                break;
+            }
+            upstream_connect(ps);
+        }
+
+        int n = epoll_wait(ps->epfd, events, PROXY_EVENTS, 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("[proxy] epoll_wait");
+            failed = 1;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t tag = events[i].data.u64;
+            uint32_t ev_mask = events[i].events;
+            if (tag == TAG_LISTEN) {
+                accept_clients(ps);
+            } else if (tag == TAG_CONNECT) {
+                upstream_connected(ps);
+            } else if (tag == TAG_UPSTREAM) {
+                if (ps->up_fd == -1) continue;
+                if (ev_mask & EPOLLOUT) {
+                    queue_send(ps, ps->up_fd, &ps->up_tx, &ps->up_want_write, TAG_UPSTREAM, "", 0);
+                }
+                if (ev_mask & (EPOLLIN | EPOLLHUP | EPOLLERR)) upstream_readable(ps);
+            } else if (tag < ps->client_cap && ps->clients[tag].in_use) {
+                if (ev_mask & EPOLLOUT) client_writable(ps, (uint32_t)tag);
+                if (ps->clients[tag].in_use && (ev_mask & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                    client_readable(ps, (uint32_t)tag);
+                }
+            }
+        }
+
+        now = mono_seconds();
+        update_share_rate(ps, now);
+        if (now - last_stats >= 30.0) {
+            print_stats(ps);
+            last_stats = now;
+        }
+    }
+
+    print_stats(ps);
+    for (uint32_t i = 0; i < ps->client_cap; i++) client_close(ps, i);
+    if (ps->up_fd != -1) close(ps->up_fd);
+    net_connector_free(&ps->up_connector);
+    close(ps->listen_fd);
+    close(ps->epfd);
+    clear_jobs(ps);
+    net_reader_free(&ps->up_rx);
+    net_buffer_free(&ps->up_tx);
+    net_buffer_free(&ps->last_notify);
+    net_buffer_free(&ps->last_difficulty);
+    free(ps->clients);
+    free(ps->free_list);
+    free(ps->slice_used);
+    free(ps);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,8 @@
+#ifndef PROXY_H
+#define PROXY_H
+
+#include "common.h"
+
+int proxy_run(const proxy_options *opts);
+
+#endif
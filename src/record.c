@@ -0,0 +1,131 @@
+#include "record.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RECORD_MAGIC "CMREC001"
+#define RECORD_MAX_LINE (64u * 1024u * 1024u)
+
+static double record_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static size_t put_varint(uint8_t *out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static int get_varint(FILE *f, uint64_t *out) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(f);
+        if (c == EOF) return 0;
+        v |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            *out = v;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int recorder_open(stratum_recorder *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "wb");
+    if (!r->f) {
+        fprintf(stderr, "[record] nao foi possivel criar %s\n", path);
+        return 0;
+    }
+    if (fwrite(RECORD_MAGIC, 1, 8, r->f) != 8) {
+        fclose(r->f);
+        r->f = NULL;
+        return 0;
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    r->start = record_now();
+    return 1;
+}
+
+void recorder_write(stratum_recorder *r, int session, int dir, const char *line, size_t len) {
+    if (!r || !r->f) return;
+    uint8_t head[1 + 10 + 10];
+    pthread_mutex_lock(&r->lock);
+    uint64_t t_us = (uint64_t)((record_now() - r->start) * 1e6);
+    if (t_us < r->last_us) t_us = r->last_us;
+    size_t n = 0;
+    head[n++] = (uint8_t)((session << 1) | (dir & 1));
+    n += put_varint(head + n, t_us - r->last_us);
+    n += put_varint(head + n, len);
+    r->last_us = t_us;
+    if (!r->failed && (fwrite(head, 1, n, r->f) != n || fwrite(line, 1, len, r->f) != len)) {
+        fprintf(stderr, "[record] falha ao gravar; captura interrompida\n");
+        r->failed = 1;
+    }
+    r->records++;
+    r->bytes += n + len;
+    pthread_mutex_unlock(&r->lock);
+}
+
+void recorder_close(stratum_recorder *r) {
+    if (!r->f) return;
+    fclose(r->f);
+    r->f = NULL;
+    pthread_mutex_destroy(&r->lock);
+    printf("[record] %zu linhas gravadas (%zu bytes)\n", r->records, r->bytes + 8);
+}
+
+int record_reader_open(record_reader *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "rb");
+    if (!r->f) {
+        fprintf(stderr, "[replay] nao foi possivel abrir %s\n", path);
+        return 0;
+    }
+    char magic[8];
+    if (fread(magic, 1, 8, r->f) != 8 || memcmp(magic, RECORD_MAGIC, 8) != 0) {
+        fprintf(stderr, "[replay] %s nao e uma captura do coinminer\n", path);
+        fclose(r->f);
+        r->f = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+int record_reader_next(record_reader *r, record_entry *e) {
+    int tag = fgetc(r->f);
+    if (tag == EOF) return 0;
+    uint64_t delta = 0;
+    uint64_t len = 0;
+    if (!get_varint(r->f, &delta) || !get_varint(r->f, &len) || len > RECORD_MAX_LINE) return -1;
+    if (len + 1 > r->cap) {
+        size_t cap = r->cap ? r->cap : 4096;
+        while (cap < len + 1) cap *= 2;
+        char *buf = realloc(r->buf, cap);
+        if (!buf) return -1;
+        r->buf = buf;
+        r->cap = cap;
+    }
+    if (fread(r->buf, 1, len, r->f) != len) return -1;
+    r->buf[len] = '\0';
+    r->t_us += delta;
+    e->session = tag >> 1;
+    e->dir = tag & 1;
+    e->t = (double)r->t_us / 1e6;
+    e->line = r->buf;
+    e->len = (size_t)len;
+    return 1;
+}
+
+void record_reader_close(record_reader *r) {
+    if (r->f) fclose(r->f);
+    free(r->buf);
+    memset(r, 0, sizeof(*r));
+}
@@ -0,0 +1,50 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define RECORD_RX 0
+#define RECORD_TX 1
+
+// Binary capture of stratum traffic. After an 8-byte magic, each line is
+// stored as: one byte (session << 1 | direction), varint microseconds since
+// the previous line, varint length, then the raw bytes without '\n'.
+typedef struct {
+    FILE *f;
+    pthread_mutex_t lock;
+    double start;
+    uint64_t last_us;
+    size_t records;
+    size_t bytes;
+    int failed;
+} stratum_recorder;
+
+typedef struct {
+    int session;
+    int dir;
+    double t;  // seconds since the start of the capture
+    const char *line;
+    size_t len;
+} record_entry;
+
+typedef struct {
+    FILE *f;
+    uint64_t t_us;
+    char *buf;
+    size_t cap;
+} record_reader;
+
+int recorder_open(stratum_recorder *r, const char *path);
+// Thread safe; timestamps are taken under the lock so they never go back.
+void recorder_write(stratum_recorder *r, int session, int dir, const char *line, size_t len);
+void recorder_close(stratum_recorder *r);
+
+int record_reader_open(record_reader *r, const char *path);
+// 1 with an entry (line valid until the next call), 0 at EOF, -1 if corrupt.
+int record_reader_next(record_reader *r, record_entry *e);
+void record_reader_close(record_reader *r);
+
+#endif
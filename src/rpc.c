@@ -0,0 +1,371 @@
+#include "rpc.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include "hex.h"
+
+// Largest chunk accepted in a chunked reply; the body as a whole has no limit.
+#define RPC_MAX_CHUNK (64ull << 20)
+
+static double rpc_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void base64_encode(const unsigned char *in, size_t in_len, char *out, size_t out_len) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t j = 0;
+    for (size_t i = 0; i < in_len && j + 4 < out_len; i += 3) {
+        unsigned val = in[i] << 16;
+        if (i + 1 < in_len) val |= in[i + 1] << 8;
+        if (i + 2 < in_len) val |= in[i + 2];
+
+        out[j++] = table[(val >> 18) & 0x3F];
+        out[j++] = table[(val >> 12) & 0x3F];
+        out[j++] = (i + 1 < in_len) ? table[(val >> 6) & 0x3F] : '=';
+        out[j++] = (i + 2 < in_len) ? table[val & 0x3F] : '=';
+    }
+    out[j] = '\0';
+}
+
+void rpc_init(rpc_client *c, const char *host, const char *port, const char *user, const char *password) {
+    memset(c, 0, sizeof(*c));
+    snprintf(c->host, sizeof(c->host), "%s", host ? host : "");
+    snprintf(c->port, sizeof(c->port), "%s", port ? port : "");
+    char raw[256];
+    snprintf(raw, sizeof(raw), "%s:%s", user ? user : "", password ? password : "");
+    base64_encode((const unsigned char *)raw, strlen(raw), c->auth, sizeof(c->auth));
+    c->sock = -1;
+}
+
+void rpc_close(rpc_client *c) {
+    if (c->sock != -1) close(c->sock);
+    c->sock = -1;
+    c->rx.len = 0;
+}
+
+void rpc_free(rpc_client *c) {
+    rpc_close(c);
+    net_buffer_free(&c->rx);
+    net_buffer_free(&c->tx);
+    net_buffer_free(&c->body);
+}
+
+// Reads more bytes into rx; 0 on EOF or error.
+static int fill(rpc_client *c) {
+    if (!net_buffer_reserve(&c->rx, 65536)) return 0;
+    for (;;) {
+        ssize_t n = recv(c->sock, c->rx.data + c->rx.len, c->rx.cap - c->rx.len, 0);
+        if (n > 0) {
+            c->rx.len += (size_t)n;
+            return 1;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (c->cancel && !*c->cancel) continue;
+            if (!c->cancel) {
+                c->timed_out = 1;
+                fprintf(stderr, "[rpc] %s:%s sem resposta em %ds\n", c->host, c->port, RPC_TIMEOUT_SECS);
+            }
+        }
+        return 0;
+    }
+}
+
+// Ensures rx holds at least `want` bytes.
+static int need(rpc_client *c, size_t want) {
+    while (c->rx.len < want) {
+        if (!fill(c)) return 0;
+    }
+    return 1;
+}
+
+// Position of "\r\n" at or after `from`, waiting for more data as needed.
+static int find_crlf(rpc_client *c, size_t from, size_t *at) {
+    size_t scan = from;
+    for (;;) {
+        if (c->rx.len > scan) {
+            char *p = memchr(c->rx.data + scan, '\n', c->rx.len - scan);
+            if (p) {
+                size_t pos = (size_t)(p - c->rx.data);
+                if (pos > from && c->rx.data[pos - 1] == '\r') {
+                    *at = pos - 1;
+                    return 1;
+                }
+                scan = pos + 1;
+                continue;
+            }
+            scan = c->rx.len;
+        }
+        if (!fill(c)) return 0;
+    }
+}
+
+static const char *header_value(const char *headers, size_t len, const char *name) {
+    size_t name_len = strlen(name);
+    const char *p = headers;
+    const char *end = headers + len;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        if ((size_t)(eol - p) > name_len && strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+            const char *v = p + name_len + 1;
+            while (v < eol && (*v == ' ' || *v == '\t')) v++;
+            return v;
+        }
+        p = eol + 1;
+    }
+    return NULL;
+}
+
+static int body_append(rpc_client *c, const char *data, size_t len) {
+    return net_buffer_append(&c->body, data, len);
+}
+
+// Parses one response off the connection. Returns 1 with the body in
+// c->body, 0 on failure; *keep tells whether the connection can be reused.
+static int read_response(rpc_client *c, int *status, int *keep) {
+    size_t head_end = 0;
+    size_t scan = 0;
+    // Header terminator search resumes where the last one stopped.
+    for (;;) {
+        if (c->rx.len >= 4) {
+            size_t from = scan > 3 ? scan - 3 : 0;
+            for (size_t i = from; i + 4 <= c->rx.len; i++) {
+                if (c->rx.data[i] == '\r' && memcmp(c->rx.data + i, "\r\n\r\n", 4) == 0) {
+                    head_end = i + 4;
+                    break;
+                }
+            }
+            if (head_end) break;
+            scan = c->rx.len;
+        }
+        if (!fill(c)) return 0;
+    }
+
+    const char *head = c->rx.data;
+    if (head_end < 12 || strncmp(head, "HTTP/1.", 7) != 0) return 0;
+    *status = atoi(head + 9);
+    *keep = head[7] == '1';
+    const char *conn = header_value(head, head_end, "Connection");
+    if (conn && strncasecmp(conn, "close", 5) == 0) *keep = 0;
+    if (conn && strncasecmp(conn, "keep-alive", 10) == 0) *keep = 1;
+    const char *te = header_value(head, head_end, "Transfer-Encoding");
+    const char *cl = header_value(head, head_end, "Content-Length");
+    int chunked = te && strncasecmp(te, "chunked", 7) == 0;
+    long long content_length = cl ? strtoll(cl, NULL, 10) : -1;
+
+    c->body.len = 0;
+    size_t pos = head_end;
+    if (chunked) {
+        for (;;) {
+            size_t eol = 0;
+            if (!find_crlf(c, pos, &eol)) return 0;
+            char *end = NULL;
+            unsigned long long size = strtoull(c->rx.data + pos, &end, 16);
+            if (end == c->rx.data + pos || size > RPC_MAX_CHUNK) {
+                fprintf(stderr, "[rpc] chunk invalido de %s:%s\n", c->host, c->port);
+                return 0;
+            }
+            pos = eol + 2;
+            if (size == 0) {
+                // Trailers end with an empty line.
+                for (;;) {
+                    if (!find_crlf(c, pos, &eol)) return 0;
+                    int empty = eol == pos;
+                    pos = eol + 2;
+                    if (empty) break;
+                }
+                break;
+            }
+            if (!need(c, pos + size + 2)) return 0;
+            if (!body_append(c, c->rx.data + pos, (size_t)size)) return 0;
+            pos += (size_t)size + 2;
+        }
+    } else if (content_length >= 0) {
+        if ((unsigned long long)content_length > SIZE_MAX - pos - 1) return 0;
+        if (!need(c, pos + (size_t)content_length)) return 0;
+        if (!body_append(c, c->rx.data + pos, (size_t)content_length)) return 0;
+        pos += (size_t)content_length;
+    } else {
+        while (fill(c)) {
+        }
+        if (!body_append(c, c->rx.data + pos, c->rx.len - pos)) return 0;
+        pos = c->rx.len;
+        *keep = 0;
+    }
+    net_buffer_consume(&c->rx, pos);
+    if (!net_buffer_reserve(&c->body, 1)) return 0;
+    c->body.data[c->body.len] = '\0';
+    return 1;
+}
+
+static int format_head(const rpc_client *c, const char *length_header, char *head, size_t cap) {
+    int len = snprintf(head, cap,
+                       "POST / HTTP/1.1\r\n"
+                       "Host: %s\r\n"
+                       "Authorization: Basic %s\r\n"
+                       "Content-Type: application/json\r\n"
+                       "%s\r\n"
+                       "Connection: keep-alive\r\n"
+                       "\r\n",
+                       c->host, c->auth, length_header);
+    return len < 0 || (size_t)len >= cap ? -1 : len;
+}
+
+// Sends one request with `send_request` and reads the reply. A reused
+// connection that fails is reopened and the request sent again once.
+static int exchange(rpc_client *c, int (*send_request)(rpc_client *c, const void *ctx), const void *ctx) {
+    double start = rpc_now();
+    c->timed_out = 0;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int reused = c->sock != -1;
+        if (!reused) {
+            c->sock = net_connect_tcp(c->host, c->port);
+            if (c->sock == -1) return 0;
+            int one = 1;
+            setsockopt(c->sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            struct timeval send_tv = {RPC_TIMEOUT_SECS, 0};
+            struct timeval recv_tv = {RPC_TIMEOUT_SECS, 0};
+            if (c->cancel) recv_tv = (struct timeval){0, 500000};
+            setsockopt(c->sock, SOL_SOCKET, SO_SNDTIMEO, &send_tv, sizeof(send_tv));
+            setsockopt(c->sock, SOL_SOCKET, SO_RCVTIMEO, &recv_tv, sizeof(recv_tv));
+            c->connects++;
+            c->rx.len = 0;
+        }
+        int status = 0;
+        int keep = 0;
+        int sent = send_request(c, ctx);
+        if (!sent && (errno == EAGAIN || errno == EWOULDBLOCK)) c->timed_out = 1;
+        if (sent) {
+            c->sent_at = rpc_now();
+            if (read_response(c, &status, &keep)) {
+                if (!keep) rpc_close(c);
+                c->requests++;
+                c->last_latency = rpc_now() - start;
+                // bitcoind answers JSON-RPC errors with 500 and a JSON body.
+                if (status != 200 && status != 500) {
+                    fprintf(stderr, "[rpc] HTTP %d de %s:%s\n", status, c->host, c->port);
+                    return 0;
+                }
+                return 1;
+            }
+        }
+        rpc_close(c);
+        // Only a reused connection gets a second try: the node may have
+        // closed it while idle. A node that timed out is not waited on twice.
+        if (!reused || c->timed_out) break;
+    }
+    return 0;
+}
+
+static int send_buffered(rpc_client *c, const void *ctx) {
+    (void)ctx;
+    return net_send_all(c->sock, c->tx.data, c->tx.len);
+}
+
+int rpc_post(rpc_client *c, const char *body, size_t body_len) {
+    char length[64];
+    char head[1024];
+    snprintf(length, sizeof(length), "Content-Length: %zu", body_len);
+    int head_len = format_head(c, length, head, sizeof(head));
+    if (head_len < 0) return 0;
+    // One write for head and body, so Nagle never holds the body back.
+    c->tx.len = 0;
+    if (!net_buffer_append(&c->tx, head, (size_t)head_len) || !net_buffer_append(&c->tx, body, body_len)) return 0;
+    return exchange(c, send_buffered, NULL);
+}
+
+typedef struct {
+    const char *prefix;
+    const struct iovec *parts;
+    size_t count;
+    const char *suffix;
+} hex_body;
+
+// Sends the staged bytes in c->tx as one chunk, behind `head` if given
+// and followed by the last-chunk marker if `last`.
+static int send_chunk(rpc_client *c, const char *head, size_t head_len, int last) {
+    char size_line[32];
+    int size_len = snprintf(size_line, sizeof(size_line), "%zx\r\n", c->tx.len);
+    static const char tail[] = "\r\n0\r\n\r\n";
+    struct iovec iov[4];
+    int n = 0;
+    if (head_len) iov[n++] = (struct iovec){(void *)head, head_len};
+    if (c->tx.len) {
+        iov[n++] = (struct iovec){size_line, (size_t)size_len};
+        iov[n++] = (struct iovec){c->tx.data, c->tx.len};
+        iov[n++] = (struct iovec){(void *)tail, last ? sizeof(tail) - 1 : 2};
+    } else if (last) {
+        iov[n++] = (struct iovec){(void *)(tail + 2), sizeof(tail) - 3};
+    }
+    c->tx.len = 0;
+    return n == 0 || net_sendv_all(c->sock, iov, n);
+}
+
+static int send_hex(rpc_client *c, const void *ctx) {
+    const hex_body *hb = ctx;
+    char head[1024];
+    int head_len = format_head(c, "Transfer-Encoding: chunked", head, sizeof(head));
+    if (head_len < 0 || !net_buffer_reserve(&c->tx, RPC_STREAM_CHUNK + 1024)) return 0;
+    size_t pending_head = (size_t)head_len;
+
+    c->tx.len = 0;
+    if (!net_buffer_append(&c->tx, hb->prefix, strlen(hb->prefix))) return 0;
+    for (size_t i = 0; i < hb->count; i++) {
+        const uint8_t *p = hb->parts[i].iov_base;
+        size_t left = hb->parts[i].iov_len;
+        while (left > 0) {
+            size_t room = c->tx.len < RPC_STREAM_CHUNK ? (RPC_STREAM_CHUNK - c->tx.len) / 2 : 0;
+            if (room == 0) {
+                if (!send_chunk(c, head, pending_head, 0)) return 0;
+                pending_head = 0;
+                continue;
+            }
+            size_t n = left < room ? left : room;
+            hex_encode(p, n, c->tx.data + c->tx.len);
+            c->tx.len += n * 2;
+            p += n;
+            left -= n;
+        }
+    }
+    if (!net_buffer_append(&c->tx, hb->suffix, strlen(hb->suffix))) return 0;
+    return send_chunk(c, head, pending_head, 1);
+}
+
+int rpc_post_hex(rpc_client *c, const char *prefix, const struct iovec *parts, size_t count, const char *suffix) {
+    hex_body hb = {prefix, parts, count, suffix};
+    return exchange(c, send_hex, &hb);
+}
+
+int rpc_batch_item(const rpc_client *c, long long id, json_message *out) {
+    json_view all = {c->body.data, c->body.len};
+    memset(out, 0, sizeof(*out));
+    while (all.len > 0 && (*all.p == ' ' || *all.p == '\n' || *all.p == '\r' || *all.p == '\t')) {
+        all.p++;
+        all.len--;
+    }
+    if (all.len == 0) return 0;
+    if (*all.p == '{') {
+        return json_parse_message(all.p, all.len, out) && json_view_int(out->id) == id;
+    }
+    json_iter it;
+    json_view item;
+    if (!json_iter_init(&it, all)) return 0;
+    while (json_iter_next(&it, &item)) {
+        if (json_parse_message(item.p, item.len, out) && json_view_int(out->id) == id) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef RPC_H
+#define RPC_H
+
+#include <signal.h>
+#include <stddef.h>
+#include "json.h"
+#include "net.h"
+
+// Bytes of hex per chunk of a streamed request body.
+#define RPC_STREAM_CHUNK 65536
+// Send/receive timeout of every RPC socket, so a hung node fails the call
+// and the next node can be tried. Long polls wait on *cancel instead.
+#define RPC_TIMEOUT_SECS 10
+
+// JSON-RPC over a persistent HTTP/1.1 connection. Responses may use
+// Content-Length, chunked encoding or close-delimited bodies and have no
+// size limit. Not thread safe; use one client per thread.
+typedef struct {
+    char host[256];
+    char port[16];
+    char auth[512];  // base64 user:password
+    int sock;
+    net_buffer rx;    // raw bytes from the socket
+    net_buffer tx;    // request being sent
+    net_buffer body;  // decoded body of the last response, NUL-terminated
+    size_t requests;
+    size_t connects;
+    double last_latency;
+    double sent_at;   // CLOCK_MONOTONIC when the last request was fully written
+    int timed_out;    // the last exchange hit RPC_TIMEOUT_SECS
+    // Optional: a blocked read gives up once *cancel is set (checked twice
+    // a second). Meant for long-poll requests.
+    const volatile sig_atomic_t *cancel;
+} rpc_client;
+
+void rpc_init(rpc_client *c, const char *host, const char *port, const char *user, const char *password);
+void rpc_close(rpc_client *c);
+void rpc_free(rpc_client *c);
+
+// POSTs `body` and waits for the reply. A kept-alive connection that turns
+// out to be closed is reopened once. On success the body is in c->body
+// (mutable, valid until the next request).
+int rpc_post(rpc_client *c, const char *body, size_t body_len);
+
+// POSTs prefix + hex(parts...) + suffix with chunked encoding. The hex is
+// produced chunk by chunk from the binary parts and gathered to the socket
+// with the chunk framing, so the body is never held in memory whole.
+int rpc_post_hex(rpc_client *c, const char *prefix, const struct iovec *parts, size_t count, const char *suffix);
+
+// Finds the member of a batch reply (or a single reply) with the given id.
+int rpc_batch_item(const rpc_client *c, long long id, json_message *out);
+
+#endif
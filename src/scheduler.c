@@ -0,0 +1,118 @@
+#include "scheduler.h"
+
+#include <math.h>
+#include <string.h>
+
+#define RATE_EWMA_ALPHA 0.3
+
+void sched_init(weighted_scheduler *s, double half_life_secs, double now) {
+    memset(s, 0, sizeof(*s));
+    s->half_life = half_life_secs > 0.0 ? half_life_secs : 30.0;
+    s->last_decay = now;
+    s->last_rate = now;
+}
+
+int sched_add(weighted_scheduler *s, double weight) {
+    if (s->count >= SCHED_MAX_SLOTS || weight <= 0.0) return -1;
+    sched_slot *slot = &s->slots[s->count];
+    memset(slot, 0, sizeof(*slot));
+    slot->weight = weight;
+    return (int)s->count++;
+}
+
+static double active_weight(const weighted_scheduler *s) {
+    double total = 0.0;
+    for (size_t i = 0; i < s->count; i++) {
+        if (s->slots[i].active) total += s->slots[i].weight;
+    }
+    return total;
+}
+
+static double active_credit(const weighted_scheduler *s) {
+    double total = 0.0;
+    for (size_t i = 0; i < s->count; i++) {
+        if (s->slots[i].active) total += s->slots[i].credit;
+    }
+    return total;
+}
+
+void sched_set_active(weighted_scheduler *s, int slot, int active) {
+    if (slot < 0 || (size_t)slot >= s->count) return;
+    sched_slot *sl = &s->slots[slot];
+    if (sl->active == active) return;
+    if (active) {
+        // Join at the fair share of current credit so a returning slot does
+        // not monopolise the workers to "catch up" on time it was offline.
+        double weights = active_weight(s) + sl->weight;
+        double credit = active_credit(s);
+        sl->credit = weights > 0.0 ? credit * sl->weight / weights : 0.0;
+    }
+    sl->active = active;
+}
+
+static void decay(weighted_scheduler *s, double now) {
+    double dt = now - s->last_decay;
+    if (dt <= 0.0) return;
+    double factor = pow(0.5, dt / s->half_life);
+    for (size_t i = 0; i < s->count; i++) s->slots[i].credit *= factor;
+    s->last_decay = now;
+}
+
+int sched_pick(weighted_scheduler *s, double now) {
+    decay(s, now);
+    double weights = active_weight(s);
+    if (weights <= 0.0) return -1;
+    double credit = active_credit(s);
+
+    int best = -1;
+    double best_deficit = 0.0;
+    for (size_t i = 0; i < s->count; i++) {
+        const sched_slot *sl = &s->slots[i];
+        if (!sl->active) continue;
+        double deficit = credit * sl->weight / weights - sl->credit;
+        if (best < 0 || deficit > best_deficit) {
+            best = (int)i;
+            best_deficit = deficit;
+        }
+    }
+    return best;
+}
+
+void sched_charge(weighted_scheduler *s, int slot, double hashes) {
+    if (slot < 0 || (size_t)slot >= s->count) return;
+    s->slots[slot].credit += hashes;
+}
+
+void sched_complete(weighted_scheduler *s, int slot, uint64_t planned, uint64_t done) {
+    if (slot < 0 || (size_t)slot >= s->count) return;
+    sched_slot *sl = &s->slots[slot];
+    sl->credit += (double)done - (double)planned;
+    if (sl->credit < 0.0) sl->credit = 0.0;
+    sl->hashes += done;
+}
+
+void sched_update_rates(weighted_scheduler *s, double now) {
+    double dt = now - s->last_rate;
+    if (dt <= 0.0) return;
+    for (size_t i = 0; i < s->count; i++) {
+        sched_slot *sl = &s->slots[i];
+        double sample = (double)(sl->hashes - sl->rate_mark) / dt;
+        sl->rate = sl->rate > 0.0 ? sl->rate + RATE_EWMA_ALPHA * (sample - sl->rate) : sample;
+        sl->rate_mark = sl->hashes;
+    }
+    s->last_rate = now;
+}
+
+double sched_weight_share(const weighted_scheduler *s, int slot) {
+    double total = 0.0;
+    for (size_t i = 0; i < s->count; i++) total += s->slots[i].weight;
+    if (total <= 0.0 || slot < 0 || (size_t)slot >= s->count) return 0.0;
+    return s->slots[slot].weight / total;
+}
+
+double sched_rate_share(const weighted_scheduler *s, int slot) {
+    double total = 0.0;
+    for (size_t i = 0; i < s->count; i++) total += s->slots[i].rate;
+    if (total <= 0.0 || slot < 0 || (size_t)slot >= s->count) return 0.0;
+    return s->slots[slot].rate / total;
+}
@@ -0,0 +1,38 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCHED_MAX_SLOTS 8
+
+typedef struct {
+    double weight;
+    int active;
+    double credit;
+    uint64_t hashes;
+    uint64_t rate_mark;
+    double rate;
+} sched_slot;
+
+// Deficit scheduler: hands batches to the slot that is furthest below its
+// weighted share of recent (exponentially decayed) hashes. Not thread safe.
+typedef struct {
+    sched_slot slots[SCHED_MAX_SLOTS];
+    size_t count;
+    double half_life;
+    double last_decay;
+    double last_rate;
+} weighted_scheduler;
+
+void sched_init(weighted_scheduler *s, double half_life_secs, double now);
+int sched_add(weighted_scheduler *s, double weight);
+void sched_set_active(weighted_scheduler *s, int slot, int active);
+int sched_pick(weighted_scheduler *s, double now);
+void sched_charge(weighted_scheduler *s, int slot, double hashes);
+void sched_complete(weighted_scheduler *s, int slot, uint64_t planned, uint64_t done);
+void sched_update_rates(weighted_scheduler *s, double now);
+double sched_weight_share(const weighted_scheduler *s, int slot);
+double sched_rate_share(const weighted_scheduler *s, int slot);
+
+#endif
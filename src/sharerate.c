@@ -0,0 +1,99 @@
+#include "sharerate.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "bitcoin/block.h"
+#include "hex.h"
+
+#define SHARE_RATE_INTERVAL 60.0
+#define SHARE_RATE_MAX_BACKOFF 16.0
+// Suggestions within this factor of the current difficulty are not worth a message.
+#define SHARE_RATE_DEADBAND 2.0
+
+void share_rate_init(share_rate_ctl *c, double target_spm) {
+    memset(c, 0, sizeof(*c));
+    c->target_spm = target_spm;
+    c->method = target_spm > 0.0 ? SUGGEST_DIFFICULTY : SUGGEST_NONE;
+    c->backoff = 1.0;
+}
+
+double share_rate_expected_spm(double hashrate, double diff) {
+    if (diff <= 0.0) return 0.0;
+    return hashrate * 60.0 / (diff * 4294967296.0);
+}
+
+static int near(double a, double b) {
+    double ratio = a / b;
+    return ratio > 0.8 && ratio < 1.25;
+}
+
+// The pool's vardiff disagrees: keep its value and wait longer before
+// suggesting again, unless our hashrate changes a lot.
+static void pool_overrode(share_rate_ctl *c) {
+    c->overridden = 1;
+    c->overrides++;
+    c->backoff *= 2.0;
+    if (c->backoff > SHARE_RATE_MAX_BACKOFF) c->backoff = SHARE_RATE_MAX_BACKOFF;
+}
+
+void share_rate_pool_difficulty(share_rate_ctl *c, double diff) {
+    c->pool_diff = diff;
+    if (c->suggested <= 0.0) return;
+    if (near(diff, c->suggested)) {
+        c->overridden = 0;
+        c->backoff = 1.0;
+    } else {
+        pool_overrode(c);
+    }
+}
+
+int share_rate_decide(share_rate_ctl *c, double hashrate, double now, double *out_diff) {
+    if (c->method == SUGGEST_NONE || c->target_spm <= 0.0 || hashrate <= 0.0) return 0;
+    if (c->suggestions > 0 && now - c->suggested_at < SHARE_RATE_INTERVAL * c->backoff) return 0;
+    // A suggestion the pool silently ignored counts as an override too.
+    if (c->suggestions > 0 && !c->overridden && c->pool_diff > 0.0 && !near(c->pool_diff, c->suggested)) {
+        pool_overrode(c);
+        return 0;
+    }
+
+    double desired = hashrate * 60.0 / (c->target_spm * 4294967296.0);
+    if (c->pool_diff > 0.0) {
+        double ratio = desired / c->pool_diff;
+        if (ratio > 1.0 / SHARE_RATE_DEADBAND && ratio < SHARE_RATE_DEADBAND) return 0;
+    }
+    if (c->overridden && c->suggested_rate > 0.0 && fabs(log2(hashrate / c->suggested_rate)) < 1.0) return 0;
+
+    c->suggested = desired;
+    c->suggested_at = now;
+    c->suggested_rate = hashrate;
+    c->suggestions++;
+    *out_diff = desired;
+    return 1;
+}
+
+void share_rate_unsupported(share_rate_ctl *c) {
+    if (c->method == SUGGEST_DIFFICULTY) {
+        c->method = SUGGEST_TARGET;
+        c->suggestions = 0;  // retry right away with the other method
+    } else {
+        c->method = SUGGEST_NONE;
+    }
+}
+
+int share_rate_format(const share_rate_ctl *c, int id, double diff, char *out, size_t cap) {
+    if (c->method == SUGGEST_DIFFICULTY) {
+        snprintf(out, cap, "{\"id\":%d,\"method\":\"mining.suggest_difficulty\",\"params\":[%.10g]}", id, diff);
+        return 1;
+    }
+    if (c->method != SUGGEST_TARGET || cap < 128) return 0;
+    uint8_t target[32];
+    if (!bitcoin_target_from_difficulty(diff, target)) return 0;
+    int n = snprintf(out, cap, "{\"id\":%d,\"method\":\"mining.suggest_target\",\"params\":[\"", id);
+    if (n < 0 || (size_t)n + 64 + 4 > cap) return 0;
+    hex_encode(target, 32, out + n);
+    n += 64;
+    snprintf(out + n, cap - (size_t)n, "\"]}");
+    return 1;
+}
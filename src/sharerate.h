@@ -0,0 +1,38 @@
+#ifndef SHARERATE_H
+#define SHARERATE_H
+
+#include <stddef.h>
+
+// Picks a share difficulty from the measured hashrate so the pool sees
+// roughly target_spm shares per minute, and backs off when the pool's own
+// vardiff keeps answering with a different value. Not thread safe.
+
+typedef enum {
+    SUGGEST_DIFFICULTY,
+    SUGGEST_TARGET,
+    SUGGEST_NONE
+} suggest_method;
+
+typedef struct {
+    double target_spm;
+    suggest_method method;
+    double pool_diff;
+    double suggested;
+    double suggested_at;
+    double suggested_rate;
+    double backoff;
+    int overridden;
+    unsigned suggestions;
+    unsigned overrides;
+} share_rate_ctl;
+
+void share_rate_init(share_rate_ctl *c, double target_spm);
+void share_rate_pool_difficulty(share_rate_ctl *c, double diff);
+int share_rate_decide(share_rate_ctl *c, double hashrate, double now, double *out_diff);
+// The pool rejected the last suggestion method; fall back to the next one.
+void share_rate_unsupported(share_rate_ctl *c);
+double share_rate_expected_spm(double hashrate, double diff);
+// JSON-RPC line for the current method; returns 0 if none is left.
+int share_rate_format(const share_rate_ctl *c, int id, double diff, char *out, size_t cap);
+
+#endif
@@ -0,0 +1,57 @@
+#include "shareset.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int share_set_grow(share_set *set) {
+    size_t cap = set->cap ? set->cap * 2 : 1024;
+    uint64_t *keys = calloc(cap, sizeof(*keys));
+    if (!keys) return 0;
+    for (size_t i = 0; i < set->cap; i++) {
+        uint64_t k = set->keys[i];
+        if (!k) continue;
+        size_t j = (size_t)(k % cap);
+        while (keys[j]) j = (j + 1) % cap;
+        keys[j] = k;
+    }
+    free(set->keys);
+    set->keys = keys;
+    set->cap = cap;
+    return 1;
+}
+
+int share_set_insert(share_set *set, uint64_t key) {
+    // Zero marks an empty slot.
+    if (key == 0) key = 1;
+    if ((set->count + 1) * 2 > set->cap && !share_set_grow(set)) return 1;
+    size_t j = (size_t)(key % set->cap);
+    while (set->keys[j]) {
+        if (set->keys[j] == key) return 0;
+        j = (j + 1) % set->cap;
+    }
+    set->keys[j] = key;
+    set->count++;
+    return 1;
+}
+
+void share_set_clear(share_set *set) {
+    if (set->keys) memset(set->keys, 0, set->cap * sizeof(*set->keys));
+    set->count = 0;
+}
+
+void share_set_free(share_set *set) {
+    free(set->keys);
+    set->keys = NULL;
+    set->cap = 0;
+    set->count = 0;
+}
+
+uint64_t share_key(const void *parts[], const size_t lens[], size_t count) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t p = 0; p < count; p++) {
+        const uint8_t *b = parts[p];
+        for (size_t i = 0; i < lens[p]; i++) h = (h ^ b[i]) * 1099511628211ull;
+        h = (h ^ '|') * 1099511628211ull;
+    }
+    return h;
+}
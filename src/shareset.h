@@ -0,0 +1,25 @@
+#ifndef SHARESET_H
+#define SHARESET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Open-addressing set of 64-bit share keys, used to catch a
+// (job, extranonce2, ntime, nonce) tuple that was already submitted.
+// Not thread safe.
+typedef struct {
+    uint64_t *keys;
+    size_t cap;
+    size_t count;
+} share_set;
+
+// Returns 1 when the key is new, 0 when it was already present. On
+// allocation failure the key is treated as new.
+int share_set_insert(share_set *set, uint64_t key);
+void share_set_clear(share_set *set);
+void share_set_free(share_set *set);
+
+// FNV-1a over the tuple fields, separated so "ab"+"c" != "a"+"bc".
+uint64_t share_key(const void *parts[], const size_t lens[], size_t count);
+
+#endif
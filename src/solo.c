@@ -7,40 +7,20 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <netdb.h>
 #include <unistd.h>
 #include <time.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "coins/registry.h"
 #include "bitcoin/block.h"
-
-static int connect_tcp(const char *host, const char *port) {
-    struct addrinfo hints;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-
-    struct addrinfo *res = NULL;
-    int rc = getaddrinfo(host, port, &hints, &res);
-    if (rc != 0) {
-        fprintf(stderr, "[solo] getaddrinfo: %s\n", gai_strerror(rc));
-        return -1;
-    }
-
-    int sock = -1;
-    for (struct addrinfo *p = res; p != NULL; p = p->ai_next) {
-        sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-        if (sock == -1) continue;
-        if (connect(sock, p->ai_addr, p->ai_addrlen) == 0) break;
-        close(sock);
-        sock = -1;
-    }
-    freeaddrinfo(res);
-    if (sock == -1) {
-        fprintf(stderr, "[solo] nao foi possivel conectar a %s:%s\n", host, port);
-    }
-    return sock;
-}
+#include "bitcoin/p2p.h"
+#include "bitcoin/template.h"
+#include "hex.h"
+#include "json.h"
+#include "rpc.h"
+#include "sha256.h"
+#include "workers.h"
 
 static volatile sig_atomic_t stop_flag = 0;
 
@@ -49,205 +29,6 @@ static void handle_stop(int sig) {
     stop_flag = 1;
 }
 
-static void base64_encode(const unsigned char *in, size_t in_len, char *out, size_t out_len) {
-    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    size_t j = 0;
-    for (size_t i = 0; i < in_len && j + 4 < out_len; i += 3) {
-        unsigned val = in[i] << 16;
-        if (i + 1 < in_len) val |= in[i + 1] << 8;
-        if (i + 2 < in_len) val |= in[i + 2];
-
-        out[j++] = table[(val >> 18) & 0x3F];
-        out[j++] = table[(val >> 12) & 0x3F];
-        out[j++] = (i + 1 < in_len) ? table[(val >> 6) & 0x3F] : '=';
-        out[j++] = (i + 2 < in_len) ? table[val & 0x3F] : '=';
-    }
-    out[j] = '\0';
-}
-
-static void hex_from_bytes(const uint8_t *buf, size_t len, char *out, size_t out_len) {
-    static const char hex[] = "0123456789abcdef";
-    if (out_len < len * 2 + 1) return;
-    for (size_t i = 0; i < len; i++) {
-        out[i * 2] = hex[(buf[i] >> 4) & 0xF];
-        out[i * 2 + 1] = hex[buf[i] & 0xF];
-    }
-    out[len * 2] = '\0';
-}
-
-static int recv_all(int sock, char *buf, size_t buf_size) {
-    size_t total = 0;
-    while (total + 1 < buf_size) {
-        ssize_t n = recv(sock, buf + total, buf_size - total - 1, 0);
-        if (n <= 0) break;
-        total += (size_t)n;
-        if (strstr(buf, "\r\n\r\n") && strstr(buf, "\"result\"")) {
-            break;
-        }
-    }
-    buf[total] = '\0';
-    return (int)total;
-}
-
-static int rpc_call(int sock, const char *host, const char *user, const char *pass, const char *body, char *out, size_t out_len) {
-    char auth_raw[256];
-    snprintf(auth_raw, sizeof(auth_raw), "%s:%s", user ? user : "", pass ? pass : "");
-    char auth_b64[512];
-    base64_encode((const unsigned char*)auth_raw, strlen(auth_raw), auth_b64, sizeof(auth_b64));
-
-    char req[1024];
-    snprintf(req, sizeof(req),
-             "POST / HTTP/1.1\r\n"
-             "Host: %s\r\n"
-             "Authorization: Basic %s\r\n"
-             "Content-Type: application/json\r\n"
-             "Content-Length: %zu\r\n"
-             "Connection: close\r\n"
-             "\r\n"
-             "%s",
-             host, auth_b64, strlen(body), body);
-
-    if (send(sock, req, strlen(req), 0) < 0) {
-        return 0;
-    }
-    if (recv_all(sock, out, out_len) <= 0) {
-        return 0;
-    }
-    return 1;
-}
-
-typedef struct {
-    char prev_hash[128];
-    char bits[16];
-    char target[128];
-    int version;
-    uint32_t curtime;
-    char coinbase_tx[4096];
-    char tx_data[512][4096];
-    char txid[512][128];
-    size_t tx_count;
-} block_template;
-
-static void skip_ws(const char **p) {
-    while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r') (*p)++;
-}
-
-static int parse_json_string(const char **p, char *out, size_t out_size) {
-    const char *s = *p;
-    skip_ws(&s);
-    if (*s != '\"') return 0;
-    s++;
-    size_t len = 0;
-    while (*s && *s != '\"') {
-        if (len + 1 < out_size) {
-            out[len++] = *s;
-        }
-        s++;
-    }
-    if (*s != '\"') return 0;
-    out[len] = '\0';
-    s++;
-    *p = s;
-    return 1;
-}
-
-static int parse_json_int(const char *src, const char *key, int *out) {
-    const char *p = strstr(src, key);
-    if (!p) return 0;
-    p = strchr(p, ':');
-    if (!p) return 0;
-    p++;
-    skip_ws(&p);
-    *out = atoi(p);
-    return 1;
-}
-
-static int parse_json_u32(const char *src, const char *key, uint32_t *out) {
-    const char *p = strstr(src, key);
-    if (!p) return 0;
-    p = strchr(p, ':');
-    if (!p) return 0;
-    p++;
-    skip_ws(&p);
-    *out = (uint32_t)strtoul(p, NULL, 10);
-    return 1;
-}
-
-static int parse_json_string_key(const char *src, const char *key, char *out, size_t out_len) {
-    const char *p = strstr(src, key);
-    if (!p) return 0;
-    p = strchr(p, ':');
-    if (!p) return 0;
-    p++;
-    return parse_json_string(&p, out, out_len);
-}
-
-static int parse_coinbase_tx(const char *src, char *out, size_t out_len) {
-    const char *p = strstr(src, "\"coinbasetxn\"");
-    if (!p) return 0;
-    p = strstr(p, "\"data\"");
-    if (!p) return 0;
-    p = strchr(p, ':');
-    if (!p) return 0;
-    p++;
-    return parse_json_string(&p, out, out_len);
-}
-
-static size_t parse_transactions(const char *src, char tx_data[][4096], char txid[][128], size_t max) {
-    const char *p = strstr(src, "\"transactions\"");
-    if (!p) return 0;
-    p = strchr(p, '[');
-    if (!p) return 0;
-    p++;
-
-    size_t count = 0;
-    while (*p && *p != ']') {
-        skip_ws(&p);
-        if (*p == ']') break;
-        if (*p != '{') {
-            p++;
-            continue;
-        }
-        const char *obj = p;
-        const char *end = strchr(obj, '}');
-        if (!end) break;
-
-        char tx_hex[4096] = {0};
-        char txid_hex[128] = {0};
-
-        const char *q = obj;
-        if (parse_json_string_key(q, "\"data\"", tx_hex, sizeof(tx_hex)) &&
-            parse_json_string_key(q, "\"txid\"", txid_hex, sizeof(txid_hex))) {
-            if (count < max) {
-                strncpy(tx_data[count], tx_hex, 4095);
-                tx_data[count][4095] = '\0';
-                strncpy(txid[count], txid_hex, 127);
-                txid[count][127] = '\0';
-                count++;
-            }
-        }
-
-        p = end + 1;
-    }
-
-    return count;
-}
-
-static int parse_block_template(const char *response, block_template *out) {
-    if (!response || !out) return 0;
-    memset(out, 0, sizeof(*out));
-
-    if (!parse_json_string_key(response, "\"previousblockhash\"", out->prev_hash, sizeof(out->prev_hash))) return 0;
-    if (!parse_json_string_key(response, "\"bits\"", out->bits, sizeof(out->bits))) return 0;
-    if (!parse_json_string_key(response, "\"target\"", out->target, sizeof(out->target))) return 0;
-    if (!parse_json_int(response, "\"version\"", &out->version)) return 0;
-    if (!parse_json_u32(response, "\"curtime\"", &out->curtime)) return 0;
-    if (!parse_coinbase_tx(response, out->coinbase_tx, sizeof(out->coinbase_tx))) return 0;
-
-    out->tx_count = parse_transactions(response, out->tx_data, out->txid, 512);
-    return 1;
-}
-
 static void reverse_bytes(uint8_t *buf, size_t len) {
     for (size_t i = 0; i < len / 2; i++) {
         uint8_t tmp = buf[i];
@@ -256,43 +37,6 @@ static void reverse_bytes(uint8_t *buf, size_t len) {
     }
 }
 
-static int build_merkle_root(const block_template *tmpl, uint8_t out[32]) {
-    if (!tmpl || !out) return 0;
-    uint8_t hashes[513][32];
-    size_t hash_count = 0;
-
-    uint8_t coinbase_bytes[4096];
-    size_t coinbase_len = 0;
-    if (!hex_to_bytes(tmpl->coinbase_tx, coinbase_bytes, sizeof(coinbase_bytes), &coinbase_len)) return 0;
-    double_sha256(coinbase_bytes, coinbase_len, hashes[hash_count++]);
-
-    for (size_t i = 0; i < tmpl->tx_count && hash_count < 513; i++) {
-        size_t len = 0;
-        if (!hex_to_bytes(tmpl->txid[i], hashes[hash_count], sizeof(hashes[0]), &len) || len != 32) return 0;
-        reverse_bytes(hashes[hash_count], 32);
-        hash_count++;
-    }
-
-    if (hash_count == 0) return 0;
-
-    uint8_t tmp[64];
-    while (hash_count > 1) {
-        size_t next_count = 0;
-        for (size_t i = 0; i < hash_count; i += 2) {
-            const uint8_t *left = hashes[i];
-            const uint8_t *right = (i + 1 < hash_count) ? hashes[i + 1] : hashes[i];
-            memcpy(tmp, left, 32);
-            memcpy(tmp + 32, right, 32);
-            double_sha256(tmp, sizeof(tmp), hashes[next_count]);
-            next_count++;
-        }
-        hash_count = next_count;
-    }
-
-    memcpy(out, hashes[0], 32);
-    return 1;
-}
-
 static void uint32_to_le(uint32_t v, uint8_t out[4]) {
     out[0] = (uint8_t)(v & 0xFF);
     out[1] = (uint8_t)((v >> 8) & 0xFF);
@@ -307,8 +51,8 @@ static int build_header(const block_template *tmpl, const uint8_t merkle_root[32
     uint8_t time_le[4];
     size_t len = 0;
 
-    if (!hex_to_bytes(tmpl->prev_hash, prev, sizeof(prev), &len) || len != 32) return 0;
-    if (!hex_to_bytes(tmpl->bits, bits, sizeof(bits), &len) || len != 4) return 0;
+    if (!hex_decode(tmpl->prev_hash, 64, prev, sizeof(prev), &len) || len != 32) return 0;
+    if (!hex_decode(tmpl->bits, 8, bits, sizeof(bits), &len) || len != 4) return 0;
 
     uint32_to_le((uint32_t)tmpl->version, version_le);
     uint32_to_le(tmpl->curtime, time_le);
@@ -316,13 +60,10 @@ static int build_header(const block_template *tmpl, const uint8_t merkle_root[32
     reverse_bytes(prev, 32);
     reverse_bytes(bits, 4);
 
-    uint8_t merkle_le[32];
-    memcpy(merkle_le, merkle_root, 32);
-    reverse_bytes(merkle_le, 32);
-
     memcpy(out, version_le, 4);
     memcpy(out + 4, prev, 32);
-    memcpy(out + 36, merkle_le, 32);
+    // The root is already in internal order, as the header stores it.
+    memcpy(out + 36, merkle_root, 32);
     memcpy(out + 68, time_le, 4);
     memcpy(out + 72, bits, 4);
     uint32_to_le(nonce, out + 76);
@@ -331,7 +72,7 @@ static int build_header(const block_template *tmpl, const uint8_t merkle_root[32
 
 static int target_from_hex(const char *hex, uint8_t out[32]) {
     size_t len = 0;
-    if (!hex_to_bytes(hex, out, 32, &len) || len != 32) return 0;
+    if (!hex_decode(hex, 64, out, 32, &len) || len != 32) return 0;
     return 1;
 }
 
@@ -339,69 +80,727 @@ static int hash_meets_target(const uint8_t hash[32], const uint8_t target[32]) {
     return memcmp(hash, target, 32) <= 0;
 }
 
-static void append_varint(uint64_t value, uint8_t *out, size_t *offset) {
-    if (value < 0xFD) {
-        out[(*offset)++] = (uint8_t)value;
-    } else if (value <= 0xFFFF) {
-        out[(*offset)++] = 0xFD;
-        out[(*offset)++] = (uint8_t)(value & 0xFF);
-        out[(*offset)++] = (uint8_t)((value >> 8) & 0xFF);
-    } else if (value <= 0xFFFFFFFF) {
-        out[(*offset)++] = 0xFE;
-        out[(*offset)++] = (uint8_t)(value & 0xFF);
-        out[(*offset)++] = (uint8_t)((value >> 8) & 0xFF);
-        out[(*offset)++] = (uint8_t)((value >> 16) & 0xFF);
-        out[(*offset)++] = (uint8_t)((value >> 24) & 0xFF);
+#define SOLO_BATCH_NONCES 65536u
+#define SOLO_MAX_FOUND 8
+// Released templates kept with their buffers for the next fetch.
+#define SOLO_SPARE_TEMPLATES 2
+
+// Extranonce bytes in a locally built coinbase. Work units are
+// (extranonce << 32 | nonce), handed out in batches.
+#define SOLO_EXTRANONCE_SIZE 4
+// Smoothing of per-node latencies; a failed call counts as this many seconds.
+#define SOLO_LATENCY_ALPHA 0.3
+#define SOLO_FAILURE_PENALTY 5.0
+
+// A parsed template ready for hashing. Shared by reference between the
+// workers; refs and work_next are guarded by the solo lock.
+typedef struct solo_template {
+    block_template tmpl;
+    uint8_t target[32];
+    uint64_t generation;
+    uint64_t work_next;
+    uint64_t work_end;
+    double fetched_at;
+    // When the node's answer reflected its tip: the request start, or the
+    // reply for a long poll (which returns on a change).
+    double tip_at;
+    // Coinbase-only stand-in built from a new tip before its template.
+    int empty;
+    int node;
+    int refs;
+    struct solo_template *next_spare;
+} solo_template;
+
+typedef struct {
+    solo_template *tmpl;
+    uint8_t header[80];
+    uint8_t extranonce[SOLO_EXTRANONCE_SIZE];
+    uint32_t nonce;
+    double found_at;
+} solo_found;
+
+struct solo_state;
+
+// One RPC backend. `rpc` belongs to the main thread (refreshes and
+// submits); long poll and tip watch open their own connections. Stats and
+// longpollid are guarded by the solo lock.
+typedef struct {
+    struct solo_state *st;
+    int index;
+    char name[280];
+    solo_node_options opts;
+    rpc_client rpc;
+    char longpollid[256];
+    double template_latency;
+    size_t templates;
+    size_t failures;
+    size_t tips_first;
+    // Parent of the newest template this node served, by tip_at.
+    char parent[65];
+    double parent_at;
+    double submit_latency;
+    size_t submits_ok;
+    size_t submits_failed;
+    // Set by the per-node submit thread.
+    const solo_found *submit;
+    int submit_ok;
+    int submit_sent;
+    double submit_sent_at;
+} solo_node;
+
+typedef struct solo_state {
+    const solo_options *opts;
+    solo_node nodes[SOLO_MAX_NODES];
+    int node_count;
+    uint8_t payout_script[128];
+    size_t payout_len;
+    // Optional P2P path to the node, tried alongside submitblock.
+    p2p_peer p2p;
+    int use_p2p;
+    const solo_found *p2p_found;
+    int p2p_sent;
+    size_t p2p_submits;
+    size_t p2p_failed;
+    double p2p_secs;
+    double p2p_max;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    solo_template *current;
+    uint64_t generation;
+    // First generation on the current tip; older batches are stale.
+    uint64_t tip_generation;
+    _Atomic uint64_t abort_before;
+    int wake_main;
+    solo_found found[SOLO_MAX_FOUND];
+    size_t found_count;
+    solo_template *spare;
+    size_t spare_count;
+
+    uint64_t hashes;
+    uint64_t stale_hashes;
+    double stale_secs;
+    size_t templates;
+    size_t tip_changes;
+    size_t longpoll_returns;
+    size_t submits;
+    double submit_secs;
+    double submit_max;
+
+    // Tip switches: when the current tip was seen, and how long until the
+    // first batch on it started.
+    int fetch_now;
+    int fetch_node;
+    // Highest tip reported by getbestblockhash and when it was first seen.
+    char seen_hash[65];
+    long long seen_height;
+    double seen_at;
+    double tip_detected_at;
+    int tip_hashed;
+    double first_hash_secs;
+    double first_hash_last;
+    size_t first_hash_count;
+    size_t speculative;
+    double empty_since;
+    double empty_secs;
+    double start;
+} solo_state;
+
+static double mono_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Caller holds the solo lock.
+static void template_release(solo_state *st, solo_template *t) {
+    if (!t || --t->refs > 0) return;
+    if (st->spare_count < SOLO_SPARE_TEMPLATES) {
+        t->next_spare = st->spare;
+        st->spare = t;
+        st->spare_count++;
     } else {
-        out[(*offset)++] = 0xFF;
-        for (int i = 0; i < 8; i++) {
-            out[(*offset)++] = (uint8_t)((value >> (i * 8)) & 0xFF);
+        block_template_free(&t->tmpl);
+        free(t);
+    }
+}
+
+static void note_latency(double *ewma, double sample) {
+    *ewma = *ewma > 0.0 ? SOLO_LATENCY_ALPHA * sample + (1.0 - SOLO_LATENCY_ALPHA) * *ewma : sample;
+}
+
+// Fetches and prepares a template from `node` over `rpc` (the node's main
+// client or a thread's own). `body` is a getblocktemplate request, alone or
+// in a batch, answered under id 1.
+static solo_template *fetch_template(solo_node *node, rpc_client *rpc, const char *body, const char *what) {
+    solo_state *st = node->st;
+    json_message gbt = {0};
+    double asked_at = mono_seconds();
+    int ok = rpc_post(rpc, body, strlen(body));
+    if (!ok) {
+        if (!stop_flag) fprintf(stderr, "[solo] %s: falha ao chamar getblocktemplate (%s)\n", node->name, what);
+    } else if (!rpc_batch_item(rpc, 1, &gbt) || !gbt.result.p || json_view_is(gbt.result, "null")) {
+        if (gbt.error.p) {
+            fprintf(stderr, "[solo] %s: getblocktemplate sem resultado: %.*s\n", node->name, (int)gbt.error.len, gbt.error.p);
+        } else {
+            fprintf(stderr, "[solo] %s: resposta invalida ao getblocktemplate (%zu bytes)\n", node->name, rpc->body.len);
         }
+        ok = 0;
+    }
+    pthread_mutex_lock(&st->lock);
+    if (ok) {
+        // Long-poll replies measure the wait for a change, not the node.
+        if (!rpc->cancel) note_latency(&node->template_latency, rpc->last_latency);
+        node->templates++;
+    } else if (!stop_flag) {
+        node->failures++;
+        note_latency(&node->template_latency, SOLO_FAILURE_PENALTY);
+    }
+    solo_template *t = NULL;
+    if (ok && (t = st->spare) != NULL) {
+        st->spare = t->next_spare;
+        st->spare_count--;
     }
+    pthread_mutex_unlock(&st->lock);
+    if (!ok) return NULL;
+    if (!t && !(t = calloc(1, sizeof(*t)))) return NULL;
+    t->refs = 1;
+    t->work_next = 0;
+    t->empty = 0;
+    t->node = node->index;
+
+    // With a payout script the coinbase is always ours, so every template
+    // has an extranonce to roll; otherwise only the node's coinbasetxn works.
+    const char *problem = NULL;
+    if (!block_template_parse(&t->tmpl, gbt.result)) {
+        problem = "template invalido";
+    } else if (!target_from_hex(t->tmpl.target, t->target)) {
+        problem = "template com target invalido";
+    } else if (st->payout_len) {
+        if (!block_template_build_coinbase(&t->tmpl, st->payout_script, st->payout_len, SOLO_EXTRANONCE_SIZE))
+            problem = "falha ao montar coinbase (coinbasevalue ausente?)";
+    } else if (!t->tmpl.coinb1_len) {
+        problem = "node nao enviou coinbasetxn; informe --payout-script";
+    }
+    pthread_mutex_lock(&st->lock);
+    if (problem) {
+        template_release(st, t);
+    } else {
+        memcpy(node->longpollid, t->tmpl.longpollid, sizeof(node->longpollid));
+    }
+    pthread_mutex_unlock(&st->lock);
+    if (problem) {
+        fprintf(stderr, "[solo] %s: %s\n", node->name, problem);
+        return NULL;
+    }
+    t->work_end = t->tmpl.extranonce_size ? 0xFFFFFFFF00000000ull : 0x100000000ull;
+    t->fetched_at = mono_seconds();
+    t->tip_at = rpc->cancel ? t->fetched_at : asked_at;
+    printf("[solo] template de %s (%s) em %.1fms: %zu bytes, txs=%zu, altura=%u\n", node->name,
+           what, 1000.0 * rpc->last_latency, rpc->body.len, t->tmpl.tx_count + 1, t->tmpl.height);
+    return t;
 }
 
-static int build_block(const block_template *tmpl, const uint8_t header[80], uint8_t *out, size_t out_cap, size_t *out_len) {
-    uint8_t coinbase_bytes[4096];
-    size_t coinbase_len = 0;
-    if (!hex_to_bytes(tmpl->coinbase_tx, coinbase_bytes, sizeof(coinbase_bytes), &coinbase_len)) return 0;
+// Swaps the template the workers hash. A new parent aborts batches on the
+// old one right away; a refresh on the same tip lets them finish. With
+// several nodes the first template for a height wins: lower heights (a
+// fetch that raced a tip change) and other parents at the same height are
+// dropped, and so are same-tip results when `same_tip` is 0 (a slower
+// node's long poll). A same-height parent is a reorg, not a race, when it
+// comes from the node behind the current template or matches the tip
+// watcher's best block; a parent older than one the node already served is
+// always dropped. `detected_at` is when its tip was first seen.
+static int publish_template(solo_state *st, solo_template *t, double detected_at, int same_tip) {
+    pthread_mutex_lock(&st->lock);
+    solo_node *node = &st->nodes[t->node];
+    solo_template *old = st->current;
+    int new_tip = !old || strcmp(old->tmpl.prev_hash, t->tmpl.prev_hash) != 0;
+    int superseded = node->parent[0] && strcmp(node->parent, t->tmpl.prev_hash) != 0 && t->tip_at < node->parent_at;
+    if (!superseded && t->tip_at >= node->parent_at) {
+        memcpy(node->parent, t->tmpl.prev_hash, sizeof(node->parent));
+        node->parent_at = t->tip_at;
+    }
+    int reorg = old && (t->node == old->node || strcmp(st->seen_hash, t->tmpl.prev_hash) == 0);
+    int stale = superseded || (old && t->tmpl.height && old->tmpl.height &&
+                               (t->tmpl.height < old->tmpl.height ||
+                                (t->tmpl.height == old->tmpl.height && new_tip && !reorg)));
+    if (stale || (!new_tip && !same_tip && !old->empty)) {
+        template_release(st, t);
+        pthread_mutex_unlock(&st->lock);
+        return 0;
+    }
+    double now = mono_seconds();
+    t->generation = ++st->generation;
+    st->current = t;
+    st->templates++;
+    if (new_tip) {
+        st->tip_generation = t->generation;
+        atomic_store(&st->abort_before, t->generation);
+        if (old) st->tip_changes++;
+        // A tip the watcher reported was already credited to its node.
+        if (strcmp(st->seen_hash, t->tmpl.prev_hash) == 0) {
+            if (st->seen_at < detected_at) detected_at = st->seen_at;
+        } else if (old) {
+            st->nodes[t->node].tips_first++;
+        }
+        st->tip_detected_at = detected_at;
+        st->tip_hashed = 0;
+    }
+    if (old && old->empty) st->empty_secs += now - st->empty_since;
+    if (t->empty) {
+        st->speculative++;
+        st->empty_since = now;
+    }
+    template_release(st, old);
+    pthread_cond_broadcast(&st->changed);
+    pthread_mutex_unlock(&st->lock);
+    if (new_tip) {
+        printf("[solo] novo tip: %s via %s%s\n", t->tmpl.prev_hash, st->nodes[t->node].name,
+               t->empty ? " (bloco vazio ate o template chegar)" : "");
+    }
+    return 1;
+}
 
-    uint8_t tx_bytes[4096];
-    size_t tx_len[512] = {0};
-    for (size_t i = 0; i < tmpl->tx_count; i++) {
-        if (!hex_to_bytes(tmpl->tx_data[i], tx_bytes, sizeof(tx_bytes), &tx_len[i])) {
-            return 0;
+// A new tip seen by getbestblockhash gets a coinbase-only template at once,
+// so workers leave the old tip before the node has assembled the real
+// one. Not done across a retarget or halving, where bits or the subsidy
+// would have to be guessed.
+static void speculate_tip(solo_node *node, const char *best, long long best_height, double detected_at) {
+    solo_state *st = node->st;
+    int retarget = coin_retarget_interval(st->opts->coin);
+    int halving = coin_halving_interval(st->opts->coin);
+    pthread_mutex_lock(&st->lock);
+    solo_template *base = st->current;
+    if (!st->opts->speculate || !base || strcmp(base->tmpl.prev_hash, best) == 0 || !st->payout_len || retarget <= 1) {
+        pthread_mutex_unlock(&st->lock);
+        return;
+    }
+    // Only a tip directly on top of the one being mined can be extended.
+    uint32_t height = base->tmpl.height + 1;
+    if (best_height != (long long)base->tmpl.height || height % (uint32_t)retarget == 0 ||
+        (halving && height % (uint32_t)halving == 0)) {
+        pthread_mutex_unlock(&st->lock);
+        return;
+    }
+    base->refs++;
+    solo_template *t = st->spare;
+    if (t) {
+        st->spare = t->next_spare;
+        st->spare_count--;
+    }
+    pthread_mutex_unlock(&st->lock);
+
+    int ok = t || (t = calloc(1, sizeof(*t))) != NULL;
+    if (ok) {
+        t->refs = 1;
+        t->work_next = 0;
+        t->empty = 1;
+        t->node = node->index;
+        ok = block_template_make_empty(&t->tmpl, &base->tmpl, best, (uint32_t)time(NULL)) &&
+             block_template_build_coinbase(&t->tmpl, st->payout_script, st->payout_len, SOLO_EXTRANONCE_SIZE);
+        memcpy(t->target, base->target, sizeof(t->target));
+        t->work_end = 0xFFFFFFFF00000000ull;
+        t->fetched_at = mono_seconds();
+        t->tip_at = detected_at;
+    }
+    pthread_mutex_lock(&st->lock);
+    template_release(st, base);
+    if (!ok && t) template_release(st, t);
+    pthread_mutex_unlock(&st->lock);
+    if (ok) publish_template(st, t, detected_at, 1);
+}
+
+// Cheap tip check (hash and height in one batch) every --tip-poll-ms, on
+// every node. Catches new blocks before the long-poll reply (which carries
+// the whole template) or when the node has no long polling. The first node
+// to report a higher tip gets the full template request.
+static void *tip_watch_thread(void *arg) {
+    solo_node *node = arg;
+    solo_state *st = node->st;
+    rpc_client rpc;
+    rpc_init(&rpc, node->opts.host, node->opts.port, node->opts.user, node->opts.password);
+    char last[65] = "";
+    static const char body[] = "[{\"id\":1,\"method\":\"getbestblockhash\",\"params\":[]},"
+                               "{\"id\":2,\"method\":\"getblockcount\",\"params\":[]}]";
+    int poll_ms = st->opts->tip_poll_ms;
+    struct timespec pause = {poll_ms / 1000, (long)(poll_ms % 1000) * 1000000L};
+    while (!stop_flag) {
+        json_message hash_reply;
+        json_message count_reply;
+        char best[65];
+        if (rpc_post(&rpc, body, sizeof(body) - 1) && rpc_batch_item(&rpc, 1, &hash_reply) &&
+            rpc_batch_item(&rpc, 2, &count_reply) && json_view_copy(hash_reply.result, best, sizeof(best)) &&
+            strcmp(best, last) != 0) {
+            long long height = json_view_int(count_reply.result);
+            double detected_at = mono_seconds();
+            memcpy(last, best, sizeof(last));
+            pthread_mutex_lock(&st->lock);
+            // Same height on the node we mine from is a reorg of the tip.
+            int higher = height > st->seen_height ||
+                         (height == st->seen_height && st->current && st->current->node == node->index);
+            int changed = higher && st->current && strcmp(st->current->tmpl.prev_hash, best) != 0;
+            if (higher) {
+                memcpy(st->seen_hash, best, sizeof(st->seen_hash));
+                st->seen_height = height;
+                st->seen_at = detected_at;
+                if (changed) node->tips_first++;
+            }
+            pthread_mutex_unlock(&st->lock);
+            if (changed) {
+                speculate_tip(node, best, height, detected_at);
+                pthread_mutex_lock(&st->lock);
+                st->fetch_now = 1;
+                st->fetch_node = node->index;
+                st->wake_main = 1;
+                pthread_cond_broadcast(&st->changed);
+                pthread_mutex_unlock(&st->lock);
+            }
         }
+        nanosleep(&pause, NULL);
     }
+    rpc_free(&rpc);
+    return NULL;
+}
 
-    size_t offset = 0;
-    if (out_cap < 80) return 0;
-    memcpy(out, header, 80);
-    offset += 80;
+// BIP 22 long polling on a separate connection per node: the node holds
+// the request until its tip (or, after a while, its mempool) changes. The
+// longpollid is node specific, so a node that has not served a template
+// yet gets a plain request first.
+static void *longpoll_thread(void *arg) {
+    solo_node *node = arg;
+    solo_state *st = node->st;
+    rpc_client rpc;
+    rpc_init(&rpc, node->opts.host, node->opts.port, node->opts.user, node->opts.password);
+    rpc.cancel = &stop_flag;
+    char body[512];
+    int plain_tries = 0;
+    while (!stop_flag) {
+        char id[sizeof(node->longpollid)];
+        pthread_mutex_lock(&st->lock);
+        memcpy(id, node->longpollid, sizeof(id));
+        pthread_mutex_unlock(&st->lock);
+        int plain = !id[0];
+        if (plain && plain_tries++ > 0) {
+            // The node does not do long polling (or is down); refresh and
+            // the tip watch cover it.
+            struct timespec ts = {plain_tries < 10 ? 1 : 30, 0};
+            nanosleep(&ts, NULL);
+            if (plain_tries > 2) continue;
+        }
+        if (plain) {
+            snprintf(body, sizeof(body), "{\"id\":1,\"method\":\"getblocktemplate\",\"params\":[{\"rules\":[\"segwit\"]}]}");
+        } else {
+            snprintf(body, sizeof(body), "{\"id\":1,\"method\":\"getblocktemplate\",\"params\":[{\"rules\":[\"segwit\"],\"longpollid\":\"%s\"}]}", id);
+        }
+        solo_template *t = fetch_template(node, &rpc, body, plain ? "inicial" : "long-poll");
+        if (!t) {
+            struct timespec ts = {1, 0};
+            if (!stop_flag) nanosleep(&ts, NULL);
+            continue;
+        }
+        if (!plain) {
+            pthread_mutex_lock(&st->lock);
+            st->longpoll_returns++;
+            pthread_mutex_unlock(&st->lock);
+        }
+        publish_template(st, t, mono_seconds(), 0);
+    }
+    rpc_free(&rpc);
+    return NULL;
+}
 
-    uint64_t total_txs = tmpl->tx_count + 1;
-    append_varint(total_txs, out, &offset);
+// Header for one extranonce of a template: coinbase txid, merkle root
+// through the cached branch, and the 80 bytes with a zero nonce.
+static int prepare_header(const solo_template *t, const uint8_t *extranonce, uint8_t header[80]) {
+    uint8_t txid[32];
+    uint8_t root[32];
+    block_template_coinbase_txid(&t->tmpl, extranonce, txid);
+    block_template_merkle_root(&t->tmpl, txid, root);
+    return build_header(&t->tmpl, root, 0, header);
+}
 
-    if (offset + coinbase_len >= out_cap) return 0;
-    memcpy(out + offset, coinbase_bytes, coinbase_len);
-    offset += coinbase_len;
+static void solo_worker(void *ctx, int index) {
+    (void)index;
+    solo_state *st = ctx;
+    uint64_t cached_generation = 0;
+    uint32_t cached_extranonce = 0;
+    uint8_t extranonce[SOLO_EXTRANONCE_SIZE];
+    uint8_t header[80];
+    sha256_ctx midstate;
+    while (!stop_flag) {
+        pthread_mutex_lock(&st->lock);
+        solo_template *t = st->current;
+        if (!t || t->work_next >= t->work_end) {
+            if (t) st->wake_main = 1;
+            pthread_cond_broadcast(&st->changed);
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&st->changed, &st->lock, &ts);
+            pthread_mutex_unlock(&st->lock);
+            continue;
+        }
+        uint64_t work = t->work_next;
+        uint64_t remaining = t->work_end - work;
+        uint32_t count = remaining < SOLO_BATCH_NONCES ? (uint32_t)remaining : SOLO_BATCH_NONCES;
+        t->work_next += count;
+        t->refs++;
+        pthread_mutex_unlock(&st->lock);
+
+        // Batches never straddle an extranonce, so the header is rebuilt
+        // only when the template or the extranonce changes.
+        uint32_t en = (uint32_t)(work >> 32);
+        uint32_t first = (uint32_t)work;
+        if (t->generation != cached_generation || en != cached_extranonce) {
+            uint32_to_le(en, extranonce);
+            if (!prepare_header(t, extranonce, header)) {
+                fprintf(stderr, "[solo] falha ao montar header\n");
+                pthread_mutex_lock(&st->lock);
+                template_release(st, t);
+                pthread_mutex_unlock(&st->lock);
+                break;
+            }
+            sha256_init(&midstate);
+            sha256_update(&midstate, header, 64);
+            cached_generation = t->generation;
+            cached_extranonce = en;
+        }
 
-    for (size_t i = 0; i < tmpl->tx_count; i++) {
-        if (!hex_to_bytes(tmpl->tx_data[i], tx_bytes, sizeof(tx_bytes), &tx_len[i])) return 0;
-        if (offset + tx_len[i] >= out_cap) return 0;
-        memcpy(out + offset, tx_bytes, tx_len[i]);
-        offset += tx_len[i];
+        double started = mono_seconds();
+        uint64_t done = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if ((i & 0xFFFu) == 0 && (stop_flag || atomic_load(&st->abort_before) > t->generation)) break;
+            uint32_t nonce = first + i;
+            uint32_to_le(nonce, header + 76);
+            uint8_t hash[32];
+            sha256_ctx c = midstate;
+            sha256_update(&c, header + 64, 16);
+            sha256_final(&c, hash);
+            sha256_init(&c);
+            sha256_update(&c, hash, 32);
+            sha256_final(&c, hash);
+            done++;
+            reverse_bytes(hash, 32);
+            if (hash_meets_target(hash, t->target)) {
+                pthread_mutex_lock(&st->lock);
+                if (st->found_count < SOLO_MAX_FOUND) {
+                    solo_found *f = &st->found[st->found_count++];
+                    f->tmpl = t;
+                    memcpy(f->header, header, sizeof(f->header));
+                    memcpy(f->extranonce, extranonce, sizeof(f->extranonce));
+                    f->nonce = nonce;
+                    f->found_at = mono_seconds();
+                    t->refs++;
+                }
+                st->wake_main = 1;
+                pthread_cond_broadcast(&st->changed);
+                pthread_mutex_unlock(&st->lock);
+            }
+        }
+
+        pthread_mutex_lock(&st->lock);
+        if (!st->tip_hashed && done > 0 && t->generation >= st->tip_generation && st->tip_detected_at > 0.0) {
+            st->tip_hashed = 1;
+            st->first_hash_last = started - st->tip_detected_at;
+            st->first_hash_secs += st->first_hash_last;
+            st->first_hash_count++;
+        }
+        st->hashes += done;
+        // Stale: the template was replaced by one on a newer tip, or the
+        // node already reported a newer tip when the batch started.
+        if (t->generation < st->tip_generation ||
+            (st->seen_hash[0] && st->seen_at <= started && strcmp(st->seen_hash, t->tmpl.prev_hash) != 0)) {
+            st->stale_hashes += done;
+            st->stale_secs += mono_seconds() - started;
+        }
+        template_release(st, t);
+        pthread_mutex_unlock(&st->lock);
     }
+}
 
-    *out_len = offset;
-    return 1;
+static void *submit_thread(void *arg) {
+    solo_node *node = arg;
+    const solo_found *f = node->submit;
+    const solo_template *t = f->tmpl;
+    block_template_glue glue;
+    struct iovec *parts = malloc((t->tmpl.tx_count + BLOCK_TEMPLATE_FIXED_PARTS) * sizeof(*parts));
+    node->submit_sent = 0;
+    node->submit_ok = 0;
+    if (!parts) return NULL;
+    size_t count = block_template_parts(&t->tmpl, f->header, f->extranonce, &glue, parts);
+    json_message reply;
+    if (rpc_post_hex(&node->rpc, "{\"id\":2,\"method\":\"submitblock\",\"params\":[\"", parts, count, "\"]}")) {
+        node->submit_sent = 1;
+        node->submit_sent_at = node->rpc.sent_at;
+        // "duplicate": the block already arrived over P2P.
+        node->submit_ok = rpc_batch_item(&node->rpc, 2, &reply) && json_view_is(reply.error, "null") &&
+                          (json_view_is(reply.result, "null") || json_view_string_eq(reply.result, "duplicate"));
+        if (!node->submit_ok) {
+            printf("[solo] %s recusou o bloco: %.*s\n", node->name,
+                   (int)(node->rpc.body.len < 300 ? node->rpc.body.len : 300), node->rpc.body.data);
+        }
+    }
+    free(parts);
+    return NULL;
 }
 
-static void report_progress(uint64_t attempts, double start_time) {
-    double elapsed = (double)clock() / (double)CLOCKS_PER_SEC - start_time;
-    if (elapsed < 0.001) return;
-    double rate = (double)attempts / elapsed;
-    printf("[progress] solo: %llu tentativas | %.2f H/s | %.2fs\n",
-           (unsigned long long)attempts, rate, elapsed);
+static void *p2p_submit_thread(void *arg) {
+    solo_state *st = arg;
+    const solo_found *f = st->p2p_found;
+    block_template_glue glue;
+    struct iovec *parts = malloc((f->tmpl->tmpl.tx_count + BLOCK_TEMPLATE_FIXED_PARTS) * sizeof(*parts));
+    st->p2p_sent = 0;
+    if (!parts) return NULL;
+    size_t count = block_template_parts(&f->tmpl->tmpl, f->header, f->extranonce, &glue, parts);
+    st->p2p_sent = p2p_send_block(&st->p2p, f->header, parts, count);
+    free(parts);
+    return NULL;
+}
+
+// The block goes to every node at once, as hex streamed straight from the
+// template's binary parts. Propagation starts with the first node to get
+// it, so found->sent is taken from the earliest send.
+static void submit_found(solo_state *st, const solo_found *f) {
+    printf("[solo] block found nonce=%u extranonce=%02x%02x%02x%02x\n", f->nonce,
+           f->extranonce[0], f->extranonce[1], f->extranonce[2], f->extranonce[3]);
+    pthread_t threads[SOLO_MAX_NODES];
+    int started[SOLO_MAX_NODES];
+    pthread_t p2p_thread;
+    int p2p_started = 0;
+    if (st->use_p2p) {
+        st->p2p_found = f;
+        p2p_started = pthread_create(&p2p_thread, NULL, p2p_submit_thread, st) == 0;
+        if (!p2p_started) p2p_submit_thread(st);
+    }
+    for (int i = 0; i < st->node_count; i++) {
+        st->nodes[i].submit = f;
+        started[i] = pthread_create(&threads[i], NULL, submit_thread, &st->nodes[i]) == 0;
+        if (!started[i]) submit_thread(&st->nodes[i]);
+    }
+    for (int i = 0; i < st->node_count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+    if (p2p_started) pthread_join(p2p_thread, NULL);
+
+    double first_sent = 0.0;
+    int accepted = 0;
+    pthread_mutex_lock(&st->lock);
+    for (int i = 0; i < st->node_count; i++) {
+        solo_node *node = &st->nodes[i];
+        if (!node->submit_sent) {
+            node->submits_failed++;
+            note_latency(&node->submit_latency, SOLO_FAILURE_PENALTY);
+            continue;
+        }
+        double sent = node->submit_sent_at - f->found_at;
+        note_latency(&node->submit_latency, sent);
+        if (node->submit_ok) {
+            node->submits_ok++;
+            accepted++;
+        } else {
+            node->submits_failed++;
+        }
+        if (first_sent == 0.0 || sent < first_sent) first_sent = sent;
+    }
+    double p2p_sent = 0.0;
+    if (st->use_p2p && st->p2p_sent) {
+        pthread_mutex_lock(&st->p2p.lock);
+        p2p_sent = st->p2p.sent_at - f->found_at;
+        pthread_mutex_unlock(&st->p2p.lock);
+        st->p2p_submits++;
+        st->p2p_secs += p2p_sent;
+        if (p2p_sent > st->p2p_max) st->p2p_max = p2p_sent;
+    } else if (st->use_p2p) {
+        st->p2p_failed++;
+    }
+    if (first_sent > 0.0) {
+        st->submits++;
+        st->submit_secs += first_sent;
+        if (first_sent > st->submit_max) st->submit_max = first_sent;
+    }
+    pthread_mutex_unlock(&st->lock);
+    printf("[solo] submitblock (%zu bytes): aceito por %d/%d nodes, achado->enviado %.2fms, tudo respondido em %.2fms\n",
+           block_template_block_size(&f->tmpl->tmpl), accepted, st->node_count, 1000.0 * first_sent,
+           1000.0 * (mono_seconds() - f->found_at));
+    if (st->use_p2p) {
+        if (p2p_sent > 0.0) {
+            printf("[solo] bloco via p2p: achado->enviado %.2fms\n", 1000.0 * p2p_sent);
+        } else {
+            printf("[solo] bloco via p2p: conexao indisponivel\n");
+        }
+    }
+}
+
+static void print_solo_stats(solo_state *st) {
+    pthread_mutex_lock(&st->lock);
+    double elapsed = mono_seconds() - st->start;
+    printf("[progress] solo: %llu tentativas | %.2f H/s | %.2fs\n", (unsigned long long)st->hashes,
+           elapsed > 0.0 ? (double)st->hashes / elapsed : 0.0, elapsed);
+    printf("[solo] templates=%zu (long-poll=%zu) | trocas de tip=%zu | trabalho stale: %llu hashes (%.2f%%) em %.3fs\n",
+           st->templates, st->longpoll_returns, st->tip_changes, (unsigned long long)st->stale_hashes,
+           st->hashes ? 100.0 * (double)st->stale_hashes / (double)st->hashes : 0.0, st->stale_secs);
+    if (st->first_hash_count) {
+        printf("[solo] novo tip -> primeiro hash: ultimo %.2fms, medio %.2fms em %zu trocas | blocos vazios=%zu (%.2fs)\n",
+               1000.0 * st->first_hash_last, 1000.0 * st->first_hash_secs / (double)st->first_hash_count,
+               st->first_hash_count, st->speculative, st->empty_secs);
+    }
+    if (st->submits) {
+        printf("[solo] blocos enviados=%zu | achado->enviado medio %.2fms, max %.2fms\n", st->submits,
+               1000.0 * st->submit_secs / (double)st->submits, 1000.0 * st->submit_max);
+    }
+    if (st->use_p2p) {
+        pthread_mutex_lock(&st->p2p.lock);
+        double rtt = st->p2p.ping_rtt;
+        size_t connects = st->p2p.connects;
+        pthread_mutex_unlock(&st->p2p.lock);
+        printf("[solo] p2p %s:%s: %s, conexoes=%zu, ping %.2fms | blocos=%zu (falhas=%zu)", st->p2p.host, st->p2p.port,
+               atomic_load(&st->p2p.ready) ? "ativo" : "desconectado", connects, 1000.0 * rtt, st->p2p_submits, st->p2p_failed);
+        if (st->p2p_submits) {
+            printf(" | achado->enviado medio %.2fms, max %.2fms", 1000.0 * st->p2p_secs / (double)st->p2p_submits,
+                   1000.0 * st->p2p_max);
+        }
+        printf("\n");
+    }
+    if (st->node_count > 1) {
+        for (int i = 0; i < st->node_count; i++) {
+            const solo_node *n = &st->nodes[i];
+            printf("[solo]   %s: template %.1fms (n=%zu, falhas=%zu) | tip primeiro=%zu | submit %.1fms ok=%zu falhas=%zu\n",
+                   n->name, 1000.0 * n->template_latency, n->templates, n->failures, n->tips_first,
+                   1000.0 * n->submit_latency, n->submits_ok, n->submits_failed);
+        }
+    }
+    pthread_mutex_unlock(&st->lock);
+}
+
+// Nodes in order of smoothed template latency, fastest first.
+static int rank_nodes(solo_state *st, int order[SOLO_MAX_NODES]) {
+    pthread_mutex_lock(&st->lock);
+    for (int i = 0; i < st->node_count; i++) {
+        int j = i;
+        while (j > 0 && st->nodes[order[j - 1]].template_latency > st->nodes[i].template_latency) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    pthread_mutex_unlock(&st->lock);
+    return st->node_count;
+}
+
+// Runs once the hash, long poll and tip watch threads are gone (or were
+// never started): stops P2P and frees templates and RPC connections.
+static void solo_teardown(solo_state *st) {
+    if (st->use_p2p) p2p_stop(&st->p2p);
+    for (size_t i = 0; i < st->found_count; i++) template_release(st, st->found[i].tmpl);
+    template_release(st, st->current);
+    while (st->spare) {
+        solo_template *t = st->spare;
+        st->spare = t->next_spare;
+        block_template_free(&t->tmpl);
+        free(t);
+    }
+    for (int i = 0; i < st->node_count; i++) rpc_free(&st->nodes[i].rpc);
+    pthread_cond_destroy(&st->changed);
+    pthread_mutex_destroy(&st->lock);
 }
 
 int solo_run(const solo_options *opts) {
@@ -415,99 +814,156 @@ int solo_run(const solo_options *opts) {
     signal(SIGTERM, handle_stop);
 #endif
 
-    printf("[solo] conectado a %s:%s (coin=%s)\n", opts->host, opts->port, coin_type_to_name(opts->coin));
-    double start_time = (double)clock() / (double)CLOCKS_PER_SEC;
-    uint64_t attempts = 0;
-
-    while (!stop_flag) {
-        int sock = connect_tcp(opts->host, opts->port);
-        if (sock == -1) return 1;
-
-        const char *body = "{\"id\":1,\"method\":\"getblocktemplate\",\"params\":[]}";
-        char response[32768];
-        if (!rpc_call(sock, opts->host, opts->user, opts->password, body, response, sizeof(response))) {
-            fprintf(stderr, "[solo] falha ao chamar getblocktemplate\n");
-            close(sock);
-            return 1;
-        }
-
-        block_template tmpl;
-        if (!parse_block_template(response, &tmpl)) {
-            fprintf(stderr, "[solo] template invalido ou coinbasetxn ausente\n");
-            close(sock);
-            return 1;
+    solo_state st;
+    memset(&st, 0, sizeof(st));
+    st.opts = opts;
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.changed, NULL);
+    atomic_init(&st.abort_before, 0);
+    st.start = mono_seconds();
+    if (opts->payout_script &&
+        !hex_decode(opts->payout_script, strlen(opts->payout_script), st.payout_script, sizeof(st.payout_script), &st.payout_len)) {
+        fprintf(stderr, "[solo] --payout-script invalido (hex, ate %zu bytes)\n", sizeof(st.payout_script));
+        return 1;
+    }
+    st.node_count = 1 + opts->extra_node_count;
+    for (int i = 0; i < st.node_count; i++) {
+        solo_node *node = &st.nodes[i];
+        node->st = &st;
+        node->index = i;
+        if (i == 0) {
+            snprintf(node->opts.host, sizeof(node->opts.host), "%s", opts->host);
+            snprintf(node->opts.port, sizeof(node->opts.port), "%s", opts->port);
+        } else {
+            node->opts = opts->extra_nodes[i - 1];
         }
+        if (i == 0 || !node->opts.user[0]) snprintf(node->opts.user, sizeof(node->opts.user), "%s", opts->user ? opts->user : "");
+        if (i == 0 || !node->opts.password[0]) snprintf(node->opts.password, sizeof(node->opts.password), "%s", opts->password ? opts->password : "");
+        snprintf(node->name, sizeof(node->name), "%s:%s", node->opts.host, node->opts.port);
+        rpc_init(&node->rpc, node->opts.host, node->opts.port, node->opts.user, node->opts.password);
+        printf("[solo] node %d: %s (coin=%s)\n", i + 1, node->name, coin_type_to_name(opts->coin));
+    }
 
-        uint8_t target[32];
-        if (!target_from_hex(tmpl.target, target)) {
-            fprintf(stderr, "[solo] target invalido\n");
-            close(sock);
-            return 1;
+    // Template and chain state travel in one batch over a kept-alive
+    // connection; the first node that answers starts the workers.
+    static const char fetch[] =
+        "[{\"id\":1,\"method\":\"getblocktemplate\",\"params\":[{\"rules\":[\"segwit\"]}]},"
+        "{\"id\":2,\"method\":\"getmininginfo\",\"params\":[]}]";
+    solo_template *first = NULL;
+    for (int i = 0; i < st.node_count && !first; i++) {
+        solo_node *node = &st.nodes[i];
+        if (!(first = fetch_template(node, &node->rpc, fetch, "inicial"))) continue;
+        json_message info;
+        if (rpc_batch_item(&node->rpc, 2, &info) && json_view_is(info.error, "null")) {
+            printf("[solo] getmininginfo: %.*s\n", (int)(info.result.len < 200 ? info.result.len : 200), info.result.p);
         }
-
-        uint8_t merkle_root[32];
-        if (!build_merkle_root(&tmpl, merkle_root)) {
-            fprintf(stderr, "[solo] falha ao construir merkle root\n");
-            close(sock);
-            return 1;
+    }
+    if (!first) {
+        for (int i = 0; i < st.node_count; i++) rpc_free(&st.nodes[i].rpc);
+        return 1;
+    }
+    if (opts->p2p_host[0]) {
+        uint8_t magic[4];
+        size_t magic_len = 0;
+        if (opts->p2p_magic ? !hex_decode(opts->p2p_magic, strlen(opts->p2p_magic), magic, sizeof(magic), &magic_len) || magic_len != 4
+                            : !coin_p2p_magic(opts->coin, magic)) {
+            fprintf(stderr, "[solo] magic p2p desconhecido; informe --p2p-magic\n");
+        } else if (p2p_start(&st.p2p, opts->p2p_host, opts->p2p_port, magic, (int32_t)first->tmpl.height - 1)) {
+            st.use_p2p = 1;
         }
+    }
+    publish_template(&st, first, mono_seconds(), 1);
+    if (!first->tmpl.longpollid[0]) printf("[solo] node sem long polling; novos blocos vem do tip watch e do refresh\n");
 
-        uint8_t header[80];
-        uint8_t block[262144];
-        size_t block_len = 0;
-        uint32_t nonce = 0;
-
-        printf("[solo] mining job: txs=%zu target=%s\n", tmpl.tx_count + 1, tmpl.target);
-
-        while (!stop_flag) {
-            if (!build_header(&tmpl, merkle_root, nonce, header)) {
-                fprintf(stderr, "[solo] falha ao montar header\n");
-                close(sock);
-                return 1;
-            }
+    worker_pool workers;
+    if (!worker_pool_start(&workers, opts->threads, solo_worker, &st)) {
+        fprintf(stderr, "[solo] falha ao iniciar threads de mineracao\n");
+        solo_teardown(&st);
+        return 1;
+    }
+    pthread_t longpoll[SOLO_MAX_NODES];
+    pthread_t tip_watch[SOLO_MAX_NODES];
+    int longpoll_started[SOLO_MAX_NODES];
+    int tip_watch_started[SOLO_MAX_NODES];
+    for (int i = 0; i < st.node_count; i++) {
+        longpoll_started[i] = pthread_create(&longpoll[i], NULL, longpoll_thread, &st.nodes[i]) == 0;
+        tip_watch_started[i] = opts->tip_poll_ms > 0 && pthread_create(&tip_watch[i], NULL, tip_watch_thread, &st.nodes[i]) == 0;
+    }
+    printf("[solo] %d threads de hash | %d node(s) | refresh a cada %ds\n", workers.count, st.node_count, opts->refresh_secs);
 
-            uint8_t hash[32];
-            double_sha256(header, sizeof(header), hash);
-            attempts++;
-            if ((attempts % 50000) == 0) {
-                report_progress(attempts, start_time);
-            }
+    int failed = 0;
+    double last_refresh = mono_seconds();
+    double last_stats = last_refresh;
+    while (!stop_flag) {
+        pthread_mutex_lock(&st.lock);
+        if (!st.wake_main) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&st.changed, &st.lock, &ts);
+        }
+        int exhausted = st.wake_main && st.current && st.current->work_next >= st.current->work_end;
+        int new_tip = st.fetch_now;
+        int tip_node = st.fetch_node;
+        st.wake_main = 0;
+        st.fetch_now = 0;
+        solo_found found[SOLO_MAX_FOUND];
+        size_t found_count = st.found_count;
+        memcpy(found, st.found, found_count * sizeof(found[0]));
+        st.found_count = 0;
+        pthread_mutex_unlock(&st.lock);
+
+        for (size_t i = 0; i < found_count; i++) {
+            submit_found(&st, &found[i]);
+            pthread_mutex_lock(&st.lock);
+            template_release(&st, found[i].tmpl);
+            pthread_mutex_unlock(&st.lock);
+        }
 
-            uint8_t hash_be[32];
-            memcpy(hash_be, hash, 32);
-            reverse_bytes(hash_be, 32);
-            if (hash_meets_target(hash_be, target)) {
-                printf("[solo] block found nonce=%u\n", nonce);
-                if (!build_block(&tmpl, header, block, sizeof(block), &block_len)) {
-                    fprintf(stderr, "[solo] falha ao montar bloco\n");
-                    close(sock);
-                    return 1;
+        // Periodic refresh picks up new transactions and fees from the
+        // fastest node; a new tip is fetched from the node that reported it.
+        double now = mono_seconds();
+        if (new_tip || exhausted || found_count > 0 || now - last_refresh >= opts->refresh_secs) {
+            int order[SOLO_MAX_NODES];
+            int count = rank_nodes(&st, order);
+            if (new_tip) {
+                for (int i = 0; i < count; i++) {
+                    if (order[i] != tip_node) continue;
+                    memmove(order + 1, order, (size_t)i * sizeof(order[0]));
+                    order[0] = tip_node;
+                    break;
                 }
-                char block_hex[600000];
-                hex_from_bytes(block, block_len, block_hex, sizeof(block_hex));
-
-                char submit_body[600512];
-                snprintf(submit_body, sizeof(submit_body),
-                         "{\"id\":2,\"method\":\"submitblock\",\"params\":[\"%s\"]}",
-                         block_hex);
-                char submit_resp[8192];
-                if (!rpc_call(sock, opts->host, opts->user, opts->password, submit_body, submit_resp, sizeof(submit_resp))) {
-                    fprintf(stderr, "[solo] falha ao enviar submitblock\n");
-                    close(sock);
-                    return 1;
-                }
-                printf("[solo] submitblock enviado\n");
-                break;
             }
-
-            nonce++;
-            if (nonce == 0) {
+            solo_template *t = NULL;
+            for (int i = 0; i < count && !t && !stop_flag; i++) {
+                solo_node *node = &st.nodes[order[i]];
+                t = fetch_template(node, &node->rpc, "{\"id\":1,\"method\":\"getblocktemplate\",\"params\":[{\"rules\":[\"segwit\"]}]}",
+                                   new_tip ? "novo tip" : exhausted ? "nonces esgotados" : "refresh");
+            }
+            if (t) {
+                publish_template(&st, t, now, 1);
+            } else if (!stop_flag) {
+                failed = 1;
                 break;
             }
+            last_refresh = now;
+        }
+        if (now - last_stats >= 30.0) {
+            print_solo_stats(&st);
+            last_stats = now;
         }
-
-        close(sock);
     }
 
-    return 0;
+    stop_flag = 1;
+    pthread_mutex_lock(&st.lock);
+    pthread_cond_broadcast(&st.changed);
+    pthread_mutex_unlock(&st.lock);
+    worker_pool_join(&workers);
+    for (int i = 0; i < st.node_count; i++) {
+        if (longpoll_started[i]) pthread_join(longpoll[i], NULL);
+        if (tip_watch_started[i]) pthread_join(tip_watch[i], NULL);
+    }
+    print_solo_stats(&st);
+    solo_teardown(&st);
+    return failed ? 1 : 0;
 }
@@ -1,61 +1,56 @@
 #include "stratum.h"
 
+#include <ctype.h>
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <netdb.h>
 #include <unistd.h>
 #include <time.h>
 #include <stdint.h>
 #include "bitcoin/job.h"
 #include "coins/registry.h"
 #include "bitcoin/block.h"
+#include "hex.h"
+#include "inflight.h"
+#include "json.h"
+#include "net.h"
+#include "record.h"
+#include "scheduler.h"
+#include "sharerate.h"
+#include "shareset.h"
+#include "sha256.h"
+#include "workers.h"
 
-static int connect_tcp(const char *host, const char *port) {
-    struct addrinfo hints;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-
-    struct addrinfo *res = NULL;
-    int rc = getaddrinfo(host, port, &hints, &res);
-    if (rc != 0) {
-        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rc));
-        return -1;
-    }
-
-    int sock = -1;
-    for (struct addrinfo *p = res; p != NULL; p = p->ai_next) {
-        sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-        if (sock == -1) continue;
-        if (connect(sock, p->ai_addr, p->ai_addrlen) == 0) break;
-        close(sock);
-        sock = -1;
-    }
-    freeaddrinfo(res);
-
-    if (sock == -1) {
-        fprintf(stderr, "Nao foi possivel conectar a %s:%s\n", host, port);
-    }
-    return sock;
-}
-
-static int send_line(int sock, const char *msg) {
-    size_t len = strlen(msg);
-    if (send(sock, msg, len, 0) < 0) return 0;
-    if (send(sock, "\n", 1, 0) < 0) return 0;
-    return 1;
-}
+#define STRATUM_BATCH_NONCES 65536u
+#define STRATUM_SPLIT_HALF_LIFE 30.0
+// Sanity bound for a single message; notifies with thousands of branches fit.
+#define STRATUM_MAX_LINE (16 * 1024 * 1024)
+#define STRATUM_SUBMIT_TIMEOUT 30.0
+#define STRATUM_DRAIN_SECS 5.0
+#define STRATUM_SUGGEST_ID 3
+#define STRATUM_EXTRANONCE_SUBSCRIBE_ID 4
+#define STRATUM_JOB_RING 8
 
 static volatile sig_atomic_t stop_flag = 0;
 
+// First signal stops hashing and drains pending submits; a second one
+// skips the drain.
 static void handle_stop(int sig) {
     (void)sig;
-    stop_flag = 1;
+    stop_flag = stop_flag ? 2 : 1;
+}
+
+static double mono_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
 }
 
 typedef struct {
@@ -66,389 +61,1054 @@ typedef struct {
     size_t job_changes;
     size_t clean_signals;
     char last_job_id[128];
-    size_t submit_accepted;
-    size_t submit_rejected;
     int submit_seq;
+    // mining.set_extranonce takes effect with the next notify.
+    int extranonce_pending;
+    char pending_extranonce1[64];
+    int pending_extranonce2_size;
+    size_t extranonce_changes;
 } stratum_session_state;
 
 typedef struct {
     int has_job;
-    uint32_t nonce;
-    uint64_t extranonce2_counter;
     uint8_t target[32];
     int target_ready;
     int target_from_difficulty;
-    double start_time;
-    uint64_t attempts;
-    uint64_t report_interval;
 } mining_state;
 
-static void skip_ws_local(const char **p) {
-    while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r') (*p)++;
-}
+// Everything a worker needs to hash for one session, snapshotted when the
+// job, extranonce or target changes. The job is shared by reference.
+typedef struct {
+    bitcoin_compiled_job *job;
+    uint8_t extranonce1[32];
+    size_t extranonce1_len;
+    size_t extranonce2_size;
+    uint8_t target[32];
+    double difficulty;
+    uint64_t generation;
+} stratum_work;
+
+// A job in the session history, with the target in force when it was
+// issued and the share tuples already submitted for it.
+typedef struct {
+    bitcoin_compiled_job *job;
+    uint8_t target[32];
+    int target_from_difficulty;  // 0 while target is the nbits fallback
+    share_set submitted;
+} stratum_job_entry;
+
+typedef struct {
+    int slot;
+    stratum_work work;
+    uint64_t extranonce2;
+    uint32_t nonce_start;
+    uint32_t count;
+} hash_batch;
+
+typedef struct {
+    int index;
+    char tag[32];
+    stratum_pool_options pool;
+    int sock;
+    net_connector connector;
+    int attempts;
+    int dead;
+    double next_connect;
+
+    net_line_reader rx;
+    size_t bytes_in;
+    size_t bytes_out;
+    size_t notify_count;
+    time_t last_ping;
+
+    stratum_session_state state;
+    mining_state miner;
+    share_rate_ctl rate_ctl;
+
+    pthread_mutex_t send_lock;
+    stratum_recorder *recorder;
+    int replay;  // no socket: shares are counted, nothing is sent
+    size_t shares_found;
+    inflight_table inflight;  // guarded by send_lock
+
+    // Guarded by the hub lock. Recent jobs stay submittable until a
+    // clean_jobs notify empties the ring.
+    bitcoin_compiled_job *latest;
+    stratum_job_entry jobs[STRATUM_JOB_RING];
+    size_t job_head;
+    size_t old_job_shares;
+    size_t invalidated_shares;
+    size_t filtered_duplicate;
+    size_t filtered_low_diff;
+    stratum_work work;
+    int has_work;
+    uint64_t extranonce2_next;
+    uint64_t nonce_next;
+
+    // Batches from generations below this are abandoned by the workers.
+    _Atomic uint64_t abort_before;
+
+    // Session resumption: the id the pool gave us and what to restore if it
+    // hands back the same extranonce1 after a reconnect.
+    char resume_id[128];
+    char resume_extranonce1[64];
+    int resume_extranonce2_size;
+    double resume_difficulty;
+    bitcoin_compiled_job *resume_job;  // guarded by the hub lock
+    uint64_t resume_extranonce2_next;
+    uint64_t resume_nonce_next;
+    size_t resumed;
+
+    // Replay only: when the last notify was fed and the generation it made.
+    double switch_started;
+    uint64_t switch_generation;
+} stratum_session;
+
+typedef struct {
+    const stratum_options *opts;
+    stratum_session *sessions;
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    weighted_scheduler sched;
+    uint64_t generation;
+    uint32_t batch_nonces;
+    int replay;
+    // Replay only: notify -> first batch handed to a worker, in seconds.
+    double *switch_samples;
+    size_t switch_count;
+    size_t switch_cap;
+} stratum_hub;
 
-static void hex_from_bytes(const uint8_t *buf, size_t len, char *out, size_t out_len) {
-    static const char hex[] = "0123456789abcdef";
-    if (out_len < len * 2 + 1) return;
+static void fill_extranonce2(uint64_t counter, uint8_t *out, size_t len) {
     for (size_t i = 0; i < len; i++) {
-        out[i * 2] = hex[(buf[i] >> 4) & 0xF];
-        out[i * 2 + 1] = hex[buf[i] & 0xF];
+        size_t shift = (len - 1 - i) * 8;
+        out[i] = (uint8_t)((counter >> shift) & 0xFF);
     }
-    out[len * 2] = '\0';
 }
 
-static void reverse_bytes(uint8_t *buf, size_t len) {
-    for (size_t i = 0; i < len / 2; i++) {
-        uint8_t tmp = buf[i];
-        buf[i] = buf[len - 1 - i];
-        buf[len - 1 - i] = tmp;
+static void job_release(bitcoin_compiled_job *cj) {
+    if (cj && --cj->refs <= 0) bitcoin_compiled_job_free(cj);
+}
+
+// Ring helpers; caller must hold hub->lock.
+static stratum_job_entry *find_job_locked(stratum_session *s, const bitcoin_compiled_job *job) {
+    for (size_t i = 0; i < STRATUM_JOB_RING; i++) {
+        if (s->jobs[i].job == job) return &s->jobs[i];
     }
+    return NULL;
 }
 
-static void uint32_to_le(uint32_t v, uint8_t out[4]) {
-    out[0] = (uint8_t)(v & 0xFF);
-    out[1] = (uint8_t)((v >> 8) & 0xFF);
-    out[2] = (uint8_t)((v >> 16) & 0xFF);
-    out[3] = (uint8_t)((v >> 24) & 0xFF);
+static void drop_job_locked(stratum_job_entry *e) {
+    job_release(e->job);
+    e->job = NULL;
+    e->target_from_difficulty = 0;
+    share_set_clear(&e->submitted);
 }
 
-static int target_from_nbits(const char *nbits_hex, uint8_t out[32]) {
-    uint8_t nbits_bytes[4];
-    size_t len = 0;
-    if (!hex_to_bytes(nbits_hex, nbits_bytes, sizeof(nbits_bytes), &len) || len != 4) return 0;
-    uint8_t exponent = nbits_bytes[0];
-    uint32_t mantissa = ((uint32_t)nbits_bytes[1] << 16) | ((uint32_t)nbits_bytes[2] << 8) | (uint32_t)nbits_bytes[3];
+static void clear_jobs_locked(stratum_session *s) {
+    for (size_t i = 0; i < STRATUM_JOB_RING; i++) drop_job_locked(&s->jobs[i]);
+}
 
-    memset(out, 0, 32);
-    if (exponent < 3) return 0;
-    int shift = (int)exponent - 3;
-    int idx = 32 - (shift + 3);
-    if (idx < 0 || idx + 2 >= 32) return 0;
-    out[idx] = (uint8_t)((mantissa >> 16) & 0xFF);
-    out[idx + 1] = (uint8_t)((mantissa >> 8) & 0xFF);
-    out[idx + 2] = (uint8_t)(mantissa & 0xFF);
-    return 1;
+static void push_job_locked(stratum_session *s, bitcoin_compiled_job *cj) {
+    stratum_job_entry *e = &s->jobs[s->job_head];
+    drop_job_locked(e);
+    // A re-sent job_id takes over the older entry's submitted set, since the
+    // pool keys duplicates by job_id.
+    for (size_t i = 0; i < STRATUM_JOB_RING; i++) {
+        stratum_job_entry *old = &s->jobs[i];
+        if (old->job && strcmp(old->job->job_id, cj->job_id) == 0) {
+            share_set tmp = e->submitted;
+            e->submitted = old->submitted;
+            old->submitted = tmp;
+            drop_job_locked(old);
+        }
+    }
+    e->job = cj;
+    cj->refs++;
+    s->job_head = (s->job_head + 1) % STRATUM_JOB_RING;
 }
 
-static void max_target_bytes(uint8_t out[32]) {
-    memset(out, 0, 32);
-    // Bitcoin max target from 0x1d00ffff (big-endian).
-    out[4] = 0xFF;
-    out[5] = 0xFF;
-    out[6] = 0x00;
-    out[7] = 0x00;
-    out[8] = 0x00;
-    out[9] = 0x00;
-    out[10] = 0x00;
-    out[11] = 0x00;
-    out[12] = 0x00;
-    out[13] = 0x00;
-    out[14] = 0x00;
-    out[15] = 0x00;
-    out[16] = 0x00;
-    out[17] = 0x00;
-    out[18] = 0x00;
-    out[19] = 0x00;
-    out[20] = 0x00;
-    out[21] = 0x00;
-    out[22] = 0x00;
-    out[23] = 0x00;
-    out[24] = 0x00;
-    out[25] = 0x00;
-    out[26] = 0x00;
-    out[27] = 0x00;
-    out[28] = 0x00;
-    out[29] = 0x00;
-    out[30] = 0x00;
-    out[31] = 0x00;
-}
-
-static int target_from_difficulty(double diff, uint8_t out[32]) {
-    if (diff <= 0.0) return 0;
-    uint8_t max_target[32];
-    max_target_bytes(max_target);
-
-    long double d = (long double)diff;
-    long double carry = 0.0L;
-    for (size_t i = 0; i < 32; i++) {
-        long double value = carry * 256.0L + (long double)max_target[i];
-        long double q = value / d;
-        if (q < 0.0L) q = 0.0L;
-        if (q > 255.0L) q = 255.0L;
-        out[i] = (uint8_t)q;
-        carry = value - ((long double)out[i] * d);
+// Decides whether a found share goes to the pool: the job must still be in
+// the history, the hash must meet the target the job was issued with (the
+// batch may carry a newer, easier one) and the tuple must be new.
+static int accept_share_locked(stratum_session *s, const stratum_work *work, uint64_t extranonce2,
+                               uint32_t nonce, const uint8_t hash[32]) {
+    stratum_job_entry *e = find_job_locked(s, work->job);
+    if (!e) {
+        s->invalidated_shares++;
+        printf("%s share descartado: job=%s invalidado por clean_jobs\n", s->tag, work->job->job_id);
+        return 0;
+    }
+    if (!bitcoin_hash_meets_target(hash, e->target)) {
+        s->filtered_low_diff++;
+        printf("%s share filtrado: abaixo do alvo do job=%s\n", s->tag, work->job->job_id);
+        return 0;
     }
+    const void *parts[3] = {&extranonce2, work->job->ntime_bytes, &nonce};
+    size_t lens[3] = {sizeof(extranonce2), 4, sizeof(nonce)};
+    if (!share_set_insert(&e->submitted, share_key(parts, lens, 3))) {
+        s->filtered_duplicate++;
+        printf("%s share filtrado: duplicado no job=%s nonce=%08x\n", s->tag, work->job->job_id, nonce);
+        return 0;
+    }
+    if (work->job != s->latest) s->old_job_shares++;
     return 1;
 }
 
-static int hash_meets_target(const uint8_t hash[32], const uint8_t target[32]) {
-    return memcmp(hash, target, 32) <= 0;
-}
+// Rebuilds the session's published work. Caller must hold hub->lock.
+static void session_refresh_work_locked(stratum_hub *hub, stratum_session *s, int new_job) {
+    uint8_t ex1[32];
+    size_t ex1_len = 0;
+    int ready = s->latest && s->miner.target_ready &&
+                s->state.extranonce2_size > 0 && s->state.extranonce2_size <= 8 &&
+                s->state.extranonce1[0] != '\0' &&
+                hex_decode(s->state.extranonce1, strlen(s->state.extranonce1), ex1, sizeof(ex1), &ex1_len);
 
-static void fill_extranonce2(uint64_t counter, uint8_t *out, size_t len) {
-    for (size_t i = 0; i < len; i++) {
-        size_t shift = (len - 1 - i) * 8;
-        out[i] = (uint8_t)((counter >> shift) & 0xFF);
+    if (!ready) {
+        if (s->has_work) {
+            job_release(s->work.job);
+            s->work.job = NULL;
+            s->has_work = 0;
+        }
+        sched_set_active(&hub->sched, s->index, 0);
+        return;
+    }
+
+    if (new_job || !s->has_work) {
+        s->work.generation = ++hub->generation;
+        s->extranonce2_next = 0;
+        s->nonce_next = 0;
+        if (s->latest->clean_jobs) {
+            atomic_store(&s->abort_before, s->work.generation);
+        }
+        // The job's share target is fixed when it is first handed out.
+        stratum_job_entry *e = find_job_locked(s, s->latest);
+        if (e) {
+            memcpy(e->target, s->miner.target, 32);
+            e->target_from_difficulty = s->miner.target_from_difficulty;
+        }
+    } else if (s->miner.target_from_difficulty) {
+        // Pools that send notify before set_difficulty: jobs handed out with
+        // the nbits fallback take the first pool difficulty, once.
+        for (size_t i = 0; i < STRATUM_JOB_RING; i++) {
+            stratum_job_entry *e = &s->jobs[i];
+            if (!e->job || e->target_from_difficulty) continue;
+            memcpy(e->target, s->miner.target, 32);
+            e->target_from_difficulty = 1;
+        }
+    }
+    if (s->work.job != s->latest) {
+        if (s->has_work) job_release(s->work.job);
+        s->work.job = s->latest;
+        s->latest->refs++;
     }
+    memcpy(s->work.extranonce1, ex1, ex1_len);
+    s->work.extranonce1_len = ex1_len;
+    s->work.extranonce2_size = (size_t)s->state.extranonce2_size;
+    memcpy(s->work.target, s->miner.target, 32);
+    s->work.difficulty = s->state.difficulty;
+    s->has_work = 1;
+    sched_set_active(&hub->sched, s->index, 1);
+    pthread_cond_broadcast(&hub->work_ready);
 }
 
-static int build_block_header(const bitcoin_job *job, const uint8_t merkle_root[32], uint32_t nonce, uint8_t out[80]) {
-    uint8_t version[4];
-    uint8_t prev[32];
-    uint8_t ntime[4];
-    uint8_t nbits[4];
-    size_t len = 0;
+static void session_refresh_work(stratum_hub *hub, stratum_session *s, int new_job) {
+    pthread_mutex_lock(&hub->lock);
+    session_refresh_work_locked(hub, s, new_job);
+    pthread_mutex_unlock(&hub->lock);
+}
 
-    if (!hex_to_bytes(job->version, version, sizeof(version), &len) || len != 4) return 0;
-    if (!hex_to_bytes(job->prev_hash, prev, sizeof(prev), &len) || len != 32) return 0;
-    if (!hex_to_bytes(job->ntime, ntime, sizeof(ntime), &len) || len != 4) return 0;
-    if (!hex_to_bytes(job->nbits, nbits, sizeof(nbits), &len) || len != 4) return 0;
+static void session_set_job(stratum_hub *hub, stratum_session *s, bitcoin_compiled_job *cj) {
+    pthread_mutex_lock(&hub->lock);
+    job_release(s->latest);
+    s->latest = cj;
+    if (cj) {
+        cj->refs++;
+        if (cj->clean_jobs) clear_jobs_locked(s);
+        push_job_locked(s, cj);
+    }
+    session_refresh_work_locked(hub, s, 1);
+    pthread_mutex_unlock(&hub->lock);
+}
 
-    reverse_bytes(version, sizeof(version));
-    reverse_bytes(prev, sizeof(prev));
-    reverse_bytes(ntime, sizeof(ntime));
-    reverse_bytes(nbits, sizeof(nbits));
+static void apply_pending_extranonce(stratum_session *s) {
+    stratum_session_state *state = &s->state;
+    if (!state->extranonce_pending) return;
+    memcpy(state->extranonce1, state->pending_extranonce1, sizeof(state->extranonce1));
+    state->extranonce2_size = state->pending_extranonce2_size;
+    state->extranonce_pending = 0;
+    printf("%s extranonce aplicado: extranonce1=%s extranonce2_size=%d\n",
+           s->tag, state->extranonce1, state->extranonce2_size);
+}
 
-    uint8_t merkle_le[32];
-    memcpy(merkle_le, merkle_root, 32);
-    reverse_bytes(merkle_le, 32);
+static void handle_notify(stratum_hub *hub, stratum_session *s, json_view params) {
+    stratum_session_state *state = &s->state;
+    mining_state *mstate = &s->miner;
+    double fed_at = mono_seconds();
+    s->notify_count++;
+    bitcoin_compiled_job *cj = bitcoin_job_from_notify(params);
+    if (!cj) {
+        fprintf(stderr, "%s notify invalido ignorado\n", s->tag);
+        return;
+    }
+    printf("%s notify parseado: job_id=%s merkle_count=%zu clean=%d\n",
+           s->tag, cj->job_id, cj->merkle_count, cj->clean_jobs);
+    if (state->last_job_id[0] == '\0' || strcmp(state->last_job_id, cj->job_id) != 0) {
+        snprintf(state->last_job_id, sizeof(state->last_job_id), "%s", cj->job_id);
+        state->job_changes++;
+    }
+    if (cj->clean_jobs) {
+        state->clean_signals++;
+    }
+    mstate->has_job = 1;
+    if (!mstate->target_from_difficulty) {
+        mstate->target_ready = bitcoin_target_from_nbits(cj->nbits, mstate->target);
+    }
+    // Published together with the job in one locked refresh, so no batch
+    // mixes the new extranonce with an old job.
+    apply_pending_extranonce(s);
+    session_set_job(hub, s, cj);
+    if (hub->replay) {
+        pthread_mutex_lock(&hub->lock);
+        s->switch_started = s->has_work ? fed_at : 0.0;
+        s->switch_generation = s->work.generation;
+        pthread_mutex_unlock(&hub->lock);
+    }
+    printf("%s notify recebido (%zu no total)\n", s->tag, s->notify_count);
+}
 
-    memcpy(out, version, 4);
-    memcpy(out + 4, prev, 32);
-    memcpy(out + 36, merkle_le, 32);
-    memcpy(out + 68, ntime, 4);
-    memcpy(out + 72, nbits, 4);
-    uint32_to_le(nonce, out + 76);
-    return 1;
+static void handle_set_difficulty(stratum_hub *hub, stratum_session *s, json_view params) {
+    stratum_session_state *state = &s->state;
+    mining_state *mstate = &s->miner;
+    json_iter it;
+    json_view v;
+    if (!json_iter_init(&it, params) || !json_iter_next(&it, &v)) return;
+    double diff = json_view_double(v);
+    if (diff <= 0.0) return;
+    state->difficulty = diff;
+    state->set_difficulty_count++;
+    printf("%s difficulty set to %.8f (count=%zu)\n", s->tag, diff, state->set_difficulty_count);
+    share_rate_pool_difficulty(&s->rate_ctl, diff);
+    if (bitcoin_target_from_difficulty(diff, mstate->target)) {
+        mstate->target_ready = 1;
+        mstate->target_from_difficulty = 1;
+        session_refresh_work(hub, s, 0);
+    }
 }
 
-static int parse_json_id(const char *line, int *out) {
-    const char *p = strstr(line, "\"id\"");
-    if (!p) return 0;
-    p = strchr(p, ':');
-    if (!p) return 0;
-    p++;
-    skip_ws_local(&p);
-    int id = atoi(p);
-    if (id <= 0) return 0;
-    *out = id;
-    return 1;
+// The pool rebalanced extranonce1: keep hashing the current job with the old
+// one and switch when the next job arrives, instead of reconnecting.
+static void handle_set_extranonce(stratum_hub *hub, stratum_session *s, json_view params) {
+    stratum_session_state *state = &s->state;
+    json_iter it;
+    json_view v;
+    char en1[sizeof(state->pending_extranonce1)];
+    if (!json_iter_init(&it, params) || !json_iter_next(&it, &v) || !json_view_copy(v, en1, sizeof(en1))) {
+        fprintf(stderr, "%s set_extranonce invalido ignorado\n", s->tag);
+        return;
+    }
+    int en2_size = state->extranonce2_size;
+    if (json_iter_next(&it, &v)) en2_size = (int)json_view_int(v);
+    memcpy(state->pending_extranonce1, en1, sizeof(en1));
+    state->pending_extranonce2_size = en2_size;
+    state->extranonce_pending = 1;
+    state->extranonce_changes++;
+    printf("%s set_extranonce recebido: extranonce1=%s extranonce2_size=%d (vale a partir do proximo job)\n",
+           s->tag, en1, en2_size);
+    if (!s->latest) {
+        apply_pending_extranonce(s);
+        session_refresh_work(hub, s, 1);
+    }
 }
 
-static void process_line(const char *line, size_t len, bitcoin_job *job, size_t *notify_count, stratum_session_state *state, mining_state *mstate) {
-    printf("[stratum] recv line (%zu bytes): %.*s\n", len, (int)len, line);
-    if (strstr(line, "mining.notify") != NULL) {
-        if (job) {
-            if (bitcoin_job_parse_notify(job, line, len)) {
-                printf("[stratum] notify parseado: job_id=%s prevhash=%s merkle_count=%zu clean=%d\n",
-                       job->job_id, job->prev_hash, job->merkle_count, job->clean_jobs);
-                if (state) {
-                    if (state->last_job_id[0] == '\0' || strcmp(state->last_job_id, job->job_id) != 0) {
-                        strncpy(state->last_job_id, job->job_id, sizeof(state->last_job_id) - 1);
-                        state->last_job_id[sizeof(state->last_job_id) - 1] = '\0';
-                        state->job_changes++;
-                    }
-                    if (job->clean_jobs) {
-                        state->clean_signals++;
-                    }
-                }
-                if (mstate) {
-                    mstate->has_job = 1;
-                    mstate->nonce = 0;
-                    mstate->extranonce2_counter = 0;
-                    if (!mstate->target_from_difficulty) {
-                        if (target_from_nbits(job->nbits, mstate->target)) {
-                            mstate->target_ready = 1;
-                        } else {
-                            mstate->target_ready = 0;
-                        }
-                    }
-                }
-            } else {
-                bitcoin_job_note_notify(job);
-                bitcoin_job_set_last_notify(job, line, len);
-            }
+// The session id is the mining.notify subscription id; pools send either a
+// list of [method, id] pairs or a single pair.
+static void save_resume_id(stratum_session *s, json_view subscriptions) {
+    json_iter it, pair_it;
+    json_view item, name, id;
+    if (!json_iter_init(&it, subscriptions) || !json_iter_next(&it, &item)) return;
+    if (item.len > 0 && item.p[0] == '"') {
+        if (json_view_string_eq(item, "mining.notify") && json_iter_next(&it, &id)) {
+            json_view_copy(id, s->resume_id, sizeof(s->resume_id));
         }
-        (*notify_count)++;
-        printf("[stratum] notify recebido (%zu no total)\n", *notify_count);
-    }
-
-    if (strstr(line, "mining.set_difficulty") != NULL) {
-        const char *p = strstr(line, "\"params\":[");
-        if (p) {
-            p = strchr(p, '[');
-            if (p) {
-                p++;
-                skip_ws_local(&p);
-                double diff = strtod(p, NULL);
-                if (diff > 0.0) {
-                    if (state) {
-                        state->difficulty = diff;
-                        state->set_difficulty_count++;
-                    }
-                    printf("[stratum] difficulty set to %.8f (count=%zu)\n", diff, state ? state->set_difficulty_count : 0);
-                    if (mstate) {
-                        if (target_from_difficulty(diff, mstate->target)) {
-                            mstate->target_ready = 1;
-                            mstate->target_from_difficulty = 1;
-                        }
-                    }
-                }
-            }
+        return;
+    }
+    do {
+        if (json_iter_init(&pair_it, item) && json_iter_next(&pair_it, &name) &&
+            json_view_string_eq(name, "mining.notify") && json_iter_next(&pair_it, &id)) {
+            json_view_copy(id, s->resume_id, sizeof(s->resume_id));
+            return;
         }
+    } while (json_iter_next(&it, &item));
+}
+
+// Same extranonce1 after a reconnect means the pool resumed our session:
+// the job we were on is still valid, so hashing restarts without waiting
+// for a notify and without repeating nonces.
+static void resume_session(stratum_hub *hub, stratum_session *s) {
+    stratum_session_state *state = &s->state;
+    mining_state *mstate = &s->miner;
+    pthread_mutex_lock(&hub->lock);
+    bitcoin_compiled_job *job = s->resume_job;
+    s->resume_job = NULL;
+    int resumed = job && strcmp(state->extranonce1, s->resume_extranonce1) == 0 &&
+                  state->extranonce2_size == s->resume_extranonce2_size && !s->latest;
+    if (!resumed) {
+        job_release(job);
+        pthread_mutex_unlock(&hub->lock);
+        return;
     }
+    if (s->resume_difficulty > 0.0 && bitcoin_target_from_difficulty(s->resume_difficulty, mstate->target)) {
+        state->difficulty = s->resume_difficulty;
+        mstate->target_ready = 1;
+        mstate->target_from_difficulty = 1;
+    }
+    mstate->has_job = 1;
+    s->latest = job;
+    push_job_locked(s, job);
+    session_refresh_work_locked(hub, s, 1);
+    s->extranonce2_next = s->resume_extranonce2_next;
+    s->nonce_next = s->resume_nonce_next;
+    s->resumed++;
+    pthread_mutex_unlock(&hub->lock);
+    printf("%s sessao retomada (id=%s): extranonce1=%s mantido, job=%s continua\n",
+           s->tag, s->resume_id, state->extranonce1, job->job_id);
+}
 
-    if (strstr(line, "\"result\"") != NULL && strstr(line, "\"id\"") != NULL) {
-        int id = 0;
-        if (parse_json_id(line, &id) && id >= 1000) {
-            if (strstr(line, "\"result\":true") != NULL) {
-                if (state) state->submit_accepted++;
-                printf("[stratum] submit accepted (id=%d)\n", id);
-            } else if (strstr(line, "\"result\":false") != NULL) {
-                if (state) state->submit_rejected++;
-                printf("[stratum] submit rejected (id=%d)\n", id);
-            }
-        }
+static void handle_subscribe_result(stratum_hub *hub, stratum_session *s, json_view result) {
+    stratum_session_state *state = &s->state;
+    json_iter it;
+    json_view v;
+    if (json_iter_init(&it, result) && json_iter_next(&it, &v)) {
+        s->resume_id[0] = '\0';
+        save_resume_id(s, v);
     }
+    if (json_iter_init(&it, result) && json_iter_next(&it, &v) &&
+        json_iter_next(&it, &v) && json_view_copy(v, state->extranonce1, sizeof(state->extranonce1)) &&
+        json_iter_next(&it, &v)) {
+        state->extranonce2_size = (int)json_view_int(v);
+        printf("%s subscribe result: extranonce1=%s extranonce2_size=%d\n",
+               s->tag, state->extranonce1, state->extranonce2_size);
+        resume_session(hub, s);
+        session_refresh_work(hub, s, 0);
+    }
+}
 
-    if (strstr(line, "\"id\":1") && strstr(line, "\"result\":[") && strstr(line, "mining.subscribe")) {
-        const char *r = strstr(line, "\"result\":[");
-        if (r) {
-            const char *first_close = strchr(r, ']');
-            if (first_close) {
-                const char *p = first_close + 1;
-                skip_ws_local(&p);
-                if (*p == ',') p++;
-                skip_ws_local(&p);
-                    if (*p == '\"') {
-                        p++;
-                        size_t len_ex = 0;
-                        while (p[len_ex] && p[len_ex] != '\"' && len_ex + 1 < sizeof(state->extranonce1)) {
-                            state->extranonce1[len_ex] = p[len_ex];
-                        len_ex++;
-                    }
-                    state->extranonce1[len_ex] = '\0';
-                    const char *after_ex = strchr(p, '\"');
-                    if (after_ex) {
-                        p = after_ex + 1;
-                        skip_ws_local(&p);
-                        if (*p == ',') p++;
-                        skip_ws_local(&p);
-                        state->extranonce2_size = atoi(p);
-                    }
-                    printf("[stratum] subscribe result: extranonce1=%s extranonce2_size=%d\n", state->extranonce1, state->extranonce2_size);
-                }
-            }
-        }
+static int view_contains(json_view v, const char *needle) {
+    size_t n = strlen(needle);
+    for (size_t i = 0; i + n <= v.len; i++) {
+        size_t j = 0;
+        while (j < n && tolower((unsigned char)v.p[i + j]) == needle[j]) j++;
+        if (j == n) return 1;
     }
+    return 0;
 }
 
-static int recv_lines(int sock, bitcoin_job *job, size_t *notify_count, size_t *bytes_in, stratum_session_state *state, mining_state *mstate) {
-    char buf[4096];
-    ssize_t n = recv(sock, buf, sizeof(buf), 0);
-    if (n <= 0) return 0;
-    if (bytes_in) *bytes_in += (size_t)n;
+// Pools report rejects as [code, "message", data]; the codes are only
+// loosely standardised, so the message is checked as well.
+static submit_outcome classify_reject(json_view error) {
+    json_iter it;
+    json_view v;
+    json_view text = {NULL, 0};
+    long long code = 0;
+    if (json_iter_init(&it, error) && json_iter_next(&it, &v)) {
+        code = json_view_int(v);
+        if (json_iter_next(&it, &v)) json_view_string(v, &text);
+    } else {
+        json_view_string(error, &text);
+    }
+    if (code == 21 || view_contains(text, "stale") || view_contains(text, "job not found")) return SUBMIT_STALE;
+    if (code == 22 || view_contains(text, "duplicate")) return SUBMIT_DUPLICATE;
+    if (code == 23 || view_contains(text, "low difficulty") || view_contains(text, "above target") ||
+        view_contains(text, "high-hash")) {
+        return SUBMIT_LOW_DIFF;
+    }
+    return SUBMIT_REJECTED;
+}
 
-    static char stash[8192];
-    static size_t stash_len = 0;
+static void handle_submit_result(stratum_session *s, long long id, const json_message *msg) {
+    double now = mono_seconds();
+    submit_outcome outcome = json_view_is(msg->result, "true") ? SUBMIT_ACCEPTED : classify_reject(msg->error);
+    pthread_mutex_lock(&s->send_lock);
+    const inflight_submit *sub = inflight_find(&s->inflight, id);
+    if (!sub) {
+        pthread_mutex_unlock(&s->send_lock);
+        printf("%s resposta tardia ou desconhecida para submit id=%lld\n", s->tag, id);
+        return;
+    }
+    printf("%s submit %s (id=%lld job=%s nonce=%08x diff=%.8f rtt=%.1fms)%s%.*s\n",
+           s->tag, submit_outcome_name(outcome), id, sub->job_id, sub->nonce, sub->difficulty,
+           1000.0 * (now - sub->sent_at), outcome == SUBMIT_ACCEPTED ? "" : " erro=",
+           outcome == SUBMIT_ACCEPTED ? 0 : (int)msg->error.len, msg->error.p ? msg->error.p : "");
+    inflight_finish(&s->inflight, id, outcome, now);
+    pthread_mutex_unlock(&s->send_lock);
+}
 
-    if ((size_t)n + stash_len >= sizeof(stash)) {
-        stash_len = 0;  // drop overflow
+static void process_line(stratum_hub *hub, stratum_session *s, const char *line, size_t len) {
+    json_message msg;
+
+    if (!hub->replay) printf("%s recv line (%zu bytes): %.*s\n", s->tag, len, (int)len, line);
+    if (!json_parse_message(line, len, &msg)) {
+        fprintf(stderr, "%s mensagem JSON invalida ignorada\n", s->tag);
+        return;
+    }
+
+    if (msg.method.p) {
+        if (json_view_string_eq(msg.method, "mining.notify")) {
+            handle_notify(hub, s, msg.params);
+        } else if (json_view_string_eq(msg.method, "mining.set_difficulty")) {
+            handle_set_difficulty(hub, s, msg.params);
+        } else if (json_view_string_eq(msg.method, "mining.set_extranonce")) {
+            handle_set_extranonce(hub, s, msg.params);
+        }
+        return;
     }
-    memcpy(stash + stash_len, buf, (size_t)n);
-    stash_len += (size_t)n;
 
-    size_t start = 0;
-    for (size_t i = 0; i < stash_len; i++) {
-        if (stash[i] == '\n') {
-            size_t line_len = i - start;
-            if (line_len > 0 && stash[start + line_len - 1] == '\r') line_len--;
-            process_line(stash + start, line_len, job, notify_count ? notify_count : &(size_t){0}, state, mstate);
-            start = i + 1;
+    long long id = json_view_int(msg.id);
+    if (id == 1 && msg.result.p) {
+        handle_subscribe_result(hub, s, msg.result);
+    } else if (id == STRATUM_EXTRANONCE_SUBSCRIBE_ID) {
+        if (!json_view_is(msg.result, "true")) {
+            printf("%s pool sem suporte a mining.extranonce.subscribe\n", s->tag);
         }
+    } else if (id == STRATUM_SUGGEST_ID) {
+        // Pools that do not know the method answer with an error; ones that
+        // accept it usually follow up with set_difficulty.
+        if (!json_view_is(msg.result, "true") && msg.error.p && !json_view_is(msg.error, "null")) {
+            printf("%s pool nao aceita sugestao de dificuldade: %.*s\n", s->tag, (int)msg.error.len, msg.error.p);
+            share_rate_unsupported(&s->rate_ctl);
+        }
+    } else if (id >= 1000) {
+        handle_submit_result(s, id, &msg);
+    }
+}
+
+static int recv_lines(stratum_hub *hub, stratum_session *s) {
+    ssize_t n = net_reader_recv(&s->rx, s->sock);
+    if (n <= 0) return 0;
+    s->bytes_in += (size_t)n;
+
+    const char *line;
+    size_t len;
+    while (net_reader_next(&s->rx, &line, &len)) {
+        recorder_write(s->recorder, s->index, RECORD_RX, line, len);
+        process_line(hub, s, line, len);
     }
-    if (start > 0) {
-        memmove(stash, stash + start, stash_len - start);
-        stash_len -= start;
+    if (net_reader_pending(&s->rx) > STRATUM_MAX_LINE) {
+        fprintf(stderr, "%s mensagem maior que %d bytes sem quebra de linha\n", s->tag, STRATUM_MAX_LINE);
+        return 0;
     }
     return 1;
 }
 
-static int send_ping(int sock) {
-    const char *ping = "{\"id\":999,\"method\":\"mining.ping\",\"params\":[]}\n";
-    ssize_t s = send(sock, ping, strlen(ping), 0);
-    if (s < 0) return 0;
-    printf("[stratum] ping enviado\n");
+static int session_send(stratum_session *s, const char *line) {
+    pthread_mutex_lock(&s->send_lock);
+    int ok = s->sock != -1 && net_send_line(s->sock, line);
+    if (ok) {
+        s->bytes_out += strlen(line) + 1;
+        recorder_write(s->recorder, s->index, RECORD_TX, line, strlen(line));
+    }
+    pthread_mutex_unlock(&s->send_lock);
+    return ok;
+}
+
+static void maybe_suggest_difficulty(stratum_hub *hub, stratum_session *s, double now) {
+    pthread_mutex_lock(&hub->lock);
+    double rate = hub->sched.slots[s->index].rate;
+    pthread_mutex_unlock(&hub->lock);
+    double diff;
+    char line[256];
+    if (!share_rate_decide(&s->rate_ctl, rate, now, &diff)) return;
+    if (!share_rate_format(&s->rate_ctl, STRATUM_SUGGEST_ID, diff, line, sizeof(line))) return;
+    printf("%s sugerindo difficulty %.8f (%.2f H/s, alvo %.1f shares/min, atual %.1f/min)\n",
+           s->tag, diff, rate, s->rate_ctl.target_spm, share_rate_expected_spm(rate, s->state.difficulty));
+    session_send(s, line);
+}
+
+static int send_ping(stratum_session *s) {
+    if (!session_send(s, "{\"id\":999,\"method\":\"mining.ping\",\"params\":[]}")) return 0;
+    printf("%s ping enviado\n", s->tag);
     return 1;
 }
 
-static int submit_share(int sock, stratum_session_state *session, const bitcoin_job *job, const char *user,
-                        const uint8_t *extranonce2, size_t extranonce2_len, uint32_t nonce) {
-    if (!session || !job || !user) return 0;
+// Sends without waiting for the reply; the pool's answer is matched back to
+// the share through the in-flight table.
+static int submit_share(stratum_session *s, const stratum_work *work, uint64_t extranonce2_counter,
+                        const uint8_t *extranonce2, uint32_t nonce) {
     char en2_hex[64];
     char nonce_hex[16];
-    if (extranonce2_len * 2 + 1 > sizeof(en2_hex)) return 0;
-    hex_from_bytes(extranonce2, extranonce2_len, en2_hex, sizeof(en2_hex));
-
-    uint8_t nonce_le[4];
-    uint32_to_le(nonce, nonce_le);
-    hex_from_bytes(nonce_le, sizeof(nonce_le), nonce_hex, sizeof(nonce_hex));
+    hex_encode(extranonce2, work->extranonce2_size, en2_hex);
+    en2_hex[work->extranonce2_size * 2] = '\0';
+    snprintf(nonce_hex, sizeof(nonce_hex), "%08x", nonce);
 
-    int submit_id = 1000 + session->submit_seq++;
-    char submit[512];
-    snprintf(submit, sizeof(submit),
+    if (s->replay) {
+        pthread_mutex_lock(&s->send_lock);
+        s->shares_found++;
+        pthread_mutex_unlock(&s->send_lock);
+        return 1;
+    }
+    size_t cap = strlen(s->pool.user) + strlen(work->job->job_id) + 160;
+    char *submit = malloc(cap);
+    if (!submit) return 0;
+    pthread_mutex_lock(&s->send_lock);
+    int submit_id = 1000 + s->state.submit_seq++;
+    snprintf(submit, cap,
              "{\"id\":%d,\"method\":\"mining.submit\",\"params\":[\"%s\",\"%s\",\"%s\",\"%s\",\"%s\"]}",
-             submit_id, user, job->job_id, en2_hex, job->ntime, nonce_hex);
-
-    return send_line(sock, submit);
+             submit_id, s->pool.user, work->job->job_id, en2_hex, work->job->ntime, nonce_hex);
+    int ok = s->sock != -1 && net_send_line(s->sock, submit);
+    if (ok) {
+        s->bytes_out += strlen(submit) + 1;
+        recorder_write(s->recorder, s->index, RECORD_TX, submit, strlen(submit));
+        inflight_add(&s->inflight, submit_id, work->job->job_id, extranonce2_counter, nonce,
+                     work->difficulty, mono_seconds());
+    }
+    s->shares_found++;
+    pthread_mutex_unlock(&s->send_lock);
+    free(submit);
+    return ok;
 }
 
-static void report_mining_progress(mining_state *mstate, const char *label) {
-    if (!mstate || mstate->report_interval == 0) return;
-    if (mstate->attempts % mstate->report_interval != 0) return;
-    double elapsed = (double)clock() / (double)CLOCKS_PER_SEC - mstate->start_time;
-    double rate = (elapsed > 0.0) ? (double)mstate->attempts / elapsed : 0.0;
-    printf("[progress] %s: %llu tentativas | %.2f H/s | %.2fs\n",
-           label, (unsigned long long)mstate->attempts, rate, elapsed);
-}
+static int next_batch(stratum_hub *hub, hash_batch *out) {
+    int slot = sched_pick(&hub->sched, mono_seconds());
+    if (slot < 0) return 0;
+    stratum_session *s = &hub->sessions[slot];
+    if (!s->has_work) {
+        sched_set_active(&hub->sched, slot, 0);
+        return 0;
+    }
 
-static void mine_batch(int sock, const bitcoin_job *job, stratum_session_state *session, mining_state *mstate, const char *user, uint32_t batch) {
-    if (!job || !session || !mstate || !mstate->has_job || !mstate->target_ready) return;
-    if (session->extranonce1[0] == '\0' || session->extranonce2_size <= 0) return;
-    if (session->extranonce2_size > 8) {
-        return;
+    uint64_t remaining = 0x100000000ull - s->nonce_next;
+    uint32_t count = remaining < hub->batch_nonces ? (uint32_t)remaining : hub->batch_nonces;
+    out->slot = slot;
+    out->work = s->work;
+    out->work.job->refs++;
+    out->extranonce2 = s->extranonce2_next;
+    out->nonce_start = (uint32_t)s->nonce_next;
+    out->count = count;
+    if (s->switch_started > 0.0 && s->work.generation >= s->switch_generation) {
+        if (hub->switch_count == hub->switch_cap) {
+            size_t cap = hub->switch_cap ? hub->switch_cap * 2 : 256;
+            double *n = realloc(hub->switch_samples, cap * sizeof(*n));
+            if (n) {
+                hub->switch_samples = n;
+                hub->switch_cap = cap;
+            }
+        }
+        if (hub->switch_count < hub->switch_cap) {
+            hub->switch_samples[hub->switch_count++] = mono_seconds() - s->switch_started;
+        }
+        s->switch_started = 0.0;
+    }
+
+    s->nonce_next += count;
+    if (s->nonce_next >= 0x100000000ull) {
+        s->nonce_next = 0;
+        s->extranonce2_next++;
+        if (s->work.extranonce2_size < 8 && s->extranonce2_next >> (s->work.extranonce2_size * 8)) {
+            s->extranonce2_next = 0;
+        }
     }
+    sched_charge(&hub->sched, slot, (double)count);
+    return 1;
+}
 
-    uint8_t extranonce2[8] = {0};
+static uint64_t run_batch(stratum_hub *hub, const hash_batch *b) {
+    stratum_session *s = &hub->sessions[b->slot];
+    const stratum_work *work = &b->work;
+
+    uint8_t extranonce2[8];
     uint8_t merkle[32];
     uint8_t header[80];
-    uint8_t hash[32];
+    fill_extranonce2(b->extranonce2, extranonce2, work->extranonce2_size);
+    if (!bitcoin_compiled_merkle_root(work->job, work->extranonce1, work->extranonce1_len,
+                                      extranonce2, work->extranonce2_size, merkle)) {
+        return 0;
+    }
+    bitcoin_compiled_header(work->job, merkle, b->nonce_start, header);
 
-    for (uint32_t i = 0; i < batch && !stop_flag; i++) {
-        fill_extranonce2(mstate->extranonce2_counter, extranonce2, (size_t)session->extranonce2_size);
-        if (!bitcoin_build_merkle_root(job, session->extranonce1, extranonce2, (size_t)session->extranonce2_size, merkle)) {
-            return;
+    // The first 64 header bytes do not depend on the nonce.
+    sha256_ctx midstate;
+    sha256_init(&midstate);
+    sha256_update(&midstate, header, 64);
+
+    uint64_t done = 0;
+    for (uint32_t i = 0; i < b->count; i++) {
+        if ((i & 0xFFFu) == 0 && (stop_flag || atomic_load(&s->abort_before) > work->generation)) break;
+        uint32_t nonce = b->nonce_start + i;
+        header[76] = (uint8_t)(nonce & 0xFF);
+        header[77] = (uint8_t)((nonce >> 8) & 0xFF);
+        header[78] = (uint8_t)((nonce >> 16) & 0xFF);
+        header[79] = (uint8_t)((nonce >> 24) & 0xFF);
+
+        uint8_t first[32];
+        uint8_t hash[32];
+        sha256_ctx ctx = midstate;
+        sha256_update(&ctx, header + 64, 16);
+        sha256_final(&ctx, first);
+        sha256_init(&ctx);
+        sha256_update(&ctx, first, sizeof(first));
+        sha256_final(&ctx, hash);
+        done++;
+
+        if (bitcoin_hash_meets_target(hash, work->target)) {
+            // Submit against the job that was hashed, as long as no
+            // clean_jobs notify has invalidated it since.
+            pthread_mutex_lock(&hub->lock);
+            int valid = accept_share_locked(s, work, b->extranonce2, nonce, hash);
+            pthread_mutex_unlock(&hub->lock);
+            if (!valid) continue;
+            printf("%s share found job=%s nonce=%08x extranonce2=%llu\n",
+                   s->tag, work->job->job_id, nonce, (unsigned long long)b->extranonce2);
+            if (!submit_share(s, work, b->extranonce2, extranonce2, nonce)) {
+                fprintf(stderr, "%s share descartado: sessao desconectada\n", s->tag);
+            }
         }
+    }
+    return done;
+}
 
-        if (!build_block_header(job, merkle, mstate->nonce, header)) {
+static void stratum_worker(void *ctx, int index) {
+    (void)index;
+    stratum_hub *hub = ctx;
+    while (!stop_flag) {
+        hash_batch batch;
+        pthread_mutex_lock(&hub->lock);
+        if (!next_batch(hub, &batch)) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 200000000L;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&hub->work_ready, &hub->lock, &ts);
+            pthread_mutex_unlock(&hub->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&hub->lock);
+
+        uint64_t done = run_batch(hub, &batch);
+
+        pthread_mutex_lock(&hub->lock);
+        sched_complete(&hub->sched, batch.slot, batch.count, done);
+        job_release(batch.work.job);
+        pthread_mutex_unlock(&hub->lock);
+    }
+}
+
+static void session_disconnect(stratum_hub *hub, stratum_session *s, double now) {
+    pthread_mutex_lock(&hub->lock);
+    // Keep the current job aside in case the pool resumes the session.
+    job_release(s->resume_job);
+    s->resume_job = s->latest;
+    s->latest = NULL;
+    snprintf(s->resume_extranonce1, sizeof(s->resume_extranonce1), "%s", s->state.extranonce1);
+    s->resume_extranonce2_size = s->state.extranonce2_size;
+    s->resume_difficulty = s->state.difficulty;
+    s->resume_extranonce2_next = s->extranonce2_next;
+    s->resume_nonce_next = s->nonce_next;
+    clear_jobs_locked(s);
+    session_refresh_work_locked(hub, s, 0);
+    atomic_store(&s->abort_before, ++hub->generation);
+    pthread_mutex_unlock(&hub->lock);
+
+    pthread_mutex_lock(&s->send_lock);
+    if (s->sock != -1) close(s->sock);
+    s->sock = -1;
+    size_t lost = inflight_drop_all(&s->inflight);
+    pthread_mutex_unlock(&s->send_lock);
+    if (lost > 0) fprintf(stderr, "%s %zu share(s) enviados ficaram sem resposta\n", s->tag, lost);
+
+    printf("%s finalizado. Notifies recebidas: %zu\n", s->tag, s->notify_count);
+    if (stop_flag) return;
+    s->attempts++;
+    const stratum_options *opts = hub->opts;
+    if (opts->max_reconnects >= 0 && s->attempts > opts->max_reconnects) {
+        fprintf(stderr, "%s limite de reconexoes atingido (%d)\n", s->tag, opts->max_reconnects);
+        s->dead = 1;
+        return;
+    }
+    double delay = net_backoff_delay(opts->reconnect_delay_secs, s->attempts);
+    printf("%s reconectando em %.1f segundos (tentativa %d)...\n", s->tag, delay, s->attempts + 1);
+    s->next_connect = now + delay;
+}
+
+static void session_connected(stratum_hub *hub, stratum_session *s, double now, int sock) {
+    const stratum_options *opts = hub->opts;
+    if (stop_flag) {
+        if (sock != -1) close(sock);
+        return;
+    }
+    if (sock == -1) {
+        s->attempts++;
+        if (opts->max_reconnects >= 0 && s->attempts > opts->max_reconnects) {
+            fprintf(stderr, "%s conexao falhou apos %d tentativas\n", s->tag, s->attempts);
+            s->dead = 1;
             return;
         }
+        double delay = net_backoff_delay(opts->reconnect_delay_secs, s->attempts);
+        fprintf(stderr, "%s tentando reconectar em %.1f segundos...\n", s->tag, delay);
+        s->next_connect = now + delay;
+        return;
+    }
 
-        double_sha256(header, sizeof(header), hash);
-        mstate->attempts++;
-        report_mining_progress(mstate, "stratum");
+    printf("%s conectado a %s:%s (tentativa %d)\n", s->tag, s->pool.host, s->pool.port, s->attempts + 1);
+    s->attempts = 0;
+    memset(&s->state, 0, sizeof(s->state));
+    memset(&s->miner, 0, sizeof(s->miner));
+    share_rate_init(&s->rate_ctl, opts->share_rate);
+    net_reader_reset(&s->rx);
+    s->notify_count = 0;
+    s->last_ping = time(NULL);
 
-        if (hash_meets_target(hash, mstate->target)) {
-            printf("[stratum] share found nonce=%u extranonce2=%llu\n",
-                   mstate->nonce, (unsigned long long)mstate->extranonce2_counter);
-            submit_share(sock, session, job, user, extranonce2, (size_t)session->extranonce2_size, mstate->nonce);
+    pthread_mutex_lock(&s->send_lock);
+    s->sock = sock;
+    pthread_mutex_unlock(&s->send_lock);
+
+    printf("%s alvo coin: %s\n", s->tag, coin_type_to_name(opts->coin));
+    char subscribe[256];
+    if (s->resume_id[0] != '\0') {
+        snprintf(subscribe, sizeof(subscribe), "{\"id\":1,\"method\":\"mining.subscribe\",\"params\":[\"coinminer/%s\",\"%s\"]}",
+                 COINMINER_VERSION, s->resume_id);
+    } else {
+        snprintf(subscribe, sizeof(subscribe), "{\"id\":1,\"method\":\"mining.subscribe\",\"params\":[\"coinminer/%s\"]}",
+                 COINMINER_VERSION);
+    }
+    if (!session_send(s, subscribe)) {
+        fprintf(stderr, "%s falha ao enviar subscribe\n", s->tag);
+        session_disconnect(hub, s, now);
+        return;
+    }
+    char authorize[512];
+    snprintf(authorize, sizeof(authorize), "{\"id\":2,\"method\":\"mining.authorize\",\"params\":[\"%s\",\"%s\"]}",
+             s->pool.user, s->pool.password[0] ? s->pool.password : "x");
+    if (!session_send(s, authorize)) {
+        fprintf(stderr, "%s falha ao enviar authorize\n", s->tag);
+        session_disconnect(hub, s, now);
+        return;
+    }
+    char subscribe_extranonce[96];
+    snprintf(subscribe_extranonce, sizeof(subscribe_extranonce),
+             "{\"id\":%d,\"method\":\"mining.extranonce.subscribe\",\"params\":[]}", STRATUM_EXTRANONCE_SUBSCRIBE_ID);
+    if (!session_send(s, subscribe_extranonce)) {
+        fprintf(stderr, "%s falha ao enviar extranonce.subscribe\n", s->tag);
+        session_disconnect(hub, s, now);
+        return;
+    }
+    printf("%s aguardando mensagens (Ctrl+C para sair)...\n", s->tag);
+}
+
+// The connect runs on the session's connector thread, so one slow pool
+// does not hold up the others; poll_sessions picks the socket up.
+static void session_connect(stratum_hub *hub, stratum_session *s, double now) {
+    if (!net_connector_start(&s->connector, s->pool.host, s->pool.port)) session_connected(hub, s, now, -1);
+}
+
+static void print_submit_stats(stratum_session *s) {
+    pthread_mutex_lock(&s->send_lock);
+    const inflight_table *t = &s->inflight;
+    const latency_histogram *h = &t->latency;
+    if (h->count > 0 || t->pending > 0) {
+        printf("%s submit:", s->tag);
+        for (int o = 0; o < SUBMIT_OUTCOMES; o++) {
+            printf(" %s=%zu", submit_outcome_name((submit_outcome)o), t->outcomes[o]);
+        }
+        printf(" pendentes=%zu\n", t->pending);
+    }
+    if (h->count > 0) {
+        printf("%s submit rtt: n=%llu avg=%.1fms p50<=%.0fms p90<=%.0fms p99<=%.0fms max=%.1fms\n",
+               s->tag, (unsigned long long)h->count, 1000.0 * h->sum / (double)h->count,
+               1000.0 * latency_percentile(h, 0.5), 1000.0 * latency_percentile(h, 0.9),
+               1000.0 * latency_percentile(h, 0.99), 1000.0 * h->max);
+    }
+    pthread_mutex_unlock(&s->send_lock);
+}
+
+static void print_session_stats(stratum_hub *hub, stratum_session *s) {
+    printf("%s stats: coin=%s | notify=%zu | bytes_in=%zu | bytes_out=%zu\n",
+           s->tag, coin_type_to_name(hub->opts->coin), s->notify_count, s->bytes_in, s->bytes_out);
+    stratum_session_state *state = &s->state;
+    pthread_mutex_lock(&hub->lock);
+    bitcoin_compiled_job *job = s->latest;
+    if (job) {
+        size_t history = 0;
+        for (size_t i = 0; i < STRATUM_JOB_RING; i++) history += s->jobs[i].job ? 1 : 0;
+        printf("%s job: id=%s merkle=%zu coinbase=%zu bytes ntime=%s clean=%d\n",
+               s->tag, job->job_id, job->merkle_count, job->coinb1_len + job->coinb2_len, job->ntime, job->clean_jobs);
+        printf("%s historico: %zu job(s) validos | shares de jobs anteriores=%zu | descartados por clean=%zu\n",
+               s->tag, history, s->old_job_shares, s->invalidated_shares);
+    }
+    if (s->filtered_duplicate || s->filtered_low_diff) {
+        printf("%s filtrados antes do submit: duplicados=%zu low-diff=%zu\n",
+               s->tag, s->filtered_duplicate, s->filtered_low_diff);
+    }
+    pthread_mutex_unlock(&hub->lock);
+    if (state->difficulty > 0.0 || state->extranonce1[0] != '\0') {
+        printf("%s session: difficulty=%.8f (set %zux) extranonce1=%s extranonce2_size=%d (trocas=%zu)\n",
+               s->tag, state->difficulty, state->set_difficulty_count, state->extranonce1, state->extranonce2_size,
+               state->extranonce_changes);
+        if (s->resumed) printf("%s sessao retomada %zux apos reconexao\n", s->tag, s->resumed);
+    }
+    print_submit_stats(s);
+    if (s->rate_ctl.target_spm > 0.0) {
+        pthread_mutex_lock(&hub->lock);
+        double rate = hub->sched.slots[s->index].rate;
+        pthread_mutex_unlock(&hub->lock);
+        printf("%s share rate: alvo=%.1f/min esperado=%.1f/min sugestoes=%u recusadas pelo vardiff=%u%s\n",
+               s->tag, s->rate_ctl.target_spm, share_rate_expected_spm(rate, state->difficulty),
+               s->rate_ctl.suggestions, s->rate_ctl.overrides,
+               s->rate_ctl.method == SUGGEST_NONE ? " (pool sem suporte)" : "");
+    }
+    if (state->job_changes > 0 || state->clean_signals > 0) {
+        printf("%s jobs: changes=%zu clean_signals=%zu last_job_id=%s\n",
+               s->tag, state->job_changes, state->clean_signals, state->last_job_id);
+    }
+    uint8_t ex1[32];
+    size_t ex1_len = 0;
+    if (job && state->extranonce1[0] != '\0' && hex_decode(state->extranonce1, strlen(state->extranonce1), ex1, sizeof(ex1), &ex1_len)) {
+        uint8_t merkle[32];
+        uint8_t en2[64] = {0};
+        size_t en2_len = 0;
+        if (state->extranonce2_size > 0) {
+            en2_len = (size_t)state->extranonce2_size;
+            if (en2_len > sizeof(en2)) en2_len = sizeof(en2);
+        }
+        if (bitcoin_compiled_merkle_root(job, ex1, ex1_len, en2, en2_len, merkle)) {
+            char hexroot[65];
+            hex_encode(merkle, 32, hexroot);
+            hexroot[64] = '\0';
+            printf("%s merkle (with extranonce2=%zu bytes of 0x00): %s\n", s->tag, en2_len, hexroot);
+        }
+    }
+}
+
+static void print_split(stratum_hub *hub, double elapsed) {
+    pthread_mutex_lock(&hub->lock);
+    double total_rate = 0.0;
+    uint64_t total_hashes = 0;
+    for (size_t i = 0; i < hub->count; i++) {
+        total_rate += hub->sched.slots[i].rate;
+        total_hashes += hub->sched.slots[i].hashes;
+    }
+    printf("[progress] stratum: %llu tentativas | %.2f H/s | %.2fs\n",
+           (unsigned long long)total_hashes, total_rate, elapsed);
+    if (hub->count > 1) {
+        for (size_t i = 0; i < hub->count; i++) {
+            const sched_slot *sl = &hub->sched.slots[i];
+            stratum_session *s = &hub->sessions[i];
+            printf("%s split: %s:%s peso=%.1f%% efetivo=%.1f%% rate=%.2f H/s hashes=%llu shares=%zu%s\n",
+                   s->tag, s->pool.host, s->pool.port,
+                   100.0 * sched_weight_share(&hub->sched, (int)i), 100.0 * sched_rate_share(&hub->sched, (int)i),
+                   sl->rate, (unsigned long long)sl->hashes, s->shares_found, sl->active ? "" : " (inativo)");
         }
+    }
+    pthread_mutex_unlock(&hub->lock);
+}
 
-        mstate->nonce++;
-        if (mstate->nonce == 0) {
-            mstate->extranonce2_counter++;
+// Polls the connected sessions (and the connects still running) once and
+// handles whatever they sent. Returns 0 only if poll itself fails.
+static int poll_sessions(stratum_hub *hub, int timeout_ms) {
+    struct pollfd fds[STRATUM_MAX_POOLS];
+    stratum_session *polled[STRATUM_MAX_POOLS];
+    nfds_t nfds = 0;
+    for (size_t i = 0; i < hub->count; i++) {
+        stratum_session *s = &hub->sessions[i];
+        if (s->sock == -1 && !s->connector.busy) continue;
+        fds[nfds].fd = s->sock != -1 ? s->sock : s->connector.wake_fd;
+        fds[nfds].events = POLLIN;
+        fds[nfds].revents = 0;
+        polled[nfds] = s;
+        nfds++;
+    }
+    int rc = poll(fds, nfds, timeout_ms);
+    if (rc < 0) {
+        if (errno == EINTR) return 1;
+        perror("[stratum] poll");
+        return 0;
+    }
+    double now = mono_seconds();
+    for (nfds_t i = 0; i < nfds; i++) {
+        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+        int sock;
+        if (polled[i]->sock == -1) {
+            if (net_connector_finish(&polled[i]->connector, &sock)) session_connected(hub, polled[i], now, sock);
+            continue;
+        }
+        if (!recv_lines(hub, polled[i])) {
+            fprintf(stderr, "%s conexao encerrada\n", polled[i]->tag);
+            session_disconnect(hub, polled[i], now);
         }
     }
+    return 1;
+}
+
+static void expire_submits(stratum_hub *hub, double now) {
+    for (size_t i = 0; i < hub->count; i++) {
+        stratum_session *s = &hub->sessions[i];
+        pthread_mutex_lock(&s->send_lock);
+        size_t expired = s->inflight.pending ? inflight_expire(&s->inflight, now, STRATUM_SUBMIT_TIMEOUT) : 0;
+        pthread_mutex_unlock(&s->send_lock);
+        if (expired > 0) {
+            fprintf(stderr, "%s %zu share(s) sem resposta do pool apos %.0fs\n", s->tag, expired, STRATUM_SUBMIT_TIMEOUT);
+        }
+    }
+}
+
+static size_t pending_submits(stratum_hub *hub) {
+    size_t pending = 0;
+    for (size_t i = 0; i < hub->count; i++) {
+        stratum_session *s = &hub->sessions[i];
+        pthread_mutex_lock(&s->send_lock);
+        if (s->sock != -1) pending += s->inflight.pending;
+        pthread_mutex_unlock(&s->send_lock);
+    }
+    return pending;
+}
+
+// Called with the workers stopped: keeps reading until the pool answered
+// every share already sent, so a restart does not lose the last ones.
+static void drain_submits(stratum_hub *hub) {
+    size_t pending = pending_submits(hub);
+    if (pending == 0) return;
+    printf("[stratum] aguardando resposta de %zu share(s) pendente(s) (Ctrl+C de novo para sair)...\n", pending);
+    double deadline = mono_seconds() + STRATUM_DRAIN_SECS;
+    while (pending > 0 && stop_flag < 2 && mono_seconds() < deadline) {
+        if (!poll_sessions(hub, 200)) break;
+        pending = pending_submits(hub);
+    }
+    if (pending > 0) fprintf(stderr, "[stratum] %zu share(s) sem resposta ao encerrar\n", pending);
+}
+
+static void free_session(stratum_hub *hub, stratum_session *s) {
+    inflight_free(&s->inflight);
+    pthread_mutex_lock(&hub->lock);
+    job_release(s->latest);
+    s->latest = NULL;
+    job_release(s->resume_job);
+    s->resume_job = NULL;
+    clear_jobs_locked(s);
+    for (size_t j = 0; j < STRATUM_JOB_RING; j++) share_set_free(&s->jobs[j].submitted);
+    pthread_mutex_unlock(&hub->lock);
+    net_reader_free(&s->rx);
+    net_connector_free(&s->connector);
+    pthread_mutex_destroy(&s->send_lock);
+}
+
+static void init_session(stratum_session *s, int index, int multi, const stratum_pool_options *pool) {
+    memset(s, 0, sizeof(*s));
+    s->index = index;
+    s->pool = *pool;
+    s->sock = -1;
+    net_connector_init(&s->connector);
+    if (multi) {
+        snprintf(s->tag, sizeof(s->tag), "[stratum#%d]", index);
+    } else {
+        snprintf(s->tag, sizeof(s->tag), "[stratum]");
+    }
+    pthread_mutex_init(&s->send_lock, NULL);
+    inflight_init(&s->inflight);
+    atomic_init(&s->abort_before, 0);
 }
 
 int stratum_run(const stratum_options *opts) {
@@ -457,140 +1117,279 @@ int stratum_run(const stratum_options *opts) {
     signal(SIGTERM, handle_stop);
 #endif
 
-    int attempts = 0;
+    stratum_pool_options pools[STRATUM_MAX_POOLS];
+    size_t pool_count = 0;
+    memset(&pools[0], 0, sizeof(pools[0]));
+    snprintf(pools[0].host, sizeof(pools[0].host), "%s", opts->host ? opts->host : "");
+    snprintf(pools[0].port, sizeof(pools[0].port), "%s", opts->port ? opts->port : "");
+    snprintf(pools[0].user, sizeof(pools[0].user), "%s", opts->user ? opts->user : "");
+    snprintf(pools[0].password, sizeof(pools[0].password), "%s", opts->password ? opts->password : "");
+    pools[0].weight = opts->weight > 0.0 ? opts->weight : 1.0;
+    pool_count = 1;
+    for (int i = 0; i < opts->extra_pool_count && pool_count < STRATUM_MAX_POOLS; i++) {
+        pools[pool_count++] = opts->extra_pools[i];
+    }
+
+    stratum_recorder recorder;
+    if (opts->record_path) {
+        if (!recorder_open(&recorder, opts->record_path)) return 1;
+        printf("[stratum] gravando trafego em %s\n", opts->record_path);
+    }
+
+    stratum_hub hub;
+    memset(&hub, 0, sizeof(hub));
+    hub.opts = opts;
+    hub.count = pool_count;
+    hub.batch_nonces = STRATUM_BATCH_NONCES;
+    hub.sessions = calloc(pool_count, sizeof(*hub.sessions));
+    if (!hub.sessions) return 1;
+    pthread_mutex_init(&hub.lock, NULL);
+    pthread_cond_init(&hub.work_ready, NULL);
+
+    double start = mono_seconds();
+    sched_init(&hub.sched, STRATUM_SPLIT_HALF_LIFE, start);
+    for (size_t i = 0; i < pool_count; i++) {
+        init_session(&hub.sessions[i], (int)i, pool_count > 1, &pools[i]);
+        if (opts->record_path) hub.sessions[i].recorder = &recorder;
+        sched_add(&hub.sched, pools[i].weight);
+    }
+
+    worker_pool workers;
+    if (!worker_pool_start(&workers, opts->threads, stratum_worker, &hub)) {
+        fprintf(stderr, "[stratum] falha ao iniciar threads de mineracao\n");
+        free(hub.sessions);
+        if (opts->record_path) recorder_close(&recorder);
+        return 1;
+    }
+    printf("[stratum] %d threads de hash, %zu sessao(oes)\n", workers.count, pool_count);
+
+    double last_rates = start;
+    double last_stats = start;
+    int failed = 0;
     while (!stop_flag) {
-        int sock = connect_tcp(opts->host, opts->port);
-        if (sock == -1) {
-            attempts++;
-            if (opts->max_reconnects >= 0 && attempts > opts->max_reconnects) {
-                fprintf(stderr, "[stratum] conexao falhou apos %d tentativas\n", attempts);
-                return 1;
-            }
-            fprintf(stderr, "[stratum] tentando reconectar em %d segundos...\n", opts->reconnect_delay_secs);
-            sleep((unsigned int)opts->reconnect_delay_secs);
-            continue;
+        double now = mono_seconds();
+        int alive = 0;
+        for (size_t i = 0; i < hub.count; i++) {
+            stratum_session *s = &hub.sessions[i];
+            if (s->dead) continue;
+            alive++;
+            if (s->sock == -1 && !s->connector.busy && now >= s->next_connect) session_connect(&hub, s, now);
         }
-
-        printf("[stratum] conectado a %s:%s (tentativa %d)\n", opts->host, opts->port, attempts + 1);
-        attempts = 0;
-
-        size_t bytes_out = 0;
-        size_t bytes_in = 0;
-        size_t notify_count = 0;
-        stratum_session_state session = {0};
-        mining_state miner = {0};
-        miner.start_time = (double)clock() / (double)CLOCKS_PER_SEC;
-        miner.report_interval = 100000;
-        printf("[stratum] alvo coin: %s\n", coin_type_to_name(opts->coin));
-        char subscribe[256];
-        snprintf(subscribe, sizeof(subscribe), "{\"id\":1,\"method\":\"mining.subscribe\",\"params\":[]}");
-        if (!send_line(sock, subscribe)) {
-            fprintf(stderr, "[stratum] falha ao enviar subscribe\n");
-            close(sock);
-            goto wait_reconnect;
+        if (alive == 0) {
+            failed = 1;
+            break;
         }
-        bytes_out += strlen(subscribe) + 1;
-        bitcoin_job job;
-        bitcoin_job_clear(&job);
-        recv_lines(sock, &job, NULL, &bytes_in, &session, &miner);
-
-        char authorize[512];
-        snprintf(authorize, sizeof(authorize), "{\"id\":2,\"method\":\"mining.authorize\",\"params\":[\"%s\",\"%s\"]}",
-                 opts->user ? opts->user : "", opts->password ? opts->password : "x");
-        if (!send_line(sock, authorize)) {
-            fprintf(stderr, "[stratum] falha ao enviar authorize\n");
-            close(sock);
-            goto wait_reconnect;
+
+        if (!poll_sessions(&hub, 1000)) {
+            failed = 1;
+            break;
         }
-        bytes_out += strlen(authorize) + 1;
-        printf("[stratum] aguardando mensagens (Ctrl+C para sair)...\n");
-
-        time_t last_ping = time(NULL);
-        time_t last_stats = time(NULL);
-
-        while (!stop_flag) {
-            fd_set fds;
-            FD_ZERO(&fds);
-            FD_SET(sock, &fds);
-            struct timeval tv;
-            tv.tv_sec = 5;
-            tv.tv_usec = 0;
-            int sel = select(sock + 1, &fds, NULL, NULL, &tv);
-            if (sel < 0) {
-                perror("[stratum] select");
-                break;
-            } else if (sel == 0) {
-                time_t now = time(NULL);
-                if (now - last_ping >= 30) {
-                    if (!send_ping(sock)) {
-                        fprintf(stderr, "[stratum] falha ao enviar ping\n");
-                        break;
-                    }
-                    bytes_out += 1;  // aprox
-                    last_ping = now;
-                }
-                mine_batch(sock, &job, &session, &miner, opts->user ? opts->user : "", 5000);
+        now = mono_seconds();
+        expire_submits(&hub, now);
+
+        time_t wall = time(NULL);
+        for (size_t i = 0; i < hub.count; i++) {
+            stratum_session *s = &hub.sessions[i];
+            if (s->sock == -1 || wall - s->last_ping < 30) continue;
+            if (!send_ping(s)) {
+                fprintf(stderr, "%s falha ao enviar ping\n", s->tag);
+                session_disconnect(&hub, s, now);
                 continue;
             }
+            s->last_ping = wall;
+        }
 
-            if (!recv_lines(sock, &job, &notify_count, &bytes_in, &session, &miner)) {
-                fprintf(stderr, "[stratum] conexao encerrada\n");
-                break;
+        if (now - last_rates >= 5.0) {
+            pthread_mutex_lock(&hub.lock);
+            sched_update_rates(&hub.sched, now);
+            pthread_mutex_unlock(&hub.lock);
+            last_rates = now;
+            for (size_t i = 0; i < hub.count; i++) {
+                if (hub.sessions[i].sock != -1) maybe_suggest_difficulty(&hub, &hub.sessions[i], now);
             }
-
-            time_t now = time(NULL);
-            if (now - last_stats >= 30) {
-                printf("[stratum] stats: coin=%s | notify=%zu | bytes_in=%zu | bytes_out=%zu\n",
-                       coin_type_to_name(opts->coin), notify_count, bytes_in, bytes_out);
-                if (job.last_notify[0] != '\0') {
-                    printf("[stratum] last notify: %s\n", job.last_notify);
-                }
-                if (job.parsed) {
-                    printf("[stratum] job parsed: id=%s prev=%s merkle=%zu version=%s nbits=%s ntime=%s clean=%d\n",
-                           job.job_id, job.prev_hash, job.merkle_count, job.version, job.nbits, job.ntime, job.clean_jobs);
-                }
-                if (session.difficulty > 0.0 || session.extranonce1[0] != '\0') {
-                    printf("[stratum] session: difficulty=%.8f (set %zux) extranonce1=%s extranonce2_size=%d\n",
-                           session.difficulty, session.set_difficulty_count, session.extranonce1, session.extranonce2_size);
-                }
-                if (session.submit_accepted || session.submit_rejected) {
-                    printf("[stratum] submit: accepted=%zu rejected=%zu\n",
-                           session.submit_accepted, session.submit_rejected);
-                }
-                if (session.job_changes > 0 || session.clean_signals > 0) {
-                    printf("[stratum] jobs: changes=%zu clean_signals=%zu last_job_id=%s\n",
-                           session.job_changes, session.clean_signals, session.last_job_id);
-                }
-                if (job.parsed && session.extranonce1[0] != '\0') {
-                    uint8_t merkle[32];
-                    uint8_t en2[64] = {0};
-                    size_t en2_len = 0;
-                    if (session.extranonce2_size > 0) {
-                        en2_len = (size_t)session.extranonce2_size;
-                        if (en2_len > sizeof(en2)) en2_len = sizeof(en2);
-                    }
-                    if (bitcoin_build_merkle_root(&job, session.extranonce1, en2_len ? en2 : NULL, en2_len, merkle)) {
-                        char hexroot[65];
-                        hex_from_bytes(merkle, 32, hexroot, sizeof(hexroot));
-                        printf("[stratum] merkle (with extranonce2=%zu bytes of 0x00): %s\n", en2_len, hexroot);
-                    }
-                }
-                last_stats = now;
+        }
+        if (now - last_stats >= 30.0) {
+            for (size_t i = 0; i < hub.count; i++) {
+                if (hub.sessions[i].sock != -1) print_session_stats(&hub, &hub.sessions[i]);
             }
+            print_split(&hub, now - start);
+            last_stats = now;
         }
+    }
 
-        printf("[stratum] finalizado. Notifies recebidas: %zu\n", notify_count);
-        close(sock);
+    if (!stop_flag) stop_flag = 1;
+    pthread_mutex_lock(&hub.lock);
+    pthread_cond_broadcast(&hub.work_ready);
+    pthread_mutex_unlock(&hub.lock);
+    worker_pool_join(&workers);
+    drain_submits(&hub);
 
-wait_reconnect:
-        if (stop_flag) break;
-        attempts++;
-        if (opts->max_reconnects >= 0 && attempts > opts->max_reconnects) {
-            fprintf(stderr, "[stratum] limite de reconexoes atingido (%d)\n", opts->max_reconnects);
-            return 1;
+    double now = mono_seconds();
+    sched_update_rates(&hub.sched, now);
+    print_split(&hub, now - start);
+    for (size_t i = 0; i < hub.count; i++) {
+        stratum_session *s = &hub.sessions[i];
+        if (s->sock != -1) session_disconnect(&hub, s, now);
+        print_submit_stats(s);
+        free_session(&hub, s);
+    }
+    pthread_cond_destroy(&hub.work_ready);
+    pthread_mutex_destroy(&hub.lock);
+    free(hub.sessions);
+    if (opts->record_path) recorder_close(&recorder);
+    return failed ? 1 : 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_replay_samples(const char *label, double *v, size_t n) {
+    if (n == 0) {
+        printf("[replay] %s: sem amostras\n", label);
+        return;
+    }
+    qsort(v, n, sizeof(*v), cmp_double);
+    printf("[replay] %s: n=%zu p50=%.3fms p90=%.3fms p99=%.3fms max=%.3fms\n", label, n,
+           1000.0 * v[n / 2], 1000.0 * v[(n * 9) / 10], 1000.0 * v[(n * 99) / 100], 1000.0 * v[n - 1]);
+}
+
+// Sleeps until `until` (monotonic), waking up for Ctrl+C.
+static void replay_wait(double until) {
+    while (!stop_flag) {
+        double left = until - mono_seconds();
+        if (left <= 0.0) return;
+        if (left > 0.1) left = 0.1;
+        struct timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = (long)(left * 1e9);
+        nanosleep(&ts, NULL);
+    }
+}
+
+int stratum_replay(const replay_options *ropts) {
+    signal(SIGINT, handle_stop);
+#ifdef SIGTERM
+    signal(SIGTERM, handle_stop);
+#endif
+
+    // First pass: sessions and length of the capture.
+    record_reader rd;
+    record_entry e;
+    if (!record_reader_open(&rd, ropts->path)) return 1;
+    int max_session = 0;
+    size_t total = 0;
+    double duration = 0.0;
+    int rc;
+    while ((rc = record_reader_next(&rd, &e)) == 1) {
+        if (e.session > max_session) max_session = e.session;
+        duration = e.t;
+        total++;
+    }
+    record_reader_close(&rd);
+    if (rc < 0) {
+        fprintf(stderr, "[replay] captura corrompida apos %zu linhas\n", total);
+        return 1;
+    }
+    size_t count = (size_t)max_session + 1;
+    if (count > STRATUM_MAX_POOLS) count = STRATUM_MAX_POOLS;
+    printf("[replay] %s: %zu linhas, %zu sessao(oes), %.1fs capturados (%s)\n", ropts->path, total, count, duration,
+           ropts->fast ? "sem pausas" : "velocidade original");
+
+    stratum_options opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.threads = ropts->threads;
+    opts.coin = ropts->coin;
+    opts.max_reconnects = 0;
+
+    stratum_hub hub;
+    memset(&hub, 0, sizeof(hub));
+    hub.opts = &opts;
+    hub.count = count;
+    hub.replay = 1;
+    hub.batch_nonces = STRATUM_BATCH_NONCES;
+    hub.sessions = calloc(count, sizeof(*hub.sessions));
+    if (!hub.sessions) return 1;
+    pthread_mutex_init(&hub.lock, NULL);
+    pthread_cond_init(&hub.work_ready, NULL);
+    double start = mono_seconds();
+    sched_init(&hub.sched, STRATUM_SPLIT_HALF_LIFE, start);
+    for (size_t i = 0; i < count; i++) {
+        stratum_pool_options pool;
+        memset(&pool, 0, sizeof(pool));
+        snprintf(pool.host, sizeof(pool.host), "replay");
+        snprintf(pool.user, sizeof(pool.user), "replay");
+        pool.weight = 1.0;
+        init_session(&hub.sessions[i], (int)i, count > 1, &pool);
+        hub.sessions[i].replay = 1;
+        sched_add(&hub.sched, 1.0);
+    }
+
+    worker_pool workers;
+    if (!worker_pool_start(&workers, opts.threads, stratum_worker, &hub)) {
+        fprintf(stderr, "[replay] falha ao iniciar threads de mineracao\n");
+        free(hub.sessions);
+        return 1;
+    }
+    printf("[replay] %d threads de hash\n", workers.count);
+
+    double *parse = malloc((total ? total : 1) * sizeof(*parse));
+    double *parse_notify = malloc((total ? total : 1) * sizeof(*parse_notify));
+    size_t rx = 0, tx = 0, notifies = 0;
+    size_t rx_bytes = 0;
+    double parse_sum = 0.0;
+    int failed = !parse || !parse_notify || !record_reader_open(&rd, ropts->path);
+    start = mono_seconds();
+    while (!failed && !stop_flag && (rc = record_reader_next(&rd, &e)) == 1) {
+        if (e.dir == RECORD_TX || (size_t)e.session >= count) {
+            tx++;
+            continue;
         }
-        printf("[stratum] reconectando em %d segundos (tentativa %d)...\n", opts->reconnect_delay_secs, attempts + 1);
-        sleep((unsigned int)opts->reconnect_delay_secs);
+        if (!ropts->fast) replay_wait(start + e.t);
+        stratum_session *s = &hub.sessions[e.session];
+        size_t before = s->notify_count;
+        double t0 = mono_seconds();
+        process_line(&hub, s, e.line, e.len);
+        double dt = mono_seconds() - t0;
+        parse[rx++] = dt;
+        parse_sum += dt;
+        rx_bytes += e.len;
+        if (s->notify_count != before) parse_notify[notifies++] = dt;
     }
-    return 0;
+    double elapsed = mono_seconds() - start;
+    record_reader_close(&rd);
+
+    stop_flag = stop_flag ? stop_flag : 1;
+    pthread_mutex_lock(&hub.lock);
+    pthread_cond_broadcast(&hub.work_ready);
+    pthread_mutex_unlock(&hub.lock);
+    worker_pool_join(&workers);
+
+    uint64_t hashes = 0;
+    size_t shares = 0;
+    for (size_t i = 0; i < hub.count; i++) {
+        hashes += hub.sched.slots[i].hashes;
+        shares += hub.sessions[i].shares_found;
+    }
+    printf("[replay] %zu linhas recebidas (%zu bytes), %zu enviadas ignoradas, %zu notifies em %.3fs\n",
+           rx, rx_bytes, tx, notifies, elapsed);
+    printf("[replay] hashing: %llu hashes | %.2f H/s | %zu shares\n",
+           (unsigned long long)hashes, elapsed > 0.0 ? (double)hashes / elapsed : 0.0, shares);
+    printf("[replay] parse: media=%.1fus | %.2f MB/s\n", rx ? 1e6 * parse_sum / (double)rx : 0.0,
+           parse_sum > 0.0 ? (double)rx_bytes / parse_sum / 1e6 : 0.0);
+    if (parse) print_replay_samples("process_line", parse, rx);
+    if (parse_notify) print_replay_samples("notify (parse + compilacao)", parse_notify, notifies);
+    print_replay_samples("troca de job (notify -> 1o lote)", hub.switch_samples, hub.switch_count);
+
+    for (size_t i = 0; i < hub.count; i++) free_session(&hub, &hub.sessions[i]);
+    free(parse);
+    free(parse_notify);
+    free(hub.switch_samples);
+    pthread_cond_destroy(&hub.work_ready);
+    pthread_mutex_destroy(&hub.lock);
+    free(hub.sessions);
+    if (rc < 0) fprintf(stderr, "[replay] captura corrompida; replay interrompido\n");
+    return failed || rc < 0 ? 1 : 0;
 }
@@ -4,5 +4,7 @@
 #include "common.h"
 
 int stratum_run(const stratum_options *opts);
+// Feeds a --record capture through the same parsing and hashing pipeline.
+int stratum_replay(const replay_options *opts);
 
 #endif
@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 static int read_line(FILE *f, char *buf, size_t len) {
     if (!fgets(buf, (int)len, f)) return 0;
@@ -22,14 +24,45 @@ void generate_address(char out[65]) {
     out[64] = '\0';
 }
 
+// fsyncs the directory holding `path` so a finished rename survives a crash.
+static void sync_parent_dir(const char *path) {
+    char dir[1024];
+    const char *slash = strrchr(path, '/');
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+    } else if (slash == path) {
+        snprintf(dir, sizeof(dir), "/");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+    }
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+// Writes a temporary file next to the wallet, fsyncs it and renames it over
+// the old one: readers and crashes see either the old or the new wallet.
 int save_wallet(const wallet_options *opts, const wallet_info *info) {
-    FILE *f = fopen(opts->path ? opts->path : DEFAULT_WALLET_PATH, "w");
+    const char *path = opts->path ? opts->path : DEFAULT_WALLET_PATH;
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
     if (!f) {
-        fprintf(stderr, "Nao foi possivel salvar carteira em %s\n", opts->path ? opts->path : DEFAULT_WALLET_PATH);
+        fprintf(stderr, "Nao foi possivel salvar carteira em %s\n", path);
         return 0;
     }
-    fprintf(f, "%s\n%llu\n%llu\n", info->address, (unsigned long long)info->balance, (unsigned long long)info->mined_blocks);
-    fclose(f);
+    int ok = fprintf(f, "%s\n%llu\n%llu\n", info->address, (unsigned long long)info->balance,
+                     (unsigned long long)info->mined_blocks) > 0;
+    ok = fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "Nao foi possivel salvar carteira em %s\n", path);
+        remove(tmp);
+        return 0;
+    }
+    sync_parent_dir(path);
     return 1;
 }
 
@@ -38,10 +71,13 @@ int load_wallet(const wallet_options *opts, wallet_info *info) {
     FILE *f = fopen(path, "r");
     if (!f) return 0;
     char line[128];
-    if (!read_line(f, info->address, sizeof(info->address))) {
+    // Read through a full line buffer: the 64-digit address exactly fills
+    // info->address and would leave its newline for the balance read.
+    if (!read_line(f, line, sizeof(line))) {
         fclose(f);
         return 0;
     }
+    snprintf(info->address, sizeof(info->address), "%.64s", line);
     if (!read_line(f, line, sizeof(line))) {
         fclose(f);
         return 0;
@@ -66,6 +102,8 @@ int ensure_wallet(const wallet_options *opts, wallet_info *info, int reset) {
     fresh.mined_blocks = 0;
 
     if (!save_wallet(opts, &fresh)) return 0;
+    // The ledger backs this wallet's totals, so a reset starts a new one.
+    if (reset && !ledger_rotate(opts->path ? opts->path : DEFAULT_WALLET_PATH)) return 0;
     if (info) *info = fresh;
     return 1;
 }
@@ -75,3 +113,104 @@ void print_wallet(const wallet_info *info) {
     printf("Balance: %llu coins\n", (unsigned long long)info->balance);
     printf("Mined blocks: %llu\n", (unsigned long long)info->mined_blocks);
 }
+
+static void *persister_thread(void *arg) {
+    wallet_persister *p = arg;
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->dirty && !p->stop) pthread_cond_wait(&p->wake, &p->lock);
+        if (!p->dirty) break;
+        wallet_info snapshot = p->pending;
+        p->dirty = 0;
+        ledger_record *found = p->queue;
+        size_t found_len = p->queue_len;
+        size_t found_cap = p->queue_cap;
+        p->queue = p->flushing;
+        p->queue_cap = p->flushing_cap;
+        p->queue_len = 0;
+        pthread_mutex_unlock(&p->lock);
+        // Ledger first: a balance on disk always has its blocks recorded.
+        if (p->has_ledger && !ledger_append(&p->ledger, found, found_len)) {
+            ledger_close(&p->ledger);
+            p->has_ledger = 0;
+        }
+        int ok = save_wallet(&p->opts, &snapshot);
+        pthread_mutex_lock(&p->lock);
+        p->flushing = found;
+        p->flushing_cap = found_cap;
+        p->writes++;
+        p->last_ok = ok;
+        if (!ok) p->failures++;
+
+        // Hold off so a burst of found blocks becomes one write.
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        double secs = p->opts.flush_secs;
+        until.tv_sec += (time_t)secs;
+        until.tv_nsec += (long)((secs - (double)(time_t)secs) * 1e9);
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        int rc = 0;
+        while (!p->stop && rc == 0) rc = pthread_cond_timedwait(&p->wake, &p->lock, &until);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+int wallet_persister_start(wallet_persister *p, const wallet_options *opts) {
+    memset(p, 0, sizeof(*p));
+    p->opts = *opts;
+    p->last_ok = 1;
+    p->has_ledger = ledger_open(&p->ledger, opts->path ? opts->path : DEFAULT_WALLET_PATH);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    if (pthread_create(&p->thread, NULL, persister_thread, p) != 0) {
+        pthread_cond_destroy(&p->wake);
+        pthread_mutex_destroy(&p->lock);
+        if (p->has_ledger) ledger_close(&p->ledger);
+        fprintf(stderr, "Nao foi possivel iniciar a gravacao da carteira\n");
+        return 0;
+    }
+    p->started = 1;
+    return 1;
+}
+
+void wallet_persister_post(wallet_persister *p, const wallet_info *info, const ledger_record *found) {
+    pthread_mutex_lock(&p->lock);
+    if (found) {
+        if (p->queue_len == p->queue_cap) {
+            size_t cap = p->queue_cap ? p->queue_cap * 2 : 64;
+            ledger_record *grown = realloc(p->queue, cap * sizeof(*grown));
+            if (grown) {
+                p->queue = grown;
+                p->queue_cap = cap;
+            }
+        }
+        if (p->queue_len < p->queue_cap) p->queue[p->queue_len++] = *found;
+    }
+    p->pending = *info;
+    p->dirty = 1;
+    p->posts++;
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+}
+
+int wallet_persister_stop(wallet_persister *p) {
+    if (!p->started) return 1;
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->thread, NULL);
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->lock);
+    if (p->has_ledger) ledger_close(&p->ledger);
+    free(p->queue);
+    free(p->flushing);
+    p->queue = NULL;
+    p->flushing = NULL;
+    p->started = 0;
+    return p->last_ok;
+}
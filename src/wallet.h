@@ -1,12 +1,46 @@
 #ifndef WALLET_H
 #define WALLET_H
 
+#include <pthread.h>
 #include "common.h"
+#include "ledger.h"
+
+// Background writer for wallet updates. Posts only copy the latest state
+// (and queue the found block for the ledger) under a short lock; the thread
+// coalesces them and writes at most once per flush_secs. Stop flushes
+// whatever is still pending.
+typedef struct {
+    wallet_options opts;
+    ledger ledger;
+    int has_ledger;
+    ledger_record *queue;
+    size_t queue_len;
+    size_t queue_cap;
+    ledger_record *flushing;
+    size_t flushing_cap;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    wallet_info pending;
+    int dirty;
+    int stop;
+    int started;
+    uint64_t posts;
+    uint64_t writes;
+    uint64_t failures;
+    int last_ok;
+} wallet_persister;
 
 int load_wallet(const wallet_options *opts, wallet_info *info);
 int save_wallet(const wallet_options *opts, const wallet_info *info);
 int ensure_wallet(const wallet_options *opts, wallet_info *info, int reset);
 void print_wallet(const wallet_info *info);
+
+int wallet_persister_start(wallet_persister *p, const wallet_options *opts);
+// `found` may be NULL for balance-only updates.
+void wallet_persister_post(wallet_persister *p, const wallet_info *info, const ledger_record *found);
+// Returns 0 if the last write failed.
+int wallet_persister_stop(wallet_persister *p);
 void generate_address(char out[65]);
 
 #endif
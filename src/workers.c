@@ -0,0 +1,60 @@
+#include "workers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct worker_arg {
+    worker_fn fn;
+    void *ctx;
+    int index;
+};
+
+static void *worker_main(void *p) {
+    worker_arg *arg = p;
+    arg->fn(arg->ctx, arg->index);
+    return NULL;
+}
+
+int worker_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > 256) n = 256;
+    return (int)n;
+}
+
+int worker_pool_start(worker_pool *pool, int count, worker_fn fn, void *ctx) {
+    if (!pool || !fn) return 0;
+    if (count <= 0) count = worker_default_threads();
+    pool->threads = calloc((size_t)count, sizeof(*pool->threads));
+    pool->args = calloc((size_t)count, sizeof(*pool->args));
+    pool->count = 0;
+    if (!pool->threads || !pool->args) {
+        free(pool->threads);
+        free(pool->args);
+        pool->threads = NULL;
+        pool->args = NULL;
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        pool->args[i].fn = fn;
+        pool->args[i].ctx = ctx;
+        pool->args[i].index = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->args[i]) != 0) {
+            fprintf(stderr, "[workers] falha ao criar thread %d\n", i);
+            break;
+        }
+        pool->count++;
+    }
+    return pool->count > 0;
+}
+
+void worker_pool_join(worker_pool *pool) {
+    if (!pool) return;
+    for (int i = 0; i < pool->count; i++) pthread_join(pool->threads[i], NULL);
+    free(pool->threads);
+    free(pool->args);
+    pool->threads = NULL;
+    pool->args = NULL;
+    pool->count = 0;
+}
@@ -0,0 +1,20 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <pthread.h>
+
+typedef void (*worker_fn)(void *ctx, int index);
+
+typedef struct worker_arg worker_arg;
+
+typedef struct {
+    pthread_t *threads;
+    worker_arg *args;
+    int count;
+} worker_pool;
+
+int worker_default_threads(void);
+int worker_pool_start(worker_pool *pool, int count, worker_fn fn, void *ctx);
+void worker_pool_join(worker_pool *pool);
+
+#endif